@@ -0,0 +1,200 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define ASSET_LOADER_THREADS_COUNT 2
+
+//----------------------------------------------------------------
+
+template<typename T>
+class Task;
+
+//----------------------------------------------------------------
+
+struct TaskPromiseBase
+{
+	// resumes the awaiting coroutine on the thread that completed the task
+	struct FinalAwaiter
+	{
+		bool	await_ready() const noexcept { return false; }
+
+		template<typename P>
+		std::coroutine_handle<>	await_suspend(std::coroutine_handle<P> handle) noexcept
+		{
+			TaskPromiseBase			&promise = handle.promise();
+			std::coroutine_handle<>	continuation = promise.m_Continuation;
+
+			// nothing of the frame may be touched once completed, its owner can destroy it right away
+			promise.m_IsComplete.store(true, std::memory_order_release);
+
+			return (continuation) ? continuation : std::noop_coroutine();
+		}
+
+		void	await_resume() const noexcept { }
+	}; // struct FinalAwaiter
+
+	std::suspend_always		initial_suspend() const noexcept { return { }; }
+	FinalAwaiter			final_suspend() const noexcept { return { }; }
+
+	// the engine doesn't use exceptions
+	void					unhandled_exception() const noexcept { std::terminate(); }
+
+	std::coroutine_handle<>	m_Continuation = nullptr;
+	std::atomic<bool>		m_IsComplete = false;
+}; // struct TaskPromiseBase
+
+//----------------------------------------------------------------
+
+template<typename T>
+struct TaskPromise : public TaskPromiseBase
+{
+	Task<T>		get_return_object() noexcept;
+	void		return_value(T value) { m_Value = std::move(value); }
+
+	T			m_Value;
+}; // struct TaskPromise
+
+template<>
+struct TaskPromise<void> : public TaskPromiseBase
+{
+	Task<void>	get_return_object() noexcept;
+	void		return_void() const noexcept { }
+}; // struct TaskPromise<void>
+
+//----------------------------------------------------------------
+
+// lazy coroutine, starts when awaited or spawned and resumes its awaiter when done,
+// parameters are copied in the frame so pass strings by value
+template<typename T = void>
+class Task
+{
+public:
+	using promise_type = TaskPromise<T>;
+
+	Task() : m_Handle(nullptr) { }
+	explicit Task(std::coroutine_handle<promise_type> handle) : m_Handle(handle) { }
+	Task(Task &&other) noexcept : m_Handle(std::exchange(other.m_Handle, nullptr)) { }
+	~Task() { if (m_Handle) m_Handle.destroy(); }
+
+	Task(const Task&) = delete;
+	Task&	operator=(const Task&) = delete;
+
+	Task&	operator=(Task &&other) noexcept
+	{
+		if (this != &other)
+		{
+			if (m_Handle)
+				m_Handle.destroy();
+
+			m_Handle = std::exchange(other.m_Handle, nullptr);
+		}
+
+		return *this;
+	}
+
+	// awaitable
+	bool					await_ready() const noexcept { return false; }
+
+	std::coroutine_handle<>	await_suspend(std::coroutine_handle<> awaiting) noexcept
+	{
+		m_Handle.promise().m_Continuation = awaiting;
+		return m_Handle;
+	}
+
+	T						await_resume()
+	{
+		if constexpr (!std::is_void_v<T>)
+			return std::move(m_Handle.promise().m_Value);
+	}
+
+	// getters
+	bool					IsComplete() const { return !m_Handle || m_Handle.promise().m_IsComplete.load(std::memory_order_acquire); }
+	std::coroutine_handle<>	GetHandle() const { return m_Handle; }
+
+private:
+	std::coroutine_handle<promise_type>	m_Handle;
+}; // class Task
+
+//----------------------------------------------------------------
+
+template<typename T>
+Task<T>	TaskPromise<T>::get_return_object() noexcept { return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this)); }
+
+inline Task<void>	TaskPromise<void>::get_return_object() noexcept { return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this)); }
+
+//----------------------------------------------------------------
+
+// runs the loading coroutines, co_await ToWorker() moves them to the loading threads for decoding and importing,
+// co_await ToRenderThread() moves them back to the render thread for anything touching the GPU or the scene
+class AssetLoader
+{
+public:
+	struct WorkerAwaiter
+	{
+		bool	await_ready() const noexcept { return false; }
+		void	await_suspend(std::coroutine_handle<> handle) const { m_Loader->PushWorker(handle); }
+		void	await_resume() const noexcept { }
+
+		AssetLoader	*m_Loader;
+	}; // struct WorkerAwaiter
+
+	struct RenderThreadAwaiter
+	{
+		bool	await_ready() const noexcept { return false; }
+		void	await_suspend(std::coroutine_handle<> handle) const { m_Loader->PushRenderThread(handle); }
+		void	await_resume() const noexcept { }
+
+		AssetLoader	*m_Loader;
+	}; // struct RenderThreadAwaiter
+
+	AssetLoader() = delete;
+	AssetLoader(uint32_t threadsCount);
+	~AssetLoader();
+
+	WorkerAwaiter			ToWorker() { return { this }; }
+	RenderThreadAwaiter		ToRenderThread() { return { this }; }
+
+	// starts the task on the calling thread, the loader owns it until it completes
+	void					Spawn(Task<> &&task);
+
+	// resumes the coroutines waiting for the render thread and releases the completed tasks,
+	// call it on the render thread between frames
+	void					Update();
+
+	// pumps Update until every spawned task completed, for the assets nothing can be rendered without
+	void					RunUntilIdle();
+
+	// getters
+	uint32_t				GetPendingTasksCount() const { return static_cast<uint32_t>(m_Tasks.size()); }
+
+private:
+	void					PushWorker(std::coroutine_handle<> handle);
+	void					PushRenderThread(std::coroutine_handle<> handle);
+
+	ThreadPool								*m_ThreadPool;
+	std::atomic<uint32_t>					m_NextThread;
+
+	std::mutex								m_Mutex;
+	bool									m_IsShuttingDown;
+	std::vector<std::coroutine_handle<>>	m_RenderThreadQueue;
+
+	std::vector<Task<>>						m_Tasks; // spawned, render thread only
+}; // class AssetLoader
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -28,9 +28,9 @@ enum BUFFER_TYPE
 template<typename T>
 struct Buffer
 {
-	Buffer() {};
+	Buffer() : m_Buffer(nullptr), m_Size(0) {};
 
-	// static buffer
+	// static buffer, transfer destinations live in device local memory and are filled by the UploadManager
 	Buffer(const VkDevice logicalDevice, BUFFER_TYPE type, uint32_t dataCount)
 	{
 		m_Size = sizeof(T) * dataCount;
@@ -41,10 +41,12 @@ struct Buffer
 		VkMemoryRequirements	memRequirements;
 		vkGetBufferMemoryRequirements(logicalDevice, m_Buffer, &memRequirements);
 
-		if (!Device::m_Device->AllocateMemory(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_Memory))
+		const VkMemoryPropertyFlags	memoryType = (type & BUFFER_TYPE::TransferDest) ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		if (!Device::m_Device->GetMemoryAllocator()->Allocate(memRequirements, memoryType, true, false, m_Allocation))
 			std::cout << "Can't allocate memory for buffer" << std::endl; // TODO: change this for real logger
 
-		CHECK_API_SUCCESS(vkBindBufferMemory(logicalDevice, m_Buffer, m_Memory, 0));
+		CHECK_API_SUCCESS(vkBindBufferMemory(logicalDevice, m_Buffer, m_Allocation.m_Memory, m_Allocation.m_Offset));
 	}
 
 	// dynamic buffer
@@ -58,60 +60,61 @@ struct Buffer
 		VkMemoryRequirements	memRequirements;
 		vkGetBufferMemoryRequirements(logicalDevice, m_Buffer, &memRequirements);
 
-		if (!Device::m_Device->AllocateMemory(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_Memory))
+		if (!Device::m_Device->GetMemoryAllocator()->Allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true, false, m_Allocation))
 			std::cout << "Can't allocate memory for buffer" << std::endl; // TODO: change this for real logger
 
-		CHECK_API_SUCCESS(vkBindBufferMemory(logicalDevice, m_Buffer, m_Memory, 0));
+		CHECK_API_SUCCESS(vkBindBufferMemory(logicalDevice, m_Buffer, m_Allocation.m_Memory, m_Allocation.m_Offset));
 	}
 
 	void			Destroy(const VkDevice logicalDevice)
 	{
 		if (m_Buffer != nullptr)
 			vkDestroyBuffer(logicalDevice, m_Buffer, nullptr);
-		if (m_Memory != nullptr)
-			vkFreeMemory(logicalDevice, m_Memory, nullptr);
+
+		Device::m_Device->GetMemoryAllocator()->Free(m_Allocation);
 	}
 
+	// host visible memory is persistently mapped by the allocator
+
 	// static buffer
 	void			UpdateData(const VkDevice logicalDevice, const std::vector<T> &data)
 	{
-		void	*mappedData;
-		vkMapMemory(logicalDevice, m_Memory, 0, m_Size, 0, &mappedData);
-		memcpy(mappedData, data.data(), static_cast<size_t>(m_Size));
-		vkUnmapMemory(logicalDevice, m_Memory);
+		memcpy(m_Allocation.m_MappedData, data.data(), static_cast<size_t>(m_Size));
 	}
 
 	// dynamic buffer
 	void			UpdateData(const VkDevice logicalDevice, const T *data)
 	{
-		void	*mappedData;
-		vkMapMemory(logicalDevice, m_Memory, 0, m_Size, 0, &mappedData);
-		memcpy(mappedData, data, static_cast<size_t>(m_Size));
-		vkUnmapMemory(logicalDevice, m_Memory);
+		memcpy(m_Allocation.m_MappedData, data, static_cast<size_t>(m_Size));
 	}
 
-	void			UpdateData(const VkDevice logicalDevice, const std::vector<std::vector<T>> &data)
+	// static host visible buffer, count elements from first
+	void			UpdateRange(const VkDevice logicalDevice, const T *data, uint32_t first, uint32_t count)
 	{
-		void			*mappedData;
-		vkMapMemory(logicalDevice, m_Memory, 0, m_Size, 0, &mappedData);
+		memcpy(static_cast<T*>(m_Allocation.m_MappedData) + first, data, sizeof(T) * count);
+	}
 
+	void			UpdateData(const VkDevice logicalDevice, const std::vector<std::vector<T>> &data)
+	{
 		const uint32_t	dataCount = static_cast<uint32_t>(data.size());
 		for (uint32_t dataIndex = 0; dataIndex < dataCount; ++dataIndex)
 		{
 			const uint32_t	dataSize = static_cast<uint32_t>(data[dataIndex].size());
-			memcpy((char*)(mappedData) + dataSize * dataIndex, data[dataIndex].data(), dataSize);
+			memcpy(static_cast<char*>(m_Allocation.m_MappedData) + dataSize * dataIndex, data[dataIndex].data(), dataSize);
 		}
-
-		vkUnmapMemory(logicalDevice, m_Memory);
 	}
 
+	// host visible buffer, read back once the GPU is done with it
+	const T*		GetMappedData() const { return static_cast<const T*>(m_Allocation.m_MappedData); }
+
 	const VkBuffer	GetApiBuffer() const { return m_Buffer; }
+	uint64_t		GetSize() const { return m_Size; }
 
 private:
-	VkBuffer		m_Buffer;
-	VkDeviceMemory	m_Memory;
+	VkBuffer			m_Buffer;
+	MemoryAllocation	m_Allocation;
 
-	uint64_t		m_Size;
+	uint64_t			m_Size;
 }; // struct Buffer
 
 //----------------------------------------------------------------
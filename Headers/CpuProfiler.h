@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Utility.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define CPU_PROFILER_EVENTS_PER_THREAD 16384 // ring buffer, the oldest zones are overwritten
+#define CPU_PROFILER_DUMP_FRAMES 120
+#define CPU_PROFILER_TRACE_PATH "cpu_trace.json"
+
+//----------------------------------------------------------------
+
+// define LIGHTLYY_DISABLE_PROFILER to compile the zones out
+#if defined(LIGHTLYY_DISABLE_PROFILER)
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#else
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) Lightlyy::CpuZone PROFILE_CONCAT(cpuZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#endif
+
+//----------------------------------------------------------------
+
+// name must outlive the profiler, string literals and __FUNCTION__ only
+struct CpuEvent
+{
+	const char	*m_Name;
+	uint64_t	m_Begin; // nanoseconds since the profiler creation
+	uint64_t	m_End;
+	uint64_t	m_Frame;
+}; // struct CpuEvent
+
+//----------------------------------------------------------------
+
+// scoped zones recorded per thread without locks, each thread writes its own ring buffer
+// and only publishes the written count, the dump reads the last frames as Chrome trace events
+class CpuProfiler
+{
+public:
+	CpuProfiler();
+	~CpuProfiler();
+
+	static CpuProfiler	m_Profiler;
+
+	static uint64_t		Now() { return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Profiler.m_StartTime).count()); }
+
+	void				Record(const char *name, uint64_t begin, uint64_t end);
+
+	// zones are tagged with the frame they end in
+	void				SetFrame(uint64_t frame) { m_Frame.store(frame, std::memory_order_relaxed); }
+
+	// name shown in the trace for the calling thread
+	void				SetThreadName(const char *name);
+
+	// writes the zones of the last framesCount frames, load the file in chrome://tracing or Perfetto
+	bool				DumpChromeTrace(const char *path, uint32_t framesCount) const;
+
+	void				SetEnabled(bool enabled) { m_Enabled.store(enabled, std::memory_order_relaxed); }
+
+	// getters
+	bool				IsEnabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+
+private:
+	struct ThreadBuffer
+	{
+		std::vector<CpuEvent>	m_Events;
+		std::atomic<uint64_t>	m_WrittenCount;
+		uint32_t				m_ThreadId;
+		std::string				m_Name;
+	}; // struct ThreadBuffer
+
+	ThreadBuffer*		GetThreadBuffer();
+
+	std::chrono::steady_clock::time_point	m_StartTime;
+
+	std::atomic<bool>			m_Enabled;
+	std::atomic<uint64_t>		m_Frame;
+
+	// only touched when a thread records its first zone and when dumping
+	mutable std::mutex			m_BuffersMutex;
+	std::vector<ThreadBuffer*>	m_Buffers;
+}; // class CpuProfiler
+
+//----------------------------------------------------------------
+
+class CpuZone
+{
+public:
+	CpuZone(const char *name) : m_Name(name), m_Begin(CpuProfiler::Now()) { }
+	~CpuZone() { CpuProfiler::m_Profiler.Record(m_Name, m_Begin, CpuProfiler::Now()); }
+
+	CpuZone(const CpuZone&) = delete;
+	CpuZone&	operator=(const CpuZone&) = delete;
+
+private:
+	const char	*m_Name;
+	uint64_t	m_Begin;
+}; // class CpuZone
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
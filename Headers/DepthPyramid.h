@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include "Initializers.h"
+#include "MemoryAllocator.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define DEPTH_PYRAMID_GROUP_SIZE 8 // texels per side of a work group of DepthPyramid.comp
+#define DEPTH_PYRAMID_FORMAT VK_FORMAT_R32_SFLOAT
+
+class RenderHandle;
+
+//----------------------------------------------------------------
+
+// farthest depth of the opaque meshes over blocks of growing size, what the occlusion tests compare the nearest depth of a box to,
+// the first level is the largest power of two below the depth attachment and each next one halves it down to a single texel,
+// levels are reduced by compute from the depth attachment once the opaque meshes are drawn and kept for the next frame
+class DepthPyramid
+{
+public:
+	DepthPyramid() = delete;
+	DepthPyramid(const RenderHandle *renderHandle);
+	~DepthPyramid();
+
+	DepthPyramid(const DepthPyramid&) = delete;
+	DepthPyramid&	operator=(const DepthPyramid&) = delete;
+
+	// the depth attachment must have been created with the sampled usage, the resolve module reads it when multisampled
+	bool			Setup(	const VkDevice logicalDevice, const VkImageView depthImageView, const VkExtent2D &depthExtent, VkSampleCountFlagBits depthSamples,
+							const VkShaderModule reduceModule, const VkShaderModule resolveModule);
+	void			Shutdown(const VkDevice logicalDevice);
+
+	// outside of any render pass, the depth attachment is given back in the layout it was drawn in
+	void			Record(const VkCommandBuffer commandBuffer, const VkImage depthImage);
+
+	// getters
+	VkDescriptorImageInfo	GetImageInfo() const; // every level, nearest filter, GENERAL layout
+	VkExtent2D		GetExtent() const { return m_Extent; }
+	uint32_t		GetLevelsCount() const { return m_LevelsCount; }
+	bool			IsBuilt() const { return m_IsBuilt; } // a level is read before the first build otherwise
+
+private:
+	bool			CreateImage(const VkDevice logicalDevice);
+	bool			CreateDescriptorSets(const VkDevice logicalDevice, const VkImageView depthImageView);
+	bool			CreatePipelines(const VkDevice logicalDevice, const VkShaderModule reduceModule, const VkShaderModule resolveModule);
+
+	const RenderHandle			*m_RenderHandle;
+
+	VkExtent2D					m_DepthExtent;
+	bool						m_IsMultisampled;
+
+	VkImage						m_Image;
+	MemoryAllocation			m_Allocation;
+	VkImageView					m_ImageView; // every level, read by the occlusion tests
+	std::vector<VkImageView>	m_LevelViews; // one per level, written by the reduction
+	VkSampler					m_Sampler;
+	VkExtent2D					m_Extent; // of the first level
+	uint32_t					m_LevelsCount;
+
+	VkDescriptorPool			m_DescriptorPool;
+	VkDescriptorSetLayout		m_SetLayout;
+	std::vector<VkDescriptorSet>	m_LevelSets; // input then output, the depth attachment for the first level
+
+	VkPipelineLayout			m_PipelineLayout;
+	VkPipeline					m_ReducePipeline;
+	VkPipeline					m_ResolvePipeline; // first level of a multisampled depth attachment, null otherwise
+
+	bool						m_IsBuilt;
+}; // class DepthPyramid
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
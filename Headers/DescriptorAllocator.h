@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Initializers.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define DESCRIPTOR_POOL_SETS_COUNT 128 // sets per pool, another pool is chained once they are all used
+
+// descriptors per set a pool is sized for, the per mesh set is the largest one
+#define DESCRIPTOR_POOL_SAMPLERS_PER_SET 4
+#define DESCRIPTOR_POOL_UNIFORMS_PER_SET 5
+#define DESCRIPTOR_POOL_ATTACHMENTS_COUNT 4 // only the offscreen set reads an input attachment
+
+//----------------------------------------------------------------
+
+// descriptor sets of one frame in flight, allocated from a chain of pools that grows on demand,
+// the pools are created with FREE_DESCRIPTOR_SET so that sets can be freed one by one
+class DescriptorAllocator
+{
+public:
+	DescriptorAllocator();
+	~DescriptorAllocator();
+
+	bool		Prepare(const VkDevice logicalDevice);
+	void		Shutdown(const VkDevice logicalDevice);
+
+	// render thread only, the set is freed back to outPool by its owner once no frame in flight uses it
+	bool		Allocate(const VkDevice logicalDevice, const VkDescriptorSetLayout layout, VkDescriptorSet &outSet, VkDescriptorPool &outPool);
+
+	// getters
+	uint32_t	GetPoolsCount() const { return static_cast<uint32_t>(m_Pools.size()); }
+
+private:
+	bool		AddPool(const VkDevice logicalDevice);
+
+	std::vector<VkDescriptorPool>	m_Pools;
+}; // class DescriptorAllocator
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
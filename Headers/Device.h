@@ -4,9 +4,12 @@
 #include <chrono>
 
 #include "Initializers.h"
+#include "VertexData.h"
 #include "Window.h"
 #include "RenderHandle.h"
-#include "imgui/UI.h"
+#include "MemoryAllocator.h"
+#include "AssetLoader.h"
+#include "Imgui/UI.h"
 
 //----------------------------------------------------------------
 
@@ -20,24 +23,86 @@ class Scene;
 
 //----------------------------------------------------------------
 
+struct DeviceSettings
+{
+	DeviceSettings() : m_PendingFrames(2), m_PresentMode(VK_PRESENT_MODE_FIFO_KHR), m_LowLatency(false), m_Headless(false), m_Extent({ 1280, 720 }), m_FramesCount(0), m_TracePath(std::string()), m_ConvertTexturesPath(std::string()), m_TextureBudget(0), m_VertexLayout(VERTEX_LAYOUT::Full), m_BvhBenchmarkCount(0), m_CullBenchmarkCount(0), m_RecordBenchmarkFrames(0), m_GpuCulling(false), m_OcclusionCulling(false) { }
+
+	// --headless --frames <count> --width <pixels> --height <pixels> --pending-frames <count>
+	// --present-mode <fifo|mailbox|immediate> --low-latency --trace <path> --convert-textures <folder>
+	// --texture-budget <megabytes> --vertex-layout <full|compact|quantized> --bvh-benchmark <objects> --cull-benchmark <objects>
+	// --record-benchmark <frames> --gpu-culling --occlusion-culling, returns false on unknown or malformed options
+	bool				ParseCommandLine(int argc, const char * const *argv);
+
+	uint32_t			m_PendingFrames; // frames in flight, clamped to [1, MAX_PENDING_FRAMES]
+	VkPresentModeKHR	m_PresentMode; // FIFO, MAILBOX or IMMEDIATE, fallback on FIFO if not supported
+	bool				m_LowLatency; // sample inputs right before recording instead of after present
+
+	bool				m_Headless; // no window nor UI, frames are rendered into offscreen targets
+	VkExtent2D			m_Extent; // offscreen targets size, the window size comes from the surface
+	uint32_t			m_FramesCount; // frames to render before exiting, 0 runs until the window is closed
+
+	std::string			m_TracePath; // CPU trace of the last frames written on exit, none when empty
+	std::string			m_ConvertTexturesPath; // images of this folder converted to KTX2 before the scene loads, none when empty
+	uint32_t			m_TextureBudget; // megabytes of mips of the streamed textures, 0 uploads every texture whole
+	VERTEX_LAYOUT		m_VertexLayout; // of every mesh, the pipelines are built for this one only
+	uint32_t			m_BvhBenchmarkCount; // objects count up to which the spatial queries are measured before the scene loads, 0 skips it
+	uint32_t			m_CullBenchmarkCount; // same for the frustum culling kernel against its scalar path
+	uint32_t			m_RecordBenchmarkFrames; // frames measured per record threads count, from one to every worker, the sweep ends the run, 0 skips it
+	bool				m_GpuCulling; // camera and cascade views culled by a compute pass and drawn indirectly, when the device supports it
+	bool				m_OcclusionCulling; // the GPU culled meshes are also tested against a depth pyramid, implies m_GpuCulling
+}; // struct DeviceSettings
+
+//----------------------------------------------------------------
+
+// smoothed per frame timings, in milliseconds
+struct FrameMetrics
+{
+	FrameMetrics() : m_CpuWaitTime(0.f), m_InputToPresentSubmitTime(0.f) { }
+
+	float	m_CpuWaitTime; // blocked on the frame slot timeline or fence, the image acquire is not included
+	float	m_InputToPresentSubmitTime; // from inputs sampling to vkQueuePresentKHR returning for the frame using them
+}; // struct FrameMetrics
+
+//----------------------------------------------------------------
+
 class Device
 {
 public:
 	Device() = delete;
-	Device(const char *applicationName, const char *engineName);
+	Device(const char *applicationName, const char *engineName, const DeviceSettings &settings = DeviceSettings());
 	~Device();
 
 	bool					Setup();
 	void					Update();
 
-	bool					AllocateMemory(VkMemoryRequirements memoryRequirements, VkMemoryPropertyFlags memoryType, VkDeviceMemory &outMemory);
 	uint32_t				FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
+	// any thread, optimal tiling images of this format can be sampled with linear filtering
+	bool					SupportsSampledFormat(VkFormat format) const;
+
+	// shadow casters in front of the near plane are flattened onto it instead of clipped
+	bool					SupportsDepthClamp() const { return m_DepthClamp; }
+
+	// requested and supported: indirect draws with a GPU count and non uniform indexing of sampler arrays
+	bool					UsesGpuCulling() const { return m_GpuCulling; }
+	bool					UsesOcclusionCulling() const { return m_GpuCulling && m_Settings.m_OcclusionCulling; } // nothing more than the GPU culling is required
+
 	// getters
 	float					GetDeltaTime() const { return m_DeltaTime; }
 	uint64_t				GetUBOMinAlignment() const { return m_PhysicalDeviceProperties.limits.minUniformBufferOffsetAlignment; }
 	VkSampleCountFlagBits	GetMaxAALevel() const { return m_MaxAALevel; }
-	const VkDescriptorPool	GetDescriptorPool() const { return m_DescriptorPool; }
+	const VkDescriptorPool	GetDescriptorPool() const { return m_DescriptorPool; } // UI only
+	const DeviceSettings&	GetSettings() const { return m_Settings; }
+	const FrameMetrics&		GetFrameMetrics() const { return m_FrameMetrics; }
+	VkPresentModeKHR		GetPresentMode() const { return m_RenderHandle->GetPresentMode(); }
+	bool					UsesTimelineSemaphore() const { return m_RenderHandle->UsesTimelineSemaphore(); }
+	UploadManager*			GetUploadManager() const { return m_RenderHandle->GetUploadManager(); }
+	GpuProfiler*			GetGpuProfiler() const { return m_RenderHandle->GetGpuProfiler(); }
+	TextureRegistry*		GetTextureRegistry() const { return m_RenderHandle->GetTextureRegistry(); }
+	GeometryPool*			GetGeometryPool() const { return m_RenderHandle->GetGeometryPool(); } // null without GPU culling
+	DescriptorAllocator*	GetDescriptorAllocator(uint32_t frameIndex) const { return m_RenderHandle->GetDescriptorAllocator(frameIndex); }
+	MemoryAllocator*		GetMemoryAllocator() const { return m_MemoryAllocator; }
+	AssetLoader*			GetAssetLoader() const { return m_AssetLoader; }
 
 	static std::unique_ptr<Device>			m_Device;
 
@@ -48,7 +113,15 @@ private:
 
 	bool		CreateDescriptorPool();
 
+	bool		IsRunning() const;
+
+	// once the frame is rendered, measures its record time and moves to the next threads count
+	void		UpdateRecordBenchmark();
+
 	bool		HasRequiredFeatures();
+	bool		HasTimelineSemaphore() const;
+	bool		HasGpuCulling() const;
+	bool		HasDeviceExtension(const char *extensionName) const;
 
 	void		LoadMemoryProperties();
 	void		RetrieveMaxAntialiasingLevel();
@@ -56,10 +129,14 @@ private:
 	const char								*m_ApplicationName;
 	const char								*m_EngineName;
 
+	DeviceSettings							m_Settings;
+
 	Window									*m_Window;
 	RenderHandle							*m_RenderHandle;
 	UI										*m_UI;
 	Scene									*m_Scene;
+	MemoryAllocator							*m_MemoryAllocator;
+	AssetLoader								*m_AssetLoader;
 
 	uint32_t								m_MaxPhysicalDevicesCount;
 
@@ -67,6 +144,14 @@ private:
 	chrono_time								m_PreviousTime;
 	float									m_DeltaTime;
 
+	chrono_time								m_InputTime;
+	FrameMetrics							m_FrameMetrics;
+
+	uint32_t								m_RecordBenchmarkThreads; // measured now, past the workers count once the sweep is done
+	uint32_t								m_RecordBenchmarkFrame;
+	float									m_RecordBenchmarkTime; // summed over the frames of the threads count
+	float									m_RecordBenchmarkSerialTime; // average with a single thread
+
 	uint64_t								m_Frame;
 
 	// ==== Vulkan Data ====
@@ -76,6 +161,10 @@ private:
 	VkPhysicalDeviceProperties				m_PhysicalDeviceProperties;
 
 	VkDevice								m_LogicalDevice;
+	bool									m_TimelineSemaphore;
+	bool									m_TextureCompressionBC;
+	bool									m_DepthClamp;
+	bool									m_GpuCulling;
 
 	VkPhysicalDeviceMemoryProperties		m_MemoryProperties;
 	std::vector<VkMemoryPropertyFlags>		m_MemoryPropertiesFlags;
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Initializers.h"
+#include "RenderCommand.h"
+#include "UniformArena.h"
+#include "DescriptorAllocator.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define MAX_PENDING_FRAMES 4
+#define FRAME_WAIT_TIMEOUT 1000000000ull // 1s in nanoseconds, waits are retried and reported past it
+
+//----------------------------------------------------------------
+
+// resources owned by one frame in flight, they can be reused as soon as the frame timeline reaches
+// m_TimelineValue (or m_Fence is signaled when timeline semaphores aren't supported)
+struct FrameContext
+{
+	FrameContext();
+
+	bool							Setup(const std::vector<VkQueueFamilyProperties> &queuesFamilyProperties);
+	bool							Prepare(const VkDevice logicalDevice, uint32_t threadCommandsCount, VkDeviceSize uniformAlignment);
+	void							Shutdown(const VkDevice logicalDevice);
+
+	void							Reset();
+
+	VkFence							m_Fence;
+	VkSemaphore						m_AcquireSemaphore;
+	VkSemaphore						m_PresentSemaphore;
+
+	// value signaled on the render handle timeline by the last submission of this frame
+	uint64_t						m_TimelineValue;
+
+	RenderCommand					*m_RenderCommand;
+
+	// per frame constants, rewound on Reset
+	UniformArena					*m_UniformArena;
+
+	// descriptor sets written against this frame's uniform arena, freed by their owner
+	DescriptorAllocator				*m_DescriptorAllocator;
+
+	// secondary command pools for parallel recording, one per worker and one extra slot for the main thread
+	std::vector<SecondaryCommand*>	m_ThreadCommands;
+}; // struct FrameContext
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+
+#include "Initializers.h"
+#include "VertexData.h"
+#include "Buffer.h"
+#include "RangeAllocator.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define GEOMETRY_POOL_VERTICES_COUNT (1 << 21) // of every mesh, in the vertex layout of the device
+#define GEOMETRY_POOL_INDICES_COUNT (1 << 23) // 32 bit, a mesh not fitting in either keeps buffers of its own
+
+class RenderHandle;
+
+//----------------------------------------------------------------
+
+// part of the pool a mesh lives in, the indices are relative to its first vertex
+struct GeometryRange
+{
+	GeometryRange() : m_FirstVertex(0), m_VerticesCount(0), m_FirstIndex(0), m_IndicesCount(0) { }
+
+	bool		IsValid() const { return m_IndicesCount > 0; }
+
+	uint32_t	m_FirstVertex;
+	uint32_t	m_VerticesCount;
+	uint32_t	m_FirstIndex;
+	uint32_t	m_IndicesCount;
+}; // struct GeometryRange
+
+//----------------------------------------------------------------
+
+// vertex streams and 32 bit indices of every mesh in three device local buffers, bound once for all the draws of a pass,
+// which is what lets the indirect draws reach any mesh, a freed range is reused once no frame in flight reads it
+class GeometryPool
+{
+public:
+	GeometryPool() = delete;
+	GeometryPool(const RenderHandle *renderHandle);
+	~GeometryPool();
+
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool&	operator=(const GeometryPool&) = delete;
+
+	bool			Prepare(const VkDevice logicalDevice, VERTEX_LAYOUT vertexLayout);
+	void			Shutdown(const VkDevice logicalDevice);
+
+	// render thread, false when the vertices or the indices don't fit
+	bool			Allocate(uint32_t verticesCount, uint32_t indicesCount, GeometryRange &outRange);
+	void			Free(const GeometryRange &range);
+
+	// streams in the vertex layout of the pool, 16 bit indices are widened on the way, false when the upload couldn't be recorded
+	bool			Upload(const GeometryRange &range, const void *positions, const void *attributes, const void *indices, uint32_t indexSize);
+
+	// render thread, once the frame slot is free: makes the ranges no frame in flight can still read available again
+	void			Collect(uint32_t pendingFramesCount);
+
+	// position stream alone for the depth only passes
+	void			BindBuffers(const VkCommandBuffer commandBuffer, bool positionsOnly) const;
+
+	// getters
+	VERTEX_LAYOUT	GetVertexLayout() const { return m_VertexLayout; }
+	uint32_t		GetUsedVerticesCount() const { return m_Vertices.GetUsedCount(); }
+	uint32_t		GetUsedIndicesCount() const { return m_Indices.GetUsedCount(); }
+
+private:
+	struct ReleasedRange
+	{
+		GeometryRange	m_Range;
+		uint64_t		m_ReleaseFrame;
+	}; // struct ReleasedRange
+
+	const RenderHandle			*m_RenderHandle;
+
+	VERTEX_LAYOUT				m_VertexLayout;
+
+	Buffer<uint8_t>				m_PositionBuffer;
+	Buffer<uint8_t>				m_AttributeBuffer;
+	Buffer<uint32_t>			m_IndexBuffer;
+
+	RangeAllocator				m_Vertices;
+	RangeAllocator				m_Indices;
+
+	std::vector<ReleasedRange>	m_ReleasedRanges;
+	uint64_t					m_Frame;
+}; // class GeometryPool
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Initializers.h"
+#include "Buffer.h"
+#include "Mesh.h"
+#include "Shadow.h"
+#include "GeometryPool.h"
+#include "Tools/FrustumCulling.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define GPU_CULLING_MAX_OBJECTS 4096 // meshes of the pool, each has a slot in the objects buffer and in the textures array
+#define GPU_CULLING_MAX_SUBMESHES 32768 // of every level of every mesh
+#define GPU_CULLING_MAX_DRAWS 16384 // per draw list, a submesh is drawn once per list at most
+#define GPU_CULLING_GROUP_SIZE 64 // objects per work group of CullMeshes.comp
+#define GPU_CULLING_VIEWS_COUNT (1 + SHADOWMAP_CASCADE_COUNT) // camera then cascades
+#define GPU_CULLING_SHARED_SAMPLERS_COUNT 3 // skybox and shadow maps, sampled by every indirect draw next to the textures array
+
+// draw lists, each one GPU_CULLING_MAX_DRAWS long with its count
+#define GPU_CULLING_LIST_OPAQUE 0 // camera, drawn before the depth pyramid is built
+#define GPU_CULLING_LIST_TRANSPARENT 1 // camera
+#define GPU_CULLING_LIST_OPAQUE_LATE 2 // camera, occluded in the last frame pyramid but not in the new one
+#define GPU_CULLING_LIST_CASCADE 3 // first cascade, one list per cascade
+#define GPU_CULLING_DRAW_LISTS_COUNT (GPU_CULLING_LIST_CASCADE + SHADOWMAP_CASCADE_COUNT)
+
+// counters after the draw counts, read back once the frame slot is reused
+#define GPU_CULLING_STAT_TESTED 0 // camera objects in the frustum, tested for occlusion
+#define GPU_CULLING_STAT_OCCLUDED 1 // of them, hidden in both pyramids
+#define GPU_CULLING_STATS_COUNT 2
+
+// what a dispatch of CullMeshes.comp does
+#define GPU_CULLING_PHASE_ALL 0 // every view, frustum and size tests only
+#define GPU_CULLING_PHASE_EARLY 1 // every view, the camera opaque objects are also tested against the last frame pyramid and flagged when hidden, transparent ones wait
+#define GPU_CULLING_PHASE_LATE 2 // camera only, the flagged and transparent objects are tested against the new pyramid
+
+//----------------------------------------------------------------
+
+// the structures below mirror the declarations of the shaders, std430 for the storage buffers and std140 for the views
+
+// one mesh, indexed by the firstInstance of its draws
+struct GpuCullingObject
+{
+	glm::mat4	m_Model; // with the dequantization, what the positions are transformed with
+	glm::vec4	m_Center; // world space center of the box, radius of the bounding sphere in w
+	glm::vec4	m_Extent; // world space half sizes, largest scale of the model in w
+	glm::vec4	m_Albedo; // opaque when uint(a) == 1, as in Mesh::Render
+	glm::vec4	m_Surface; // roughness, metallic, reflectance and lod bias
+	glm::uvec4	m_LodFirstSubmesh; // in the submeshes buffer, per level
+	glm::uvec4	m_LodSubmeshesCount;
+	glm::vec4	m_LodErrors; // object space, 0 for the first level
+	uint32_t	m_LodsCount; // 0 for a free slot, never drawn
+	uint32_t	m_TextureIndex; // in the textures array of the draw set
+	uint32_t	m_Padding[2];
+}; // struct GpuCullingObject
+
+static_assert(MESH_LOD_MAX_COUNT == 4, "GpuCullingObject keeps the levels in 4 component vectors");
+static_assert(sizeof(GpuCullingObject) % 16 == 0, "GpuCullingObject must match its std430 declaration");
+
+// draw template, copied into the draw list of every view the object is visible in
+struct GpuCullingSubmesh
+{
+	uint32_t	m_FirstIndex; // in the geometry pool
+	uint32_t	m_IndicesCount;
+	int32_t		m_VertexOffset; // in the geometry pool
+	uint32_t	m_ObjectIndex;
+}; // struct GpuCullingSubmesh
+
+struct GpuCullingView
+{
+	glm::mat4	m_ViewProj; // the occlusion tests project the boxes with it, camera only
+	glm::vec4	m_Planes[6];
+	glm::vec4	m_RowW;
+	float		m_RowWLength;
+	float		m_PixelsPerUnit;
+	float		m_MinPixels;
+	float		m_LodErrorPixels;
+	uint32_t	m_DrawList; // opaque list, the camera appends its transparent draws to the next one
+	uint32_t	m_SplitsOpacity;
+	uint32_t	m_IsActive; // cascades without light draw nothing
+	uint32_t	m_LateDrawList; // opaque objects found visible by the late phase
+}; // struct GpuCullingView
+
+static_assert(sizeof(GpuCullingView) % 16 == 0, "GpuCullingView must match its std140 declaration");
+
+// push constants of CullMeshes.comp
+struct GpuCullingPass
+{
+	uint32_t	m_ObjectsCount;
+	uint32_t	m_Phase; // GPU_CULLING_PHASE_*
+	float		m_PyramidWidth; // first level of the depth pyramid, 0 skips the occlusion tests
+	float		m_PyramidHeight;
+}; // struct GpuCullingPass
+
+// what the indirect draws bind besides the objects and their textures, the uniforms live in the frame uniform arenas
+struct GpuCullingBindings
+{
+	VkDescriptorImageInfo	m_Fallback; // free slots of the textures array
+	VkDescriptorImageInfo	m_Skybox;
+	VkDescriptorImageInfo	m_ShadowCascade;
+	VkDescriptorImageInfo	m_ShadowSpotLight;
+	VkDescriptorImageInfo	m_DepthPyramid; // the fallback without occlusion culling, never sampled then
+
+	VkDeviceSize			m_VPRange;
+	VkDeviceSize			m_LightsRange;
+	VkDeviceSize			m_ShadowCascadeRange;
+	VkDeviceSize			m_ShadowSpotLightRange;
+}; // struct GpuCullingBindings
+
+//----------------------------------------------------------------
+
+// meshes of the geometry pool culled by a compute pass against the camera and each cascade, which selects their level
+// and compacts the draws of the survivors into indirect command lists, drawn with the count the pass wrote,
+// the objects are mirrored in the host visible buffers of every frame slot and only the changed slots are copied,
+// with occlusion culling the camera is culled in two phases around the build of the depth pyramid
+class GpuCulling
+{
+public:
+	GpuCulling() = delete;
+	GpuCulling(const RenderHandle *renderHandle);
+	~GpuCulling();
+
+	GpuCulling(const GpuCulling&) = delete;
+	GpuCulling&		operator=(const GpuCulling&) = delete;
+
+	bool			Setup(const VkDevice logicalDevice, const VkShaderModule cullModule, const GpuCullingBindings &bindings);
+	void			Shutdown(const VkDevice logicalDevice);
+
+	// false when the mesh isn't in the geometry pool or every slot or submesh is taken, the mesh is drawn on the CPU path then
+	bool			AddMesh(Mesh *mesh, uint32_t &outSlot);
+	void			RemoveMesh(uint32_t slot);
+
+	// render thread, for a mesh whose transform or material changed, rebuilds the slot and copies it in the next frames
+	void			UpdateObject(uint32_t slot, Mesh *mesh);
+
+	// the descriptor set of the frame must not be used by a frame in flight
+	void			UpdateTexture(const VkDevice logicalDevice, uint32_t frameIndex, uint32_t slot, const Texture &texture);
+
+	// rebinds the uniform arena of the frame once it was recreated, same conditions as UpdateTexture
+	void			UpdateUniformBuffer(const VkDevice logicalDevice, uint32_t frameIndex) const;
+
+	// render thread, in Prepare: views of the frame, no cascade view without light, and the slots changed since the frame slot was written,
+	// the occlusion counters of the last frame drawn in this slot are read back too
+	void			UpdateFrame(const VkDevice logicalDevice, uint32_t frameIndex,
+								const CullingView &cameraView, const glm::mat4 &cameraViewProj, float lodErrorPixels,
+								const CullingView *cascadeViews, uint32_t cascadeViewsCount, float shadowLodErrorPixels);
+
+	// outside of any render pass: GPU_CULLING_PHASE_ALL or EARLY before the views are drawn, LATE once the depth pyramid is built,
+	// an empty pyramid extent skips the occlusion tests
+	void			RecordCulling(const VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t phase, const VkExtent2D &pyramidExtent) const;
+
+	// the pipeline is bound by the caller, the draw set takes the VP, lights, cascade and spot light offsets
+	void			DrawObjects(const VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t drawList, const uint32_t *dynamicOffsets) const;
+	void			DrawCascade(const VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t cascadeIndex, uint32_t cascadeOffset) const;
+
+	// getters
+	VkPipelineLayout	GetDrawPipelineLayout() const { return m_DrawPipelineLayout; }
+	VkPipelineLayout	GetShadowPipelineLayout() const { return m_ShadowPipelineLayout; }
+	uint32_t		GetObjectsCount() const { return m_SlotsCount - static_cast<uint32_t>(m_FreeSlots.size()); }
+	uint32_t		GetTestedCount() const { return m_TestedCount; } // last frame read back
+	uint32_t		GetOccludedCount() const { return m_OccludedCount; }
+	float			GetOcclusionRate() const { return m_OcclusionRate; } // smoothed, occluded over tested
+
+private:
+	struct SubmeshRange
+	{
+		uint32_t	m_First;
+		uint32_t	m_Count;
+	}; // struct SubmeshRange
+
+	struct DirtySlot
+	{
+		uint32_t	m_Slot;
+		uint32_t	m_FramesLeft; // frame slots whose buffer doesn't have the change yet
+	}; // struct DirtySlot
+
+	struct DirtySubmeshes
+	{
+		SubmeshRange	m_Range;
+		uint32_t		m_FramesLeft;
+	}; // struct DirtySubmeshes
+
+	struct FrameResources
+	{
+		Buffer<GpuCullingObject>				m_ObjectBuffer; // host visible
+		Buffer<GpuCullingSubmesh>				m_SubmeshBuffer;
+		Buffer<GpuCullingView>					m_ViewBuffer;
+		Buffer<VkDrawIndexedIndirectCommand>	m_DrawBuffer; // GPU_CULLING_MAX_DRAWS per list
+		Buffer<uint32_t>						m_CountBuffer; // per list, then the occlusion counters
+		Buffer<uint32_t>						m_StatsBuffer; // host visible copy of the occlusion counters
+
+		VkDescriptorSet							m_CullSet;
+		VkDescriptorSet							m_DrawSet;
+		VkDescriptorSet							m_ShadowSet;
+	}; // struct FrameResources
+
+	bool			CreateDescriptorSets(const VkDevice logicalDevice, const GpuCullingBindings &bindings);
+	bool			CreatePipelines(const VkDevice logicalDevice, const VkShaderModule cullModule);
+
+	void			BuildObject(uint32_t slot, Mesh *mesh, GpuCullingObject &outObject) const;
+	void			MarkDirty(uint32_t slot);
+	void			WriteTexture(const VkDevice logicalDevice, uint32_t frameIndex, uint32_t slot, const VkDescriptorImageInfo &imageInfo) const;
+
+	void			DrawList(const VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t drawList) const;
+
+	const RenderHandle				*m_RenderHandle;
+
+	std::vector<FrameResources>		m_Frames; // per frame slot
+	Buffer<uint32_t>				m_VisibilityBuffer; // per slot, flagged by the early phase for the late one, shared by the frame slots which cull in submission order
+
+	VkDescriptorPool				m_DescriptorPool;
+	VkDescriptorSetLayout			m_CullSetLayout;
+	VkDescriptorSetLayout			m_DrawSetLayout;
+	VkDescriptorSetLayout			m_ShadowSetLayout;
+
+	VkPipelineLayout				m_CullPipelineLayout;
+	VkPipeline						m_CullPipeline;
+	VkPipelineLayout				m_DrawPipelineLayout;
+	VkPipelineLayout				m_ShadowPipelineLayout;
+
+	VkDescriptorImageInfo			m_FallbackImage;
+	GpuCullingBindings				m_UniformRanges; // only its ranges are read again, its images may have been released since
+
+	std::vector<GpuCullingObject>	m_Objects; // CPU copy of every slot
+	std::vector<GpuCullingSubmesh>	m_Submeshes;
+	std::vector<SubmeshRange>		m_SlotSubmeshes; // per slot
+	std::vector<uint64_t>			m_TextureVersions; // per frame slot and slot, image version in the textures array, UINT64_MAX for the fallback
+	std::vector<uint32_t>			m_FreeSlots;
+	uint32_t						m_SlotsCount; // highest slot in use + 1 at most, the pass is dispatched over them
+	RangeAllocator					m_SubmeshRanges;
+
+	std::vector<DirtySlot>			m_DirtySlots;
+	std::vector<uint32_t>			m_SlotDirtyIndices; // per slot, in m_DirtySlots, UINT32_MAX when clean
+	std::vector<DirtySubmeshes>		m_DirtySubmeshes;
+
+	uint32_t						m_TestedCount;
+	uint32_t						m_OccludedCount;
+	float							m_OcclusionRate;
+}; // class GpuCulling
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+
+#include "Initializers.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define GPU_PROFILER_MAX_SCOPES 32 // per frame, each scope uses two timestamp queries
+#define GPU_PROFILER_SMOOTHING 0.05f
+
+//----------------------------------------------------------------
+
+// timings of one named scope, in milliseconds
+struct GpuScope
+{
+	GpuScope() : m_Name(std::string()), m_Time(0.f), m_AverageTime(0.f), m_SamplesCount(0) { }
+
+	std::string	m_Name;
+
+	float		m_Time; // last resolved frame
+	float		m_AverageTime; // exponential moving average
+	uint32_t	m_SamplesCount;
+}; // struct GpuScope
+
+//----------------------------------------------------------------
+
+// timestamp queries around passes, one query pool per frame in flight,
+// results are read back when the frame slot is reused so that they never stall the CPU
+class GpuProfiler
+{
+public:
+	GpuProfiler();
+	~GpuProfiler();
+
+	bool					Prepare(const VkDevice logicalDevice, uint32_t pendingFrames, float timestampPeriod, uint32_t timestampValidBits);
+	void					Shutdown();
+
+	// resolve the scopes last recorded in this frame slot then reset its queries,
+	// must be called outside of any render pass once the frame fence or timeline has been waited on
+	void					BeginFrame(const VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+	// begin and end can be written in different command buffers as long as they execute in that order,
+	// returns the scope id to give back to EndScope, UINT32_MAX when disabled or full
+	uint32_t				BeginScope(const VkCommandBuffer commandBuffer, const char *name);
+	void					EndScope(const VkCommandBuffer commandBuffer, uint32_t scopeId);
+
+	const GpuScope*			FindScope(const char *name) const;
+
+	// getters
+	bool					IsEnabled() const { return m_Enabled; }
+	const std::vector<GpuScope>&	GetScopes() const { return m_Scopes; }
+	float					GetFrameTime() const { return m_FrameTime; }
+
+private:
+	struct FrameQueries
+	{
+		VkQueryPool				m_QueryPool;
+		std::vector<uint32_t>	m_Scopes; // scope index per recorded begin/end pair
+	}; // struct FrameQueries
+
+	uint32_t				GetScopeIndex(const char *name);
+
+	VkDevice					m_LogicalDevice;
+
+	bool						m_Enabled;
+	float						m_TimestampPeriod; // nanoseconds per tick
+	uint64_t					m_TimestampMask;
+
+	std::vector<FrameQueries>	m_Frames;
+	uint32_t					m_CurrentFrame;
+
+	std::vector<GpuScope>		m_Scopes; // in first recorded order
+	float						m_FrameTime; // sum of the scopes averages
+}; // class GpuProfiler
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -18,7 +18,17 @@ LIGHTLYY_BEGIN
 //----------------------------------------------------------------
 
 class Scene;
-class Mesh;
+
+//----------------------------------------------------------------
+
+// entry of the Add > Mesh menu, loaded when picked
+struct UIMeshAsset
+{
+	const char	*m_Name;
+	const char	*m_Path;
+	const char	*m_TexturePath; // empty keeps the imported material
+	glm::vec3	m_Scale;
+}; // struct UIMeshAsset
 
 //----------------------------------------------------------------
 
@@ -56,9 +66,14 @@ public:
 private:
 	bool	UploadFont(const UIInitInfo &initInfo);
 
+	// a click outside the panels selects the mesh or light under the cursor
+	void	PickObject();
+
 	void	RenderHierarchyPanel();
 	void	RenderObjectPanel(Object *object);
 	void	RenderCascadeShadowPanel();
+	void	RenderStatisticsPanel();
+	void	RenderGpuProfilerPanel();
 	void	MeshObjectPanel(Object *object);
 	void	LightObjectPanel(Object *object);
 
@@ -69,10 +84,12 @@ private:
 
 	bool				m_HierarchyVisible;
 	bool				m_ObjectPanelVisible;
+	bool				m_StatisticsVisible;
+	bool				m_GpuProfilerVisible;
 
 	int32_t				m_ObjectSelectedIndex;
 
-	std::vector<Mesh*>	m_Meshes;
+	std::vector<UIMeshAsset>	m_MeshAssets;
 }; // class UI
 
 //----------------------------------------------------------------
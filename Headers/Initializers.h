@@ -19,7 +19,9 @@
 
 //----------------------------------------------------------------
 
+#if defined(_WIN32)
 #include <SDKDDKVer.h>
+#endif
 
 #include "volk/volk.h"
 
@@ -75,7 +77,7 @@ namespace Initializers
 				appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 				appInfo.pEngineName = engineName;
 				appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-				appInfo.apiVersion = VK_API_VERSION_1_0;
+				appInfo.apiVersion = VK_API_VERSION_1_1; // vkGetPhysicalDeviceFeatures2 for optional device features
 			}
 
 			return appInfo;
@@ -141,6 +143,7 @@ namespace Initializers
 
 	namespace Surface
 	{
+#if defined(_WIN32)
 		inline VkWin32SurfaceCreateInfoKHR	CreateInfo(HINSTANCE moduleInstance, HWND windowHandle)
 		{
 			VkWin32SurfaceCreateInfoKHR	surfaceInfo = { };
@@ -152,6 +155,7 @@ namespace Initializers
 
 			return surfaceInfo;
 		}
+#endif
 
 	} // namespace Surface
 
@@ -322,7 +326,7 @@ namespace Initializers
 			VkCommandPoolCreateInfo	commandPoolInfo = { };
 			{
 				commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-				commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+				commandPoolInfo.flags = createFlags;
 				commandPoolInfo.queueFamilyIndex = queueFamilyIndex;
 			}
 
@@ -424,6 +428,19 @@ namespace Initializers
 			return allocInfo;
 		}
 
+		inline VkCommandBufferInheritanceInfo	InheritanceInfo(const VkRenderPass renderPass, uint32_t subpass, const VkFramebuffer frameBuffer)
+		{
+			VkCommandBufferInheritanceInfo inheritanceInfo = { };
+			{
+				inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+				inheritanceInfo.renderPass = renderPass;
+				inheritanceInfo.subpass = subpass;
+				inheritanceInfo.framebuffer = frameBuffer;
+			}
+
+			return inheritanceInfo;
+		}
+
 	} // namespace Command
 
 	namespace Fence
@@ -452,6 +469,32 @@ namespace Initializers
 			return semInfo;
 		}
 
+		// chain into VkSemaphoreCreateInfo::pNext to create a timeline semaphore
+		inline VkSemaphoreTypeCreateInfoKHR	TypeCreateInfo(uint64_t initialValue)
+		{
+			VkSemaphoreTypeCreateInfoKHR typeInfo = { };
+			{
+				typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+				typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+				typeInfo.initialValue = initialValue;
+			}
+
+			return typeInfo;
+		}
+
+		inline VkSemaphoreWaitInfoKHR		WaitInfo(const VkSemaphore *semaphore, const uint64_t *value)
+		{
+			VkSemaphoreWaitInfoKHR waitInfo = { };
+			{
+				waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+				waitInfo.semaphoreCount = 1;
+				waitInfo.pSemaphores = semaphore;
+				waitInfo.pValues = value;
+			}
+
+			return waitInfo;
+		}
+
 	} // namespace Semaphore
 
 	namespace Debug
@@ -74,7 +74,7 @@ public:
 
 	void	SetLuminousFlow(const float luminousFlow) { m_LuminousFlow = luminousFlow; };
 	void	SetColor(glm::vec4 color) { m_Data.m_Color = color; }
-	void	SetRadius(const float radius) { m_Data.m_Radius = radius; };
+	void	SetRadius(const float radius) { m_Data.m_Radius = radius; MarkDirty(); }; // the range is boxed in the objects tree
 	void	SetAttenuation(const float attenuation) { m_Data.m_Attenuation = attenuation; };
 	void	SetIntensity(const float intensity) { m_Data.m_Intensity = intensity; };
 	void	SetAngle(const float angle) { m_Data.m_Angle = angle; };
@@ -2,7 +2,7 @@
 
 #include "glm/glm.hpp"
 
-#include "Texture.h"
+#include "TextureRegistry.h"
 
 //----------------------------------------------------------------
 
@@ -34,29 +34,28 @@ class Material
 public:
 	// Constructor
 	Material();
-	Material(const std::string &texturePath);
-	Material(const std::string &texturePath, const std::string &normalPath);
+	Material(const TextureHandle &texture, const TextureHandle &normalTexture = nullptr);
 
 	// Getter
 	float		GetRoughness() const { return m_Data.m_Roughness; };
 	float		GetMetallic() const { return m_Data.m_Metallic; };
 	float		GetReflectance() const { return m_Data.m_Reflectance; };
 	glm::vec4	GetAlbedo() const { return m_Data.m_Albedo; };
-	Texture&	GetTexture() { return m_Texture; };
-	Texture&	GetNormalTexture() { return m_NormalTexture; };
+	const TextureHandle&	GetTexture() const { return m_Texture; }; // null when the material has none
+	const TextureHandle&	GetNormalTexture() const { return m_NormalTexture; };
 
 	// Setter
 	void		SetRoughness(const float roughness) { m_Data.m_Roughness = roughness; };
 	void		SetMetallic(const float metallic) { m_Data.m_Metallic = metallic; };
 	void		SetReflectance(const float reflectance) { m_Data.m_Reflectance = reflectance; };
 	void		SetAlbedo(const glm::vec4 &albedo) { m_Data.m_Albedo = albedo; };
-	void		SetTexture(const Texture &texture) { m_Texture = texture; };
+	void		SetTexture(const TextureHandle &texture) { m_Texture = texture; };
 
 private:
 	MaterialData	m_Data;
 
-	Texture			m_Texture;
-	Texture			m_NormalTexture;
+	TextureHandle	m_Texture;
+	TextureHandle	m_NormalTexture;
 }; // class Material
 
 //----------------------------------------------------------------
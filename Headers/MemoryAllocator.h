@@ -0,0 +1,140 @@
+#pragma once
+
+#include <set>
+#include <mutex>
+
+#include "Initializers.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define MEMORY_BLOCK_SIZE				(64ull << 20) // 64MB, power of two
+#define MEMORY_MIN_ALLOCATION_SIZE		256ull // smallest buddy, power of two
+#define MEMORY_DEDICATED_THRESHOLD		(MEMORY_BLOCK_SIZE / 4) // bigger requests get their own VkDeviceMemory
+
+//----------------------------------------------------------------
+
+class MemoryBlock;
+
+//----------------------------------------------------------------
+
+struct MemoryAllocation
+{
+	MemoryAllocation() : m_Memory(nullptr), m_Offset(0), m_Size(0), m_RequestedSize(0), m_MappedData(nullptr), m_Block(nullptr) { }
+
+	VkDeviceMemory	m_Memory;
+	VkDeviceSize	m_Offset;
+	VkDeviceSize	m_Size; // buddy size, or requested size for dedicated allocations
+	VkDeviceSize	m_RequestedSize;
+
+	void			*m_MappedData; // host visible memory stays mapped, nullptr otherwise
+
+	MemoryBlock		*m_Block; // nullptr for dedicated allocations
+}; // struct MemoryAllocation
+
+//----------------------------------------------------------------
+
+struct MemoryStatistics
+{
+	MemoryStatistics() : m_BlocksCount(0), m_DedicatedCount(0), m_AllocationsCount(0), m_ReservedSize(0), m_AllocatedSize(0), m_UsedSize(0), m_FreeSize(0), m_LargestFreeSize(0) { }
+
+	uint32_t		m_BlocksCount;
+	uint32_t		m_DedicatedCount;
+	uint32_t		m_AllocationsCount; // sub-allocations and dedicated ones
+
+	VkDeviceSize	m_ReservedSize; // every VkDeviceMemory
+	VkDeviceSize	m_AllocatedSize; // rounded to buddy sizes
+	VkDeviceSize	m_UsedSize; // as requested by resources
+	VkDeviceSize	m_FreeSize; // left in blocks
+	VkDeviceSize	m_LargestFreeSize;
+
+	// share of free block memory not usable by the largest request, and padding lost to buddy rounding
+	float			GetExternalFragmentation() const { return (m_FreeSize > 0) ? 1.f - static_cast<float>(m_LargestFreeSize) / static_cast<float>(m_FreeSize) : 0.f; }
+	float			GetInternalFragmentation() const { return (m_AllocatedSize > 0) ? 1.f - static_cast<float>(m_UsedSize) / static_cast<float>(m_AllocatedSize) : 0.f; }
+}; // struct MemoryStatistics
+
+//----------------------------------------------------------------
+
+// one VkDeviceMemory split with a buddy allocator
+class MemoryBlock
+{
+public:
+	MemoryBlock(uint32_t poolIndex);
+	~MemoryBlock();
+
+	bool				Create(const VkDevice logicalDevice, uint32_t memoryTypeIndex, bool mapped);
+	void				Destroy(const VkDevice logicalDevice);
+
+	bool				Allocate(VkDeviceSize size, VkDeviceSize &outOffset, VkDeviceSize &outSize);
+	void				Free(VkDeviceSize offset, VkDeviceSize size);
+
+	VkDeviceSize		GetLargestFreeSize() const;
+
+	// getters
+	VkDeviceMemory		GetMemory() const { return m_Memory; }
+	void*				GetMappedData() const { return m_MappedData; }
+	uint32_t			GetPoolIndex() const { return m_PoolIndex; }
+	VkDeviceSize		GetAllocatedSize() const { return m_AllocatedSize; }
+	bool				IsEmpty() const { return m_AllocatedSize == 0; }
+
+private:
+	uint32_t			GetOrder(VkDeviceSize size) const;
+
+	VkDeviceMemory						m_Memory;
+	void								*m_MappedData;
+
+	uint32_t							m_PoolIndex;
+	VkDeviceSize						m_AllocatedSize;
+
+	// free offsets per order, order n holds blocks of MEMORY_MIN_ALLOCATION_SIZE << n bytes
+	std::vector<std::set<VkDeviceSize>>	m_FreeLists;
+}; // class MemoryBlock
+
+//----------------------------------------------------------------
+
+// sub-allocates resources from large blocks, one pool per memory type and resource kind
+// (linear or optimal) so that bufferImageGranularity never has to be considered
+class MemoryAllocator
+{
+public:
+	MemoryAllocator();
+	~MemoryAllocator();
+
+	bool				Setup(const VkDevice logicalDevice, const VkPhysicalDeviceMemoryProperties &memoryProperties);
+	void				Shutdown();
+
+	bool				Allocate(	const VkMemoryRequirements &memoryRequirements,
+									VkMemoryPropertyFlags memoryType,
+									bool linearResource,
+									bool dedicated,
+									MemoryAllocation &outAllocation);
+	void				Free(MemoryAllocation &allocation);
+
+	MemoryStatistics	GetStatistics() const;
+
+private:
+	bool				AllocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, MemoryAllocation &outAllocation);
+	bool				AllocateFromPool(const VkMemoryRequirements &memoryRequirements, uint32_t memoryTypeIndex, bool linearResource, MemoryAllocation &outAllocation);
+
+	bool				FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t &outTypeIndex) const;
+
+	VkDevice								m_LogicalDevice;
+	VkPhysicalDeviceMemoryProperties		m_MemoryProperties;
+
+	// indexed by memory type * 2 + (linear ? 0 : 1)
+	std::vector<std::vector<MemoryBlock*>>	m_Pools;
+
+	uint32_t								m_DedicatedCount;
+	VkDeviceSize							m_DedicatedSize;
+	uint32_t								m_SubAllocationsCount;
+	VkDeviceSize							m_UsedSize;
+
+	mutable std::mutex						m_Lock;
+}; // class MemoryAllocator
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
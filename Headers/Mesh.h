@@ -7,6 +7,9 @@
 #include "Material.h"
 #include "Buffer.h"
 #include "VertexData.h"
+#include "GeometryPool.h"
+#include "AssetLoader.h"
+#include "Tools/MeshCache.h"
 
 //----------------------------------------------------------------
 
@@ -14,6 +17,12 @@ LIGHTLYY_BEGIN
 
 //----------------------------------------------------------------
 
+// import time level of detail chain, each level targets half the indices of the previous one
+#define MESH_LOD_MIN_REDUCTION 0.85f // a level keeping more indices of the previous one than that isn't worth its memory, the chain stops there
+#define MESH_LOD_MAX_ERROR 0.02f // relative to the bounds diagonal, the simplification stops there
+
+//----------------------------------------------------------------
+
 struct MeshData
 {
 	glm::mat4				m_Model;
@@ -30,21 +39,46 @@ struct MeshData
 class Mesh : public Object
 {
 public:
-	// Constructor
+	// Constructor, loads and uploads right away
 	Mesh(const VkDevice logicalDevice, const std::string &path, const std::string &name);
 
+	// Constructor, nothing is loaded until LoadAsync
+	Mesh(const std::string &path, const std::string &name);
+
 	// Destructor
 	virtual ~Mesh();
 
-	void			Render(const VkCommandBuffer commandBuffer, uint32_t isOpaque);
+	// imports or maps the cache and decodes the textures on a loading thread, creates the buffers and the images on the render thread
+	Task<bool>		LoadAsync(AssetLoader &loader, const VkDevice logicalDevice);
+
+	void			Render(const VkCommandBuffer commandBuffer, uint32_t isOpaque, uint32_t lodIndex);
+
+	// position stream only, every submesh of the level whatever the opacity, for the depth only pipelines
+	void			RenderDepth(const VkCommandBuffer commandBuffer, uint32_t lodIndex);
 
-	void			UpdateData(const VkDevice logicalDevice, const std::vector<VertexData> &vertices, const std::vector<uint16_t> &indices);
+	// coarsest level whose error, projected by viewProj on a target viewSize pixels high, stays under errorPixels,
+	// works for perspective and orthographic views alike, the full detail when the view is inside the bounds
+	uint32_t		SelectLod(const glm::mat4 &viewProj, float viewSize, float errorPixels) const;
+
+	// the pointers are read during the call only, their sizes are the ones the buffers were created with,
+	// false when no staging memory was left for the upload
+	bool			UpdateData(const VkDevice logicalDevice, const std::vector<VertexData> &vertices, const std::vector<uint16_t> &indices);
+	bool			UpdateData(const VkDevice logicalDevice, const void *positions, const void *attributes, const void *indices); // streams already in m_VertexLayout
 
 	// Getter
 	std::string		GetPath() const { return m_Path; };
 	bool			IsOpaque() const { return m_IsOpaque; }
-	Material&		GetMaterial() { return m_Material; };
+	const Material&	GetMaterial() const { return m_Material; };
 	float			GetLodBias() const { return m_LodBias; }
+	const std::vector<Submesh>&	GetSubmeshes() const { return m_Submeshes; } // of every level, see GetLods
+	const std::vector<MeshLod>&	GetLods() const { return m_Lods; }
+	uint32_t		GetLodIndicesCount(uint32_t lodIndex) const;
+	const glm::vec3&	GetBoundsMin() const { return m_BoundsMin; } // object space
+	const glm::vec3&	GetBoundsMax() const { return m_BoundsMax; }
+	float			GetBoundsRadius() const { return m_BoundsRadius; } // bounding sphere centered on the box, tighter than its half diagonal
+	VERTEX_LAYOUT	GetVertexLayout() const { return m_VertexLayout; }
+	const GeometryRange&	GetGeometryRange() const { return m_GeometryRange; } // invalid without pool or when the mesh didn't fit in it
+	const glm::mat4&	GetDequantization() const { return m_Dequantization; } // applied before the model matrix
 
 	// Setter
 	virtual void	SetPosition(const glm::vec3 &position) override { Object::SetPosition(position); };
@@ -52,20 +86,62 @@ public:
 	virtual void	SetScale(const glm::vec3 &scale) override { Object::SetScale(scale); };
 
 	void			SetPath(const std::string &path) { m_Path = path; };
-	void			SetOpaque(const bool &opaque) { m_IsOpaque = opaque; };
-	void			SetMaterial(const Material &material) { m_Material = material; };
-	void			SetLodBias(float lodBias) { m_LodBias = lodBias; };
+	void			SetOpaque(const bool &opaque) { m_IsOpaque = opaque; MarkDirty(); };
+	void			SetMaterial(const Material &material) { m_Material = material; MarkDirty(); };
+	void			SetLodBias(float lodBias) { m_LodBias = lodBias; MarkDirty(); };
 
 protected:
+	// CPU side of a load, either the mapped cache or the freshly imported data
+	struct MeshSource
+	{
+		MeshCache::View			m_Cache;
+		MeshCache::MeshData		m_ImportedData;
+		std::vector<uint8_t>	m_Positions; // streams encoded in the vertex layout
+		std::vector<uint8_t>	m_Attributes;
+		PendingTexture			m_Texture;
+		PendingTexture			m_NormalTexture;
+	}; // struct MeshSource
+
+	// no GPU access, safe on any thread
+	bool					LoadSource(MeshSource &outSource) const;
+	bool					Import(uint32_t importFlags, MeshCache::MeshData &outData) const;
+	static float			ComputeBoundsRadius(const VertexData *vertices, uint32_t verticesCount, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+	static void				DecodeMaterial(	const Submesh *submeshes, uint32_t submeshesCount, const MeshCache::Material *materials, uint32_t materialsCount,
+											MeshSource &outSource);
+
+	bool					CreateFromSource(const VkDevice logicalDevice, MeshSource &source);
+
+	// a range of the geometry pool, buffers of its own without pool or when it is full
+	void					AllocateBuffers(const VkDevice logicalDevice, uint32_t verticesCount, uint32_t indicesCount, uint32_t indexSize);
+	void					DestroyBuffers();
+	bool					CreateBuffers(	const VkDevice logicalDevice,
+											const void *positions, const void *attributes, uint32_t verticesCount,
+											const void *indices, uint32_t indicesCount, uint32_t indexSize,
+											const Submesh *submeshes, uint32_t submeshesCount, const MeshLod *lods, uint32_t lodsCount);
+
 	std::string				m_Path;
 	bool					m_IsOpaque;
 	Material				m_Material;
-	std::vector<uint16_t>	m_Indices;
+	std::vector<uint16_t>	m_Indices; // only kept by procedural meshes
+	std::vector<Submesh>	m_Submeshes;
+	std::vector<MeshLod>	m_Lods; // full detail first, never empty once created
+	VkIndexType				m_IndexType;
+
+	glm::vec3				m_BoundsMin;
+	glm::vec3				m_BoundsMax;
+	float					m_BoundsRadius;
 
 	float					m_LodBias;
 
-	Buffer<VertexData>		m_VertexBuffer;
-	Buffer<uint16_t>		m_IndexBuffer;
+	VERTEX_LAYOUT			m_VertexLayout; // from the device settings
+	glm::mat4				m_Dequantization;
+
+	GeometryRange			m_GeometryRange; // indices widened to 32 bit there, m_IndexType is the one of the source
+
+	Buffer<uint8_t>			m_PositionBuffer; // streams encoded in m_VertexLayout, only outside of the pool
+	Buffer<uint8_t>			m_AttributeBuffer;
+	Buffer<uint8_t>			m_IndexBuffer; // 16 or 32 bit indices, see m_IndexType
+	VkDevice				m_BuffersDevice; // the one the buffers above were created on, null without them
 }; // class Mesh
 
 //----------------------------------------------------------------
@@ -38,7 +38,7 @@ public:
 
 	glm::vec3			GetEulerAngles() const { return m_EulerAngles; }
 
-	glm::mat4&			GetModel() { return m_Model; };
+	const glm::mat4&	GetModel() const { return m_Model; };
 
 	const std::string&	GetName() const { return m_Name; }
 
@@ -53,6 +53,14 @@ public:
 
 	void				SetName(std::string newName) { m_Name = newName; }
 
+	// changed since the scene last refitted its bounds and uploaded it, the first change of a frame queues it in the scene list
+	bool				IsDirty() const { return m_IsDirty; }
+	void				MarkDirty();
+	void				ClearDirty() { m_IsDirty = false; }
+
+	// set by the scene holding the object, clean from there on
+	void				SetDirtyList(std::vector<Object*> *dirtyObjects) { m_DirtyObjects = dirtyObjects; m_IsDirty = false; }
+
 protected:
 	void				UpdateMatrix();
 
@@ -67,6 +75,9 @@ protected:
 	std::string	m_Name;
 
 	OBJECT_TYPE	m_Type;
+
+	bool					m_IsDirty;
+	std::vector<Object*>	*m_DirtyObjects; // owned by the scene, nullptr while the object isn't in one
 }; // class Object
 
 //----------------------------------------------------------------
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Utility.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+// contiguous ranges in a fixed capacity, first fit, a freed range is merged with its free neighbours
+class RangeAllocator
+{
+public:
+	RangeAllocator() : m_Capacity(0), m_UsedCount(0) { }
+
+	void			Reset(uint32_t capacity);
+
+	// first element of the range, UINT32_MAX when no free range is large enough
+	uint32_t		Allocate(uint32_t count);
+	void			Free(uint32_t first, uint32_t count);
+
+	// getters
+	uint32_t		GetCapacity() const { return m_Capacity; }
+	uint32_t		GetUsedCount() const { return m_UsedCount; }
+
+private:
+	struct Range
+	{
+		uint32_t	m_First;
+		uint32_t	m_Count;
+	}; // struct Range
+
+	std::vector<Range>	m_FreeRanges; // sorted by first element
+	uint32_t			m_Capacity;
+	uint32_t			m_UsedCount;
+}; // class RangeAllocator
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
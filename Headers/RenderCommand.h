@@ -10,10 +10,6 @@ LIGHTLYY_BEGIN
 
 //----------------------------------------------------------------
 
-struct Texture;
-
-//----------------------------------------------------------------
-
 enum COMMAND_TYPE
 {
 	GraphicsOp = 1,
@@ -49,7 +45,6 @@ public:
 	void					Shutdown(const VkDevice logicalDevice);
 
 	void					Begin();
-	void					SingleSubmit(const Texture &texture, VkBuffer buffer, VkImageSubresourceRange subRange, bool generateMipmaps);
 	void					End();
 	void					Reset();
 
@@ -58,6 +53,7 @@ public:
 	// getters
 	const VkCommandBuffer	GetBuffer() const { return m_CommandBuffer; }
 	const Queue&			GetQueue() const { return m_Queue; }
+	const VkCommandPool		GetPool() const { return m_CommandPool; }
 
 private:
 	bool			CreateCommandPool(const VkDevice logicalDevice);
@@ -78,4 +74,30 @@ private:
 
 //----------------------------------------------------------------
 
+// command pool owned by a single recording thread, it hands out secondary command buffers
+// which are recycled all at once by Reset() when the frame using them is done
+class SecondaryCommand
+{
+public:
+	SecondaryCommand();
+	~SecondaryCommand();
+
+	bool					Prepare(const VkDevice logicalDevice, uint32_t queueFamilyIndex);
+	void					Shutdown();
+
+	VkCommandBuffer			Begin(const VkCommandBufferInheritanceInfo &inheritanceInfo);
+	void					End(const VkCommandBuffer commandBuffer);
+	void					Reset();
+
+private:
+	VkDevice						m_LogicalDevice;
+
+	VkCommandPool					m_CommandPool;
+	std::vector<VkCommandBuffer>	m_CommandBuffers;
+
+	uint32_t						m_UsedCount;
+}; // class SecondaryCommand
+
+//----------------------------------------------------------------
+
 LIGHTLYY_END
@@ -3,6 +3,12 @@
 #include "Initializers.h"
 #include "Window.h"
 #include "RenderCommand.h"
+#include "FrameContext.h"
+#include "UploadManager.h"
+#include "GpuProfiler.h"
+#include "TextureRegistry.h"
+#include "MemoryAllocator.h"
+#include "ThreadPool.h"
 
 //----------------------------------------------------------------
 
@@ -11,6 +17,7 @@ LIGHTLYY_BEGIN
 //----------------------------------------------------------------
 
 class	Mesh;
+class	GeometryPool;
 struct	Skybox;
 
 //----------------------------------------------------------------
@@ -48,12 +55,13 @@ public:
 	RenderHandle();
 	~RenderHandle();
 
+	// a null window sets up a headless render handle, frames are rendered into offscreen targets
 	bool								Setup(	const VkInstance instance,
 												const Window *window,
 												const VkPhysicalDevice physicalDevice,
-												const std::vector<COMMAND_TYPE> &renderCommandsType,
-												uint32_t pendingFrames);
-	bool								Prepare(const VkPhysicalDevice physicalDevice, const VkDevice logicalDevice);
+												uint32_t pendingFrames,
+												uint32_t recordThreadsCount);
+	bool								Prepare(const VkPhysicalDevice physicalDevice, const VkDevice logicalDevice, bool useTimelineSemaphore);
 	void								Shutdown(const VkInstance instance, const VkDevice logicalDevice);
 
 	void								BeginRender(const VkDevice logicalDevice);
@@ -63,14 +71,18 @@ public:
 														const VkDevice logicalDevice,
 														const SWAPCHAIN_USAGE swapchainUsage,
 														bool useSRGB,
+														VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR,
 														bool doubleBuffering = true);
 
+	// headless replacement of the swapchain, one color target per frame in flight
+	bool								CreateOffscreenTargets(const VkDevice logicalDevice, const VkExtent2D &extent, bool useSRGB);
+
 	bool								CreateImages(const VkDevice logicalDevice,
 													const VkImageCreateInfo &imageCreateInfo,
 													VkMemoryPropertyFlags memoryType,
 													uint32_t imagesCount,
 													std::vector<VkImage> &outImages,
-													std::vector<VkDeviceMemory> &outMemories) const;
+													std::vector<MemoryAllocation> &outAllocations) const;
 
 	bool								CreateImageViews(	const VkDevice logicalDevice,
 															const std::vector<VkImage> &images,
@@ -94,18 +106,34 @@ public:
 	const VkSurfaceFormatKHR&					GetSurfaceFormat() const { return m_SurfaceFormat; }
 	const std::vector<VkImageView>&				GetSwapchainImageViews() const { return m_SwapchainImageViews; }
 	const VkExtent2D&							GetSwapchainExtent() const { return m_SwapchainExtent; }
-	const std::vector<RenderCommand*>&			GetRenderCommands() const { return m_RenderCommands; }
-	const VkCommandBuffer						GetCurrentCommandBuffer() const { return m_RenderCommands[m_CurrentFrame]->GetBuffer(); }
+	const FrameContext&							GetFrameContext(uint32_t frameIndex) const { return m_Frames[frameIndex]; }
+	const FrameContext&							GetCurrentFrameContext() const { return m_Frames[m_CurrentFrame]; }
+	const VkCommandBuffer						GetCurrentCommandBuffer() const { return m_Frames[m_CurrentFrame].m_RenderCommand->GetBuffer(); }
 	const std::vector<VkClearValue>&			GetClearValues() const { return m_ClearValues; }
 	bool										GetDoubleBuffering() const { return m_DoubleBuffering; }
+	bool										IsHeadless() const { return m_Headless; }
+	VkPresentModeKHR							GetPresentMode() const { return m_PresentMode; }
+	bool										UsesTimelineSemaphore() const { return m_FrameTimeline != nullptr; }
 	uint32_t									GetPendingFramesCount() const { return m_PendingFrames; }
 	uint8_t										GetCurrentFrame() const { return m_CurrentFrame; }
+	float										GetFrameWaitTime() const { return m_FrameWaitTime; }
 	uint32_t									GetCurrentSwapchainImage() const { return m_CurrentSwapchainImage; }
-	RenderCommand							*m_SingleCommand;
+	ThreadPool*									GetThreadPool() const { return m_ThreadPool; }
+	SecondaryCommand*							GetThreadCommand(uint32_t threadIndex) const { return m_Frames[m_CurrentFrame].m_ThreadCommands[threadIndex]; }
+	UniformArena*								GetUniformArena(uint32_t frameIndex) const { return m_Frames[frameIndex].m_UniformArena; }
+	UniformArena*								GetCurrentUniformArena() const { return m_Frames[m_CurrentFrame].m_UniformArena; }
+	DescriptorAllocator*						GetDescriptorAllocator(uint32_t frameIndex) const { return m_Frames[frameIndex].m_DescriptorAllocator; }
+	UploadManager*								GetUploadManager() const { return m_UploadManager; }
+	GpuProfiler*								GetGpuProfiler() const { return m_GpuProfiler; }
+	TextureRegistry*							GetTextureRegistry() const { return m_TextureRegistry; }
+	GeometryPool*								GetGeometryPool() const { return m_GeometryPool; } // null without GPU culling
 
 private:
 	void								RetrieveQueueFamilyProperties(const VkPhysicalDevice physicalDevice);
 
+	// image, view, sampler and memory of a texture whose upload couldn't be recorded, never used by the GPU
+	void								DestroyTextureImage(const VkDevice logicalDevice, const Texture &texture) const;
+
 	VkSurfaceKHR							m_Surface;
 	VkSurfaceFormatKHR						m_SurfaceFormat;
 
@@ -114,24 +142,42 @@ private:
 	std::vector<VkImageView>				m_SwapchainImageViews;
 	VkExtent2D								m_SwapchainExtent;
 
-	VkExtent2D								m_ShadowExtent;
-
-	std::vector<VkFence>					m_Fences;
+	// headless only, the offscreen targets stand in for the swapchain images
+	bool									m_Headless;
+	std::vector<MemoryAllocation>			m_OffscreenAllocations;
 
-	std::vector<VkSemaphore>				m_AcquireSemaphores;
-	std::vector<VkSemaphore>				m_PresentSemaphores;
+	VkExtent2D								m_ShadowExtent;
 
 	uint32_t								m_MaxQueueFamilyCount;
 	std::vector<VkQueueFamilyProperties>	m_QueuesFamilyProperties;
 
-	std::vector<RenderCommand*>				m_RenderCommands;
+	// ring of frames in flight, m_CurrentFrame indexes it
+	std::vector<FrameContext>				m_Frames;
+
+	// frame pacing timeline, each submission signals the next value (nullptr when falling back on fences)
+	VkSemaphore								m_FrameTimeline;
+	uint64_t								m_FrameTimelineValue;
+
+	// time BeginRender spent blocked on the frame timeline or fence, in milliseconds
+	float									m_FrameWaitTime;
 
 	Queue									m_PresentQueue;
 
+	UploadManager							*m_UploadManager;
+
+	GpuProfiler								*m_GpuProfiler;
+
+	TextureRegistry							*m_TextureRegistry;
+
+	GeometryPool							*m_GeometryPool;
+
+	ThreadPool								*m_ThreadPool;
+
 	VkClearColorValue						m_ClearColor;
 	std::vector<VkClearValue>				m_ClearValues;
 
 	bool									m_DoubleBuffering;
+	VkPresentModeKHR						m_PresentMode;
 	uint32_t								m_PendingFrames;
 
 	uint8_t									m_CurrentFrame;
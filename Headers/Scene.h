@@ -1,5 +1,8 @@
 #pragma once
 
+#include <functional>
+#include <unordered_map>
+
 #include "Initializers.h"
 #include "RenderHandle.h"
 #include "Camera.h"
@@ -8,7 +11,11 @@
 #include "Shadow.h"
 #include "Skybox.h"
 #include "UniformDescription.h"
-#include "imgui/UI.h"
+#include "GpuCulling.h"
+#include "DepthPyramid.h"
+#include "Imgui/UI.h"
+#include "Tools/FrustumCulling.h"
+#include "Tools/DynamicBvh.h"
 
 //----------------------------------------------------------------
 
@@ -16,6 +23,13 @@ LIGHTLYY_BEGIN
 
 //----------------------------------------------------------------
 
+#define LOD_ERROR_PIXELS 1.f // default screen space error of the meshes levels of detail in the camera view
+#define LOD_SHADOW_ERROR_PIXELS 4.f // in shadow map texels, shadows are filtered and rarely looked at closely
+#define CULLING_MIN_PIXELS 1.f // default projected bounding sphere diameter under which the main passes skip a mesh
+#define PICK_LIGHT_RADIUS 0.5f // world units around the position of a light a pick ray must pass through, lights have no geometry
+
+//----------------------------------------------------------------
+
 struct VP
 {
 	glm::mat4	m_View;
@@ -24,6 +38,32 @@ struct VP
 
 //----------------------------------------------------------------
 
+// dynamic offsets of the per frame uniforms in the current frame uniform arena
+struct UniformOffsets
+{
+	UniformOffsets() : m_VP(0), m_Meshes(0), m_Lights(0), m_ShadowCascade(0), m_ShadowSpotLight(0) { }
+
+	uint32_t	m_VP;
+	uint32_t	m_Meshes; // first entry, meshes are SHADOWMAP_CASCADE_COUNT aligned entries each
+	uint32_t	m_Lights;
+	uint32_t	m_ShadowCascade;
+	uint32_t	m_ShadowSpotLight; // first entry, one aligned entry per spot light shadow view
+}; // struct UniformOffsets
+
+//----------------------------------------------------------------
+
+// level of detail a mesh is drawn with in the camera and cascade views, selected every frame in Prepare,
+// spot light shadow views keep theirs next to their casters
+struct MeshLodSelection
+{
+	MeshLodSelection() : m_Objects(0), m_Cascades{ } { }
+
+	uint32_t	m_Objects;
+	uint32_t	m_Cascades[SHADOWMAP_CASCADE_COUNT];
+}; // struct MeshLodSelection
+
+//----------------------------------------------------------------
+
 class Scene
 {
 public:
@@ -32,15 +72,32 @@ public:
 	~Scene();
 
 	bool						Setup(const VkDevice logicalDevice);
-	void						Prepare(const VkDevice logicalDevice);
+	// false when the frame can't be drawn, its uniform arena couldn't grow to the scene
+	bool						Prepare(const VkDevice logicalDevice);
 	void						Render(const UI *ui);
 	void						Shutdown(const VkDevice logicalDevice);
 
 	void						AddMesh(const VkDevice logicalDevice, Mesh *mesh);
+
+	// spawn it on the asset loader, the mesh is added once loaded, an empty texture path keeps the imported material
+	Task<>						LoadMesh(const VkDevice logicalDevice, std::string path, std::string name, std::string texturePath, glm::vec3 position, glm::vec3 scale);
 	void						DeleteMesh(Mesh *mesh);
 	void						DeleteLight(Light *light);
 	void						AddLight(Light *light);
 
+	void						SetRecordThreadsCount(uint32_t threadsCount);
+	void						SetLodErrorPixels(float errorPixels) { m_LodErrorPixels = errorPixels; }
+	void						SetShadowLodErrorPixels(float errorPixels) { m_ShadowLodErrorPixels = errorPixels; }
+	void						SetCullingMinPixels(float minPixels) { m_CullingMinPixels = minPixels; }
+
+	// spatial queries over every mesh and light, with the world space boxes of the last Prepare, lights are boxed by their range
+	void						QueryObjectsInFrustum(const CullingView &view, std::vector<Object*> &outObjects) const;
+	void						QueryObjectsInSphere(const glm::vec3 &center, float radius, std::vector<Object*> &outObjects) const;
+	void						QueryObjectsInBox(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, std::vector<Object*> &outObjects) const;
+
+	// closest mesh box or light position along the segment from origin to origin + direction, nullptr when none
+	Object*						PickObject(const glm::vec3 &origin, const glm::vec3 &direction) const;
+
 	// getters
 	const VkRenderPass			GetRenderPassObjects() const { return m_RenderPassObjects; }
 	const std::vector<Object*>&	GetSceneObjects() const { return m_Objects; }
@@ -48,6 +105,22 @@ public:
 	const Camera*				GetCamera() const { return m_Camera; }
 	const std::vector<Light*>&	GetLightObjects() const { return m_Lights; }
 	Shadow*						GetShadow() const { return m_Shadow; }
+	uint32_t					GetRecordThreadsCount() const { return m_RecordThreadsCount; }
+	uint32_t					GetMaxRecordThreadsCount() const { return m_RenderHandle->GetThreadPool()->GetThreadsCount(); }
+	float						GetRecordTime() const { return m_RecordTime; }
+	float						GetLastRecordTime() const { return m_LastRecordTime; }
+	float						GetLodErrorPixels() const { return m_LodErrorPixels; }
+	float						GetShadowLodErrorPixels() const { return m_ShadowLodErrorPixels; }
+	uint32_t					GetObjectsTrianglesCount() const { return m_ObjectsTrianglesCount; } // drawn last frame
+	uint32_t					GetShadowTrianglesCount() const { return m_ShadowTrianglesCount; } // in every shadow view
+	float						GetCullingMinPixels() const { return m_CullingMinPixels; }
+	uint32_t					GetVisibleMeshesCount() const { return static_cast<uint32_t>(m_VisibleMeshes.size()); }
+	uint32_t					GetMeshesCount() const { return static_cast<uint32_t>(m_Meshes.size()); }
+	uint32_t					GetCascadeCastersCount() const; // draws of every cascade
+	uint32_t					GetGpuCulledMeshesCount() const { return (m_GpuCulling != nullptr) ? m_GpuCulling->GetObjectsCount() : 0; }
+	const GpuCulling*			GetGpuCulling() const { return m_GpuCulling; } // null on the CPU path
+	bool						UsesOcclusionCulling() const { return m_DepthPyramid != nullptr; }
+	const DynamicBvh&			GetObjectsBvh() const { return m_ObjectsBvh; }
 
 private:
 	bool						CreateRenderPasses(const VkDevice logicalDevice);
@@ -62,10 +135,13 @@ private:
 														const std::vector<VkShaderModule> &offscreenModules,
 														const std::vector<VkShaderModule> &skyboxModules,
 														const std::vector<VkShaderModule> &shadowModules,
-														const std::vector<VkShaderModule> &shadowSpotLightModule);
+														const std::vector<VkShaderModule> &shadowSpotLightModule,
+														const std::vector<VkShaderModule> &indirectModules); // empty on the CPU path
 	bool						CreatePipelineLayoutObjects(const VkDevice logicalDevice);
 	bool						CreatePipelineLayoutOffscreen(const VkDevice logicalDevice);
 	bool						CreatePipelineLayoutSkybox(const VkDevice logicalDevice);
+
+	Task<>						LoadSkybox(const VkDevice logicalDevice, std::string folderPath, std::string extension);
 	bool						CreatePipelineLayoutShadowCascade(const VkDevice logicalDevice); // ShadowMap -> Only Directionnal 
 	bool						CreatePipelineLayoutShadowSpotLight(const VkDevice logicalDevice); // ShadowMap -> Only SpotLight
 
@@ -74,21 +150,98 @@ private:
 
 	bool						CreateShaderModule(const VkDevice logicalDevice, const std::vector<char> &shaderByteCode, VkShaderModule &shaderModule);
 
+	// culling pass and indirect draws of the meshes in the geometry pool, once the objects layout prepared the samplers,
+	// the depth pyramid is only built with the reduce module, the resolve one is needed too when the depth is multisampled
+	bool						SetupGpuCulling(const VkDevice logicalDevice, const VkShaderModule cullModule, const VkShaderModule pyramidModule, const VkShaderModule pyramidResolveModule);
+
+	// slot of the mesh in the culling pass, UINT32_MAX when it stays on the CPU path
+	uint32_t					AddGpuCullingMesh(Mesh *mesh);
+
+	// dirty meshes and views of the frame, the culling pass reads them in Render
+	void						UpdateGpuCulling(const VkDevice logicalDevice, const glm::mat4 &viewProj);
+
+	// keeps the meshes drawn on the CPU path in a list of meshes indices
+	void						RemoveGpuCulledMeshes(std::vector<uint32_t> &meshes) const;
+
 	void						AddObject(Object *object);
 	void						RemoveObject(Object *object);
 
+	// world space box of a mesh, or of the range of a light
+	void						GetObjectBounds(Object *object, glm::vec3 &outMin, glm::vec3 &outMax) const;
+
+	// dirty objects refit their proxy, the tree is rebuilt when the refits degraded it too much
+	void						UpdateObjectsBvh();
+
+	// once the tree and the culling pass took the changes of the frame
+	void						ClearDirtyObjects();
+
+	// meshes indices of the proxies, after meshes were removed
+	void						UpdateProxyMeshes();
+
+	// meshes whose box is at least partly in the view, in increasing order
+	void						QueryMeshes(const CullingView &view, std::vector<uint32_t> &outMeshes);
+
 	bool						UpdateMeshBuffer(const VkDevice logicalDevice, uint32_t newMeshIndex);
 
+	// descriptor sets of the objects layout sampling texture, one per frame in flight
+	UniformDescription			CreateMeshDescription(const VkDevice logicalDevice, const Texture &texture) const;
+
+	// deletes the meshes and their descriptor sets no frame in flight can still use, once the frame slot is free
+	void						CollectReleasedMeshes();
+
+	// grows the uniform arena of the current frame to size bytes and points the descriptor sets of the frame to its new buffer
+	bool						ReserveUniformArena(const VkDevice logicalDevice, VkDeviceSize size);
+
+	// requests texture levels from the screen size of every mesh and points the descriptor set of the frame
+	// to the images the streaming recreated
+	void						UpdateMeshTextures(const VkDevice logicalDevice, const glm::mat4 &view, const glm::mat4 &proj);
+
+	// meshes of the objects tree in the camera frustum, then their bounds against it and the minimum size, fill the visible list of the main passes,
+	// the meshes of the tree in each cascade box fill its caster list
+	void						CullMeshes(const glm::mat4 &viewProj);
+
+	// from the projected error of every level in the camera and in each active shadow view
+	void						SelectMeshLods(const glm::mat4 &viewProj);
+
+	// command recording, a range of a mesh list is split over the worker threads when recording in parallel
+	using RecordMeshesFunction = std::function<void(const VkCommandBuffer, uint32_t, uint32_t)>;
+	using RecordFunction = std::function<void(const VkCommandBuffer)>;
+
+	bool						IsRecordingParallel() const { return m_RecordThreadsCount > 1; }
+	void						RecordMeshes(const VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo &renderPassBeginInfo, uint32_t meshesCount, const RecordMeshesFunction &recordFunction) const;
+	void						RecordSingle(const VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo &renderPassBeginInfo, const RecordFunction &recordFunction) const;
+
+	// GPU timestamps, pass the render pass begin info when inside a render pass
+	uint32_t					BeginGpuScope(const VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *renderPassBeginInfo, const char *name) const;
+	void						EndGpuScope(const VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *renderPassBeginInfo, uint32_t scopeId) const;
+
+	void						RecordShadowCascade(const VkCommandBuffer commandBuffer, uint32_t cascadeIndex, uint32_t firstCaster, uint32_t lastCaster) const;
+	void						RecordShadowView(const VkCommandBuffer commandBuffer, const ShadowView &shadowView, uint32_t firstCaster, uint32_t lastCaster) const;
+	void						RecordObjects(const VkCommandBuffer commandBuffer, uint32_t pipelineIndex, uint32_t isOpaque, uint32_t firstVisible, uint32_t lastVisible) const; // range of the visible list
+
+	// draw lists written by the culling pass
+	void						RecordShadowCascadeIndirect(const VkCommandBuffer commandBuffer, uint32_t cascadeIndex) const;
+	void						RecordObjectsIndirect(const VkCommandBuffer commandBuffer, uint32_t pipelineIndex, uint32_t drawList) const;
+
 	std::string					GetDefinitiveObjectName(const std::string &name);
 
+	struct ReleasedMesh
+	{
+		Mesh				*m_Mesh;
+		UniformDescription	m_UniformDescription;
+		uint64_t			m_ReleaseFrame;
+	}; // struct ReleasedMesh
+
 	const RenderHandle				*m_RenderHandle;
 
 	VkRenderPass					m_RenderPassObjects;
+	VkRenderPass					m_RenderPassObjectsResume; // loads what m_RenderPassObjects stored, after the occlusion culling, null without it
 	std::vector<VkFramebuffer>		m_FrameBuffersObjects;
 
 	VkRenderPass					m_RenderPassShadow;
 	std::vector<VkFramebuffer>		m_FrameBuffersShadowCascade;
 	std::vector<VkFramebuffer>		m_FrameBuffersShadowSpotLight;
+	std::vector<ShadowView>			m_ShadowViewsSpotLight;
 
 	std::vector<VkPipeline>			m_GraphicsPipelinesObjects;
 	VkPipelineLayout				m_PipelineLayoutObjects;
@@ -96,50 +249,72 @@ private:
 	VkPipelineLayout				m_PiplelineLayoutShadowCascade;
 	VkPipelineLayout				m_PiplelineLayoutShadowSpotLight;
 	std::vector<UniformDescription>	m_UniformDescriptions;
+	UniformDescription				*m_SkyboxUniformDescription; // objects layout, the objects and skybox pipeline layouts are made from it
 
-	std::vector<Buffer<VP>>			m_VPBuffers;
-	std::vector<Buffer<MeshData>>	m_PerMeshBuffers;
-	std::vector<Buffer<UBOLights>>	m_LightBuffers;
-	std::vector<Buffer<ShadowInfoCascade>>	m_ShadowCascadeBuffers;
-	std::vector<Buffer<ShadowInfoSpotLight>>m_ShadowSpotLightBuffers;
+	UniformOffsets					m_UniformOffsets;
 
 	uint32_t						m_PerMeshBufferAlignment;
 	uint32_t						m_PerSpotShadowBufferAlignment;
 
 	VkImage							m_DepthImage;
 	VkImageView						m_DepthImageView;
-	VkDeviceMemory					m_DepthMemory;
+	MemoryAllocation				m_DepthAllocation;
 
 	std::vector<VkImage>			m_ImagesObjects;
 	std::vector<VkImageView>		m_ImageViewsObjects;
-	std::vector<VkDeviceMemory>		m_ObjectsMemories;
+	std::vector<MemoryAllocation>	m_ObjectsAllocations;
 
 	// ShadowCascade
 	std::vector<VkImage>			m_ShadowCascadeImages;
 	std::vector<VkImageView>		m_ShadowCascadeImageViews;
-	std::vector<VkDeviceMemory>		m_ShadowCascadeMemories;
+	std::vector<MemoryAllocation>	m_ShadowCascadeAllocations;
 	VkSampler						m_ShadowCascadeSampler;
 
 	// Shadow SpotLight
 	std::vector<VkImage>			m_ShadowSpotLightImages;
 	std::vector<VkImageView>		m_ShadowSpotLightImageViews;
-	std::vector<VkDeviceMemory>		m_ShadowSpotLightMemories;
+	std::vector<MemoryAllocation>	m_ShadowSpotLightAllocations;
 	VkSampler						m_ShadowSpotLightSampler;
 
 	std::vector<Mesh*>				m_Meshes;
+	std::vector<ReleasedMesh>		m_ReleasedMeshes;
+	uint64_t						m_Frame; // prepared frames, tags the released meshes
+	std::vector<uint64_t>			m_MeshImageVersions; // per mesh and frame slot, image version of the texture in the descriptor set
+	std::vector<MeshLodSelection>	m_MeshLods; // per mesh
+	std::vector<uint32_t>			m_CullingMeshes; // meshes indices in the camera view boxes, one per culling bounds
+	CullingBounds					m_CullingBounds; // rebuilt every frame
+	std::vector<uint32_t>			m_VisibleMeshes; // meshes indices, in the camera view
+	std::vector<uint32_t>			m_CascadeCasters[SHADOWMAP_CASCADE_COUNT]; // meshes indices, in each cascade box or toward the light
+	std::vector<uint32_t>			m_MeshCullingSlots; // per mesh, in m_GpuCulling, UINT32_MAX for the meshes culled and drawn on the CPU
+	uint32_t						m_CpuCulledMeshesCount; // meshes with a UINT32_MAX slot, the camera and the cascades skip the tree when there are none
+	float							m_CullingMinPixels;
+	GpuCulling						*m_GpuCulling; // null when the device or the shaders don't support it, every mesh is on the CPU path then
+	DepthPyramid					*m_DepthPyramid; // null without occlusion culling
 	std::vector<Light*>				m_Lights;
 	int								m_SpotLightCount;
 
-	MeshData*						m_MeshesData;
-
 	std::vector<Object*>			m_Objects; // contains meshes and lights
 	std::vector<std::string>		m_ObjectsNames;
+	std::unordered_map<const Object*, uint32_t>	m_ObjectsProxies; // in m_ObjectsBvh
+	std::vector<Object*>			m_DirtyObjects; // moved or edited since the last frame, see Object::MarkDirty
+	DynamicBvh						m_ObjectsBvh; // user data are the objects
+	std::vector<uint32_t>			m_ProxyMeshes; // mesh index of each proxy, UINT32_MAX for lights and unused proxies
+	std::vector<uint32_t>			m_QueryProxies; // scratch of the queries
 
 	Camera							*m_Camera;
 
 	Skybox							m_Skybox;
 
 	Shadow							*m_Shadow;
+
+	uint32_t						m_RecordThreadsCount;
+	float							m_RecordTime; // smoothed, in milliseconds
+	float							m_LastRecordTime; // of the last frame, what the benchmarks average
+
+	float							m_LodErrorPixels;
+	float							m_ShadowLodErrorPixels;
+	uint32_t						m_ObjectsTrianglesCount;
+	uint32_t						m_ShadowTrianglesCount;
 }; // class Scene
 
 //----------------------------------------------------------------
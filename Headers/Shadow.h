@@ -2,6 +2,7 @@
 
 #include "Initializers.h"
 #include "Light.h"
+#include "Tools/FrustumCulling.h"
 
 #include "glm/glm.hpp"
 
@@ -11,7 +12,7 @@ LIGHTLYY_BEGIN
 
 //----------------------------------------------------------------
 
-#define SHADOWMAP_SPOTLIGHT_COUNT 1 // same to cascade -> TODO :  
+#define SHADOWMAP_SPOTLIGHT_COUNT 1 // one layer per shadowed spot light, the objects pass samples only the first one
 
 //----------------------------------------------------------------
 
@@ -35,6 +36,18 @@ struct ShadowInfoCascade
 
 //----------------------------------------------------------------
 
+// a light point of view rendered into one shadow map layer,
+// the whole caster list is drawn inside a single render pass
+struct ShadowView
+{
+	VkFramebuffer			m_FrameBuffer;
+	uint32_t				m_InfoOffset; // dynamic offset of the view info in the shadow buffer
+	std::vector<uint32_t>	m_Casters; // meshes indices
+	std::vector<uint32_t>	m_CasterLods; // level of detail of each caster
+};
+
+//----------------------------------------------------------------
+
 // Calculate split depths base on view camera frustum
 // https://developer.nvidia.com/gpugems/GPUGems3/gpugems3_ch10.html
 // https://github.com/SaschaWillems/Vulkan/blob/master/examples/shadowmappingcascade/shadowmappingcascade.cpp
@@ -46,7 +59,7 @@ public:
 	Shadow(float nearClip = 0.1f, float farClip = 100.0f);
 
 	// Spot Light -> doesn't use cascade Shadow
-	void				UpdateSpotLightShadow(const Light* spotLight, const glm::mat4 &cameraProj, const glm::mat4 &cameraView);
+	void				UpdateSpotLightShadow(uint32_t shadowIndex, const Light* spotLight, const glm::mat4 &cameraProj, const glm::mat4 &cameraView);
 
 
 	// CascadeShadow -> Directionnal Light
@@ -55,8 +68,9 @@ public:
 	void				CalculateOrthoFrustum(const glm::vec3& directionnalLightPos, const glm::mat4 &cameraProj, const glm::mat4 &cameraView);
 
 	// Getters
-	ShadowInfoSpotLight	GetShadowInfoSpotLight() const	{ return m_ShadowInfoSpotLight; }
+	ShadowInfoSpotLight	GetShadowInfoSpotLight(uint32_t shadowIndex) const { return m_ShadowInfoSpotLights[shadowIndex]; }
 	ShadowInfoCascade	GetShadowInfoCascade() const	{ return m_ShadowInfoCascade; }
+	const CullingView&	GetCascadeCullingView(uint32_t cascadeIndex) const { return m_CascadeCullingViews[cascadeIndex]; } // light space box of the cascade, open toward the light
 	VkExtent2D			GetExtent2D() const				{ return m_Extent; }
 	float				GetCascadeSplitCoeff() const	{ return m_CascadeSplitLambda; }
 	bool				IsShowCascade() const			{ return m_ShadowInfoCascade.m_ShowCascade; }
@@ -71,7 +85,7 @@ public:
 
 private:
 	// Spot Light Shadow
-	ShadowInfoSpotLight			m_ShadowInfoSpotLight;
+	ShadowInfoSpotLight			m_ShadowInfoSpotLights[SHADOWMAP_SPOTLIGHT_COUNT];
 
 	// Cascade Shadow
 	float						m_CascadeSplits[SHADOWMAP_CASCADE_COUNT];
@@ -79,6 +93,7 @@ private:
 
 	glm::vec4					m_FrustumCascadeSplits;
 	glm::mat4					m_LightSpace[SHADOWMAP_CASCADE_COUNT];
+	CullingView					m_CascadeCullingViews[SHADOWMAP_CASCADE_COUNT];
 
 	float						m_NearClip;
 	float						m_FarClip;
@@ -3,6 +3,7 @@
 #include "Utility.h"
 #include "Texture.h"
 #include "Buffer.h"
+#include "AssetLoader.h"
 
 //----------------------------------------------------------------
 
@@ -15,6 +16,9 @@ struct Skybox
 	Skybox() {};
 	Skybox(const VkDevice logicalDevice, const std::string &folderPath, const std::string &extension);
 
+	// faces are decoded on a loading thread, the buffers are created on the render thread
+	static Task<Skybox>							LoadAsync(AssetLoader &loader, const VkDevice logicalDevice, std::string folderPath, std::string extension);
+
 	void										Render(const VkCommandBuffer commandBuffer);
 
 	void										FreeTextures();
@@ -29,6 +33,9 @@ struct Skybox
 	VkPipelineLayout					m_PipelineLayout;
 
 private:
+	void								LoadFaces(const std::string &folderPath, const std::string &extension);
+	void								CreateBuffers(const VkDevice logicalDevice);
+
 	std::vector<glm::vec3>				m_Vertices =
 	{
 		{-1.f, -1.f, -1.f},
@@ -4,6 +4,8 @@
 
 #include "Utility.h"
 #include "Initializers.h"
+#include "MemoryAllocator.h"
+#include "Tools/Ktx2.h"
 
 //----------------------------------------------------------------
 
@@ -14,8 +16,10 @@ LIGHTLYY_BEGIN
 struct Texture
 {
 	// Constructor
-	Texture() {};
-	Texture(const std::string &path, uint32_t desiredChannelCount);
+	Texture();
+	// a .ktx2 file is loaded as is, any other image prefers its up to date .ktx2 sibling unless useCompressed is false
+	Texture(const std::string &path, uint32_t desiredChannelCount, bool useCompressed = true);
+	Texture(const std::string &name, uint32_t width, uint32_t height, std::vector<stbi_uc> &&pixels); // RGBA8 pixels
 
 	void						FreeTexture();
 
@@ -24,24 +28,48 @@ struct Texture
 	uint32_t					GetWidth() const { return m_Width; };
 	uint32_t					GetHeight() const { return m_Height; };
 	uint32_t					GetChannel() const { return m_Channel; };
+	uint32_t					GetDesiredChannelCount() const { return m_DesiredChannelCount; }
 	uint32_t					GetMipmapLevels() const { return m_MipmapLevels; }
+	VkFormat					GetFormat() const { return m_Format; }
 
-	const std::vector<stbi_uc>&	GetPixels() const { return m_Pixels; }
+	const std::vector<stbi_uc>&		GetPixels() const { return m_Pixels; }
+	const std::vector<Ktx2::Level>&	GetLevels() const { return m_Levels; } // levels stored in the pixels, base level first
+
+	// every level comes from the file, nothing to blit on upload
+	bool						HasAllMipmaps() const { return m_Levels.size() == m_MipmapLevels; }
+
+	// bytes of the levels from firstLevel down to the smallest one
+	uint64_t					GetChainSize(uint32_t firstLevel) const;
 
 	VkImage					m_Image;
 	VkImageView				m_ImageView;
-	VkDeviceMemory			m_Memory;
+	MemoryAllocation		m_Allocation;
 	VkSampler				m_Sampler;
 
+	uint64_t				m_UploadBatch; // poll with UploadManager::IsComplete
+
+	// streaming, the image only holds the levels from m_ResidentLevel down
+	bool					m_Streamed; // pixels are kept to upload the levels requested later
+	uint32_t				m_ResidentLevel;
+	uint32_t				m_RequestedLevel; // finest level asked by the last frame requesting it
+	uint64_t				m_LastRequestFrame;
+	uint64_t				m_ImageVersion; // unique per created image, descriptors are rewritten when it changes
+
 private:
+	bool					LoadKtx2(const std::string &path);
+	void					SetBaseLevel(); // single level of uncompressed RGBA8 pixels, the other mips get blitted
+
 	std::string				m_Path;
 
 	uint32_t				m_Width;
 	uint32_t				m_Height;
 	uint32_t				m_Channel;
+	uint32_t				m_DesiredChannelCount;
 	uint32_t				m_MipmapLevels;
+	VkFormat				m_Format;
 
 	std::vector<stbi_uc>	m_Pixels;
+	std::vector<Ktx2::Level>	m_Levels;
 }; // struct Texture
 
 //----------------------------------------------------------------
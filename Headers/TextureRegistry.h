@@ -0,0 +1,130 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Texture.h"
+#include "AssetLoader.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define TEXTURE_STREAMING_BASE_SIZE 64 // streamed textures start with the levels not larger than this
+#define TEXTURE_STREAMING_MAX_UPDATES 4 // images of streamed textures recreated per frame to get finer levels
+
+class RenderHandle;
+
+// shared GPU texture, the image is released once the last handle on it is dropped
+using TextureHandle = std::shared_ptr<const Texture>;
+
+//----------------------------------------------------------------
+
+// texture loaded off the render thread, either already shared or freshly decoded
+struct PendingTexture
+{
+	TextureHandle	m_Handle;
+	Texture			m_Decoded;
+}; // struct PendingTexture
+
+//----------------------------------------------------------------
+
+// sizes in bytes of the levels in images, counts since startup
+struct TextureStreamingStatistics
+{
+	TextureStreamingStatistics() : m_BudgetSize(0), m_ResidentSize(0), m_RequestedSize(0), m_StreamedCount(0), m_UploadedLevelsCount(0), m_EvictedLevelsCount(0) { }
+
+	uint64_t	m_BudgetSize; // 0 when streaming is off
+	uint64_t	m_ResidentSize; // levels of the streamed textures
+	uint64_t	m_RequestedSize; // levels the streamed textures would need to honor every request
+	uint32_t	m_StreamedCount;
+	uint64_t	m_UploadedLevelsCount;
+	uint64_t	m_EvictedLevelsCount;
+}; // struct TextureStreamingStatistics
+
+//----------------------------------------------------------------
+
+// GPU textures keyed by canonical path and load parameters, every material loading the same file shares one image
+class TextureRegistry
+{
+public:
+	TextureRegistry() = delete;
+	TextureRegistry(const RenderHandle *renderHandle);
+	~TextureRegistry();
+
+	TextureRegistry(const TextureRegistry&) = delete;
+	TextureRegistry&	operator=(const TextureRegistry&) = delete;
+
+	// creates the fallback texture, needs the upload manager
+	bool					Prepare(const VkDevice logicalDevice);
+	void					Shutdown(const VkDevice logicalDevice);
+
+	// any thread, returns the shared texture or decodes it, nothing when the path is empty
+	PendingTexture			Decode(const std::string &path, uint32_t desiredChannelCount) const;
+
+	// render thread, creates the image of a decoded texture unless another load registered it meanwhile,
+	// null when the file couldn't be decoded
+	TextureHandle			Resolve(const VkDevice logicalDevice, PendingTexture &&pendingTexture);
+
+	TextureHandle			Load(const VkDevice logicalDevice, const std::string &path, uint32_t desiredChannelCount);
+	Task<TextureHandle>		LoadAsync(AssetLoader &loader, const VkDevice logicalDevice, std::string path, uint32_t desiredChannelCount);
+
+	// render thread, once the frame slot is free: destroys the released textures no frame in flight can still sample
+	void					Collect(const VkDevice logicalDevice, uint32_t pendingFramesCount);
+
+	// textures with their whole mip chain registered while the budget isn't 0 are streamed: they start with their small levels,
+	// get finer ones when requested and lose the least recently requested ones when the budget is exceeded
+	void					SetStreamingBudget(uint64_t budgetSize);
+
+	// render thread, screenSize is the height in pixels covered by the texture, the finest request of the frame wins
+	void					RequestScreenSize(const Texture &texture, float screenSize);
+
+	// render thread after Collect, recreates the images of the streamed textures whose resident levels change
+	void					Stream(const VkDevice logicalDevice);
+
+	static std::string		GetKey(const std::string &path, uint32_t desiredChannelCount);
+
+	// getters
+	const TextureHandle&	GetFallback() const { return m_Fallback; } // white, bound by materials without texture
+	uint32_t				GetTexturesCount() const;
+	TextureStreamingStatistics	GetStreamingStatistics() const;
+
+private:
+	struct ReleasedTexture
+	{
+		Texture		*m_Texture;
+		uint64_t	m_ReleaseFrame;
+	}; // struct ReleasedTexture
+
+	TextureHandle			Register(const VkDevice logicalDevice, Texture &&texture);
+	void					Release(Texture *texture);
+	void					Destroy(const VkDevice logicalDevice, Texture *texture) const;
+
+	// the old image is released like a texture, frames in flight may still sample it
+	bool					SetResidentLevel(const VkDevice logicalDevice, Texture *texture, uint32_t residentLevel);
+
+	static uint32_t			GetStreamingBaseLevel(const Texture &texture);
+
+	const RenderHandle										*m_RenderHandle;
+
+	mutable std::mutex										m_Mutex;
+	std::unordered_map<std::string, std::weak_ptr<const Texture>>	m_Textures;
+	std::vector<ReleasedTexture>							m_ReleasedTextures;
+	uint64_t												m_Frame;
+	uint64_t												m_ImageVersion;
+
+	std::vector<Texture*>									m_StreamedTextures;
+	uint64_t												m_StreamingBudget;
+	TextureStreamingStatistics								m_StreamingStatistics; // sizes computed by Stream
+
+	TextureHandle											m_Fallback;
+}; // class TextureRegistry
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
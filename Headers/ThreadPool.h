@@ -0,0 +1,50 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "Utility.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+// each worker owns its queue so a job always runs on the thread it was pushed to,
+// callers can then bind per thread resources (ie. command pools) to the worker index
+class ThreadPool
+{
+public:
+	ThreadPool() = delete;
+	ThreadPool(uint32_t threadsCount);
+	~ThreadPool();
+
+	void		Push(uint32_t threadIndex, const std::function<void()> &job);
+	void		Wait();
+
+	// getters
+	uint32_t	GetThreadsCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+private:
+	struct Worker
+	{
+		std::thread							m_Thread;
+		std::queue<std::function<void()>>	m_Jobs;
+		std::mutex							m_Mutex;
+		std::condition_variable				m_Condition;
+		bool								m_IsDestroying = false;
+	}; // struct Worker
+
+	void		Loop(Worker *worker);
+
+	std::vector<Worker*>	m_Workers;
+}; // class ThreadPool
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Utility.h"
+#include "Tools/FrustumCulling.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define BVH_NULL_NODE 0xffffffff
+#define BVH_FAT_MARGIN 0.1f // of the leaf boxes, relative to their size, moves staying inside the fat box don't touch the tree
+#define BVH_REBUILD_COST_RATIO 1.5f // SAH cost the refits may reach, relative to the one of the last rebuild
+#define BVH_SAH_BINS 16 // per split of the rebuild, along the widest axis of the centroids
+
+//----------------------------------------------------------------
+
+struct BvhRayHit
+{
+	BvhRayHit() : m_Proxy(BVH_NULL_NODE), m_Distance(0.f) { }
+
+	uint32_t	m_Proxy;
+	float		m_Distance; // along the ray direction, in its units
+}; // struct BvhRayHit
+
+//----------------------------------------------------------------
+
+// world space boxes of objects, leaves are inserted where they add the least surface and refit in place when they move,
+// the whole tree is rebuilt top down with binned SAH once the refits made it too expensive to traverse,
+// proxies are the leaf nodes indices and stay valid until removed, CPU only
+class DynamicBvh
+{
+public:
+	// exact distance of the hit on the object, negative for a miss, boxDistance is where the ray enters its fat box
+	using RaycastFunction = std::function<float(uint32_t proxy, float boxDistance)>;
+
+	DynamicBvh();
+
+	uint32_t		Insert(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, void *userData);
+	void			Remove(uint32_t proxy);
+
+	// refits the ancestors when the bounds leave the fat box, returns true then
+	bool			Update(uint32_t proxy, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+
+	// once per frame after the updates, returns true when the tree was rebuilt
+	bool			RebuildIfDegraded();
+	void			Rebuild();
+
+	// proxies whose fat box is at least partly in the view, without its size test
+	void			QueryFrustum(const CullingView &view, std::vector<uint32_t> &outProxies) const;
+	void			QuerySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &outProxies) const;
+	void			QueryAabb(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, std::vector<uint32_t> &outProxies) const;
+
+	// closest hit accepted by hitFunction, boxes farther than the closest hit so far are skipped
+	bool			Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, const RaycastFunction &hitFunction, BvhRayHit &outHit) const;
+
+	// getters
+	void*			GetUserData(uint32_t proxy) const { return m_Nodes[proxy].m_UserData; }
+	const glm::vec3&	GetFatMin(uint32_t proxy) const { return m_Nodes[proxy].m_Min; }
+	const glm::vec3&	GetFatMax(uint32_t proxy) const { return m_Nodes[proxy].m_Max; }
+	uint32_t		GetProxiesCount() const { return m_ProxiesCount; }
+	uint32_t		GetRebuildsCount() const { return m_RebuildsCount; }
+
+	// surface of the inner nodes over the one of the root, the expected nodes visited by a random ray
+	float			GetCost() const;
+
+	// query costs against a linear scan of the same boxes, printed for counts up to maxProxiesCount
+	static void		Benchmark(uint32_t maxProxiesCount);
+
+private:
+	struct Node
+	{
+		bool		IsLeaf() const { return m_Children[0] == BVH_NULL_NODE; }
+
+		glm::vec3	m_Min;
+		glm::vec3	m_Max;
+		uint32_t	m_Parent; // next free node when unused
+		uint32_t	m_Children[2];
+		void		*m_UserData; // leaves only
+	}; // struct Node
+
+	uint32_t		AllocateNode();
+	void			FreeNode(uint32_t nodeIndex);
+
+	// from nodeIndex up to the root, stops once a box doesn't change
+	void			Refit(uint32_t nodeIndex);
+
+	uint32_t		FindBestSibling(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const;
+
+	template<typename TestFunction>
+	void			Query(const TestFunction &testFunction, std::vector<uint32_t> &outProxies) const;
+
+	std::vector<Node>	m_Nodes;
+	uint32_t			m_Root;
+	uint32_t			m_FreeNode;
+	uint32_t			m_ProxiesCount;
+	uint32_t			m_RebuildsCount;
+
+	double				m_InnerArea; // sum over the inner nodes, kept up to date by every change of the tree
+	float				m_RebuildCost; // right after the last rebuild, 0 before the first one
+}; // class DynamicBvh
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
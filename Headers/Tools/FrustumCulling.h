@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Utility.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define FRUSTUM_CULLING_LANES 8 // objects per iteration of the widest kernel, the bounds arrays are padded to it
+
+//----------------------------------------------------------------
+
+// world space bounds of every object, one array per component so that the kernels load several objects at once,
+// the bounding sphere is centered on the box
+struct CullingBounds
+{
+	CullingBounds() : m_Count(0) { }
+
+	void				Resize(uint32_t objectsCount);
+	void				Set(uint32_t objectIndex, const glm::vec3 &center, const glm::vec3 &extent, float radius);
+
+	// object space box and radius around its center, the box stays axis aligned so it grows with the rotation
+	void				SetTransformed(uint32_t objectIndex, const glm::mat4 &model, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float radius);
+
+	uint32_t			GetCount() const { return m_Count; }
+
+	std::vector<float>	m_CenterX;
+	std::vector<float>	m_CenterY;
+	std::vector<float>	m_CenterZ;
+	std::vector<float>	m_ExtentX; // half sizes
+	std::vector<float>	m_ExtentY;
+	std::vector<float>	m_ExtentZ;
+	std::vector<float>	m_Radius;
+
+	uint32_t			m_Count; // without the padding
+}; // struct CullingBounds
+
+//----------------------------------------------------------------
+
+// planes and projected size test of a view, perspective or orthographic
+struct CullingView
+{
+	glm::vec4	m_Planes[6]; // unit normal pointing inside and distance
+	glm::vec4	m_RowW; // of the view projection, the perspective divide
+	float		m_RowWLength; // of its xyz, 0 for an orthographic view
+	float		m_PixelsPerUnit; // at a divide of 1
+	float		m_MinPixels; // projected diameter of the bounding sphere, 0 disables the size test
+}; // struct CullingView
+
+//----------------------------------------------------------------
+
+// CPU only, nothing here touches the device
+namespace FrustumCulling
+{
+
+//----------------------------------------------------------------
+
+// depth from 0 to 1, viewHeight in pixels
+CullingView		MakeView(const glm::mat4 &viewProj, float viewHeight, float minPixels);
+
+// drops the near plane, objects between the eye and the view pass too,
+// shadow casters out of a light view still darken it once their depth is clamped
+void			ExtendTowardEye(CullingView &view);
+
+// appends the indices of the visible objects in increasing order, with the widest kernel the build targets
+void			Cull(const CullingView &view, const CullingBounds &bounds, std::vector<uint32_t> &outVisible);
+
+// one object at a time, same results as Cull
+void			CullScalar(const CullingView &view, const CullingBounds &bounds, std::vector<uint32_t> &outVisible);
+
+// "AVX", "SSE" or "scalar"
+const char*		GetKernelName();
+
+// microseconds per view of the kernel against the scalar path, printed for counts up to maxObjectsCount
+void			Benchmark(uint32_t maxObjectsCount);
+
+//----------------------------------------------------------------
+
+} // namespace FrustumCulling
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Utility.h"
+#include "Initializers.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define KTX2_EXTENSION ".ktx2"
+
+//----------------------------------------------------------------
+
+// subset of KTX 2.0: single 2D image, no supercompression, RGBA8 or BC1/BC3/BC5/BC7 with any number of mips
+namespace Ktx2
+{
+
+//----------------------------------------------------------------
+
+struct Level
+{
+	uint64_t	m_Offset; // in Image::m_Data
+	uint64_t	m_Size;
+	uint32_t	m_Width;
+	uint32_t	m_Height;
+}; // struct Level
+
+//----------------------------------------------------------------
+
+// levels are stored from the base level down, tightly packed
+struct Image
+{
+	VkFormat				m_Format;
+	uint32_t				m_Width;
+	uint32_t				m_Height;
+	std::vector<Level>		m_Levels;
+	std::vector<uint8_t>	m_Data;
+}; // struct Image
+
+//----------------------------------------------------------------
+
+// fails on anything outside the supported subset
+bool			Read(const std::string &path, Image &outImage);
+
+// written in a temporary file then renamed, with a data format descriptor so that other tools can open it
+bool			Write(const std::string &path, const Image &image);
+
+bool			IsSupportedFormat(VkFormat format);
+bool			IsBlockCompressed(VkFormat format);
+
+// bytes of one level, whole 4x4 blocks for compressed formats
+uint64_t		GetLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+//----------------------------------------------------------------
+
+} // namespace Ktx2
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
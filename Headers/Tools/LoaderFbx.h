@@ -104,7 +104,20 @@ enum IMPORT_FLAG
 
 //----------------------------------------------------------------
 
-extern bool	Load(const std::string& path, const int flags, std::vector<glm::vec3>& allPosition, std::vector<glm::vec2>& allUV, std::vector<glm::vec3>& allNormal, std::vector<glm::vec4>& allDiffuseColor, std::vector<uint16_t>& allIndices, std::vector<std::string>& allDiffuseTextures, std::vector<std::string>& allNormalTextures);
+// one per aiMesh, indices are local to the mesh vertices starting at m_FirstVertex
+struct SubmeshRange
+{
+	uint32_t	m_FirstIndex;
+	uint32_t	m_IndicesCount;
+	uint32_t	m_FirstVertex;
+	uint32_t	m_VerticesCount;
+	uint32_t	m_MaterialIndex;
+};
+
+//----------------------------------------------------------------
+
+// textures are given per scene material, an empty path when the material has none
+extern bool	Load(const std::string& path, const int flags, std::vector<glm::vec3>& allPosition, std::vector<glm::vec2>& allUV, std::vector<glm::vec3>& allNormal, std::vector<glm::vec4>& allDiffuseColor, std::vector<uint32_t>& allIndices, std::vector<SubmeshRange>& allSubmeshes, std::vector<std::string>& allDiffuseTextures, std::vector<std::string>& allNormalTextures);
 
 //----------------------------------------------------------------
 
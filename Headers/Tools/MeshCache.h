@@ -0,0 +1,153 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "VertexData.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define MESH_CACHE_MAGIC 0x48534d4c // "LMSH"
+#define MESH_CACHE_VERSION 5 // bump on any layout change of the file or of VertexData, and when the import optimization or simplification changes
+#define MESH_CACHE_EXTENSION ".lmesh"
+#define MESH_CACHE_MAX_PATH 256
+#define MESH_CACHE_SECTION_ALIGNMENT 16
+
+//----------------------------------------------------------------
+
+// read only view of a whole file, memory mapped so that nothing is copied until it is read
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile&	operator=(const MappedFile&) = delete;
+
+	bool			Open(const std::string &path);
+	void			Close();
+
+	// getters
+	const void*		GetData() const { return m_Data; }
+	uint64_t		GetSize() const { return m_Size; }
+	bool			IsOpen() const { return m_Data != nullptr; }
+
+private:
+	const void		*m_Data;
+	uint64_t		m_Size;
+
+#if defined(_WIN32)
+	void			*m_File;
+	void			*m_Mapping;
+#endif
+}; // class MappedFile
+
+//----------------------------------------------------------------
+
+namespace MeshCache
+{
+
+//----------------------------------------------------------------
+
+// every section offset is from the start of the file and aligned on MESH_CACHE_SECTION_ALIGNMENT
+struct Header
+{
+	uint32_t	m_Magic;
+	uint32_t	m_Version;
+	uint64_t	m_SourceHash;
+	uint32_t	m_ImportFlags;
+	uint32_t	m_VertexStride;
+
+	uint32_t	m_VerticesCount;
+	uint32_t	m_IndicesCount;
+	uint32_t	m_IndexSize; // 2 or 4 bytes
+	uint32_t	m_SubmeshesCount;
+	uint32_t	m_MaterialsCount;
+	uint32_t	m_LodsCount; // 1 to MESH_LOD_MAX_COUNT
+
+	glm::vec3	m_BoundsMin;
+	glm::vec3	m_BoundsMax;
+	float		m_BoundsRadius; // of the bounding sphere centered on the box
+
+	uint64_t	m_VerticesOffset;
+	uint64_t	m_IndicesOffset;
+	uint64_t	m_SubmeshesOffset;
+	uint64_t	m_MaterialsOffset;
+	uint64_t	m_LodsOffset;
+}; // struct Header
+
+//----------------------------------------------------------------
+
+// texture paths relative to the working directory, empty when the material has none
+struct Material
+{
+	char		m_DiffusePath[MESH_CACHE_MAX_PATH];
+	char		m_NormalPath[MESH_CACHE_MAX_PATH];
+}; // struct Material
+
+//----------------------------------------------------------------
+
+// everything written into a cache file
+struct MeshData
+{
+	std::vector<VertexData>	m_Vertices;
+	std::vector<uint8_t>	m_Indices; // m_IndicesCount indices of m_IndexSize bytes
+	uint32_t				m_IndicesCount;
+	uint32_t				m_IndexSize;
+	std::vector<Submesh>	m_Submeshes; // every level of detail
+	std::vector<Material>	m_Materials;
+	std::vector<MeshLod>	m_Lods; // full detail first
+
+	glm::vec3				m_BoundsMin;
+	glm::vec3				m_BoundsMax;
+	float					m_BoundsRadius;
+}; // struct MeshData
+
+//----------------------------------------------------------------
+
+// mapped cache file, the pointers stay valid until Close
+class View
+{
+public:
+	// fails when the file is missing, truncated, from another version or built from another source or flags
+	bool					Open(const std::string &path, uint64_t sourceHash, uint32_t importFlags);
+	void					Close() { m_File.Close(); }
+
+	bool					IsOpen() const { return m_File.IsOpen(); }
+
+	// getters
+	const Header&			GetHeader() const { return *static_cast<const Header*>(m_File.GetData()); }
+	const VertexData*		GetVertices() const { return reinterpret_cast<const VertexData*>(GetSection(GetHeader().m_VerticesOffset)); }
+	const void*				GetIndices() const { return GetSection(GetHeader().m_IndicesOffset); }
+	const Submesh*			GetSubmeshes() const { return reinterpret_cast<const Submesh*>(GetSection(GetHeader().m_SubmeshesOffset)); }
+	const Material*			GetMaterials() const { return reinterpret_cast<const Material*>(GetSection(GetHeader().m_MaterialsOffset)); }
+	const MeshLod*			GetLods() const { return reinterpret_cast<const MeshLod*>(GetSection(GetHeader().m_LodsOffset)); }
+
+private:
+	const char*				GetSection(uint64_t offset) const { return static_cast<const char*>(m_File.GetData()) + offset; }
+
+	MappedFile				m_File;
+}; // class View
+
+//----------------------------------------------------------------
+
+// FNV-1a of the source file content and of the import flags, 0 when the source can't be read
+uint64_t		HashSource(const std::string &sourcePath, uint32_t importFlags);
+
+std::string		GetCachePath(const std::string &sourcePath);
+
+// written in a temporary file then renamed, a crash never leaves a truncated cache behind
+bool			Write(const std::string &path, uint64_t sourceHash, uint32_t importFlags, const MeshData &data);
+
+//----------------------------------------------------------------
+
+} // namespace MeshCache
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "VertexData.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define MESH_OPTIMIZER_CACHE_SIZE 16 // FIFO post-transform cache the statistics are measured with
+#define MESH_OPTIMIZER_OVERDRAW_THRESHOLD 1.05f // ACMR the overdraw pass may lose, relative to the vertex cache order
+#define MESH_OPTIMIZER_OVERDRAW_RESOLUTION 256 // of each of the 6 axis views rasterized by AnalyzeOverdraw
+#define MESH_OPTIMIZER_PASS_COUNT 5 // source, weld, vertex cache, overdraw, vertex fetch
+#define MESH_OPTIMIZER_SIMPLIFY_MIN_COSINE 0.25f // of the rotation a collapse may give to a triangle normal, about 75 degrees
+
+//----------------------------------------------------------------
+
+// sums of counters, so that the statistics of several submeshes add up
+struct VertexCacheStatistics
+{
+	VertexCacheStatistics() : m_TrianglesCount(0), m_VerticesCount(0), m_TransformedCount(0) { }
+
+	VertexCacheStatistics&	operator+=(const VertexCacheStatistics &other);
+
+	// average cache miss ratio, transformed vertices per triangle, 0.5 at best and 3 at worst
+	float		GetAcmr() const { return (m_TrianglesCount > 0) ? static_cast<float>(m_TransformedCount) / m_TrianglesCount : 0.f; }
+	// average transform to vertex ratio, 1 when every vertex is transformed once
+	float		GetAtvr() const { return (m_VerticesCount > 0) ? static_cast<float>(m_TransformedCount) / m_VerticesCount : 0.f; }
+
+	uint32_t	m_TrianglesCount;
+	uint32_t	m_VerticesCount; // referenced by the indices
+	uint32_t	m_TransformedCount; // cache misses
+}; // struct VertexCacheStatistics
+
+//----------------------------------------------------------------
+
+struct OverdrawStatistics
+{
+	OverdrawStatistics() : m_CoveredPixels(0), m_ShadedPixels(0) { }
+
+	OverdrawStatistics&		operator+=(const OverdrawStatistics &other);
+
+	// shaded pixels per covered pixel, 1 when nothing is drawn twice
+	float		GetOverdraw() const { return (m_CoveredPixels > 0) ? static_cast<float>(m_ShadedPixels) / m_CoveredPixels : 0.f; }
+
+	uint64_t	m_CoveredPixels;
+	uint64_t	m_ShadedPixels; // passed the depth test
+}; // struct OverdrawStatistics
+
+//----------------------------------------------------------------
+
+// statistics after each pass, summed over the optimized submeshes
+struct MeshOptimizerReport
+{
+	// one line per pass
+	void					Print(const std::string &name) const;
+
+	VertexCacheStatistics	m_VertexCache[MESH_OPTIMIZER_PASS_COUNT];
+	OverdrawStatistics		m_Overdraw[MESH_OPTIMIZER_PASS_COUNT];
+}; // struct MeshOptimizerReport
+
+//----------------------------------------------------------------
+
+// import time optimization of one submesh, triangle lists indexing the given vertices
+namespace MeshOptimizer
+{
+
+//----------------------------------------------------------------
+
+VertexCacheStatistics	AnalyzeVertexCache(const std::vector<uint32_t> &indices, uint32_t verticesCount);
+
+// counter clockwise triangles rasterized in order with a depth test, from the 6 axis directions around the vertices bounds
+OverdrawStatistics		AnalyzeOverdraw(const std::vector<VertexData> &vertices, const std::vector<uint32_t> &indices);
+
+// merges bitwise identical vertices, unreferenced ones are kept until OptimizeVertexFetch
+void					WeldVertices(std::vector<VertexData> &vertices, std::vector<uint32_t> &indices);
+
+// Forsyth's linear speed ordering, for any cache size up to 32
+void					OptimizeVertexCache(std::vector<uint32_t> &indices, uint32_t verticesCount);
+
+// splits the cache ordered triangles into clusters and draws the outward facing ones first, losing at most threshold times the ACMR
+void					OptimizeOverdraw(const std::vector<VertexData> &vertices, std::vector<uint32_t> &indices, float threshold);
+
+// vertices in order of first use, unreferenced ones are removed
+void					OptimizeVertexFetch(std::vector<VertexData> &vertices, std::vector<uint32_t> &indices);
+
+// every pass above in order, the statistics of the submesh are added to the report
+void					Optimize(std::vector<VertexData> &vertices, std::vector<uint32_t> &indices, MeshOptimizerReport &report);
+
+// quadric error edge collapses onto existing vertices, so that every level of detail draws from the same vertices,
+// until the indices count or the error is reached, border and seam vertices never move,
+// returns the error of the result as an object space distance
+float					Simplify(	const std::vector<VertexData> &vertices, const std::vector<uint32_t> &indices, uint32_t targetIndicesCount, float targetError,
+									std::vector<uint32_t> &outIndices);
+
+//----------------------------------------------------------------
+
+} // namespace MeshOptimizer
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
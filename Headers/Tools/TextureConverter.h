@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Tools/Ktx2.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+enum class TEXTURE_COMPRESSION
+{
+	Auto = 0, // BC5 for normal maps, BC3 with alpha, BC1 otherwise
+	RGBA8 = 1,
+	BC1 = 2,
+	BC3 = 3,
+	BC5 = 4
+};
+
+//----------------------------------------------------------------
+
+// offline conversion of source images into KTX2 files with their whole mip chain, so that loading never blits
+namespace TextureConverter
+{
+
+//----------------------------------------------------------------
+
+// the automatic choice looks at the file name and at the alpha of the RGBA8 pixels
+VkFormat	ChooseFormat(const std::string &sourcePath, const std::vector<uint8_t> &pixels, TEXTURE_COMPRESSION compression);
+
+// box filtered mips of RGBA8 pixels, each level encoded in RGBA8, BC1, BC3 or BC5
+bool		Encode(const std::vector<uint8_t> &pixels, uint32_t width, uint32_t height, VkFormat format, Ktx2::Image &outImage);
+
+bool		ConvertFile(const std::string &sourcePath, const std::string &destinationPath, TEXTURE_COMPRESSION compression = TEXTURE_COMPRESSION::Auto);
+
+// writes a .ktx2 next to every image of the folder and its sub folders whose conversion is missing or older, returns the converted count
+uint32_t	ConvertFolder(const std::string &folderPath, TEXTURE_COMPRESSION compression = TEXTURE_COMPRESSION::Auto);
+
+//----------------------------------------------------------------
+
+} // namespace TextureConverter
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Initializers.h"
+#include "MemoryAllocator.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+#define UNIFORM_ARENA_SIZE (4ull << 20) // 4MB per frame in flight to start with, grown by Reserve
+
+//----------------------------------------------------------------
+
+// persistently mapped uniform buffer of one frame in flight, filled by bump allocation and rewound
+// once the GPU is done with the frame, allocations are aligned so that offsets can be used as dynamic offsets
+class UniformArena
+{
+public:
+	UniformArena();
+	~UniformArena();
+
+	bool				Prepare(const VkDevice logicalDevice, VkDeviceSize size, VkDeviceSize alignment);
+	void				Shutdown(const VkDevice logicalDevice);
+
+	void				Reset() { m_Head = 0; }
+
+	// at least size bytes once it returns true, the buffer is recreated when it grows (at least doubling) so the frame
+	// must not be in flight and the descriptors reading the old buffer must be rewritten, see GetApiBuffer
+	bool				Reserve(const VkDevice logicalDevice, VkDeviceSize size);
+
+	// returns the mapped memory to write into, nullptr when the arena is full
+	void*				Allocate(VkDeviceSize size, uint32_t &outOffset);
+
+	template<typename T>
+	T*					Allocate(uint32_t count, uint32_t &outOffset) { return static_cast<T*>(Allocate(sizeof(T) * count, outOffset)); }
+
+	VkDeviceSize		GetAlignedSize(VkDeviceSize size) const { return (size + m_Alignment - 1) & ~(m_Alignment - 1); }
+
+	// getters
+	const VkBuffer		GetApiBuffer() const { return m_Buffer; }
+	VkDeviceSize		GetSize() const { return m_Size; }
+	VkDeviceSize		GetUsedSize() const { return m_Head; }
+
+private:
+	VkBuffer			m_Buffer;
+	MemoryAllocation	m_Allocation;
+
+	VkDeviceSize		m_Size;
+	VkDeviceSize		m_Alignment;
+	VkDeviceSize		m_Head;
+}; // class UniformArena
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
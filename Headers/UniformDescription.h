@@ -1,6 +1,7 @@
 #pragma once
 
 #include <tuple>
+#include <utility>
 
 #include "Initializers.h"
 #include "RenderHandle.h"
@@ -38,6 +39,8 @@ union DescriptionInfo
 
 //----------------------------------------------------------------
 
+// one descriptor set per frame in flight, set i is allocated from frame i's descriptor allocator,
+// the sets and their layout are released on destruction so no frame in flight may still use them
 struct UniformDescription
 {
 	UniformDescription(	const VkDevice logicalDevice,
@@ -45,6 +48,7 @@ struct UniformDescription
 						const std::vector<DescriptionInfo> &descriptionsInfo,
 						uint32_t pendingFrames,
 						bool isOffscreen = false)
+	:	m_LogicalDevice(logicalDevice)
 	{
 		// TODO: move descriptor structs in initializers
 
@@ -80,16 +84,16 @@ struct UniformDescription
 		// create DescriptorSets
 		m_DescriptorLayouts = std::vector<VkDescriptorSetLayout>(pendingFrames, descLayout);
 
-		VkDescriptorSetAllocateInfo descAllocateInfo = { };
+		m_Descriptors.resize(pendingFrames, nullptr);
+		m_DescriptorPools.resize(pendingFrames, nullptr);
+
+		for (uint32_t frameIndex = 0; frameIndex < pendingFrames; ++frameIndex)
 		{
-			descAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-			descAllocateInfo.descriptorPool = Device::m_Device->GetDescriptorPool();
-			descAllocateInfo.descriptorSetCount = pendingFrames;
-			descAllocateInfo.pSetLayouts = m_DescriptorLayouts.data();
-		}
+			DescriptorAllocator	*descAllocator = Device::m_Device->GetDescriptorAllocator(frameIndex);
 
-		m_Descriptors.resize(pendingFrames);
-		CHECK_API_SUCCESS(vkAllocateDescriptorSets(logicalDevice, &descAllocateInfo, m_Descriptors.data()));
+			if (!descAllocator->Allocate(logicalDevice, descLayout, m_Descriptors[frameIndex], m_DescriptorPools[frameIndex]))
+				std::cout << "Can't allocate uniform description for frame " << frameIndex << std::endl; // TODO: change this for real logger
+		}
 
 		// update DescriptorSets with WriteDescriptorSets
 		VkWriteDescriptorSet writeDesc = { };
@@ -133,6 +137,8 @@ struct UniformDescription
 					case DESCRIPTION_TYPE::StorageBufferDynamic:
 					{
 						writeDesc.pBufferInfo = descriptionsInfo[descIndex + infoIndex].m_DescBufferInfo;
+
+						m_BufferBindings.push_back({ frameIndex, descIndex, writeDesc.descriptorType, *writeDesc.pBufferInfo });
 						break;
 					}
 					case DESCRIPTION_TYPE::UniformTexelBuffer:
@@ -152,12 +158,131 @@ struct UniformDescription
 		}
 	}
 
+	UniformDescription(const UniformDescription&) = delete;
+	UniformDescription&	operator=(const UniformDescription&) = delete;
+
+	UniformDescription(UniformDescription &&other) noexcept
+	:	m_LogicalDevice(other.m_LogicalDevice),
+		m_Descriptors(std::move(other.m_Descriptors)),
+		m_DescriptorPools(std::move(other.m_DescriptorPools)),
+		m_DescriptorLayouts(std::move(other.m_DescriptorLayouts)),
+		m_BufferBindings(std::move(other.m_BufferBindings))
+	{
+		other.m_LogicalDevice = nullptr;
+	}
+
+	UniformDescription&	operator=(UniformDescription &&other) noexcept
+	{
+		if (this != &other)
+		{
+			Release();
+
+			m_LogicalDevice = other.m_LogicalDevice;
+			m_Descriptors = std::move(other.m_Descriptors);
+			m_DescriptorPools = std::move(other.m_DescriptorPools);
+			m_DescriptorLayouts = std::move(other.m_DescriptorLayouts);
+			m_BufferBindings = std::move(other.m_BufferBindings);
+
+			other.m_LogicalDevice = nullptr;
+		}
+
+		return *this;
+	}
+
+	~UniformDescription()
+	{
+		Release();
+	}
+
+	// the descriptor set of the frame must not be used by a frame in flight
+	void	UpdateImage(const VkDevice logicalDevice, uint32_t frameIndex, uint32_t binding, const VkDescriptorImageInfo &imageInfo) const
+	{
+		VkWriteDescriptorSet writeDesc = { };
+		{
+			writeDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeDesc.dstSet = m_Descriptors[frameIndex];
+			writeDesc.dstBinding = binding;
+			writeDesc.dstArrayElement = 0;
+			writeDesc.descriptorCount = 1;
+			writeDesc.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writeDesc.pImageInfo = &imageInfo;
+		}
+
+		vkUpdateDescriptorSets(logicalDevice, 1, &writeDesc, 0, nullptr);
+	}
+
+	// rewrites the buffer bindings of the frame that read oldBuffer, same offsets and ranges,
+	// the descriptor set of the frame must not be used by a frame in flight
+	void	ReplaceBuffer(const VkDevice logicalDevice, uint32_t frameIndex, const VkBuffer oldBuffer, const VkBuffer newBuffer)
+	{
+		const uint32_t	bindingsCount = static_cast<uint32_t>(m_BufferBindings.size());
+		for (uint32_t bindingIndex = 0; bindingIndex < bindingsCount; ++bindingIndex)
+		{
+			BufferBinding	&bufferBinding = m_BufferBindings[bindingIndex];
+
+			if (bufferBinding.m_FrameIndex != frameIndex || bufferBinding.m_Info.buffer != oldBuffer)
+				continue;
+
+			bufferBinding.m_Info.buffer = newBuffer;
+
+			VkWriteDescriptorSet writeDesc = { };
+			{
+				writeDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writeDesc.dstSet = m_Descriptors[frameIndex];
+				writeDesc.dstBinding = bufferBinding.m_Binding;
+				writeDesc.dstArrayElement = 0;
+				writeDesc.descriptorCount = 1;
+				writeDesc.descriptorType = bufferBinding.m_Type;
+				writeDesc.pBufferInfo = &bufferBinding.m_Info;
+			}
+
+			vkUpdateDescriptorSets(logicalDevice, 1, &writeDesc, 0, nullptr);
+		}
+	}
+
 	const std::vector<VkDescriptorSet>&			GetDescriptors() const { return m_Descriptors; }
 	const std::vector<VkDescriptorSetLayout>&	GetDescriptorLayouts() const { return m_DescriptorLayouts; }
 
 private:
+	struct BufferBinding
+	{
+		uint32_t				m_FrameIndex;
+		uint32_t				m_Binding;
+		VkDescriptorType		m_Type;
+		VkDescriptorBufferInfo	m_Info;
+	}; // struct BufferBinding
+
+	void	Release()
+	{
+		if (m_LogicalDevice == nullptr)
+			return;
+
+		// the pools are created with FREE_DESCRIPTOR_SET
+		const uint32_t	descriptorsCount = static_cast<uint32_t>(m_Descriptors.size());
+		for (uint32_t frameIndex = 0; frameIndex < descriptorsCount; ++frameIndex)
+		{
+			if (m_Descriptors[frameIndex] != nullptr)
+				vkFreeDescriptorSets(m_LogicalDevice, m_DescriptorPools[frameIndex], 1, &m_Descriptors[frameIndex]);
+		}
+
+		// every entry is the same layout, one per frame for allocations and pipeline layouts
+		if (!m_DescriptorLayouts.empty())
+			vkDestroyDescriptorSetLayout(m_LogicalDevice, m_DescriptorLayouts[0], nullptr);
+
+		m_Descriptors.clear();
+		m_DescriptorPools.clear();
+		m_DescriptorLayouts.clear();
+		m_BufferBindings.clear();
+
+		m_LogicalDevice = nullptr;
+	}
+
+	VkDevice							m_LogicalDevice;
+
 	std::vector<VkDescriptorSet>		m_Descriptors;
+	std::vector<VkDescriptorPool>		m_DescriptorPools; // pool each set was allocated from, to free it
 	std::vector<VkDescriptorSetLayout>	m_DescriptorLayouts;
+	std::vector<BufferBinding>			m_BufferBindings; // as last written, to follow a buffer that is recreated
 }; // struct UniformDescription
 
 //----------------------------------------------------------------
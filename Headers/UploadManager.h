@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Initializers.h"
+#include "RenderCommand.h"
+#include "MemoryAllocator.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+struct Texture;
+
+//----------------------------------------------------------------
+
+struct StagingBuffer
+{
+	StagingBuffer() : m_Buffer(nullptr) { }
+
+	VkBuffer			m_Buffer;
+	MemoryAllocation	m_Allocation;
+}; // struct StagingBuffer
+
+//----------------------------------------------------------------
+
+// copies recorded between two flushes, submitted at once and tracked by a fence
+struct UploadBatch
+{
+	UploadBatch();
+
+	uint64_t					m_Id;
+
+	VkCommandBuffer				m_TransferBuffer;
+	VkCommandBuffer				m_GraphicsBuffer; // ownership acquire and mipmaps, only with a dedicated transfer queue
+	VkSemaphore					m_TransferSemaphore;
+	VkFence						m_Fence;
+
+	// released once m_Fence is signaled
+	std::vector<StagingBuffer>	m_StagingBuffers;
+}; // struct UploadBatch
+
+//----------------------------------------------------------------
+
+// batches texture and buffer uploads on a dedicated transfer queue when the device has one,
+// mipmaps are generated on the graphics queue after the queue family ownership transfer
+class UploadManager
+{
+public:
+	UploadManager();
+	~UploadManager();
+
+	bool					Setup(const std::vector<VkQueueFamilyProperties> &queuesFamilyProperties);
+	bool					Prepare(const VkDevice logicalDevice);
+	void					Shutdown();
+
+	// record into the pending batch, outBatchId is the batch to poll or wait on,
+	// false when no staging memory is left even after waiting for the batches in flight, nothing is recorded then
+	bool					UploadTexture(	const Texture &texture,
+											const std::vector<const void*> &layers,
+											VkDeviceSize layerSize,
+											VkImageSubresourceRange subRange,
+											bool generateMipmaps,
+											uint64_t &outBatchId);
+	bool					UploadBuffer(	const VkBuffer buffer,
+											const void *data,
+											VkDeviceSize size,
+											VkAccessFlags dstAccess,
+											VkPipelineStageFlags dstStage,
+											VkDeviceSize dstOffset = 0);
+
+	// submit the pending batch, work submitted later on the graphics queue is ordered after it
+	uint64_t				Flush();
+	// release staging memory of completed batches
+	void					Update();
+	void					Wait(uint64_t batchId);
+
+	// getters
+	bool					IsComplete(uint64_t batchId) const { return batchId <= m_CompletedBatchId; }
+	bool					HasDedicatedTransfer() const { return m_TransferCommand != m_GraphicsCommand; }
+	uint32_t				GetTransferFamilyIndex() const { return m_TransferCommand->GetQueue().m_FamilyIndex; }
+	uint32_t				GetGraphicsFamilyIndex() const { return m_GraphicsCommand->GetQueue().m_FamilyIndex; }
+
+private:
+	UploadBatch*			GetPendingBatch();
+	bool					CreateStagingBuffer(const std::vector<const void*> &data, VkDeviceSize dataSize, StagingBuffer &outStagingBuffer);
+	void					ReleaseBatch(UploadBatch *batch);
+
+	void					RecordMipmaps(const VkCommandBuffer commandBuffer, const Texture &texture, VkImageSubresourceRange subRange);
+
+	VkDevice					m_LogicalDevice;
+
+	RenderCommand				*m_GraphicsCommand;
+	RenderCommand				*m_TransferCommand; // same as m_GraphicsCommand without dedicated transfer family
+
+	UploadBatch					*m_PendingBatch;
+	std::vector<UploadBatch*>	m_InFlightBatches; // in submission order
+	std::vector<UploadBatch*>	m_FreeBatches;
+
+	uint64_t					m_NextBatchId;
+	uint64_t					m_CompletedBatchId;
+}; // class UploadManager
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
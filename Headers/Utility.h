@@ -3,6 +3,7 @@
 #include <vector>
 #include <fstream>
 #include <string>
+#include <iostream>
 
 #include <stb_image.h>
 
@@ -10,7 +11,9 @@
 
 #define LIGHTLYY_BEGIN namespace Lightlyy {
 #define LIGHTLYY_END }
-#define ENGINE_DATA_PATH "../../Data/"
+#if !defined(ENGINE_DATA_PATH)
+#define ENGINE_DATA_PATH "../../Data/" // relative to the working directory, builds may point it elsewhere
+#endif
 
 //----------------------------------------------------------------
 
@@ -20,7 +23,7 @@ LIGHTLYY_BEGIN
 
 static std::vector<char>	LoadFile(const std::string &path, uint32_t openMode)
 {
-	std::ifstream file(path, openMode);
+	std::ifstream file(path, static_cast<std::ios::openmode>(openMode));
 
 	if (file.is_open())
 	{
@@ -44,6 +47,17 @@ static std::vector<stbi_uc> LoadImageTextureWithSTB(const std::string &path, uin
 {
 	stbi_uc*				pixels = stbi_load(path.c_str(), reinterpret_cast<int*>(width), reinterpret_cast<int*>(height), reinterpret_cast<int*>(channel), desiredChannelCount);
 
+	if (pixels == nullptr)
+	{
+		std::cout << "Can't decode texture " << path << std::endl; // TODO: change this for real logger
+
+		*width = 0;
+		*height = 0;
+		*channel = 0;
+
+		return std::vector<stbi_uc>();
+	}
+
 	std::vector<stbi_uc>	p = std::vector<stbi_uc>(pixels, pixels + ((*width) * (*height) * desiredChannelCount));
 
 	stbi_image_free(pixels);
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <vector>
+
 #include "glm/glm.hpp"
 
 #include "Initializers.h"
@@ -11,6 +15,40 @@ LIGHTLYY_BEGIN
 
 //----------------------------------------------------------------
 
+// layout of the mesh vertex streams, the vertex fetch decodes every one of them into the same float inputs
+enum class VERTEX_LAYOUT
+{
+	Full = 0, // ShadowData and AttributeData, 12 + 36 bytes
+	Compact = 1, // ShadowData and CompactAttributeData, 12 + 12 bytes
+	Quantized = 2 // QuantizedShadowData and CompactAttributeData, 8 + 12 bytes, positions dequantized by the model matrix
+};
+
+//----------------------------------------------------------------
+
+// packed attribute types, each one maps to the format reading it back as floats
+struct Half2
+{
+	uint32_t	m_Packed;
+}; // struct Half2
+
+struct SNorm8x4
+{
+	uint32_t	m_Packed;
+}; // struct SNorm8x4
+
+struct UNorm8x4
+{
+	uint32_t	m_Packed;
+}; // struct UNorm8x4
+
+struct UNorm16x4
+{
+	uint32_t	m_Packed[2]; // 4 bytes aligned so that the vertex isn't padded
+}; // struct UNorm16x4
+
+//----------------------------------------------------------------
+
+// imported and procedural vertices, also the layout of the mesh cache
 struct VertexData
 {
 	glm::vec3	m_Pos;
@@ -19,50 +57,276 @@ struct VertexData
 	glm::vec4	m_Color;
 }; // struct VertexData
 
+// meshes are drawn from two streams, the position stream alone is bound by the shadow passes
+struct ShadowData
+{
+	glm::vec3	m_Pos;
+}; // struct ShadowData
+
+// positions are in the unit cube of the mesh bounds, see VertexFormat::GetDequantization
+struct QuantizedShadowData
+{
+	UNorm16x4	m_Pos; // w is 1
+}; // struct QuantizedShadowData
+
+struct AttributeData
+{
+	glm::vec2	m_TexCoord;
+	glm::vec3	m_Normal;
+	glm::vec4	m_Color;
+}; // struct AttributeData
+
+struct CompactAttributeData
+{
+	Half2		m_TexCoord;
+	SNorm8x4	m_Normal; // w unused
+	UNorm8x4	m_Color;
+}; // struct CompactAttributeData
+
 //----------------------------------------------------------------
 
-struct VertexDescription // must mirror VertexData
+// range of the shared index buffer drawn with its own base vertex, indices are local to the submesh
+struct Submesh
 {
-	VertexDescription()
+	uint32_t	m_FirstIndex;
+	uint32_t	m_IndicesCount;
+	int32_t		m_VertexOffset;
+	uint32_t	m_MaterialIndex;
+}; // struct Submesh
+
+//----------------------------------------------------------------
+
+#define MESH_LOD_MAX_COUNT 4 // full detail included
+
+// one level of detail of a whole mesh, a range of the submeshes array, every level draws from the same vertices
+struct MeshLod
+{
+	uint32_t	m_FirstSubmesh;
+	uint32_t	m_SubmeshesCount;
+	float		m_Error; // object space distance to the full detail surface, 0 for the first level
+}; // struct MeshLod
+
+//----------------------------------------------------------------
+
+template<typename T>
+struct VertexAttributeFormat;
+
+template<> struct VertexAttributeFormat<glm::vec2> { static constexpr VkFormat m_Format = VK_FORMAT_R32G32_SFLOAT; };
+template<> struct VertexAttributeFormat<glm::vec3> { static constexpr VkFormat m_Format = VK_FORMAT_R32G32B32_SFLOAT; };
+template<> struct VertexAttributeFormat<glm::vec4> { static constexpr VkFormat m_Format = VK_FORMAT_R32G32B32A32_SFLOAT; };
+template<> struct VertexAttributeFormat<Half2> { static constexpr VkFormat m_Format = VK_FORMAT_R16G16_SFLOAT; };
+template<> struct VertexAttributeFormat<SNorm8x4> { static constexpr VkFormat m_Format = VK_FORMAT_R8G8B8A8_SNORM; };
+template<> struct VertexAttributeFormat<UNorm8x4> { static constexpr VkFormat m_Format = VK_FORMAT_R8G8B8A8_UNORM; };
+template<> struct VertexAttributeFormat<UNorm16x4> { static constexpr VkFormat m_Format = VK_FORMAT_R16G16B16A16_UNORM; };
+
+//----------------------------------------------------------------
+
+struct VertexAttribute
+{
+	uint32_t	m_Location;
+	VkFormat	m_Format;
+	uint32_t	m_Offset;
+	uint32_t	m_Size;
+}; // struct VertexAttribute
+
+// format, offset and size come from the member declaration
+#define VERTEX_ATTRIBUTE(vertex, member, location) VertexAttribute{ location, VertexAttributeFormat<decltype(vertex::member)>::m_Format, static_cast<uint32_t>(offsetof(vertex, member)), static_cast<uint32_t>(sizeof(vertex::member)) }
+
+//----------------------------------------------------------------
+
+// one table per stream struct, in shader location order
+template<typename Vertex>
+struct VertexLayout;
+
+template<>
+struct VertexLayout<ShadowData>
+{
+	static constexpr VertexAttribute	m_Attributes[] = { VERTEX_ATTRIBUTE(ShadowData, m_Pos, 0) };
+}; // struct VertexLayout<ShadowData>
+
+template<>
+struct VertexLayout<QuantizedShadowData>
+{
+	static constexpr VertexAttribute	m_Attributes[] = { VERTEX_ATTRIBUTE(QuantizedShadowData, m_Pos, 0) };
+}; // struct VertexLayout<QuantizedShadowData>
+
+template<>
+struct VertexLayout<AttributeData>
+{
+	static constexpr VertexAttribute	m_Attributes[] = {	VERTEX_ATTRIBUTE(AttributeData, m_TexCoord, 1), VERTEX_ATTRIBUTE(AttributeData, m_Normal, 2),
+															VERTEX_ATTRIBUTE(AttributeData, m_Color, 3) };
+}; // struct VertexLayout<AttributeData>
+
+template<>
+struct VertexLayout<CompactAttributeData>
+{
+	static constexpr VertexAttribute	m_Attributes[] = {	VERTEX_ATTRIBUTE(CompactAttributeData, m_TexCoord, 1), VERTEX_ATTRIBUTE(CompactAttributeData, m_Normal, 2),
+															VERTEX_ATTRIBUTE(CompactAttributeData, m_Color, 3) };
+}; // struct VertexLayout<CompactAttributeData>
+
+//----------------------------------------------------------------
+
+// bytes read by the vertex fetch for each attribute format used above
+constexpr uint32_t	GetVertexFormatSize(VkFormat format)
+{
+	switch (format)
 	{
-		m_BindingDesc = { };
-		{
-			m_BindingDesc.binding = 0;
-			m_BindingDesc.stride = sizeof(VertexData);
-			m_BindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		}
+	case VK_FORMAT_R16G16_SFLOAT:
+	case VK_FORMAT_R8G8B8A8_SNORM:
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		return 4;
+	case VK_FORMAT_R32G32_SFLOAT:
+	case VK_FORMAT_R16G16B16A16_UNORM:
+		return 8;
+	case VK_FORMAT_R32G32B32_SFLOAT:
+		return 12;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+// every member listed once in declaration order, without padding, with consecutive locations,
+// and each one exactly as large as the format reading it
+template<typename Vertex>
+constexpr bool	IsVertexLayoutComplete()
+{
+	uint32_t	offset = 0;
+	uint32_t	location = VertexLayout<Vertex>::m_Attributes[0].m_Location;
 
-		m_AttribsDesc.resize(4);
-
-		m_AttribsDesc[0].binding = 0;
-		m_AttribsDesc[0].location = 0;
-		m_AttribsDesc[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		m_AttribsDesc[0].offset = offsetof(VertexData, VertexData::m_Pos);
-
-		m_AttribsDesc[1].binding = 0;
-		m_AttribsDesc[1].location = 1;
-		m_AttribsDesc[1].format = VK_FORMAT_R32G32_SFLOAT;
-		m_AttribsDesc[1].offset = offsetof(VertexData, VertexData::m_TexCoord);
-		
-		m_AttribsDesc[2].binding = 0;
-		m_AttribsDesc[2].location = 2;
-		m_AttribsDesc[2].format = VK_FORMAT_R32G32B32_SFLOAT;
-		m_AttribsDesc[2].offset = offsetof(VertexData, VertexData::m_Normal);
-
-		m_AttribsDesc[3].binding = 0;
-		m_AttribsDesc[3].location = 3;
-		m_AttribsDesc[3].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-		m_AttribsDesc[3].offset = offsetof(VertexData, VertexData::m_Color);
+	for (const VertexAttribute &attribute : VertexLayout<Vertex>::m_Attributes)
+	{
+		if (attribute.m_Location != location++)
+			return false;
+
+		if (attribute.m_Offset != offset || attribute.m_Size != GetVertexFormatSize(attribute.m_Format))
+			return false;
+
+		offset += attribute.m_Size;
 	}
 
-	const VkVertexInputBindingDescription&					GetBindingDesc() const { return m_BindingDesc; }
+	return offset == sizeof(Vertex);
+}
+
+static_assert(IsVertexLayoutComplete<ShadowData>(), "VertexLayout<ShadowData> doesn't match its struct");
+static_assert(IsVertexLayoutComplete<QuantizedShadowData>(), "VertexLayout<QuantizedShadowData> doesn't match its struct");
+static_assert(IsVertexLayoutComplete<AttributeData>(), "VertexLayout<AttributeData> doesn't match its struct");
+static_assert(IsVertexLayoutComplete<CompactAttributeData>(), "VertexLayout<CompactAttributeData> doesn't match its struct");
+
+//----------------------------------------------------------------
+
+// binding 0, patched when the stream is bound elsewhere
+template<typename Vertex>
+constexpr auto	MakeAttributesDesc()
+{
+	constexpr size_t	attributesCount = std::size(VertexLayout<Vertex>::m_Attributes);
+
+	std::array<VkVertexInputAttributeDescription, attributesCount>	attributesDesc = { };
+
+	for (size_t attributeIndex = 0; attributeIndex < attributesCount; ++attributeIndex)
+	{
+		const VertexAttribute	&attribute = VertexLayout<Vertex>::m_Attributes[attributeIndex];
+
+		attributesDesc[attributeIndex].location = attribute.m_Location;
+		attributesDesc[attributeIndex].binding = 0;
+		attributesDesc[attributeIndex].format = attribute.m_Format;
+		attributesDesc[attributeIndex].offset = attribute.m_Offset;
+	}
+
+	return attributesDesc;
+}
+
+//----------------------------------------------------------------
+
+// pipeline vertex input, one binding per stream, built at compile time from the tables above
+struct VertexInputDescription
+{
+	const std::vector<VkVertexInputBindingDescription>&		GetBindingsDesc() const { return m_BindingsDesc; }
 	const std::vector<VkVertexInputAttributeDescription>&	GetAttributesDesc() const { return m_AttribsDesc; }
 
-private:
-	VkVertexInputBindingDescription					m_BindingDesc;
+protected:
+	template<typename Vertex>
+	void	AddBinding()
+	{
+		const uint32_t			binding = static_cast<uint32_t>(m_BindingsDesc.size());
+		static constexpr auto	attributesDesc = MakeAttributesDesc<Vertex>();
+
+		VkVertexInputBindingDescription	bindingDesc = { };
+		{
+			bindingDesc.binding = binding;
+			bindingDesc.stride = sizeof(Vertex);
+			bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		}
+
+		m_BindingsDesc.push_back(bindingDesc);
+
+		for (VkVertexInputAttributeDescription attributeDesc : attributesDesc)
+		{
+			attributeDesc.binding = binding;
+			m_AttribsDesc.push_back(attributeDesc);
+		}
+	}
+
+	std::vector<VkVertexInputBindingDescription>	m_BindingsDesc;
 	std::vector<VkVertexInputAttributeDescription>	m_AttribsDesc;
+}; // struct VertexInputDescription
+
+//----------------------------------------------------------------
+
+// position stream in binding 0, attribute stream in binding 1
+struct VertexDescription : public VertexInputDescription
+{
+	VertexDescription(VERTEX_LAYOUT layout = VERTEX_LAYOUT::Full)
+	{
+		if (layout == VERTEX_LAYOUT::Quantized)
+			AddBinding<QuantizedShadowData>();
+		else
+			AddBinding<ShadowData>();
+
+		if (layout == VERTEX_LAYOUT::Full)
+			AddBinding<AttributeData>();
+		else
+			AddBinding<CompactAttributeData>();
+	}
 }; // struct VertexDescription
 
 //----------------------------------------------------------------
 
+// position stream only, for the depth only pipelines
+struct ShadowDescription : public VertexInputDescription
+{
+	ShadowDescription(VERTEX_LAYOUT layout = VERTEX_LAYOUT::Full)
+	{
+		if (layout == VERTEX_LAYOUT::Quantized)
+			AddBinding<QuantizedShadowData>();
+		else
+			AddBinding<ShadowData>();
+	}
+}; // struct ShadowDescription
+
+//----------------------------------------------------------------
+
+// conversion of VertexData into the GPU layouts
+namespace VertexFormat
+{
+
+//----------------------------------------------------------------
+
+uint32_t		GetPositionStride(VERTEX_LAYOUT layout);
+uint32_t		GetAttributeStride(VERTEX_LAYOUT layout);
+
+// object space from the stored positions, to apply before the model matrix, identity unless quantized
+glm::mat4		GetDequantization(VERTEX_LAYOUT layout, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+
+// splits the vertices into their position and attribute streams, the bounds must contain every position
+void			Encode(	VERTEX_LAYOUT layout, const VertexData *vertices, uint32_t verticesCount, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+						std::vector<uint8_t> &outPositions, std::vector<uint8_t> &outAttributes);
+
+//----------------------------------------------------------------
+
+} // namespace VertexFormat
+
+//----------------------------------------------------------------
+
 LIGHTLYY_END
@@ -4,8 +4,8 @@
 
 #include "Initializers.h"
 
-#include <glfw/glfw3.h>
-#include <glfw/glfw3native.h>
+#include <GLFW/glfw3.h>
+#include <GLFW/glfw3native.h>
 
 #define GLFW_INCLUDE_NONE
 #define GLFW_INCLUDE_VULKAN
@@ -31,7 +31,9 @@ public:
 	bool	IsClosed() const;
 
 	const GLFWwindow*	GetApiWindow() const { return m_ApiWindow; }
+#if defined(_WIN32)
 	HWND				GetWindowHandle() const;
+#endif
 
 	Camera	*m_Camera;
 
@@ -42,6 +44,8 @@ private:
 
 	float		m_CameraX;
 	float		m_CameraY;
+
+	bool		m_TraceKeyPressed;
 };
 
 //----------------------------------------------------------------
@@ -0,0 +1,30 @@
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "Device.h"
+
+//----------------------------------------------------------------
+
+using namespace Lightlyy;
+
+//----------------------------------------------------------------
+
+// renders the default scene into offscreen targets, without window nor UI, see DeviceSettings::ParseCommandLine
+// for the options, --frames bounds the run
+int		main(int argc, char **argv)
+{
+	DeviceSettings	settings;
+
+	if (!settings.ParseCommandLine(argc, argv))
+	{
+		std::cout << "Usage: " << argv[0] << " --frames <count> [options of DeviceSettings::ParseCommandLine]" << std::endl; // TODO: change this for real logger
+		return 1;
+	}
+
+	// this binary never opens a window
+	settings.m_Headless = true;
+
+	Device::m_Device = std::make_unique<Device>("Lightlyy Headless", "Lightlyy", settings);
+
+	// runs every frame before returning, the device is destroyed with the static pointer since its shutdown still reads it
+	return Device::m_Device->Setup() ? 0 : 1;
+}
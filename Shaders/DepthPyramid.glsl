@@ -0,0 +1,29 @@
+// declarations shared by DepthPyramid.comp and DepthPyramidResolve.comp, they mirror DepthPyramid.cpp and must change with it
+
+#define DEPTH_PYRAMID_GROUP_SIZE 8
+
+layout(local_size_x = DEPTH_PYRAMID_GROUP_SIZE, local_size_y = DEPTH_PYRAMID_GROUP_SIZE) in;
+
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D outputLevel;
+
+// an output texel takes the farthest depth of the input texels it covers
+layout(push_constant) uniform DepthPyramidLevel
+{
+	uint	inputWidth;
+	uint	inputHeight;
+	uint	outputWidth;
+	uint	outputHeight;
+} level;
+
+// input texels covered by an output texel, end excluded, 2x2 past the first level and up to 3x3 for the first one
+void	GetInputRange(uvec2 outputCoord, out ivec2 outFirst, out ivec2 outLast)
+{
+	const uvec2	inputSize = uvec2(level.inputWidth, level.inputHeight);
+	const uvec2	outputSize = uvec2(level.outputWidth, level.outputHeight);
+
+	const uvec2	first = (outputCoord * inputSize) / outputSize;
+	const uvec2	last = max(((outputCoord + 1) * inputSize + outputSize - 1) / outputSize, first + 1);
+
+	outFirst = ivec2(first);
+	outLast = ivec2(min(last, inputSize));
+}
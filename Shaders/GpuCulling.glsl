@@ -0,0 +1,69 @@
+// declarations shared by CullMeshes.comp and the indirect draws, they mirror GpuCulling.h and must change with it
+
+#define GPU_CULLING_MAX_OBJECTS 4096
+#define GPU_CULLING_MAX_DRAWS 16384
+#define GPU_CULLING_GROUP_SIZE 64
+#define GPU_CULLING_VIEWS_COUNT 5
+
+#define GPU_CULLING_LIST_OPAQUE 0
+#define GPU_CULLING_LIST_TRANSPARENT 1
+#define GPU_CULLING_LIST_OPAQUE_LATE 2
+#define GPU_CULLING_LIST_CASCADE 3
+#define GPU_CULLING_DRAW_LISTS_COUNT 7
+
+#define GPU_CULLING_STAT_TESTED 0
+#define GPU_CULLING_STAT_OCCLUDED 1
+
+#define GPU_CULLING_PHASE_ALL 0
+#define GPU_CULLING_PHASE_EARLY 1
+#define GPU_CULLING_PHASE_LATE 2
+
+// std430, indexed by the firstInstance of its draws
+struct GpuCullingObject
+{
+	mat4	model; // with the dequantization
+	vec4	center; // radius of the bounding sphere in w
+	vec4	extent; // largest scale of the model in w
+	vec4	albedo; // opaque when uint(a) == 1
+	vec4	surface; // roughness, metallic, reflectance and lod bias
+	uvec4	lodFirstSubmesh;
+	uvec4	lodSubmeshesCount;
+	vec4	lodErrors;
+	uint	lodsCount; // 0 for a free slot
+	uint	textureIndex;
+	uint	padding[2];
+};
+
+struct GpuCullingSubmesh
+{
+	uint	firstIndex;
+	uint	indicesCount;
+	int		vertexOffset;
+	uint	objectIndex;
+};
+
+// std140
+struct GpuCullingView
+{
+	mat4	viewProj;
+	vec4	planes[6];
+	vec4	rowW;
+	float	rowWLength;
+	float	pixelsPerUnit;
+	float	minPixels;
+	float	lodErrorPixels;
+	uint	drawList;
+	uint	splitsOpacity;
+	uint	isActive;
+	uint	lateDrawList;
+};
+
+// VkDrawIndexedIndirectCommand
+struct DrawIndexedCommand
+{
+	uint	indexCount;
+	uint	instanceCount;
+	uint	firstIndex;
+	int		vertexOffset;
+	uint	firstInstance;
+};
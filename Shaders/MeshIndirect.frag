@@ -0,0 +1,243 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "GpuCulling.glsl"
+
+// Mesh.frag for the draws of CullMeshes.comp, the material and the texture come from the object of the draw
+
+#define LIGHTS_MAX_COUNT 4
+#define LIGHT_DIRECTIONAL 1
+#define LIGHT_POINT 2
+#define LIGHT_SPOT 3
+
+#define SHADOWMAP_CASCADE_COUNT 4
+#define SHADOW_BIAS 0.005
+#define SHADOW_AMBIENT 0.1
+
+#define PI 3.14159265359
+
+layout(location = 0) in vec3 inViewPos;
+layout(location = 1) in vec3 inWorldPos;
+layout(location = 2) in vec3 inNormal;
+layout(location = 3) in vec2 inTexCoord;
+layout(location = 4) in vec4 inColor;
+layout(location = 5) in vec4 inSpotLightPos;
+layout(location = 6) in vec3 inWorldNormal;
+layout(location = 7) in vec3 inWorldViewDir;
+layout(location = 8) flat in uint inObjectIndex;
+
+layout(std430, set = 0, binding = 1) readonly buffer Objects
+{
+	GpuCullingObject	objects[];
+};
+
+layout(set = 0, binding = 2) uniform sampler2D textures[GPU_CULLING_MAX_OBJECTS]; // the fallback in the free slots
+layout(set = 0, binding = 3) uniform samplerCube skybox;
+
+struct LightData
+{
+	vec4	color;
+	vec4	position; // view space
+	vec4	direction; // view space
+	float	radius;
+	float	angle; // half angle of the cone, radians
+	float	intensity;
+	float	attenuation;
+	uint	type;
+};
+
+layout(set = 0, binding = 4) uniform UBOLights
+{
+	LightData	lights[LIGHTS_MAX_COUNT];
+	uint		count;
+} lights;
+
+layout(set = 0, binding = 5) uniform sampler2DArray shadowMapCascade;
+
+layout(set = 0, binding = 6) uniform ShadowInfoCascade
+{
+	mat4	lightSpace[4];
+	vec4	cascadeSplits;
+	int		showCascade;
+	int		showPCF;
+} shadowCascade;
+
+layout(set = 0, binding = 7) uniform sampler2DArray shadowMapSpotLight;
+
+layout(location = 0) out vec4 outColor;
+
+//----------------------------------------------------------------
+
+// 1 when lit, SHADOW_AMBIENT in the shadow, the coordinates are divided and in texture space
+float	SampleShadow(sampler2DArray shadowMap, vec3 shadowCoord, float layer, vec2 offset)
+{
+	if (shadowCoord.z <= 0.0 || shadowCoord.z >= 1.0)
+		return 1.0;
+
+	const float	depth = texture(shadowMap, vec3(shadowCoord.xy + offset, layer)).r;
+
+	return (depth < shadowCoord.z - SHADOW_BIAS) ? SHADOW_AMBIENT : 1.0;
+}
+
+//----------------------------------------------------------------
+
+float	FilterShadow(sampler2DArray shadowMap, vec3 shadowCoord, float layer, bool usesPCF)
+{
+	if (!usesPCF)
+		return SampleShadow(shadowMap, shadowCoord, layer, vec2(0.0));
+
+	const vec2	texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+
+	float		shadow = 0.0;
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+			shadow += SampleShadow(shadowMap, shadowCoord, layer, vec2(x, y) * texelSize);
+	}
+
+	return shadow / 9.0;
+}
+
+//----------------------------------------------------------------
+
+// cascades split the view depth, the splits are negative view space depths
+uint	GetCascadeIndex()
+{
+	uint	cascadeIndex = 0;
+	for (uint splitIndex = 0; splitIndex < SHADOWMAP_CASCADE_COUNT - 1; ++splitIndex)
+	{
+		if (inViewPos.z < shadowCascade.cascadeSplits[splitIndex])
+			cascadeIndex = splitIndex + 1;
+	}
+
+	return cascadeIndex;
+}
+
+//----------------------------------------------------------------
+
+float	GetCascadeShadow(uint cascadeIndex)
+{
+	const vec4	lightPos = shadowCascade.lightSpace[cascadeIndex] * vec4(inWorldPos, 1.0);
+	const vec3	shadowCoord = vec3(lightPos.xy / lightPos.w * 0.5 + 0.5, lightPos.z / lightPos.w);
+
+	return FilterShadow(shadowMapCascade, shadowCoord, float(cascadeIndex), shadowCascade.showPCF != 0);
+}
+
+//----------------------------------------------------------------
+
+float	GetSpotLightShadow()
+{
+	if (inSpotLightPos.w <= 0.0)
+		return 1.0;
+
+	const vec3	shadowCoord = vec3(inSpotLightPos.xy / inSpotLightPos.w * 0.5 + 0.5, inSpotLightPos.z / inSpotLightPos.w);
+
+	return FilterShadow(shadowMapSpotLight, shadowCoord, 0.0, shadowCascade.showPCF != 0);
+}
+
+//----------------------------------------------------------------
+
+// GGX distribution, Smith visibility and Schlick fresnel
+vec3	GetRadiance(vec3 N, vec3 V, vec3 L, vec3 baseColor, float roughness, float metallic, vec3 f0)
+{
+	const vec3	H = normalize(V + L);
+	const float	NdotL = max(dot(N, L), 0.0);
+	const float	NdotV = max(dot(N, V), 1e-4);
+	const float	NdotH = max(dot(N, H), 0.0);
+	const float	VdotH = max(dot(V, H), 0.0);
+
+	const float	alpha = roughness * roughness;
+	const float	alpha2 = alpha * alpha;
+	const float	denominator = NdotH * NdotH * (alpha2 - 1.0) + 1.0;
+	const float	D = alpha2 / (PI * denominator * denominator);
+
+	const float	k = alpha * 0.5;
+	const float	G = (NdotL / (NdotL * (1.0 - k) + k)) * (NdotV / (NdotV * (1.0 - k) + k));
+
+	const vec3	F = f0 + (1.0 - f0) * pow(1.0 - VdotH, 5.0);
+
+	const vec3	specular = D * G * F / (4.0 * NdotL * NdotV + 1e-4);
+	const vec3	diffuse = (1.0 - F) * (1.0 - metallic) * baseColor / PI;
+
+	return (diffuse + specular) * NdotL;
+}
+
+//----------------------------------------------------------------
+
+void	main()
+{
+	const GpuCullingObject	object = objects[inObjectIndex];
+
+	const float	roughness = clamp(object.surface.x, 0.04, 1.0);
+	const float	metallic = object.surface.y;
+	const float	reflectance = object.surface.z;
+
+	const vec4	texel = texture(textures[nonuniformEXT(object.textureIndex)], inTexCoord, object.surface.w);
+	const vec3	baseColor = object.albedo.rgb * texel.rgb;
+	const vec3	f0 = 0.16 * reflectance * reflectance * (1.0 - metallic) + baseColor * metallic;
+
+	const vec3	N = normalize(inNormal);
+	const vec3	V = normalize(-inViewPos);
+
+	const uint	cascadeIndex = GetCascadeIndex();
+	bool		hasSpotLightShadow = false;
+
+	vec3		color = vec3(0.0);
+	for (uint lightIndex = 0; lightIndex < lights.count && lightIndex < LIGHTS_MAX_COUNT; ++lightIndex)
+	{
+		const LightData	light = lights.lights[lightIndex];
+
+		vec3	L;
+		float	attenuation = 1.0;
+		float	shadow = 1.0;
+
+		if (light.type == LIGHT_DIRECTIONAL)
+		{
+			L = normalize(-light.direction.xyz);
+
+			// the cascades follow the first light only
+			if (lightIndex == 0)
+				shadow = GetCascadeShadow(cascadeIndex);
+		}
+		else
+		{
+			const vec3	toLight = light.position.xyz - inViewPos;
+			const float	distance = length(toLight);
+
+			L = toLight / max(distance, 1e-4);
+			attenuation = clamp(1.0 - distance / light.radius, 0.0, 1.0) / (1.0 + light.attenuation * distance * distance);
+
+			if (light.type == LIGHT_SPOT)
+			{
+				const float	cosOuter = cos(light.angle);
+				const float	cosTheta = dot(-L, normalize(light.direction.xyz));
+
+				attenuation *= smoothstep(cosOuter, mix(cosOuter, 1.0, 0.1), cosTheta);
+
+				// the first spot light has the only shadow view
+				if (!hasSpotLightShadow)
+				{
+					shadow = GetSpotLightShadow();
+					hasSpotLightShadow = true;
+				}
+			}
+		}
+
+		color += GetRadiance(N, V, L, baseColor, roughness, metallic, f0) * light.color.rgb * light.intensity * attenuation * shadow;
+	}
+
+	// skybox reflection, fainter on rough surfaces
+	const vec3	R = reflect(normalize(inWorldViewDir), normalize(inWorldNormal));
+	const vec3	F = f0 + (1.0 - f0) * pow(1.0 - max(dot(N, V), 0.0), 5.0);
+
+	color += texture(skybox, R).rgb * F * (1.0 - roughness);
+
+	if (shadowCascade.showCascade != 0)
+	{
+		const vec3	cascadeColors[SHADOWMAP_CASCADE_COUNT] = vec3[](vec3(1.0, 0.25, 0.25), vec3(0.25, 1.0, 0.25), vec3(0.25, 0.25, 1.0), vec3(1.0, 1.0, 0.25));
+		color *= cascadeColors[cascadeIndex];
+	}
+
+	outColor = vec4(color, object.albedo.a * texel.a);
+}
@@ -0,0 +1,68 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "GpuCulling.glsl"
+
+// Mesh.vert for the draws of CullMeshes.comp, the per mesh uniform is the object at gl_InstanceIndex
+
+layout(location = 0) in vec3 inPos; // dequantized by the model matrix
+layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) in vec3 inNormal;
+layout(location = 3) in vec4 inColor;
+
+layout(set = 0, binding = 0) uniform VP
+{
+	mat4	view;
+	mat4	proj;
+} vp;
+
+layout(std430, set = 0, binding = 1) readonly buffer Objects
+{
+	GpuCullingObject	objects[];
+};
+
+layout(set = 0, binding = 6) uniform ShadowInfoCascade
+{
+	mat4	lightSpace[4];
+	vec4	cascadeSplits;
+	int		showCascade;
+	int		showPCF;
+} shadowCascade;
+
+layout(set = 0, binding = 8) uniform ShadowInfoSpotLight
+{
+	mat4	lightSpace;
+} shadowSpotLight;
+
+layout(location = 0) out vec3 outViewPos;
+layout(location = 1) out vec3 outWorldPos;
+layout(location = 2) out vec3 outNormal; // view space
+layout(location = 3) out vec2 outTexCoord;
+layout(location = 4) out vec4 outColor;
+layout(location = 5) out vec4 outSpotLightPos; // clip space of the first shadowed spot light
+layout(location = 6) out vec3 outWorldNormal;
+layout(location = 7) out vec3 outWorldViewDir; // from the eye, for the skybox reflection
+layout(location = 8) flat out uint outObjectIndex;
+
+void	main()
+{
+	const GpuCullingObject	object = objects[gl_InstanceIndex];
+
+	const vec4	worldPos = object.model * vec4(inPos, 1.0);
+	const vec4	viewPos = vp.view * worldPos;
+
+	// the normals are not quantized, the columns lose the scale of the bounds and of the model with it
+	const mat3	rotation = mat3(normalize(object.model[0].xyz), normalize(object.model[1].xyz), normalize(object.model[2].xyz));
+
+	outViewPos = viewPos.xyz;
+	outWorldPos = worldPos.xyz;
+	outWorldNormal = rotation * inNormal;
+	outNormal = mat3(vp.view) * outWorldNormal;
+	outTexCoord = inTexCoord;
+	outColor = inColor;
+	outSpotLightPos = shadowSpotLight.lightSpace * worldPos;
+	outWorldViewDir = worldPos.xyz + transpose(mat3(vp.view)) * vp.view[3].xyz; // the eye is at -R^T t
+	outObjectIndex = uint(gl_InstanceIndex);
+
+	gl_Position = vp.proj * viewPos;
+}
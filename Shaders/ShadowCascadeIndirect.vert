@@ -0,0 +1,31 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "GpuCulling.glsl"
+
+// ShadowCascade.vert for the cascade lists of CullMeshes.comp, only the position stream is bound
+
+layout(location = 0) in vec3 inPos; // dequantized by the model matrix
+
+layout(set = 0, binding = 0) uniform ShadowInfoCascade
+{
+	mat4	lightSpace[4];
+	vec4	cascadeSplits;
+	int		showCascade;
+	int		showPCF;
+} shadowCascade;
+
+layout(std430, set = 0, binding = 1) readonly buffer Objects
+{
+	GpuCullingObject	objects[];
+};
+
+layout(push_constant) uniform Cascade
+{
+	uint	cascadeIndex;
+} cascade;
+
+void	main()
+{
+	gl_Position = shadowCascade.lightSpace[cascade.cascadeIndex] * objects[gl_InstanceIndex].model * vec4(inPos, 1.0);
+}
@@ -0,0 +1,110 @@
+#include "AssetLoader.h"
+
+#include <algorithm>
+
+#include "CpuProfiler.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+AssetLoader::AssetLoader(uint32_t threadsCount)
+:	m_NextThread(0),
+	m_IsShuttingDown(false),
+	m_RenderThreadQueue(std::vector<std::coroutine_handle<>>()),
+	m_Tasks(std::vector<Task<>>())
+{
+	m_ThreadPool = new ThreadPool(std::max(threadsCount, 1u));
+}
+
+//----------------------------------------------------------------
+
+AssetLoader::~AssetLoader()
+{
+	// coroutines still running on the loading threads park themselves in the render thread queue from now on
+	{
+		std::lock_guard<std::mutex>	lock(m_Mutex);
+		m_IsShuttingDown = true;
+	}
+
+	delete m_ThreadPool;
+	m_ThreadPool = nullptr;
+
+	// nothing runs anymore, unfinished tasks are destroyed with everything they were awaiting
+	m_RenderThreadQueue.clear();
+	m_Tasks.clear();
+}
+
+//----------------------------------------------------------------
+
+void	AssetLoader::Spawn(Task<> &&task)
+{
+	m_Tasks.push_back(std::move(task));
+	m_Tasks.back().GetHandle().resume();
+}
+
+//----------------------------------------------------------------
+
+void	AssetLoader::Update()
+{
+	PROFILE_ZONE("AssetLoader::Update");
+
+	std::vector<std::coroutine_handle<>>	handles;
+	{
+		std::lock_guard<std::mutex>	lock(m_Mutex);
+		handles.swap(m_RenderThreadQueue);
+	}
+
+	const uint32_t	handlesCount = static_cast<uint32_t>(handles.size());
+	for (uint32_t handleIndex = 0; handleIndex < handlesCount; ++handleIndex)
+		handles[handleIndex].resume();
+
+	// completed frames are no longer touched by any thread
+	m_Tasks.erase(std::remove_if(m_Tasks.begin(), m_Tasks.end(), [](const Task<> &task) { return task.IsComplete(); }), m_Tasks.end());
+}
+
+//----------------------------------------------------------------
+
+void	AssetLoader::RunUntilIdle()
+{
+	while (!m_Tasks.empty())
+	{
+		Update();
+		std::this_thread::yield();
+	}
+}
+
+//----------------------------------------------------------------
+
+void	AssetLoader::PushWorker(std::coroutine_handle<> handle)
+{
+	std::lock_guard<std::mutex>	lock(m_Mutex);
+
+	if (m_IsShuttingDown)
+	{
+		m_RenderThreadQueue.push_back(handle);
+		return;
+	}
+
+	// loads are independent, spread them over the threads
+	const uint32_t	threadIndex = m_NextThread.fetch_add(1, std::memory_order_relaxed) % m_ThreadPool->GetThreadsCount();
+
+	m_ThreadPool->Push(threadIndex, [handle]()
+	{
+		handle.resume();
+	});
+}
+
+//----------------------------------------------------------------
+
+void	AssetLoader::PushRenderThread(std::coroutine_handle<> handle)
+{
+	std::lock_guard<std::mutex>	lock(m_Mutex);
+	m_RenderThreadQueue.push_back(handle);
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,192 @@
+#include "CpuProfiler.h"
+
+#include <iostream>
+#include <iomanip>
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+CpuProfiler CpuProfiler::m_Profiler;
+
+//----------------------------------------------------------------
+
+namespace
+{
+	thread_local void	*t_ThreadBuffer = nullptr;
+
+	void	WriteJsonString(std::ofstream &file, const char *text)
+	{
+		file << '"';
+		for (const char *character = text; *character != '\0'; ++character)
+		{
+			if (*character == '"' || *character == '\\')
+				file << '\\';
+			file << *character;
+		}
+		file << '"';
+	}
+}
+
+//----------------------------------------------------------------
+
+CpuProfiler::CpuProfiler()
+:	m_StartTime(std::chrono::steady_clock::now()),
+	m_Enabled(true),
+	m_Frame(0),
+	m_Buffers(std::vector<ThreadBuffer*>())
+{
+
+}
+
+//----------------------------------------------------------------
+
+CpuProfiler::~CpuProfiler()
+{
+	std::lock_guard<std::mutex>	lock(m_BuffersMutex);
+
+	const uint32_t	buffersCount = static_cast<uint32_t>(m_Buffers.size());
+	for (uint32_t bufferIndex = 0; bufferIndex < buffersCount; ++bufferIndex)
+		delete m_Buffers[bufferIndex];
+
+	m_Buffers.clear();
+}
+
+//----------------------------------------------------------------
+
+void	CpuProfiler::Record(const char *name, uint64_t begin, uint64_t end)
+{
+	if (!IsEnabled())
+		return;
+
+	ThreadBuffer	*buffer = GetThreadBuffer();
+
+	// single writer per buffer, the count is published once the event is complete
+	const uint64_t	writtenCount = buffer->m_WrittenCount.load(std::memory_order_relaxed);
+
+	CpuEvent		&event = buffer->m_Events[writtenCount % CPU_PROFILER_EVENTS_PER_THREAD];
+	{
+		event.m_Name = name;
+		event.m_Begin = begin;
+		event.m_End = end;
+		event.m_Frame = m_Frame.load(std::memory_order_relaxed);
+	}
+
+	buffer->m_WrittenCount.store(writtenCount + 1, std::memory_order_release);
+}
+
+//----------------------------------------------------------------
+
+void	CpuProfiler::SetThreadName(const char *name)
+{
+	ThreadBuffer	*buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex>	lock(m_BuffersMutex);
+	buffer->m_Name = name;
+}
+
+//----------------------------------------------------------------
+
+bool	CpuProfiler::DumpChromeTrace(const char *path, uint32_t framesCount) const
+{
+	std::ofstream	file(path, std::ios::out | std::ios::trunc);
+
+	if (!file.is_open())
+	{
+		std::cout << "Can't open " << path << " to write the CPU trace" << std::endl; // TODO: change this for real logger
+		return false;
+	}
+
+	const uint64_t	currentFrame = m_Frame.load(std::memory_order_relaxed);
+	const uint64_t	firstFrame = (currentFrame > framesCount) ? currentFrame - framesCount : 0;
+
+	uint32_t		eventsCount = 0;
+	bool			isFirstEvent = true;
+
+	file << "{\"traceEvents\":[\n" << std::fixed << std::setprecision(3);
+
+	std::lock_guard<std::mutex>	lock(m_BuffersMutex);
+
+	std::vector<CpuEvent>		events;
+	events.reserve(CPU_PROFILER_EVENTS_PER_THREAD);
+
+	const uint32_t	buffersCount = static_cast<uint32_t>(m_Buffers.size());
+	for (uint32_t bufferIndex = 0; bufferIndex < buffersCount; ++bufferIndex)
+	{
+		const ThreadBuffer	*buffer = m_Buffers[bufferIndex];
+
+		// copy first, the owning thread keeps writing while we read
+		const uint64_t		writtenCount = buffer->m_WrittenCount.load(std::memory_order_acquire);
+		const uint64_t		firstEvent = (writtenCount > CPU_PROFILER_EVENTS_PER_THREAD) ? writtenCount - CPU_PROFILER_EVENTS_PER_THREAD : 0;
+
+		events.clear();
+		for (uint64_t eventIndex = firstEvent; eventIndex < writtenCount; ++eventIndex)
+			events.push_back(buffer->m_Events[eventIndex % CPU_PROFILER_EVENTS_PER_THREAD]);
+
+		// drop the events that may have been overwritten during the copy
+		const uint64_t		newWrittenCount = buffer->m_WrittenCount.load(std::memory_order_acquire);
+		const uint64_t		overwrittenCount = (newWrittenCount > firstEvent + CPU_PROFILER_EVENTS_PER_THREAD) ? newWrittenCount - firstEvent - CPU_PROFILER_EVENTS_PER_THREAD : 0;
+
+		// thread name metadata
+		file << (isFirstEvent ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->m_ThreadId << ",\"args\":{\"name\":";
+		WriteJsonString(file, buffer->m_Name.c_str());
+		file << "}}";
+		isFirstEvent = false;
+
+		const uint32_t		copiedCount = static_cast<uint32_t>(events.size());
+		for (uint64_t eventIndex = overwrittenCount; eventIndex < copiedCount; ++eventIndex)
+		{
+			const CpuEvent	&event = events[eventIndex];
+			if (event.m_Frame < firstFrame)
+				continue;
+
+			// complete events, timestamps in microseconds
+			file << ",\n{\"name\":";
+			WriteJsonString(file, event.m_Name);
+			file << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->m_ThreadId
+				 << ",\"ts\":" << static_cast<double>(event.m_Begin) * 1e-3
+				 << ",\"dur\":" << static_cast<double>(event.m_End - event.m_Begin) * 1e-3
+				 << ",\"args\":{\"frame\":" << event.m_Frame << "}}";
+
+			++eventsCount;
+		}
+	}
+
+	file << "\n]}\n";
+	file.close();
+
+	std::cout << "CPU trace of " << eventsCount << " zones written to " << path << std::endl; // TODO: change this for real logger
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+CpuProfiler::ThreadBuffer*	CpuProfiler::GetThreadBuffer()
+{
+	if (t_ThreadBuffer != nullptr)
+		return static_cast<ThreadBuffer*>(t_ThreadBuffer);
+
+	ThreadBuffer	*buffer = new ThreadBuffer();
+	buffer->m_Events.resize(CPU_PROFILER_EVENTS_PER_THREAD);
+	buffer->m_WrittenCount.store(0, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex>	lock(m_BuffersMutex);
+
+		buffer->m_ThreadId = static_cast<uint32_t>(m_Buffers.size());
+		buffer->m_Name = "Thread " + std::to_string(buffer->m_ThreadId);
+
+		m_Buffers.push_back(buffer);
+	}
+
+	t_ThreadBuffer = buffer;
+
+	return buffer;
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
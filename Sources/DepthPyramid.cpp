@@ -0,0 +1,396 @@
+#include "DepthPyramid.h"
+
+#include <algorithm>
+
+#include "Device.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+// push constants of DepthPyramid.comp, an output texel takes the farthest depth of the input texels it covers
+struct DepthPyramidLevel
+{
+	uint32_t	m_InputWidth;
+	uint32_t	m_InputHeight;
+	uint32_t	m_OutputWidth;
+	uint32_t	m_OutputHeight;
+}; // struct DepthPyramidLevel
+
+//----------------------------------------------------------------
+
+static uint32_t	PreviousPowerOfTwo(uint32_t value)
+{
+	uint32_t	powerOfTwo = 1;
+	while (powerOfTwo * 2 <= value)
+		powerOfTwo *= 2;
+
+	return powerOfTwo;
+}
+
+//----------------------------------------------------------------
+
+static VkExtent2D	GetLevelExtent(const VkExtent2D &extent, uint32_t level)
+{
+	return { std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u) };
+}
+
+//----------------------------------------------------------------
+
+DepthPyramid::DepthPyramid(const RenderHandle *renderHandle)
+:	m_RenderHandle(renderHandle),
+	m_DepthExtent({ 0, 0 }),
+	m_IsMultisampled(false),
+	m_Image(nullptr),
+	m_ImageView(nullptr),
+	m_Sampler(nullptr),
+	m_Extent({ 0, 0 }),
+	m_LevelsCount(0),
+	m_DescriptorPool(nullptr),
+	m_SetLayout(nullptr),
+	m_PipelineLayout(nullptr),
+	m_ReducePipeline(nullptr),
+	m_ResolvePipeline(nullptr),
+	m_IsBuilt(false)
+{
+}
+
+//----------------------------------------------------------------
+
+DepthPyramid::~DepthPyramid()
+{
+	m_RenderHandle = nullptr;
+}
+
+//----------------------------------------------------------------
+
+bool	DepthPyramid::Setup(const VkDevice logicalDevice, const VkImageView depthImageView, const VkExtent2D &depthExtent, VkSampleCountFlagBits depthSamples,
+							const VkShaderModule reduceModule, const VkShaderModule resolveModule)
+{
+	m_DepthExtent = depthExtent;
+	m_IsMultisampled = (depthSamples != VK_SAMPLE_COUNT_1_BIT);
+
+	// a level halves the previous one exactly, only the first covers more than 2x2 texels of its input
+	m_Extent = { PreviousPowerOfTwo(depthExtent.width), PreviousPowerOfTwo(depthExtent.height) };
+	m_LevelsCount = 1;
+	while ((std::max(m_Extent.width, m_Extent.height) >> m_LevelsCount) > 0)
+		++m_LevelsCount;
+
+	if (!CreateImage(logicalDevice))
+		return false;
+
+	if (!CreateDescriptorSets(logicalDevice, depthImageView))
+		return false;
+
+	return CreatePipelines(logicalDevice, reduceModule, resolveModule);
+}
+
+//----------------------------------------------------------------
+
+bool	DepthPyramid::CreateImage(const VkDevice logicalDevice)
+{
+	const VkImageCreateInfo		imageCreateInfo = Initializers::Image::CreateInfo(	VK_IMAGE_TYPE_2D,
+																					m_Extent,
+																					m_LevelsCount, 1,
+																					DEPTH_PYRAMID_FORMAT,
+																					VK_IMAGE_TILING_OPTIMAL,
+																					VK_IMAGE_LAYOUT_UNDEFINED,
+																					VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+																					VK_SAMPLE_COUNT_1_BIT);
+
+	std::vector<VkImage>			outImages;
+	std::vector<MemoryAllocation>	outAllocations;
+	if (!m_RenderHandle->CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, outImages, outAllocations))
+	{
+		std::cout << "Can't allocate the depth pyramid" << std::endl; // TODO: change this for real logger
+		return false;
+	}
+
+	m_Image = outImages[0];
+	m_Allocation = outAllocations[0];
+
+	std::vector<VkImageView>	outImageViews;
+	if (!m_RenderHandle->CreateImageViews(	logicalDevice, outImages, VK_IMAGE_VIEW_TYPE_2D, DEPTH_PYRAMID_FORMAT, { VK_COMPONENT_SWIZZLE_IDENTITY },
+											Initializers::Image::SubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, m_LevelsCount, 0, 1, 0), outImageViews))
+		return false;
+
+	m_ImageView = outImageViews[0];
+
+	m_LevelViews.resize(m_LevelsCount);
+	for (uint32_t level = 0; level < m_LevelsCount; ++level)
+	{
+		if (!m_RenderHandle->CreateImageViews(	logicalDevice, outImages, VK_IMAGE_VIEW_TYPE_2D, DEPTH_PYRAMID_FORMAT, { VK_COMPONENT_SWIZZLE_IDENTITY },
+												Initializers::Image::SubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, 1, level, 1, 0), outImageViews))
+			return false;
+
+		m_LevelViews[level] = outImageViews[0];
+	}
+
+	// texels are fetched, never filtered: a filtered depth would no longer be the farthest one
+	VkSamplerCreateInfo		samplerInfo = { };
+	{
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.compareEnable = VK_FALSE;
+		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+		samplerInfo.maxAnisotropy = 1.f;
+		samplerInfo.minLod = 0.f;
+		samplerInfo.maxLod = static_cast<float>(m_LevelsCount);
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	}
+
+	CHECK_API_SUCCESS(vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &m_Sampler));
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	DepthPyramid::CreateDescriptorSets(const VkDevice logicalDevice, const VkImageView depthImageView)
+{
+	const std::vector<VkDescriptorPoolSize>	poolSizes = Initializers::Pool::DescriptorSizes(0, m_LevelsCount, 0, m_LevelsCount, 0, 0, 0, 0, 0, 0, 0);
+
+	VkDescriptorPoolCreateInfo				poolInfo = Initializers::Pool::DescriptorCreateInfo(poolSizes);
+	{
+		poolInfo.maxSets = m_LevelsCount;
+	}
+
+	CHECK_API_SUCCESS(vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &m_DescriptorPool));
+
+	// input level, or the depth attachment, then output level
+	VkDescriptorSetLayoutBinding	bindings[2] = { };
+	{
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo		layoutInfo = { };
+	{
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = 2;
+		layoutInfo.pBindings = bindings;
+	}
+
+	CHECK_API_SUCCESS(vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &m_SetLayout));
+
+	const std::vector<VkDescriptorSetLayout>	setLayouts(m_LevelsCount, m_SetLayout);
+	m_LevelSets.resize(m_LevelsCount);
+
+	VkDescriptorSetAllocateInfo		allocateInfo = { };
+	{
+		allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocateInfo.descriptorPool = m_DescriptorPool;
+		allocateInfo.descriptorSetCount = m_LevelsCount;
+		allocateInfo.pSetLayouts = setLayouts.data();
+	}
+
+	CHECK_API_SUCCESS(vkAllocateDescriptorSets(logicalDevice, &allocateInfo, m_LevelSets.data()));
+
+	for (uint32_t level = 0; level < m_LevelsCount; ++level)
+	{
+		// the depth attachment is read in the layout Record moves it to
+		const VkDescriptorImageInfo	inputInfo = (level == 0) ?	VkDescriptorImageInfo{ m_Sampler, depthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL } :
+																VkDescriptorImageInfo{ m_Sampler, m_LevelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+		const VkDescriptorImageInfo	outputInfo = { nullptr, m_LevelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+
+		VkWriteDescriptorSet		writeDescs[2] = { };
+		for (uint32_t binding = 0; binding < 2; ++binding)
+		{
+			writeDescs[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeDescs[binding].dstSet = m_LevelSets[level];
+			writeDescs[binding].dstBinding = binding;
+			writeDescs[binding].descriptorCount = 1;
+			writeDescs[binding].descriptorType = bindings[binding].descriptorType;
+			writeDescs[binding].pImageInfo = (binding == 0) ? &inputInfo : &outputInfo;
+		}
+
+		vkUpdateDescriptorSets(logicalDevice, 2, writeDescs, 0, nullptr);
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	DepthPyramid::CreatePipelines(const VkDevice logicalDevice, const VkShaderModule reduceModule, const VkShaderModule resolveModule)
+{
+	const VkPushConstantRange	pushConstant = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthPyramidLevel) };
+
+	VkPipelineLayoutCreateInfo	pipelineLayoutInfo = { };
+	{
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &m_SetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+	}
+
+	CHECK_API_SUCCESS(vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &m_PipelineLayout));
+
+	VkComputePipelineCreateInfo	pipelineInfo = { };
+	{
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = static_cast<VkShaderStageFlagBits>(SHADER_STAGE::Compute);
+		pipelineInfo.stage.module = reduceModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = m_PipelineLayout;
+	}
+
+	CHECK_API_SUCCESS(vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_ReducePipeline));
+
+	// the reduction reads a single sampled image, every sample of a multisampled attachment is fetched by its own shader
+	if (m_IsMultisampled)
+	{
+		if (resolveModule == nullptr)
+			return false;
+
+		pipelineInfo.stage.module = resolveModule;
+		CHECK_API_SUCCESS(vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_ResolvePipeline));
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	DepthPyramid::Shutdown(const VkDevice logicalDevice)
+{
+	if (m_ReducePipeline != nullptr)
+		vkDestroyPipeline(logicalDevice, m_ReducePipeline, nullptr);
+
+	if (m_ResolvePipeline != nullptr)
+		vkDestroyPipeline(logicalDevice, m_ResolvePipeline, nullptr);
+
+	vkDestroyPipelineLayout(logicalDevice, m_PipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, m_SetLayout, nullptr);
+
+	// frees the sets too
+	if (m_DescriptorPool != nullptr)
+		vkDestroyDescriptorPool(logicalDevice, m_DescriptorPool, nullptr);
+
+	for (const VkImageView levelView : m_LevelViews)
+		vkDestroyImageView(logicalDevice, levelView, nullptr);
+
+	vkDestroyImageView(logicalDevice, m_ImageView, nullptr);
+	vkDestroySampler(logicalDevice, m_Sampler, nullptr);
+
+	if (m_Image != nullptr)
+	{
+		vkDestroyImage(logicalDevice, m_Image, nullptr);
+		Device::m_Device->GetMemoryAllocator()->Free(m_Allocation);
+	}
+
+	m_LevelViews.clear();
+	m_LevelSets.clear();
+
+	m_Image = nullptr;
+	m_ReducePipeline = nullptr;
+	m_ResolvePipeline = nullptr;
+	m_DescriptorPool = nullptr;
+}
+
+//----------------------------------------------------------------
+
+void	DepthPyramid::Record(const VkCommandBuffer commandBuffer, const VkImage depthImage)
+{
+	// depth writes of the opaque meshes to the reduction, and the reads of the last frame occlusion tests before the levels are overwritten
+	VkImageMemoryBarrier	beginBarriers[2] = { };
+	{
+		beginBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		beginBarriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		beginBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		beginBarriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		beginBarriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		beginBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		beginBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		beginBarriers[0].image = depthImage;
+		beginBarriers[0].subresourceRange = Initializers::Image::SubresourceRange(VK_IMAGE_ASPECT_DEPTH_BIT, 1, 0, 1, 0);
+
+		beginBarriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		beginBarriers[1].srcAccessMask = 0;
+		beginBarriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		beginBarriers[1].oldLayout = (m_IsBuilt) ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+		beginBarriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		beginBarriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		beginBarriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		beginBarriers[1].image = m_Image;
+		beginBarriers[1].subresourceRange = Initializers::Image::SubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, m_LevelsCount, 0, 1, 0);
+	}
+
+	vkCmdPipelineBarrier(	commandBuffer,
+							VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+							0, 0, nullptr, 0, nullptr, 2, beginBarriers);
+
+	VkImageMemoryBarrier	levelBarrier = { };
+	{
+		levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		levelBarrier.image = m_Image;
+	}
+
+	for (uint32_t level = 0; level < m_LevelsCount; ++level)
+	{
+		const VkExtent2D	inputExtent = (level == 0) ? m_DepthExtent : GetLevelExtent(m_Extent, level - 1);
+		const VkExtent2D	outputExtent = GetLevelExtent(m_Extent, level);
+
+		const DepthPyramidLevel	pushLevel = { inputExtent.width, inputExtent.height, outputExtent.width, outputExtent.height };
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, (level == 0 && m_IsMultisampled) ? m_ResolvePipeline : m_ReducePipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1, &m_LevelSets[level], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthPyramidLevel), &pushLevel);
+
+		vkCmdDispatch(	commandBuffer,
+						(outputExtent.width + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE,
+						(outputExtent.height + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE, 1);
+
+		// the next level reads this one, the occlusion tests read them all after the last one
+		levelBarrier.subresourceRange = Initializers::Image::SubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, 1, level, 1, 0);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+	}
+
+	// the remaining meshes are depth tested against what was reduced
+	VkImageMemoryBarrier	endBarrier = beginBarriers[0];
+	{
+		endBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		endBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		endBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		endBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	}
+
+	vkCmdPipelineBarrier(	commandBuffer,
+							VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+							0, 0, nullptr, 0, nullptr, 1, &endBarrier);
+
+	m_IsBuilt = true;
+}
+
+//----------------------------------------------------------------
+
+VkDescriptorImageInfo	DepthPyramid::GetImageInfo() const
+{
+	return { m_Sampler, m_ImageView, VK_IMAGE_LAYOUT_GENERAL };
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,116 @@
+#include "DescriptorAllocator.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+DescriptorAllocator::DescriptorAllocator()
+:	m_Pools(std::vector<VkDescriptorPool>())
+{
+
+}
+
+//----------------------------------------------------------------
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+
+}
+
+//----------------------------------------------------------------
+
+bool	DescriptorAllocator::Prepare(const VkDevice logicalDevice)
+{
+	return AddPool(logicalDevice);
+}
+
+//----------------------------------------------------------------
+
+void	DescriptorAllocator::Shutdown(const VkDevice logicalDevice)
+{
+	// destroying a pool frees the sets still allocated from it
+	const uint32_t	poolsCount = static_cast<uint32_t>(m_Pools.size());
+	for (uint32_t poolIndex = 0; poolIndex < poolsCount; ++poolIndex)
+		vkDestroyDescriptorPool(logicalDevice, m_Pools[poolIndex], nullptr);
+
+	m_Pools.clear();
+}
+
+//----------------------------------------------------------------
+
+bool	DescriptorAllocator::Allocate(const VkDevice logicalDevice, const VkDescriptorSetLayout layout, VkDescriptorSet &outSet, VkDescriptorPool &outPool)
+{
+	VkDescriptorSetAllocateInfo	descAllocateInfo = { };
+	{
+		descAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		descAllocateInfo.descriptorSetCount = 1;
+		descAllocateInfo.pSetLayouts = &layout;
+	}
+
+	// newest pool first, older ones only have room left by freed sets
+	for (uint32_t poolIndex = static_cast<uint32_t>(m_Pools.size()); poolIndex-- > 0; )
+	{
+		descAllocateInfo.descriptorPool = m_Pools[poolIndex];
+
+		const VkResult	result = vkAllocateDescriptorSets(logicalDevice, &descAllocateInfo, &outSet);
+		if (result == VK_SUCCESS)
+		{
+			outPool = m_Pools[poolIndex];
+			return true;
+		}
+
+		if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+		{
+			std::cout << "Can't allocate descriptor set" << std::endl; // TODO: change this for real logger
+			return false;
+		}
+	}
+
+	if (!AddPool(logicalDevice))
+		return false;
+
+	descAllocateInfo.descriptorPool = m_Pools.back();
+
+	if (vkAllocateDescriptorSets(logicalDevice, &descAllocateInfo, &outSet) != VK_SUCCESS)
+	{
+		std::cout << "Can't allocate descriptor set from a new pool" << std::endl; // TODO: change this for real logger
+		return false;
+	}
+
+	outPool = m_Pools.back();
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	DescriptorAllocator::AddPool(const VkDevice logicalDevice)
+{
+	const uint32_t							samplersCount = DESCRIPTOR_POOL_SETS_COUNT * DESCRIPTOR_POOL_SAMPLERS_PER_SET;
+	const uint32_t							uniformsCount = DESCRIPTOR_POOL_SETS_COUNT * DESCRIPTOR_POOL_UNIFORMS_PER_SET;
+
+	const std::vector<VkDescriptorPoolSize>	descPoolSizes = Initializers::Pool::DescriptorSizes(0, samplersCount, 0, 0, 0, uniformsCount, 0, 0, 0, 0, DESCRIPTOR_POOL_ATTACHMENTS_COUNT);
+
+	VkDescriptorPoolCreateInfo				descPoolCreateInfo = Initializers::Pool::DescriptorCreateInfo(descPoolSizes);
+	{
+		descPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		descPoolCreateInfo.maxSets = DESCRIPTOR_POOL_SETS_COUNT;
+	}
+
+	VkDescriptorPool						descPool = nullptr;
+	if (vkCreateDescriptorPool(logicalDevice, &descPoolCreateInfo, nullptr, &descPool) != VK_SUCCESS)
+	{
+		std::cout << "Can't create descriptor pool" << std::endl; // TODO: change this for real logger
+		return false;
+	}
+
+	m_Pools.push_back(descPool);
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
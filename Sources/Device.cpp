@@ -1,8 +1,15 @@
 #include "Device.h"
 
 #include <algorithm>
+#include <cstring>
+#include <cstdlib>
 
 #include "Scene.h"
+#include "CpuProfiler.h"
+#include "Tools/TextureConverter.h"
+#include "Tools/DynamicBvh.h"
+#include "Tools/FrustumCulling.h"
+#include "GpuCulling.h"
 
 //----------------------------------------------------------------
 
@@ -14,19 +21,155 @@ std::unique_ptr<Device> Device::m_Device = nullptr;
 
 //----------------------------------------------------------------
 
-Device::Device(const char *applicationName, const char* engineName)
+bool	DeviceSettings::ParseCommandLine(int argc, const char * const *argv)
+{
+	for (int argIndex = 1; argIndex < argc; ++argIndex)
+	{
+		const char	*arg = argv[argIndex];
+		const char	*value = (argIndex + 1 < argc) ? argv[argIndex + 1] : nullptr;
+
+		if (strcmp(arg, "--headless") == 0)
+		{
+			m_Headless = true;
+			continue;
+		}
+
+		if (strcmp(arg, "--low-latency") == 0)
+		{
+			m_LowLatency = true;
+			continue;
+		}
+
+		if (strcmp(arg, "--gpu-culling") == 0)
+		{
+			m_GpuCulling = true;
+			continue;
+		}
+
+		if (strcmp(arg, "--occlusion-culling") == 0)
+		{
+			m_GpuCulling = true;
+			m_OcclusionCulling = true;
+			continue;
+		}
+
+		// every other option takes a value
+		if (value == nullptr)
+		{
+			std::cout << "Missing value for " << arg << std::endl; // TODO: change this for real logger
+			return false;
+		}
+
+		++argIndex;
+
+		if (strcmp(arg, "--present-mode") == 0)
+		{
+			if (strcmp(value, "fifo") == 0)
+				m_PresentMode = VK_PRESENT_MODE_FIFO_KHR;
+			else if (strcmp(value, "mailbox") == 0)
+				m_PresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+			else if (strcmp(value, "immediate") == 0)
+				m_PresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			else
+			{
+				std::cout << "Unknown present mode " << value << std::endl; // TODO: change this for real logger
+				return false;
+			}
+
+			continue;
+		}
+
+		if (strcmp(arg, "--vertex-layout") == 0)
+		{
+			if (strcmp(value, "full") == 0)
+				m_VertexLayout = VERTEX_LAYOUT::Full;
+			else if (strcmp(value, "compact") == 0)
+				m_VertexLayout = VERTEX_LAYOUT::Compact;
+			else if (strcmp(value, "quantized") == 0)
+				m_VertexLayout = VERTEX_LAYOUT::Quantized;
+			else
+			{
+				std::cout << "Unknown vertex layout " << value << std::endl; // TODO: change this for real logger
+				return false;
+			}
+
+			continue;
+		}
+
+		if (strcmp(arg, "--trace") == 0)
+		{
+			m_TracePath = value;
+			continue;
+		}
+
+		if (strcmp(arg, "--convert-textures") == 0)
+		{
+			m_ConvertTexturesPath = value;
+			continue;
+		}
+
+		char			*valueEnd = nullptr;
+		const uint32_t	number = static_cast<uint32_t>(strtoul(value, &valueEnd, 10));
+
+		if (valueEnd == value || *valueEnd != '\0')
+		{
+			std::cout << "Invalid value " << value << " for " << arg << std::endl; // TODO: change this for real logger
+			return false;
+		}
+
+		if (strcmp(arg, "--frames") == 0)
+			m_FramesCount = number;
+		else if (strcmp(arg, "--width") == 0 && number > 0)
+			m_Extent.width = number;
+		else if (strcmp(arg, "--height") == 0 && number > 0)
+			m_Extent.height = number;
+		else if (strcmp(arg, "--pending-frames") == 0)
+			m_PendingFrames = number;
+		else if (strcmp(arg, "--texture-budget") == 0)
+			m_TextureBudget = number;
+		else if (strcmp(arg, "--bvh-benchmark") == 0)
+			m_BvhBenchmarkCount = number;
+		else if (strcmp(arg, "--cull-benchmark") == 0)
+			m_CullBenchmarkCount = number;
+		else if (strcmp(arg, "--record-benchmark") == 0)
+			m_RecordBenchmarkFrames = number;
+		else
+		{
+			std::cout << "Unknown option " << arg << std::endl; // TODO: change this for real logger
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+Device::Device(const char *applicationName, const char* engineName, const DeviceSettings &settings)
 :	m_ApplicationName(applicationName),
 	m_EngineName(engineName),
+	m_Settings(settings),
 	m_MaxPhysicalDevicesCount(9), // one for intergrated GPU and 8 for others GPU
 	m_Instance(nullptr),
 	m_PhysicalDevice(nullptr),
 	m_LogicalDevice(nullptr),
+	m_TimelineSemaphore(false),
+	m_TextureCompressionBC(false),
+	m_DepthClamp(false),
+	m_GpuCulling(false),
+	m_RecordBenchmarkThreads(1),
+	m_RecordBenchmarkFrame(0),
+	m_RecordBenchmarkTime(0.f),
+	m_RecordBenchmarkSerialTime(0.f),
 	m_DescriptorPool(nullptr)
 {
-	m_Window = new Window();
+	// headless runs have neither window nor UI
+	m_Window = (m_Settings.m_Headless) ? nullptr : new Window();
 	m_RenderHandle = new RenderHandle();
-	m_UI = new UI();
+	m_UI = (m_Settings.m_Headless) ? nullptr : new UI();
 	m_Scene = new Scene(m_RenderHandle);
+	m_MemoryAllocator = new MemoryAllocator();
+	m_AssetLoader = new AssetLoader(ASSET_LOADER_THREADS_COUNT);
 
 	if (m_Device == nullptr)
 		m_Device = std::unique_ptr<Device>(this);
@@ -42,6 +185,12 @@ Device::~Device()
 	if (m_LogicalDevice == VK_NULL_HANDLE)
 		return;
 
+	// unfinished loads reference the scene and the UI, drop them first
+	if (m_AssetLoader != nullptr)
+		delete m_AssetLoader;
+
+	m_AssetLoader = nullptr;
+
 	// destroy UI
 	if (m_UI != nullptr)
 		delete m_UI;
@@ -74,6 +223,16 @@ Device::~Device()
 
 	m_RenderHandle = nullptr;
 
+	// every resource is gone, release memory blocks
+	if (m_MemoryAllocator != nullptr)
+	{
+		m_MemoryAllocator->Shutdown();
+
+		delete m_MemoryAllocator;
+	}
+
+	m_MemoryAllocator = nullptr;
+
 	if (m_DescriptorPool != nullptr)
 		vkDestroyDescriptorPool(m_LogicalDevice, m_DescriptorPool, nullptr);
 
@@ -97,6 +256,10 @@ bool	Device::Setup() // TODO: Add runtime errors on fail
 {
 	CHECK_API_SUCCESS(volkInitialize());
 
+	// create window first, glfw gives the surface extensions needed by the instance
+	if (m_Window != nullptr && !m_Window->Setup(m_ApplicationName))
+		return false;
+
 	if (!CreateInstance())
 		return false;
 
@@ -104,10 +267,6 @@ bool	Device::Setup() // TODO: Add runtime errors on fail
 	Initializers::Debug::SetupDebugCallback(m_Instance, &m_DebugCallback);
 #endif
 
-	// create window
-	if (!m_Window->Setup(m_ApplicationName))
-		return false;
-
 	// choose physical device
 	if (!CreatePhysicalDevice())
 		return false;
@@ -122,55 +281,100 @@ bool	Device::Setup() // TODO: Add runtime errors on fail
 	RetrieveMaxAntialiasingLevel();
 
 	// create render handle
-	std::vector<COMMAND_TYPE>	renderCommandsType = { COMMAND_TYPE::GraphicsOp, COMMAND_TYPE::GraphicsOp }; // TODO: manage multiple pending frames
+	m_Settings.m_PendingFrames = std::min(std::max(m_Settings.m_PendingFrames, 1u), static_cast<uint32_t>(MAX_PENDING_FRAMES));
+
+	// keep one core for the main thread which records the primary command buffer
+	const uint32_t				recordThreadsCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
 
-	if (!m_RenderHandle->Setup(m_Instance, m_Window, m_PhysicalDevice, renderCommandsType, 2))
+	if (!m_RenderHandle->Setup(m_Instance, m_Window, m_PhysicalDevice, m_Settings.m_PendingFrames, recordThreadsCount))
 		return false;
 	
 	if (!CreateLogicalDevice())
 		return false;
 
-	if (!m_RenderHandle->Prepare(m_PhysicalDevice, m_LogicalDevice))
+	if (!m_MemoryAllocator->Setup(m_LogicalDevice, m_MemoryProperties))
 		return false;
 
-	// create swapchain
-	const SWAPCHAIN_USAGE	swapchainUsage = static_cast<SWAPCHAIN_USAGE>(SWAPCHAIN_USAGE::ColorAttachment | SWAPCHAIN_USAGE::InputAttachment | SWAPCHAIN_USAGE::TransferWrite);
-	if (!m_RenderHandle->CreateSwapchain(m_PhysicalDevice, m_LogicalDevice, swapchainUsage, true))
+	if (!m_RenderHandle->Prepare(m_PhysicalDevice, m_LogicalDevice, m_TimelineSemaphore))
 		return false;
 
+	GetTextureRegistry()->SetStreamingBudget(static_cast<uint64_t>(m_Settings.m_TextureBudget) * 1024 * 1024);
+
+	// create swapchain, or the offscreen targets replacing it
+	if (m_Settings.m_Headless)
+	{
+		if (!m_RenderHandle->CreateOffscreenTargets(m_LogicalDevice, m_Settings.m_Extent, true))
+			return false;
+	}
+	else
+	{
+		const SWAPCHAIN_USAGE	swapchainUsage = static_cast<SWAPCHAIN_USAGE>(SWAPCHAIN_USAGE::ColorAttachment | SWAPCHAIN_USAGE::InputAttachment | SWAPCHAIN_USAGE::TransferWrite);
+		if (!m_RenderHandle->CreateSwapchain(m_PhysicalDevice, m_LogicalDevice, swapchainUsage, true, m_Settings.m_PresentMode))
+			return false;
+	}
+
 	if (!CreateDescriptorPool())
 		return false;
 
+	// converted textures are picked by the loads of the scene right after
+	if (!m_Settings.m_ConvertTexturesPath.empty())
+	{
+		const uint32_t	convertedCount = TextureConverter::ConvertFolder(m_Settings.m_ConvertTexturesPath);
+		std::cout << convertedCount << " textures converted in " << m_Settings.m_ConvertTexturesPath << std::endl; // TODO: change this for real logger
+	}
+
+	if (m_Settings.m_BvhBenchmarkCount > 0)
+		DynamicBvh::Benchmark(m_Settings.m_BvhBenchmarkCount);
+
+	if (m_Settings.m_CullBenchmarkCount > 0)
+		FrustumCulling::Benchmark(m_Settings.m_CullBenchmarkCount);
+
 	if (!m_Scene->Setup(m_LogicalDevice))
 		return false;
 
-	// create UI
-	const RenderCommand		*command = m_RenderHandle->GetRenderCommands()[0];
+	// captures and benchmarks must not depend on how fast the assets streamed in
+	if (m_Settings.m_Headless || m_Settings.m_RecordBenchmarkFrames > 0)
+		m_AssetLoader->RunUntilIdle();
 
-	UIInitInfo				uiInitInfo;
+	if (m_Settings.m_RecordBenchmarkFrames > 0)
 	{
-		uiInitInfo.m_Instance = m_Instance;
-		uiInitInfo.m_PhysicalDevice = m_PhysicalDevice;
-		uiInitInfo.m_LogicalDevice = m_LogicalDevice;
-		uiInitInfo.m_RenderPass = m_Scene->GetRenderPassObjects();
-		uiInitInfo.m_CommandBuffer = command->GetBuffer();
-		uiInitInfo.m_GraphicsQueue = command->GetQueue().m_ApiQueue;
-		uiInitInfo.m_GraphicsQueueIndex = command->GetQueue().m_FamilyIndex;
-		uiInitInfo.m_DescPool = m_DescriptorPool;
-		uiInitInfo.m_DoubleBuffering = m_RenderHandle->GetDoubleBuffering();
-		uiInitInfo.m_PendingFrames = m_RenderHandle->GetPendingFramesCount();
-		uiInitInfo.m_AALevel = m_MaxAALevel;
+		m_Scene->SetRecordThreadsCount(m_RecordBenchmarkThreads);
+
+		std::cout << "Record benchmark, " << m_Scene->GetMeshesCount() << " meshes, milliseconds per frame over " << m_Settings.m_RecordBenchmarkFrames << " frames" << std::endl; // TODO: change this for real logger
 	}
 
-	if (!m_UI->Setup(m_Window, uiInitInfo))
-		return false;
+	// create UI
+	if (m_UI != nullptr)
+	{
+		const RenderCommand		*command = m_RenderHandle->GetFrameContext(0).m_RenderCommand;
 
-	m_UI->SetCurrentScene(m_Scene);
+		UIInitInfo				uiInitInfo;
+		{
+			uiInitInfo.m_Instance = m_Instance;
+			uiInitInfo.m_PhysicalDevice = m_PhysicalDevice;
+			uiInitInfo.m_LogicalDevice = m_LogicalDevice;
+			uiInitInfo.m_RenderPass = m_Scene->GetRenderPassObjects();
+			uiInitInfo.m_CommandBuffer = command->GetBuffer();
+			uiInitInfo.m_GraphicsQueue = command->GetQueue().m_ApiQueue;
+			uiInitInfo.m_GraphicsQueueIndex = command->GetQueue().m_FamilyIndex;
+			uiInitInfo.m_DescPool = m_DescriptorPool;
+			uiInitInfo.m_DoubleBuffering = m_RenderHandle->GetDoubleBuffering();
+			uiInitInfo.m_PendingFrames = m_RenderHandle->GetPendingFramesCount();
+			uiInitInfo.m_AALevel = m_MaxAALevel;
+		}
+
+		if (!m_UI->Setup(m_Window, uiInitInfo))
+			return false;
 
-	m_Window->m_Camera = m_Scene->GetCameraUnsafe();
+		m_UI->SetCurrentScene(m_Scene);
+	}
+
+	if (m_Window != nullptr)
+		m_Window->m_Camera = m_Scene->GetCameraUnsafe();
 
 	m_PreviousTime = std::chrono::high_resolution_clock::now();
 	m_StartTime = m_PreviousTime;
+	m_InputTime = m_PreviousTime;
 
 	m_Frame = 0;
 	Update(); // Note: move this call outside device? in main?
@@ -182,44 +386,126 @@ bool	Device::Setup() // TODO: Add runtime errors on fail
 
 void		Device::Update()
 {
-	while (!m_Window->IsClosed())
+	CpuProfiler::m_Profiler.SetThreadName("Main");
+
+	while (IsRunning())
 	{
+		CpuProfiler::m_Profiler.SetFrame(m_Frame);
+
+		PROFILE_ZONE("Device::Update");
+
 		chrono_time	currentTime = std::chrono::high_resolution_clock::now();
 		m_DeltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - m_PreviousTime).count();
 		m_PreviousTime = currentTime;
 
 		m_RenderHandle->BeginRender(m_LogicalDevice);
 
-		if (m_Frame != 0)
+		const chrono_time	recordTime = std::chrono::high_resolution_clock::now();
+
+		// low latency: inputs are sampled once the frame slot and the swapchain image are available
+		if (m_Settings.m_LowLatency && m_Window != nullptr)
 		{
-			m_Scene->Prepare(m_LogicalDevice);
+			m_Window->RetrieveInputs();
+			m_InputTime = recordTime;
+		}
+
+		// loads finishing on the render thread add their meshes before the scene is prepared
+		m_AssetLoader->Update();
 
+		if (m_Frame != 0 && m_Scene->Prepare(m_LogicalDevice))
+		{
 			m_Scene->Render(m_UI);
+
+			if (m_Settings.m_RecordBenchmarkFrames > 0)
+				UpdateRecordBenchmark();
 		}
 
 		m_RenderHandle->EndRender();
 
-		m_Window->RetrieveInputs();
+		// EndRender returns once the present is queued, not once the image is on screen
+		const chrono_time	presentSubmitTime = std::chrono::high_resolution_clock::now();
+		const float			inputToPresentSubmitTime = std::chrono::duration<float, std::chrono::milliseconds::period>(presentSubmitTime - m_InputTime).count();
+
+		// otherwise inputs are sampled after present and wait for the next frame slot
+		if (!m_Settings.m_LowLatency && m_Window != nullptr)
+		{
+			m_Window->RetrieveInputs();
+			m_InputTime = std::chrono::high_resolution_clock::now();
+		}
+
+		// smooth timings so that they stay readable from the UI
+		const float			smoothing = (m_Frame == 0) ? 1.f : 0.05f;
+		m_FrameMetrics.m_CpuWaitTime += (m_RenderHandle->GetFrameWaitTime() - m_FrameMetrics.m_CpuWaitTime) * smoothing;
+		m_FrameMetrics.m_InputToPresentSubmitTime += (inputToPresentSubmitTime - m_FrameMetrics.m_InputToPresentSubmitTime) * smoothing;
 
 		++m_Frame;
 	}
+
+	// nothing may be in flight once the loop is left, resources are destroyed right after
+	vkDeviceWaitIdle(m_LogicalDevice);
+
+	if (!m_Settings.m_TracePath.empty())
+		CpuProfiler::m_Profiler.DumpChromeTrace(m_Settings.m_TracePath.c_str(), CPU_PROFILER_DUMP_FRAMES);
+
+	if (m_Settings.m_Headless && m_Frame > 1)
+	{
+		// the first loop only flushes the setup uploads and isn't counted
+		const uint64_t	renderedFrames = m_Frame - 1;
+		const float		totalTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - m_StartTime).count();
+
+		std::cout << "Rendered " << renderedFrames << " frames (" << m_Settings.m_Extent.width << "x" << m_Settings.m_Extent.height << ") in " << totalTime << " ms, "
+				  << totalTime / static_cast<float>(renderedFrames) << " ms per frame" << std::endl; // TODO: change this for real logger
+
+		// a requested size above the budget means the budget is too small for this machine's views
+		const TextureStreamingStatistics	streamingStatistics = GetTextureRegistry()->GetStreamingStatistics();
+		if (streamingStatistics.m_BudgetSize > 0)
+		{
+			std::cout << "Streamed textures: " << streamingStatistics.m_ResidentSize / 1024 << " KB resident, " << streamingStatistics.m_RequestedSize / 1024 << " KB requested, "
+					  << streamingStatistics.m_UploadedLevelsCount << " mips uploaded, " << streamingStatistics.m_EvictedLevelsCount << " evicted" << std::endl; // TODO: change this for real logger
+		}
+	}
 }
 
 //----------------------------------------------------------------
 
-// TODO: store found memory type to speed up things
-bool		Device::AllocateMemory(VkMemoryRequirements memoryRequirements, VkMemoryPropertyFlags memoryType, VkDeviceMemory &outMemory)
+bool	Device::IsRunning() const
 {
-	VkMemoryAllocateInfo memAllocInfo = { };
-	{
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memAllocInfo.allocationSize = memoryRequirements.size;
-		memAllocInfo.memoryTypeIndex = FindMemoryType(memoryRequirements.memoryTypeBits, memoryType);
-	}
+	// the first loop doesn't render, it only flushes the setup uploads
+	if (m_Settings.m_FramesCount > 0 && m_Frame > m_Settings.m_FramesCount)
+		return false;
 
-	CHECK_API_SUCCESS(vkAllocateMemory(m_LogicalDevice, &memAllocInfo, nullptr, &outMemory)); // TODO: add error management
+	if (m_Settings.m_RecordBenchmarkFrames > 0 && m_RecordBenchmarkThreads > m_Scene->GetMaxRecordThreadsCount())
+		return false;
 
-	return true;
+	return (m_Window == nullptr) || !m_Window->IsClosed();
+}
+
+//----------------------------------------------------------------
+
+void	Device::UpdateRecordBenchmark()
+{
+	// the first frame of a threads count records with buffers allocated for the previous one, it isn't measured
+	if (m_RecordBenchmarkFrame > 0)
+		m_RecordBenchmarkTime += m_Scene->GetLastRecordTime();
+
+	if (++m_RecordBenchmarkFrame <= m_Settings.m_RecordBenchmarkFrames)
+		return;
+
+	const float		recordTime = m_RecordBenchmarkTime / static_cast<float>(m_Settings.m_RecordBenchmarkFrames);
+
+	if (m_RecordBenchmarkThreads == 1)
+		m_RecordBenchmarkSerialTime = recordTime;
+
+	const float		speedup = (recordTime > 0.f) ? m_RecordBenchmarkSerialTime / recordTime : 0.f;
+
+	std::cout << "\t" << m_RecordBenchmarkThreads << " threads: " << recordTime << " ms (x" << speedup << ")" << std::endl; // TODO: change this for real logger
+
+	m_RecordBenchmarkFrame = 0;
+	m_RecordBenchmarkTime = 0.f;
+
+	// IsRunning stops once every workers count is measured
+	++m_RecordBenchmarkThreads;
+	m_Scene->SetRecordThreadsCount(m_RecordBenchmarkThreads);
 }
 
 //----------------------------------------------------------------
@@ -240,13 +526,41 @@ uint32_t	Device::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags prope
 
 //----------------------------------------------------------------
 
+bool	Device::SupportsSampledFormat(VkFormat format) const
+{
+	if (Ktx2::IsBlockCompressed(format) && !m_TextureCompressionBC)
+		return false;
+
+	VkFormatProperties	formatProperties;
+	vkGetPhysicalDeviceFormatProperties(m_PhysicalDevice, format, &formatProperties);
+
+	const VkFormatFeatureFlags	requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+}
+
+//----------------------------------------------------------------
+
 bool	Device::CreateInstance()
 {
-	m_ExtensionNames = { VK_KHR_SURFACE_EXTENSION_NAME
+	m_ExtensionNames = std::vector<const char*>();
+
+	// surface extensions are only needed to present, headless runs work on drivers without any
+	if (m_Window != nullptr)
+	{
 #if defined(_WIN32)
-		, VK_KHR_WIN32_SURFACE_EXTENSION_NAME
+		m_ExtensionNames = { VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+#else
+		uint32_t	glfwExtensionsCount = 0;
+		const char	**glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionsCount);
+
+		m_ExtensionNames.assign(glfwExtensions, glfwExtensions + glfwExtensionsCount);
+#endif
+	}
+
+#if defined(VULKAN_ENABLE_VALIDATION_LAYER)
+	m_ExtensionNames.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
 #endif
-		, VK_EXT_DEBUG_REPORT_EXTENSION_NAME };
 
 	m_LayerNames = std::vector<const char*>();
 
@@ -292,7 +606,10 @@ bool	Device::CreatePhysicalDevice()
 	if (m_PhysicalDevice == nullptr) // no separate GPU
 	{
 		if (physicalDevices[0] != nullptr) // fallback on first one
+		{
 			m_PhysicalDevice = physicalDevices[0];
+			vkGetPhysicalDeviceProperties(m_PhysicalDevice, &m_PhysicalDeviceProperties);
+		}
 		else // no physical device, abort
 			return false;
 	}
@@ -306,11 +623,83 @@ bool	Device::CreateLogicalDevice()
 {
 	float									queuePriorities[] = { 1.f };
 	// TODO: Manage multiple queues
-	VkDeviceQueueCreateInfo					deviceQueueInfo = Initializers::Device::QueueCreateInfo(m_RenderHandle->GetRenderCommands()[0]->GetQueue().m_FamilyIndex, 1, queuePriorities); 
+	VkDeviceQueueCreateInfo					deviceQueueInfo = Initializers::Device::QueueCreateInfo(m_RenderHandle->GetFrameContext(0).m_RenderCommand->GetQueue().m_FamilyIndex, 1, queuePriorities); 
 
 	std::vector<VkDeviceQueueCreateInfo>	queueInfos = { deviceQueueInfo };
-	std::vector<const char*>				deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+
+	// uploads run on their own family when the device has a dedicated transfer one
+	const UploadManager						*uploadManager = m_RenderHandle->GetUploadManager();
+	if (uploadManager->HasDedicatedTransfer())
+		queueInfos.push_back(Initializers::Device::QueueCreateInfo(uploadManager->GetTransferFamilyIndex(), 1, queuePriorities));
+	std::vector<const char*>				deviceExtensions = std::vector<const char*>();
+	if (!m_Settings.m_Headless)
+		deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+	// frame pacing uses timeline semaphores when available, fences otherwise
+	m_TimelineSemaphore = HasTimelineSemaphore();
+
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR	timelineFeatures = { };
+	{
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timelineFeatures.timelineSemaphore = VK_TRUE;
+	}
+
+	if (m_TimelineSemaphore)
+		deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+	// BC compressed textures are loaded when the device samples them, their source image is decoded otherwise
+	VkPhysicalDeviceFeatures				supportedFeatures;
+	vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supportedFeatures);
+
+	m_TextureCompressionBC = (supportedFeatures.textureCompressionBC == VK_TRUE);
+	m_DepthClamp = (supportedFeatures.depthClamp == VK_TRUE);
+
+	// the culling pass writes the draws and their count, the indirect draws index the textures of every mesh from one array
+	m_GpuCulling = m_Settings.m_GpuCulling && HasGpuCulling();
+
+	if (m_Settings.m_GpuCulling && !m_GpuCulling)
+		std::cout << "GPU culling not supported by this device, meshes are culled on the CPU" << std::endl; // TODO: change this for real logger
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT	descriptorIndexingFeatures = { };
+	{
+		descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	}
+
+	if (m_GpuCulling)
+	{
+		deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+	}
+
+	VkPhysicalDeviceFeatures				enabledFeatures = { };
+	{
+		enabledFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+		enabledFeatures.depthClamp = supportedFeatures.depthClamp;
+		enabledFeatures.multiDrawIndirect = (m_GpuCulling) ? VK_TRUE : VK_FALSE;
+		enabledFeatures.drawIndirectFirstInstance = (m_GpuCulling) ? VK_TRUE : VK_FALSE;
+	}
+
+	// features of the enabled extensions are chained
+	void									*featuresChain = nullptr;
+
+	if (m_GpuCulling)
+	{
+		descriptorIndexingFeatures.pNext = featuresChain;
+		featuresChain = &descriptorIndexingFeatures;
+	}
+
+	if (m_TimelineSemaphore)
+	{
+		timelineFeatures.pNext = featuresChain;
+		featuresChain = &timelineFeatures;
+	}
+
 	VkDeviceCreateInfo						deviceInfo = Initializers::Device::CreateInfo(queueInfos, deviceExtensions);
+	{
+		deviceInfo.pEnabledFeatures = &enabledFeatures;
+		deviceInfo.pNext = featuresChain;
+	}
 
 	CHECK_API_SUCCESS(vkCreateDevice(m_PhysicalDevice, &deviceInfo, nullptr, &m_LogicalDevice));
 
@@ -323,7 +712,8 @@ bool	Device::CreateLogicalDevice()
 
 bool	Device::CreateDescriptorPool()
 {
-	const std::vector<VkDescriptorPoolSize>	descPoolSizes = Initializers::Pool::DescriptorSizes(100, 100, 100, 100, 100, 100, 0, 100, 100, 0, 200);
+	// only the UI allocates here (its font sampler), scene sets come from the frame descriptor allocators
+	const std::vector<VkDescriptorPoolSize>	descPoolSizes = Initializers::Pool::DescriptorSizes(0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0);
 
 	VkDescriptorPoolCreateInfo				descPoolCreateInfo = Initializers::Pool::DescriptorCreateInfo(descPoolSizes);
 
@@ -345,6 +735,89 @@ bool	Device::HasRequiredFeatures()
 
 //----------------------------------------------------------------
 
+bool	Device::HasTimelineSemaphore() const
+{
+	// features query needs a 1.1 physical device
+	if (m_PhysicalDeviceProperties.apiVersion < VK_API_VERSION_1_1)
+		return false;
+
+	if (!HasDeviceExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+		return false;
+
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR	timelineFeatures = { };
+	{
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	}
+
+	VkPhysicalDeviceFeatures2						features = { };
+	{
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &timelineFeatures;
+	}
+
+	vkGetPhysicalDeviceFeatures2(m_PhysicalDevice, &features);
+
+	return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+//----------------------------------------------------------------
+
+bool	Device::HasGpuCulling() const
+{
+	// features query needs a 1.1 physical device, the descriptor indexing extension needs maintenance3 which 1.1 has
+	if (m_PhysicalDeviceProperties.apiVersion < VK_API_VERSION_1_1)
+		return false;
+
+	if (!HasDeviceExtension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) || !HasDeviceExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+		return false;
+
+	// the textures array of the culled meshes comes on top of the samplers every mesh binds
+	const VkPhysicalDeviceLimits					&limits = m_PhysicalDeviceProperties.limits;
+	const uint32_t									samplersCount = GPU_CULLING_MAX_OBJECTS + GPU_CULLING_SHARED_SAMPLERS_COUNT;
+
+	if (limits.maxPerStageDescriptorSamplers < samplersCount || limits.maxPerStageDescriptorSampledImages < samplersCount ||
+		limits.maxDescriptorSetSamplers < samplersCount || limits.maxDescriptorSetSampledImages < samplersCount ||
+		limits.maxDrawIndirectCount < GPU_CULLING_MAX_DRAWS)
+		return false;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT	descriptorIndexingFeatures = { };
+	{
+		descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	}
+
+	VkPhysicalDeviceFeatures2						features = { };
+	{
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &descriptorIndexingFeatures;
+	}
+
+	vkGetPhysicalDeviceFeatures2(m_PhysicalDevice, &features);
+
+	return	features.features.multiDrawIndirect == VK_TRUE && features.features.drawIndirectFirstInstance == VK_TRUE &&
+			descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing == VK_TRUE;
+}
+
+//----------------------------------------------------------------
+
+bool	Device::HasDeviceExtension(const char *extensionName) const
+{
+	uint32_t							extensionsCount = 0;
+	CHECK_API_SUCCESS(vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionsCount, nullptr));
+
+	std::vector<VkExtensionProperties>	extensions(extensionsCount);
+	CHECK_API_SUCCESS(vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionsCount, extensions.data()));
+
+	for (uint32_t extensionIndex = 0; extensionIndex < extensionsCount; ++extensionIndex)
+	{
+		if (strcmp(extensions[extensionIndex].extensionName, extensionName) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+//----------------------------------------------------------------
+
 void	Device::LoadMemoryProperties()
 {
 	vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &m_MemoryProperties);
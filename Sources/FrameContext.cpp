@@ -0,0 +1,137 @@
+#include "FrameContext.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+FrameContext::FrameContext()
+:	m_Fence(nullptr),
+	m_AcquireSemaphore(nullptr),
+	m_PresentSemaphore(nullptr),
+	m_TimelineValue(0),
+	m_RenderCommand(nullptr),
+	m_UniformArena(nullptr),
+	m_DescriptorAllocator(nullptr),
+	m_ThreadCommands(std::vector<SecondaryCommand*>())
+{
+
+}
+
+//----------------------------------------------------------------
+
+bool	FrameContext::Setup(const std::vector<VkQueueFamilyProperties> &queuesFamilyProperties)
+{
+	m_RenderCommand = new RenderCommand(COMMAND_TYPE::GraphicsOp);
+
+	return m_RenderCommand->Setup(queuesFamilyProperties);
+}
+
+//----------------------------------------------------------------
+
+bool	FrameContext::Prepare(const VkDevice logicalDevice, uint32_t threadCommandsCount, VkDeviceSize uniformAlignment)
+{
+	if (!m_RenderCommand->Prepare(logicalDevice))
+		return false;
+
+	// create fence and semaphores
+	VkFenceCreateInfo		fenceCreateInfo = Initializers::Fence::CreateInfo();
+	VkSemaphoreCreateInfo	semaphoreCreateInfo = Initializers::Semaphore::CreateInfo();
+
+	CHECK_API_SUCCESS(vkCreateFence(logicalDevice, &fenceCreateInfo, nullptr, &m_Fence)); // TODO: add error management
+
+	CHECK_API_SUCCESS(vkCreateSemaphore(logicalDevice, &semaphoreCreateInfo, nullptr, &m_AcquireSemaphore)); // TODO: add error management
+	CHECK_API_SUCCESS(vkCreateSemaphore(logicalDevice, &semaphoreCreateInfo, nullptr, &m_PresentSemaphore));
+
+	// create secondary command pools on the same family as the primary command buffer
+	const uint32_t	queueFamilyIndex = m_RenderCommand->GetQueue().m_FamilyIndex;
+
+	m_ThreadCommands.resize(threadCommandsCount);
+
+	for (uint32_t threadIndex = 0; threadIndex < threadCommandsCount; ++threadIndex)
+	{
+		m_ThreadCommands[threadIndex] = new SecondaryCommand();
+		if (!m_ThreadCommands[threadIndex]->Prepare(logicalDevice, queueFamilyIndex))
+			return false;
+	}
+
+	m_DescriptorAllocator = new DescriptorAllocator();
+	if (!m_DescriptorAllocator->Prepare(logicalDevice))
+		return false;
+
+	m_UniformArena = new UniformArena();
+
+	return m_UniformArena->Prepare(logicalDevice, UNIFORM_ARENA_SIZE, uniformAlignment);
+}
+
+//----------------------------------------------------------------
+
+void	FrameContext::Shutdown(const VkDevice logicalDevice)
+{
+	if (m_RenderCommand != nullptr)
+	{
+		m_RenderCommand->Shutdown(logicalDevice);
+
+		delete m_RenderCommand;
+	}
+
+	m_RenderCommand = nullptr;
+
+	if (m_Fence != nullptr)
+		vkDestroyFence(logicalDevice, m_Fence, nullptr);
+
+	if (m_AcquireSemaphore != nullptr)
+		vkDestroySemaphore(logicalDevice, m_AcquireSemaphore, nullptr);
+
+	if (m_PresentSemaphore != nullptr)
+		vkDestroySemaphore(logicalDevice, m_PresentSemaphore, nullptr);
+
+	m_Fence = nullptr;
+	m_AcquireSemaphore = nullptr;
+	m_PresentSemaphore = nullptr;
+
+	// destroy secondary command pools
+	const uint32_t	threadCommandsCount = static_cast<uint32_t>(m_ThreadCommands.size());
+	for (uint32_t threadIndex = 0; threadIndex < threadCommandsCount; ++threadIndex)
+	{
+		m_ThreadCommands[threadIndex]->Shutdown();
+		delete m_ThreadCommands[threadIndex];
+	}
+
+	m_ThreadCommands.clear();
+
+	if (m_UniformArena != nullptr)
+	{
+		m_UniformArena->Shutdown(logicalDevice);
+
+		delete m_UniformArena;
+	}
+
+	m_UniformArena = nullptr;
+
+	if (m_DescriptorAllocator != nullptr)
+	{
+		m_DescriptorAllocator->Shutdown(logicalDevice);
+
+		delete m_DescriptorAllocator;
+	}
+
+	m_DescriptorAllocator = nullptr;
+}
+
+//----------------------------------------------------------------
+
+void	FrameContext::Reset()
+{
+	m_RenderCommand->Reset();
+	m_UniformArena->Reset();
+
+	const uint32_t	threadCommandsCount = static_cast<uint32_t>(m_ThreadCommands.size());
+	for (uint32_t threadIndex = 0; threadIndex < threadCommandsCount; ++threadIndex)
+		m_ThreadCommands[threadIndex]->Reset();
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,160 @@
+#include "GeometryPool.h"
+
+#include "Device.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+GeometryPool::GeometryPool(const RenderHandle *renderHandle)
+:	m_RenderHandle(renderHandle),
+	m_VertexLayout(VERTEX_LAYOUT::Full),
+	m_Frame(0)
+{
+}
+
+//----------------------------------------------------------------
+
+GeometryPool::~GeometryPool()
+{
+}
+
+//----------------------------------------------------------------
+
+bool	GeometryPool::Prepare(const VkDevice logicalDevice, VERTEX_LAYOUT vertexLayout)
+{
+	m_VertexLayout = vertexLayout;
+
+	// storage too, so that compute passes can read the meshes where they are drawn from
+	const BUFFER_TYPE	vertexType = static_cast<BUFFER_TYPE>(BUFFER_TYPE::Vertex | BUFFER_TYPE::Storage | BUFFER_TYPE::TransferDest);
+	const BUFFER_TYPE	indexType = static_cast<BUFFER_TYPE>(BUFFER_TYPE::Index | BUFFER_TYPE::Storage | BUFFER_TYPE::TransferDest);
+
+	m_PositionBuffer = Buffer<uint8_t>(logicalDevice, vertexType, GEOMETRY_POOL_VERTICES_COUNT * VertexFormat::GetPositionStride(vertexLayout));
+	m_AttributeBuffer = Buffer<uint8_t>(logicalDevice, vertexType, GEOMETRY_POOL_VERTICES_COUNT * VertexFormat::GetAttributeStride(vertexLayout));
+	m_IndexBuffer = Buffer<uint32_t>(logicalDevice, indexType, GEOMETRY_POOL_INDICES_COUNT);
+
+	m_Vertices.Reset(GEOMETRY_POOL_VERTICES_COUNT);
+	m_Indices.Reset(GEOMETRY_POOL_INDICES_COUNT);
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	GeometryPool::Shutdown(const VkDevice logicalDevice)
+{
+	m_PositionBuffer.Destroy(logicalDevice);
+	m_AttributeBuffer.Destroy(logicalDevice);
+	m_IndexBuffer.Destroy(logicalDevice);
+
+	m_ReleasedRanges.clear();
+}
+
+//----------------------------------------------------------------
+
+bool	GeometryPool::Allocate(uint32_t verticesCount, uint32_t indicesCount, GeometryRange &outRange)
+{
+	if (verticesCount == 0 || indicesCount == 0)
+		return false;
+
+	const uint32_t	firstVertex = m_Vertices.Allocate(verticesCount);
+	if (firstVertex == UINT32_MAX)
+		return false;
+
+	const uint32_t	firstIndex = m_Indices.Allocate(indicesCount);
+	if (firstIndex == UINT32_MAX)
+	{
+		m_Vertices.Free(firstVertex, verticesCount);
+		return false;
+	}
+
+	outRange.m_FirstVertex = firstVertex;
+	outRange.m_VerticesCount = verticesCount;
+	outRange.m_FirstIndex = firstIndex;
+	outRange.m_IndicesCount = indicesCount;
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	GeometryPool::Free(const GeometryRange &range)
+{
+	if (range.IsValid())
+		m_ReleasedRanges.push_back({ range, m_Frame });
+}
+
+//----------------------------------------------------------------
+
+bool	GeometryPool::Upload(const GeometryRange &range, const void *positions, const void *attributes, const void *indices, uint32_t indexSize)
+{
+	// device local buffers, the data is copied to staging right away and by the next upload batch to the GPU
+	UploadManager			*uploadManager = m_RenderHandle->GetUploadManager();
+
+	const VkDeviceSize		positionStride = VertexFormat::GetPositionStride(m_VertexLayout);
+	const VkDeviceSize		attributeStride = VertexFormat::GetAttributeStride(m_VertexLayout);
+
+	if (!uploadManager->UploadBuffer(	m_PositionBuffer.GetApiBuffer(), positions, range.m_VerticesCount * positionStride,
+										VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, range.m_FirstVertex * positionStride))
+		return false;
+
+	if (!uploadManager->UploadBuffer(	m_AttributeBuffer.GetApiBuffer(), attributes, range.m_VerticesCount * attributeStride,
+										VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, range.m_FirstVertex * attributeStride))
+		return false;
+
+	// one index type for every draw of a pass
+	std::vector<uint32_t>	widenedIndices;
+	if (indexSize == sizeof(uint16_t))
+	{
+		const uint16_t	*shortIndices = static_cast<const uint16_t*>(indices);
+		widenedIndices.assign(shortIndices, shortIndices + range.m_IndicesCount);
+
+		indices = widenedIndices.data();
+	}
+
+	return uploadManager->UploadBuffer(	m_IndexBuffer.GetApiBuffer(), indices, range.m_IndicesCount * sizeof(uint32_t),
+										VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, range.m_FirstIndex * sizeof(uint32_t));
+}
+
+//----------------------------------------------------------------
+
+void	GeometryPool::Collect(uint32_t pendingFramesCount)
+{
+	++m_Frame;
+
+	// a range released while recording frame N is read at most by the frames already in flight,
+	// all of them are done once pendingFramesCount frame slots have been waited for
+	uint32_t	releasedIndex = 0;
+	while (releasedIndex < static_cast<uint32_t>(m_ReleasedRanges.size()))
+	{
+		const ReleasedRange	&releasedRange = m_ReleasedRanges[releasedIndex];
+
+		if (m_Frame >= releasedRange.m_ReleaseFrame + pendingFramesCount)
+		{
+			m_Vertices.Free(releasedRange.m_Range.m_FirstVertex, releasedRange.m_Range.m_VerticesCount);
+			m_Indices.Free(releasedRange.m_Range.m_FirstIndex, releasedRange.m_Range.m_IndicesCount);
+
+			m_ReleasedRanges[releasedIndex] = m_ReleasedRanges.back();
+			m_ReleasedRanges.pop_back();
+		}
+		else
+			++releasedIndex;
+	}
+}
+
+//----------------------------------------------------------------
+
+void	GeometryPool::BindBuffers(const VkCommandBuffer commandBuffer, bool positionsOnly) const
+{
+	const VkDeviceSize	offsets[2] = { 0, 0 };
+	const VkBuffer		vertexBuffers[2] = { m_PositionBuffer.GetApiBuffer(), m_AttributeBuffer.GetApiBuffer() };
+
+	vkCmdBindVertexBuffers(commandBuffer, 0, (positionsOnly) ? 1 : 2, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer.GetApiBuffer(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
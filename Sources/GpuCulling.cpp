@@ -0,0 +1,734 @@
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#include "Device.h"
+#include "GpuProfiler.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+static VkDescriptorSetLayoutBinding	MakeBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stages, uint32_t count = 1)
+{
+	VkDescriptorSetLayoutBinding	layoutBinding = { };
+	{
+		layoutBinding.binding = binding;
+		layoutBinding.descriptorType = type;
+		layoutBinding.descriptorCount = count;
+		layoutBinding.stageFlags = stages;
+	}
+
+	return layoutBinding;
+}
+
+//----------------------------------------------------------------
+
+static VkWriteDescriptorSet	MakeWrite(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const VkDescriptorBufferInfo *bufferInfo, const VkDescriptorImageInfo *imageInfo, uint32_t count = 1)
+{
+	VkWriteDescriptorSet	writeDesc = { };
+	{
+		writeDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writeDesc.dstSet = set;
+		writeDesc.dstBinding = binding;
+		writeDesc.dstArrayElement = 0;
+		writeDesc.descriptorCount = count;
+		writeDesc.descriptorType = type;
+		writeDesc.pBufferInfo = bufferInfo;
+		writeDesc.pImageInfo = imageInfo;
+	}
+
+	return writeDesc;
+}
+
+//----------------------------------------------------------------
+
+static GpuCullingView	MakeGpuView(const CullingView &view, float lodErrorPixels, uint32_t drawList, bool splitsOpacity)
+{
+	GpuCullingView	gpuView = { };
+	{
+		for (uint32_t planeIndex = 0; planeIndex < 6; ++planeIndex)
+			gpuView.m_Planes[planeIndex] = view.m_Planes[planeIndex];
+
+		gpuView.m_RowW = view.m_RowW;
+		gpuView.m_RowWLength = view.m_RowWLength;
+		gpuView.m_PixelsPerUnit = view.m_PixelsPerUnit;
+		gpuView.m_MinPixels = view.m_MinPixels;
+		gpuView.m_LodErrorPixels = lodErrorPixels;
+		gpuView.m_DrawList = drawList;
+		gpuView.m_SplitsOpacity = (splitsOpacity) ? 1 : 0;
+		gpuView.m_IsActive = 1;
+	}
+
+	return gpuView;
+}
+
+//----------------------------------------------------------------
+
+GpuCulling::GpuCulling(const RenderHandle *renderHandle)
+:	m_RenderHandle(renderHandle),
+	m_DescriptorPool(nullptr),
+	m_CullSetLayout(nullptr),
+	m_DrawSetLayout(nullptr),
+	m_ShadowSetLayout(nullptr),
+	m_CullPipelineLayout(nullptr),
+	m_CullPipeline(nullptr),
+	m_DrawPipelineLayout(nullptr),
+	m_ShadowPipelineLayout(nullptr),
+	m_FallbackImage({ }),
+	m_UniformRanges({ }),
+	m_SlotsCount(0),
+	m_TestedCount(0),
+	m_OccludedCount(0),
+	m_OcclusionRate(0.f)
+{
+}
+
+//----------------------------------------------------------------
+
+GpuCulling::~GpuCulling()
+{
+	m_RenderHandle = nullptr;
+}
+
+//----------------------------------------------------------------
+
+bool	GpuCulling::Setup(const VkDevice logicalDevice, const VkShaderModule cullModule, const GpuCullingBindings &bindings)
+{
+	const uint32_t					framesCount = m_RenderHandle->GetPendingFramesCount();
+
+	// every slot of every frame starts free, the pass skips objects without levels
+	std::vector<GpuCullingObject>	freeObjects(GPU_CULLING_MAX_OBJECTS);
+	memset(freeObjects.data(), 0, freeObjects.size() * sizeof(GpuCullingObject));
+
+	const std::vector<uint32_t>		noStats(GPU_CULLING_STATS_COUNT, 0);
+
+	// draws and counts are only touched by the GPU, device local
+	const BUFFER_TYPE				indirectType = static_cast<BUFFER_TYPE>(BUFFER_TYPE::Indirect | BUFFER_TYPE::Storage | BUFFER_TYPE::TransferDest);
+
+	m_Frames.resize(framesCount);
+	for (FrameResources &frame : m_Frames)
+	{
+		frame.m_ObjectBuffer = Buffer<GpuCullingObject>(logicalDevice, BUFFER_TYPE::Storage, GPU_CULLING_MAX_OBJECTS);
+		frame.m_SubmeshBuffer = Buffer<GpuCullingSubmesh>(logicalDevice, BUFFER_TYPE::Storage, GPU_CULLING_MAX_SUBMESHES);
+		frame.m_ViewBuffer = Buffer<GpuCullingView>(logicalDevice, BUFFER_TYPE::Uniform, GPU_CULLING_VIEWS_COUNT);
+		frame.m_DrawBuffer = Buffer<VkDrawIndexedIndirectCommand>(logicalDevice, indirectType, GPU_CULLING_MAX_DRAWS * GPU_CULLING_DRAW_LISTS_COUNT);
+		frame.m_CountBuffer = Buffer<uint32_t>(logicalDevice, indirectType, GPU_CULLING_DRAW_LISTS_COUNT + GPU_CULLING_STATS_COUNT);
+
+		// copied into, but read by the CPU
+		frame.m_StatsBuffer = Buffer<uint32_t>(logicalDevice, BUFFER_TYPE::TransferDest, GPU_CULLING_STATS_COUNT, sizeof(uint32_t));
+
+		frame.m_ObjectBuffer.UpdateData(logicalDevice, freeObjects);
+		frame.m_StatsBuffer.UpdateData(logicalDevice, noStats);
+	}
+
+	// the flags are only read by the late phase of the frame that wrote them, one buffer serves every frame slot
+	m_VisibilityBuffer = Buffer<uint32_t>(logicalDevice, static_cast<BUFFER_TYPE>(BUFFER_TYPE::Storage | BUFFER_TYPE::TransferDest), GPU_CULLING_MAX_OBJECTS);
+
+	m_Submeshes.resize(GPU_CULLING_MAX_SUBMESHES);
+	m_SubmeshRanges.Reset(GPU_CULLING_MAX_SUBMESHES);
+	m_TextureVersions.assign(framesCount * GPU_CULLING_MAX_OBJECTS, UINT64_MAX);
+	m_FallbackImage = bindings.m_Fallback;
+
+	if (!CreateDescriptorSets(logicalDevice, bindings))
+		return false;
+
+	return CreatePipelines(logicalDevice, cullModule);
+}
+
+//----------------------------------------------------------------
+
+bool	GpuCulling::CreateDescriptorSets(const VkDevice logicalDevice, const GpuCullingBindings &bindings)
+{
+	const uint32_t	framesCount = m_RenderHandle->GetPendingFramesCount();
+
+	m_UniformRanges = bindings;
+
+	// the textures array alone is far larger than the shared pool
+	const std::vector<VkDescriptorPoolSize>	poolSizes = Initializers::Pool::DescriptorSizes(0,
+																							(GPU_CULLING_MAX_OBJECTS + GPU_CULLING_SHARED_SAMPLERS_COUNT + 1) * framesCount, // and the depth pyramid
+																							0, 0,
+																							framesCount, // views
+																							5 * framesCount, // draw and shadow sets uniforms
+																							0,
+																							7 * framesCount, // objects of every set, submeshes, draws, counts and visibility
+																							0, 0, 0);
+
+	VkDescriptorPoolCreateInfo				poolInfo = Initializers::Pool::DescriptorCreateInfo(poolSizes);
+	{
+		poolInfo.maxSets = 3 * framesCount;
+	}
+
+	CHECK_API_SUCCESS(vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &m_DescriptorPool));
+
+	const VkShaderStageFlags	vertexFragment = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	// culling pass: views, objects, submeshes, draws, counts, visibility and depth pyramid
+	const VkDescriptorSetLayoutBinding	cullBindings[] =
+	{
+		MakeBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT),
+		MakeBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT),
+		MakeBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT),
+		MakeBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT),
+		MakeBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT),
+		MakeBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT),
+		MakeBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT),
+	};
+
+	// same bindings as the per mesh sets of the objects pass, the per mesh uniform becomes the objects buffer
+	// and the mesh texture an array indexed by object
+	const VkDescriptorSetLayoutBinding	drawBindings[] =
+	{
+		MakeBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT), // matrices view and proj
+		MakeBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vertexFragment), // objects
+		MakeBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, GPU_CULLING_MAX_OBJECTS), // mesh textures
+		MakeBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT), // skybox
+		MakeBinding(4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT), // light
+		MakeBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT), // shadowMapCascadeSampler
+		MakeBinding(6, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, vertexFragment), // shadowBufferCascade
+		MakeBinding(7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT), // shadowMapSpotLight
+		MakeBinding(8, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT), // shadowBufferSpotLight
+	};
+
+	// cascades, the cascade index is a push constant
+	const VkDescriptorSetLayoutBinding	shadowBindings[] =
+	{
+		MakeBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT), // shadowBuffer
+		MakeBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT), // objects
+	};
+
+	VkDescriptorSetLayoutCreateInfo		layoutInfo = { };
+	{
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	}
+
+	layoutInfo.bindingCount = static_cast<uint32_t>(std::size(cullBindings));
+	layoutInfo.pBindings = cullBindings;
+	CHECK_API_SUCCESS(vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &m_CullSetLayout));
+
+	layoutInfo.bindingCount = static_cast<uint32_t>(std::size(drawBindings));
+	layoutInfo.pBindings = drawBindings;
+	CHECK_API_SUCCESS(vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &m_DrawSetLayout));
+
+	layoutInfo.bindingCount = static_cast<uint32_t>(std::size(shadowBindings));
+	layoutInfo.pBindings = shadowBindings;
+	CHECK_API_SUCCESS(vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &m_ShadowSetLayout));
+
+	const std::vector<VkDescriptorImageInfo>	fallbackInfos(GPU_CULLING_MAX_OBJECTS, bindings.m_Fallback);
+
+	for (uint32_t frameIndex = 0; frameIndex < framesCount; ++frameIndex)
+	{
+		FrameResources				&frame = m_Frames[frameIndex];
+
+		const VkDescriptorSetLayout	setLayouts[3] = { m_CullSetLayout, m_DrawSetLayout, m_ShadowSetLayout };
+		VkDescriptorSet				sets[3] = { };
+
+		VkDescriptorSetAllocateInfo	allocateInfo = { };
+		{
+			allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			allocateInfo.descriptorPool = m_DescriptorPool;
+			allocateInfo.descriptorSetCount = 3;
+			allocateInfo.pSetLayouts = setLayouts;
+		}
+
+		CHECK_API_SUCCESS(vkAllocateDescriptorSets(logicalDevice, &allocateInfo, sets));
+
+		frame.m_CullSet = sets[0];
+		frame.m_DrawSet = sets[1];
+		frame.m_ShadowSet = sets[2];
+
+		const VkDescriptorBufferInfo	viewInfo = { frame.m_ViewBuffer.GetApiBuffer(), 0, VK_WHOLE_SIZE };
+		const VkDescriptorBufferInfo	objectInfo = { frame.m_ObjectBuffer.GetApiBuffer(), 0, VK_WHOLE_SIZE };
+		const VkDescriptorBufferInfo	submeshInfo = { frame.m_SubmeshBuffer.GetApiBuffer(), 0, VK_WHOLE_SIZE };
+		const VkDescriptorBufferInfo	drawInfo = { frame.m_DrawBuffer.GetApiBuffer(), 0, VK_WHOLE_SIZE };
+		const VkDescriptorBufferInfo	countInfo = { frame.m_CountBuffer.GetApiBuffer(), 0, VK_WHOLE_SIZE };
+		const VkDescriptorBufferInfo	visibilityInfo = { m_VisibilityBuffer.GetApiBuffer(), 0, VK_WHOLE_SIZE };
+
+		const VkWriteDescriptorSet	writeDescs[] =
+		{
+			MakeWrite(frame.m_CullSet, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &viewInfo, nullptr),
+			MakeWrite(frame.m_CullSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &objectInfo, nullptr),
+			MakeWrite(frame.m_CullSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &submeshInfo, nullptr),
+			MakeWrite(frame.m_CullSet, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &drawInfo, nullptr),
+			MakeWrite(frame.m_CullSet, 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &countInfo, nullptr),
+			MakeWrite(frame.m_CullSet, 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &visibilityInfo, nullptr),
+			MakeWrite(frame.m_CullSet, 6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nullptr, &bindings.m_DepthPyramid),
+
+			MakeWrite(frame.m_DrawSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &objectInfo, nullptr),
+			MakeWrite(frame.m_DrawSet, 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nullptr, fallbackInfos.data(), GPU_CULLING_MAX_OBJECTS),
+			MakeWrite(frame.m_DrawSet, 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nullptr, &bindings.m_Skybox),
+			MakeWrite(frame.m_DrawSet, 5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nullptr, &bindings.m_ShadowCascade),
+			MakeWrite(frame.m_DrawSet, 7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nullptr, &bindings.m_ShadowSpotLight),
+
+			MakeWrite(frame.m_ShadowSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &objectInfo, nullptr),
+		};
+
+		vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(std::size(writeDescs)), writeDescs, 0, nullptr);
+
+		UpdateUniformBuffer(logicalDevice, frameIndex);
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::UpdateUniformBuffer(const VkDevice logicalDevice, uint32_t frameIndex) const
+{
+	const FrameResources			&frame = m_Frames[frameIndex];
+
+	const VkBuffer					uniformBuffer = m_RenderHandle->GetUniformArena(frameIndex)->GetApiBuffer();
+
+	const VkDescriptorBufferInfo	vpInfo = { uniformBuffer, 0, m_UniformRanges.m_VPRange };
+	const VkDescriptorBufferInfo	lightsInfo = { uniformBuffer, 0, m_UniformRanges.m_LightsRange };
+	const VkDescriptorBufferInfo	cascadeInfo = { uniformBuffer, 0, m_UniformRanges.m_ShadowCascadeRange };
+	const VkDescriptorBufferInfo	spotLightInfo = { uniformBuffer, 0, m_UniformRanges.m_ShadowSpotLightRange };
+
+	const VkWriteDescriptorSet		writeDescs[] =
+	{
+		MakeWrite(frame.m_DrawSet, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, &vpInfo, nullptr),
+		MakeWrite(frame.m_DrawSet, 4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, &lightsInfo, nullptr),
+		MakeWrite(frame.m_DrawSet, 6, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, &cascadeInfo, nullptr),
+		MakeWrite(frame.m_DrawSet, 8, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, &spotLightInfo, nullptr),
+
+		MakeWrite(frame.m_ShadowSet, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, &cascadeInfo, nullptr),
+	};
+
+	vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(std::size(writeDescs)), writeDescs, 0, nullptr);
+}
+
+//----------------------------------------------------------------
+
+bool	GpuCulling::CreatePipelines(const VkDevice logicalDevice, const VkShaderModule cullModule)
+{
+	const VkPushConstantRange	cullPushConstant = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GpuCullingPass) };
+
+	VkPipelineLayoutCreateInfo	pipelineLayoutInfo = { };
+	{
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &m_CullSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &cullPushConstant;
+	}
+
+	CHECK_API_SUCCESS(vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &m_CullPipelineLayout));
+
+	// cascade index
+	const VkPushConstantRange	shadowPushConstant = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t) };
+
+	pipelineLayoutInfo.pSetLayouts = &m_ShadowSetLayout;
+	pipelineLayoutInfo.pPushConstantRanges = &shadowPushConstant;
+
+	CHECK_API_SUCCESS(vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &m_ShadowPipelineLayout));
+
+	pipelineLayoutInfo.pSetLayouts = &m_DrawSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 0;
+	pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+	CHECK_API_SUCCESS(vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &m_DrawPipelineLayout));
+
+	VkPipelineShaderStageCreateInfo	cullStage = { };
+	{
+		cullStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		cullStage.stage = static_cast<VkShaderStageFlagBits>(SHADER_STAGE::Compute);
+		cullStage.module = cullModule;
+		cullStage.pName = "main";
+	}
+
+	VkComputePipelineCreateInfo		pipelineInfo = { };
+	{
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = cullStage;
+		pipelineInfo.layout = m_CullPipelineLayout;
+	}
+
+	CHECK_API_SUCCESS(vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_CullPipeline));
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::Shutdown(const VkDevice logicalDevice)
+{
+	for (FrameResources &frame : m_Frames)
+	{
+		frame.m_ObjectBuffer.Destroy(logicalDevice);
+		frame.m_SubmeshBuffer.Destroy(logicalDevice);
+		frame.m_ViewBuffer.Destroy(logicalDevice);
+		frame.m_DrawBuffer.Destroy(logicalDevice);
+		frame.m_CountBuffer.Destroy(logicalDevice);
+		frame.m_StatsBuffer.Destroy(logicalDevice);
+	}
+
+	m_Frames.clear();
+
+	m_VisibilityBuffer.Destroy(logicalDevice);
+
+	if (m_CullPipeline != nullptr)
+		vkDestroyPipeline(logicalDevice, m_CullPipeline, nullptr);
+
+	vkDestroyPipelineLayout(logicalDevice, m_CullPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, m_DrawPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, m_ShadowPipelineLayout, nullptr);
+
+	vkDestroyDescriptorSetLayout(logicalDevice, m_CullSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, m_DrawSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, m_ShadowSetLayout, nullptr);
+
+	// frees the sets too
+	if (m_DescriptorPool != nullptr)
+		vkDestroyDescriptorPool(logicalDevice, m_DescriptorPool, nullptr);
+
+	m_CullPipeline = nullptr;
+	m_DescriptorPool = nullptr;
+}
+
+//----------------------------------------------------------------
+
+bool	GpuCulling::AddMesh(Mesh *mesh, uint32_t &outSlot)
+{
+	const GeometryRange				&geometryRange = mesh->GetGeometryRange();
+	const std::vector<Submesh>		&submeshes = mesh->GetSubmeshes();
+	const uint32_t					submeshesCount = static_cast<uint32_t>(submeshes.size());
+
+	// the indirect draws only reach the geometry pool
+	if (!geometryRange.IsValid() || (m_FreeSlots.empty() && m_SlotsCount == GPU_CULLING_MAX_OBJECTS))
+		return false;
+
+	const uint32_t					firstSubmesh = m_SubmeshRanges.Allocate(submeshesCount);
+	if (firstSubmesh == UINT32_MAX)
+		return false;
+
+	uint32_t						slot = 0;
+	if (!m_FreeSlots.empty())
+	{
+		slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	}
+	else
+	{
+		slot = m_SlotsCount++;
+
+		m_Objects.emplace_back();
+		m_SlotSubmeshes.emplace_back();
+		m_SlotDirtyIndices.push_back(UINT32_MAX);
+	}
+
+	for (uint32_t submeshIndex = 0; submeshIndex < submeshesCount; ++submeshIndex)
+	{
+		const Submesh		&submesh = submeshes[submeshIndex];
+		GpuCullingSubmesh	&gpuSubmesh = m_Submeshes[firstSubmesh + submeshIndex];
+
+		gpuSubmesh.m_FirstIndex = geometryRange.m_FirstIndex + submesh.m_FirstIndex;
+		gpuSubmesh.m_IndicesCount = submesh.m_IndicesCount;
+		gpuSubmesh.m_VertexOffset = static_cast<int32_t>(geometryRange.m_FirstVertex) + submesh.m_VertexOffset;
+		gpuSubmesh.m_ObjectIndex = slot;
+	}
+
+	m_SlotSubmeshes[slot] = { firstSubmesh, submeshesCount };
+	m_DirtySubmeshes.push_back({ m_SlotSubmeshes[slot], m_RenderHandle->GetPendingFramesCount() });
+
+	BuildObject(slot, mesh, m_Objects[slot]);
+	MarkDirty(slot);
+
+	outSlot = slot;
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::RemoveMesh(uint32_t slot)
+{
+	// no level, the pass skips it from the next frames on, the range is rewritten before any new owner is drawn
+	memset(&m_Objects[slot], 0, sizeof(GpuCullingObject));
+	MarkDirty(slot);
+
+	m_SubmeshRanges.Free(m_SlotSubmeshes[slot].m_First, m_SlotSubmeshes[slot].m_Count);
+	m_SlotSubmeshes[slot] = { 0, 0 };
+
+	m_FreeSlots.push_back(slot);
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::UpdateObject(uint32_t slot, Mesh *mesh)
+{
+	BuildObject(slot, mesh, m_Objects[slot]);
+	MarkDirty(slot);
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::BuildObject(uint32_t slot, Mesh *mesh, GpuCullingObject &outObject) const
+{
+	// padding and unused levels included
+	memset(&outObject, 0, sizeof(GpuCullingObject));
+
+	const glm::mat4				&model = mesh->GetModel();
+	const Material				&material = mesh->GetMaterial();
+
+	// same bounds as the CPU culling
+	const glm::vec3				center = glm::vec3(model * glm::vec4((mesh->GetBoundsMin() + mesh->GetBoundsMax()) * 0.5f, 1.f));
+	const glm::vec3				extent = (mesh->GetBoundsMax() - mesh->GetBoundsMin()) * 0.5f;
+	const glm::vec3				worldExtent = glm::abs(glm::vec3(model[0])) * extent.x + glm::abs(glm::vec3(model[1])) * extent.y + glm::abs(glm::vec3(model[2])) * extent.z;
+	const float					scale = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+
+	outObject.m_Model = model * mesh->GetDequantization();
+	outObject.m_Center = glm::vec4(center, mesh->GetBoundsRadius() * scale);
+	outObject.m_Extent = glm::vec4(worldExtent, scale);
+	outObject.m_Albedo = material.GetAlbedo();
+	outObject.m_Surface = glm::vec4(material.GetRoughness(), material.GetMetallic(), material.GetReflectance(), mesh->GetLodBias());
+
+	const std::vector<MeshLod>	&lods = mesh->GetLods();
+	const uint32_t				lodsCount = std::min(static_cast<uint32_t>(lods.size()), static_cast<uint32_t>(MESH_LOD_MAX_COUNT));
+
+	for (uint32_t lodIndex = 0; lodIndex < lodsCount; ++lodIndex)
+	{
+		outObject.m_LodFirstSubmesh[lodIndex] = m_SlotSubmeshes[slot].m_First + lods[lodIndex].m_FirstSubmesh;
+		outObject.m_LodSubmeshesCount[lodIndex] = lods[lodIndex].m_SubmeshesCount;
+		outObject.m_LodErrors[lodIndex] = lods[lodIndex].m_Error;
+	}
+
+	outObject.m_LodsCount = lodsCount;
+	outObject.m_TextureIndex = slot;
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::MarkDirty(uint32_t slot)
+{
+	const uint32_t	framesCount = m_RenderHandle->GetPendingFramesCount();
+
+	if (m_SlotDirtyIndices[slot] != UINT32_MAX)
+	{
+		m_DirtySlots[m_SlotDirtyIndices[slot]].m_FramesLeft = framesCount;
+		return;
+	}
+
+	m_SlotDirtyIndices[slot] = static_cast<uint32_t>(m_DirtySlots.size());
+	m_DirtySlots.push_back({ slot, framesCount });
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::UpdateTexture(const VkDevice logicalDevice, uint32_t frameIndex, uint32_t slot, const Texture &texture)
+{
+	uint64_t	&imageVersion = m_TextureVersions[frameIndex * GPU_CULLING_MAX_OBJECTS + slot];
+	if (imageVersion == texture.m_ImageVersion)
+		return;
+
+	VkDescriptorImageInfo	imageInfo = { };
+	{
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = texture.m_ImageView;
+		imageInfo.sampler = texture.m_Sampler;
+	}
+
+	WriteTexture(logicalDevice, frameIndex, slot, imageInfo);
+	imageVersion = texture.m_ImageVersion;
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::WriteTexture(const VkDevice logicalDevice, uint32_t frameIndex, uint32_t slot, const VkDescriptorImageInfo &imageInfo) const
+{
+	VkWriteDescriptorSet	writeDesc = MakeWrite(m_Frames[frameIndex].m_DrawSet, 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nullptr, &imageInfo);
+	writeDesc.dstArrayElement = slot;
+
+	vkUpdateDescriptorSets(logicalDevice, 1, &writeDesc, 0, nullptr);
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::UpdateFrame(const VkDevice logicalDevice, uint32_t frameIndex,
+								const CullingView &cameraView, const glm::mat4 &cameraViewProj, float lodErrorPixels,
+								const CullingView *cascadeViews, uint32_t cascadeViewsCount, float shadowLodErrorPixels)
+{
+	FrameResources	&frame = m_Frames[frameIndex];
+
+	// counters of the last frame recorded in this slot, zeros without occlusion culling
+	const uint32_t	*stats = frame.m_StatsBuffer.GetMappedData();
+
+	m_TestedCount = stats[GPU_CULLING_STAT_TESTED];
+	m_OccludedCount = stats[GPU_CULLING_STAT_OCCLUDED];
+
+	const float		occlusionRate = (m_TestedCount > 0) ? static_cast<float>(m_OccludedCount) / static_cast<float>(m_TestedCount) : 0.f;
+	m_OcclusionRate += (occlusionRate - m_OcclusionRate) * GPU_PROFILER_SMOOTHING;
+
+	// inactive views keep zeroed planes and draw nothing
+	GpuCullingView	views[GPU_CULLING_VIEWS_COUNT] = { };
+
+	views[0] = MakeGpuView(cameraView, lodErrorPixels, GPU_CULLING_LIST_OPAQUE, true);
+	views[0].m_ViewProj = cameraViewProj;
+	views[0].m_LateDrawList = GPU_CULLING_LIST_OPAQUE_LATE;
+
+	for (uint32_t cascadeIndex = 0; cascadeIndex < cascadeViewsCount && cascadeIndex < SHADOWMAP_CASCADE_COUNT; ++cascadeIndex)
+		views[1 + cascadeIndex] = MakeGpuView(cascadeViews[cascadeIndex], shadowLodErrorPixels, GPU_CULLING_LIST_CASCADE + cascadeIndex, false);
+
+	frame.m_ViewBuffer.UpdateData(logicalDevice, views);
+
+	// the frame slot buffers are free once its fence was waited for, each change is copied once into every one of them
+	uint32_t		dirtyIndex = 0;
+	while (dirtyIndex < static_cast<uint32_t>(m_DirtySlots.size()))
+	{
+		DirtySlot	&dirtySlot = m_DirtySlots[dirtyIndex];
+		const uint32_t	slot = dirtySlot.m_Slot;
+
+		frame.m_ObjectBuffer.UpdateRange(logicalDevice, &m_Objects[slot], slot, 1);
+
+		// a free slot samples the fallback again before the registry can release the texture of its last mesh
+		uint64_t	&imageVersion = m_TextureVersions[frameIndex * GPU_CULLING_MAX_OBJECTS + slot];
+		if (m_Objects[slot].m_LodsCount == 0 && imageVersion != UINT64_MAX)
+		{
+			WriteTexture(logicalDevice, frameIndex, slot, m_FallbackImage);
+			imageVersion = UINT64_MAX;
+		}
+
+		if (--dirtySlot.m_FramesLeft > 0)
+		{
+			++dirtyIndex;
+			continue;
+		}
+
+		m_SlotDirtyIndices[slot] = UINT32_MAX;
+
+		m_DirtySlots[dirtyIndex] = m_DirtySlots.back();
+		m_DirtySlots.pop_back();
+
+		if (dirtyIndex < static_cast<uint32_t>(m_DirtySlots.size()))
+			m_SlotDirtyIndices[m_DirtySlots[dirtyIndex].m_Slot] = dirtyIndex;
+	}
+
+	uint32_t		submeshesIndex = 0;
+	while (submeshesIndex < static_cast<uint32_t>(m_DirtySubmeshes.size()))
+	{
+		DirtySubmeshes	&dirtySubmeshes = m_DirtySubmeshes[submeshesIndex];
+
+		frame.m_SubmeshBuffer.UpdateRange(logicalDevice, &m_Submeshes[dirtySubmeshes.m_Range.m_First], dirtySubmeshes.m_Range.m_First, dirtySubmeshes.m_Range.m_Count);
+
+		if (--dirtySubmeshes.m_FramesLeft > 0)
+		{
+			++submeshesIndex;
+			continue;
+		}
+
+		m_DirtySubmeshes[submeshesIndex] = m_DirtySubmeshes.back();
+		m_DirtySubmeshes.pop_back();
+	}
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::RecordCulling(const VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t phase, const VkExtent2D &pyramidExtent) const
+{
+	const FrameResources	&frame = m_Frames[frameIndex];
+
+	if (phase != GPU_CULLING_PHASE_LATE)
+	{
+		// the draws of the last use of the frame slot are done, its fence was waited for
+		vkCmdFillBuffer(commandBuffer, frame.m_CountBuffer.GetApiBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+		// and after the passes of the frames submitted before, which share the visibility flags
+		VkMemoryBarrier		clearBarrier = { };
+		{
+			clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+	}
+	else
+	{
+		// flags and counters of the early phase
+		VkMemoryBarrier		earlyBarrier = { };
+		{
+			earlyBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			earlyBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			earlyBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &earlyBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	if (m_SlotsCount > 0)
+	{
+		const GpuCullingPass	pass = { m_SlotsCount, phase, static_cast<float>(pyramidExtent.width), static_cast<float>(pyramidExtent.height) };
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipelineLayout, 0, 1, &frame.m_CullSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, m_CullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GpuCullingPass), &pass);
+
+		// one row of groups per view, the late phase only culls the camera
+		vkCmdDispatch(commandBuffer, (m_SlotsCount + GPU_CULLING_GROUP_SIZE - 1) / GPU_CULLING_GROUP_SIZE, (phase == GPU_CULLING_PHASE_LATE) ? 1 : GPU_CULLING_VIEWS_COUNT, 1);
+	}
+
+	VkMemoryBarrier			drawBarrier = { };
+	{
+		drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+
+	if (phase != GPU_CULLING_PHASE_LATE)
+		return;
+
+	// the counters are final, the CPU reads them when the frame slot comes back
+	const VkBufferCopy		statsCopy = { (GPU_CULLING_DRAW_LISTS_COUNT + GPU_CULLING_STAT_TESTED) * sizeof(uint32_t), 0, GPU_CULLING_STATS_COUNT * sizeof(uint32_t) };
+	vkCmdCopyBuffer(commandBuffer, frame.m_CountBuffer.GetApiBuffer(), frame.m_StatsBuffer.GetApiBuffer(), 1, &statsCopy);
+
+	VkMemoryBarrier			hostBarrier = { };
+	{
+		hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::DrawObjects(const VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t drawList, const uint32_t *dynamicOffsets) const
+{
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_DrawPipelineLayout, 0, 1, &m_Frames[frameIndex].m_DrawSet, 4, dynamicOffsets);
+	m_RenderHandle->GetGeometryPool()->BindBuffers(commandBuffer, false);
+
+	DrawList(commandBuffer, frameIndex, drawList);
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::DrawCascade(const VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t cascadeIndex, uint32_t cascadeOffset) const
+{
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ShadowPipelineLayout, 0, 1, &m_Frames[frameIndex].m_ShadowSet, 1, &cascadeOffset);
+	vkCmdPushConstants(commandBuffer, m_ShadowPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &cascadeIndex);
+	m_RenderHandle->GetGeometryPool()->BindBuffers(commandBuffer, true);
+
+	DrawList(commandBuffer, frameIndex, GPU_CULLING_LIST_CASCADE + cascadeIndex);
+}
+
+//----------------------------------------------------------------
+
+void	GpuCulling::DrawList(const VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t drawList) const
+{
+	const FrameResources	&frame = m_Frames[frameIndex];
+
+	// the firstInstance of every draw is its object, the shaders index the objects buffer with gl_InstanceIndex
+	vkCmdDrawIndexedIndirectCountKHR(	commandBuffer,
+										frame.m_DrawBuffer.GetApiBuffer(), drawList * GPU_CULLING_MAX_DRAWS * sizeof(VkDrawIndexedIndirectCommand),
+										frame.m_CountBuffer.GetApiBuffer(), drawList * sizeof(uint32_t),
+										GPU_CULLING_MAX_DRAWS, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
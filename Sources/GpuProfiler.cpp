@@ -0,0 +1,195 @@
+#include "GpuProfiler.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+GpuProfiler::GpuProfiler()
+:	m_LogicalDevice(nullptr),
+	m_Enabled(false),
+	m_TimestampPeriod(1.f),
+	m_TimestampMask(0),
+	m_Frames(std::vector<FrameQueries>()),
+	m_CurrentFrame(0),
+	m_Scopes(std::vector<GpuScope>()),
+	m_FrameTime(0.f)
+{
+
+}
+
+//----------------------------------------------------------------
+
+GpuProfiler::~GpuProfiler()
+{
+
+}
+
+//----------------------------------------------------------------
+
+bool	GpuProfiler::Prepare(const VkDevice logicalDevice, uint32_t pendingFrames, float timestampPeriod, uint32_t timestampValidBits)
+{
+	m_LogicalDevice = logicalDevice;
+
+	// the graphics queue can't write timestamps, keep the profiler silent
+	m_Enabled = timestampValidBits > 0;
+	if (!m_Enabled)
+		return true;
+
+	m_TimestampPeriod = timestampPeriod;
+	m_TimestampMask = (timestampValidBits >= 64) ? ~0ull : ((1ull << timestampValidBits) - 1);
+
+	VkQueryPoolCreateInfo	queryPoolCreateInfo = { };
+	{
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = GPU_PROFILER_MAX_SCOPES * 2;
+	}
+
+	m_Frames.resize(pendingFrames);
+
+	for (uint32_t frameIndex = 0; frameIndex < pendingFrames; ++frameIndex)
+	{
+		m_Frames[frameIndex].m_QueryPool = nullptr;
+		CHECK_API_SUCCESS(vkCreateQueryPool(m_LogicalDevice, &queryPoolCreateInfo, nullptr, &m_Frames[frameIndex].m_QueryPool)); // TODO: add error management
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	GpuProfiler::Shutdown()
+{
+	const uint32_t	framesCount = static_cast<uint32_t>(m_Frames.size());
+	for (uint32_t frameIndex = 0; frameIndex < framesCount; ++frameIndex)
+	{
+		if (m_Frames[frameIndex].m_QueryPool != nullptr)
+			vkDestroyQueryPool(m_LogicalDevice, m_Frames[frameIndex].m_QueryPool, nullptr);
+	}
+
+	m_Frames.clear();
+	m_Scopes.clear();
+
+	m_Enabled = false;
+}
+
+//----------------------------------------------------------------
+
+void	GpuProfiler::BeginFrame(const VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if (!m_Enabled)
+		return;
+
+	m_CurrentFrame = frameIndex;
+
+	FrameQueries	&frame = m_Frames[frameIndex];
+
+	const uint32_t	frameScopesCount = static_cast<uint32_t>(frame.m_Scopes.size());
+	if (frameScopesCount > 0)
+	{
+		// the frame has been waited on, no need to ask the driver to wait
+		std::vector<uint64_t>	timestamps(frameScopesCount * 2);
+
+		const VkResult			result = vkGetQueryPoolResults(	m_LogicalDevice, frame.m_QueryPool, 0, frameScopesCount * 2,
+																timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+																VK_QUERY_RESULT_64_BIT);
+
+		if (result == VK_SUCCESS)
+		{
+			// a scope can be recorded several times in a frame, its time is the sum of them
+			std::vector<float>	scopesTime(m_Scopes.size(), 0.f);
+
+			for (uint32_t frameScopeIndex = 0; frameScopeIndex < frameScopesCount; ++frameScopeIndex)
+			{
+				const uint64_t	ticks = (timestamps[frameScopeIndex * 2 + 1] - timestamps[frameScopeIndex * 2]) & m_TimestampMask;
+				scopesTime[frame.m_Scopes[frameScopeIndex]] += static_cast<float>(static_cast<double>(ticks) * m_TimestampPeriod * 1e-6);
+			}
+
+			m_FrameTime = 0.f;
+
+			const uint32_t	scopesCount = static_cast<uint32_t>(m_Scopes.size());
+			for (uint32_t scopeIndex = 0; scopeIndex < scopesCount; ++scopeIndex)
+			{
+				GpuScope	&scope = m_Scopes[scopeIndex];
+
+				scope.m_Time = scopesTime[scopeIndex];
+				scope.m_AverageTime = (scope.m_SamplesCount == 0) ? scope.m_Time : scope.m_AverageTime + (scope.m_Time - scope.m_AverageTime) * GPU_PROFILER_SMOOTHING;
+				++scope.m_SamplesCount;
+
+				m_FrameTime += scope.m_AverageTime;
+			}
+		}
+	}
+
+	frame.m_Scopes.clear();
+
+	vkCmdResetQueryPool(commandBuffer, frame.m_QueryPool, 0, GPU_PROFILER_MAX_SCOPES * 2);
+}
+
+//----------------------------------------------------------------
+
+uint32_t	GpuProfiler::BeginScope(const VkCommandBuffer commandBuffer, const char *name)
+{
+	if (!m_Enabled)
+		return UINT32_MAX;
+
+	FrameQueries	&frame = m_Frames[m_CurrentFrame];
+
+	if (frame.m_Scopes.size() >= GPU_PROFILER_MAX_SCOPES)
+		return UINT32_MAX;
+
+	const uint32_t	scopeId = static_cast<uint32_t>(frame.m_Scopes.size());
+	frame.m_Scopes.push_back(GetScopeIndex(name));
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.m_QueryPool, scopeId * 2);
+
+	return scopeId;
+}
+
+//----------------------------------------------------------------
+
+void	GpuProfiler::EndScope(const VkCommandBuffer commandBuffer, uint32_t scopeId)
+{
+	if (scopeId == UINT32_MAX)
+		return;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_Frames[m_CurrentFrame].m_QueryPool, scopeId * 2 + 1);
+}
+
+//----------------------------------------------------------------
+
+const GpuScope*	GpuProfiler::FindScope(const char *name) const
+{
+	const uint32_t	scopesCount = static_cast<uint32_t>(m_Scopes.size());
+	for (uint32_t scopeIndex = 0; scopeIndex < scopesCount; ++scopeIndex)
+	{
+		if (m_Scopes[scopeIndex].m_Name == name)
+			return &m_Scopes[scopeIndex];
+	}
+
+	return nullptr;
+}
+
+//----------------------------------------------------------------
+
+uint32_t	GpuProfiler::GetScopeIndex(const char *name)
+{
+	// few scopes, a linear search is enough
+	const uint32_t	scopesCount = static_cast<uint32_t>(m_Scopes.size());
+	for (uint32_t scopeIndex = 0; scopeIndex < scopesCount; ++scopeIndex)
+	{
+		if (m_Scopes[scopeIndex].m_Name == name)
+			return scopeIndex;
+	}
+
+	m_Scopes.push_back(GpuScope());
+	m_Scopes.back().m_Name = name;
+
+	return scopesCount;
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
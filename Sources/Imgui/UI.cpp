@@ -1,5 +1,9 @@
-#include "imgui/UI.h"
+#include "Imgui/UI.h"
+
+#include <algorithm>
+
 #include "Scene.h"
+#include "CpuProfiler.h"
 
 #include "Sphere.h"
 #include "Light.h"
@@ -15,6 +19,8 @@ UI::UI()
 :	m_CurrentObject(nullptr),
 	m_HierarchyVisible(true),
 	m_ObjectPanelVisible(false),
+	m_StatisticsVisible(true),
+	m_GpuProfilerVisible(true),
 	m_ObjectSelectedIndex(-1)
 {
 	IMGUI_CHECKVERSION();
@@ -50,21 +56,18 @@ bool	UI::Setup(const Window *window, const UIInitInfo &initInfo)
 		info.QueueFamily = initInfo.m_GraphicsQueueIndex;
 		info.DescriptorPool = initInfo.m_DescPool;
 		info.MinImageCount = (initInfo.m_DoubleBuffering) ? 2 : 1;
-		info.ImageCount = initInfo.m_PendingFrames;
+		info.ImageCount = std::max(initInfo.m_PendingFrames, info.MinImageCount); // ImGui keeps its buffers per image count
 		info.MSAASamples = initInfo.m_AALevel;
 	}
 
 	if (!ImGui_ImplVulkan_Init(&info, initInfo.m_RenderPass))
 		return false;
 
-	m_Meshes = {
-		new Mesh(initInfo.m_LogicalDevice, ENGINE_DATA_PATH"Models/ironman/ironman.fbx", "IronMan"),
-		new Mesh(initInfo.m_LogicalDevice, ENGINE_DATA_PATH"Models/Teapot/teapot.obj", "Teapot")
+	m_MeshAssets = {
+		{ "IronMan", ENGINE_DATA_PATH"Models/ironman/ironman.fbx", "", { 1.f, 1.f, 1.f } },
+		{ "Teapot", ENGINE_DATA_PATH"Models/Teapot/teapot.obj", ENGINE_DATA_PATH"Textures/Basic.jpg", { 0.1f, 0.1f, 0.1f } }
 	};
 
-	m_Meshes[1]->SetScale({ 0.1f, 0.1f, 0.1f });
-	m_Meshes[1]->SetMaterial(Material(ENGINE_DATA_PATH"Textures/Basic.jpg"));
-
 	return UploadFont(initInfo);
 }
 
@@ -72,12 +75,22 @@ bool	UI::Setup(const Window *window, const UIInitInfo &initInfo)
 
 void	UI::Render(VkCommandBuffer commandBuffer)
 {
+	PROFILE_ZONE("UI::Render");
+
 	ImGui_ImplVulkan_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
 	ImGui::NewFrame();
 
+	PickObject();
+
 	RenderHierarchyPanel();
 
+	if (m_StatisticsVisible)
+		RenderStatisticsPanel();
+
+	if (m_GpuProfilerVisible)
+		RenderGpuProfilerPanel();
+
 	ImGui::Render();
 	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
 }
@@ -117,6 +130,37 @@ bool	UI::UploadFont(const UIInitInfo &initInfo)
 
 //----------------------------------------------------------------
 
+void	UI::PickObject()
+{
+	ImGuiIO	&io = ImGui::GetIO();
+
+	if (io.WantCaptureMouse || !ImGui::IsMouseClicked(0) || io.DisplaySize.x <= 0.f || io.DisplaySize.y <= 0.f)
+		return;
+
+	// from the near to the far plane under the cursor, depth goes from 0 to 1
+	const Camera	*camera = m_CurrentScene->GetCamera();
+	const glm::mat4	invViewProj = glm::inverse(camera->GetProjection() * camera->GetView());
+	const glm::vec2	cursor = glm::vec2(io.MousePos.x / io.DisplaySize.x, io.MousePos.y / io.DisplaySize.y) * 2.f - 1.f;
+
+	const glm::vec4	nearPoint = invViewProj * glm::vec4(cursor, 0.f, 1.f);
+	const glm::vec4	farPoint = invViewProj * glm::vec4(cursor, 1.f, 1.f);
+	const glm::vec3	origin = glm::vec3(nearPoint) / nearPoint.w;
+
+	Object			*object = m_CurrentScene->PickObject(origin, glm::vec3(farPoint) / farPoint.w - origin);
+
+	if (object == nullptr)
+		return;
+
+	const std::vector<Object*>	&sceneObjects = m_CurrentScene->GetSceneObjects();
+
+	m_ObjectSelectedIndex = static_cast<int32_t>(std::find(sceneObjects.begin(), sceneObjects.end(), object) - sceneObjects.begin());
+	m_CurrentObject = object;
+
+	m_ObjectPanelVisible = true;
+}
+
+//----------------------------------------------------------------
+
 void	UI::RenderHierarchyPanel()
 {
 	ImGuiIO	&io = ImGui::GetIO();
@@ -157,12 +201,14 @@ void	UI::RenderHierarchyPanel()
 
 			if (ImGui::BeginMenu("Mesh"))
 			{
-				const uint32_t	meshesCount = static_cast<uint32_t>(m_Meshes.size());
-				for (uint32_t meshIndex = 0; meshIndex < meshesCount; ++meshIndex)
+				const uint32_t	meshAssetsCount = static_cast<uint32_t>(m_MeshAssets.size());
+				for (uint32_t meshAssetIndex = 0; meshAssetIndex < meshAssetsCount; ++meshAssetIndex)
 				{
-					Mesh	*mesh = m_Meshes[meshIndex];
-					if (ImGui::MenuItem(mesh->GetName().c_str()))
-						m_CurrentScene->AddMesh(m_LogicalDevice, mesh);
+					const UIMeshAsset	&meshAsset = m_MeshAssets[meshAssetIndex];
+
+					// a new instance each time, added by the asset loader once imported
+					if (ImGui::MenuItem(meshAsset.m_Name))
+						Device::m_Device->GetAssetLoader()->Spawn(m_CurrentScene->LoadMesh(m_LogicalDevice, meshAsset.m_Path, meshAsset.m_Name, meshAsset.m_TexturePath, glm::vec3(0.f), meshAsset.m_Scale));
 				}
 
 				ImGui::EndMenu();
@@ -270,21 +316,24 @@ void	UI::RenderObjectPanel(Object *object)
 
 	ImGui::Text("Object");
 
+	// the setters flag the object for the scene, only edited values are written back
 	glm::vec3	pos = object->GetPosition();
-	ImGui::InputFloat3("Position", glm::value_ptr(pos), "%.4f", ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_AutoSelectAll);
-	object->SetPosition(pos);
+	if (ImGui::InputFloat3("Position", glm::value_ptr(pos), "%.4f", ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_AutoSelectAll))
+		object->SetPosition(pos);
 
 	glm::vec3	rot = object->GetEulerAngles();
-	ImGui::InputFloat3("Rotation", glm::value_ptr(rot), "%.4f", ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_AutoSelectAll);
-	glm::quat	rotX = glm::angleAxis(rot.x * (3.14159265359f / 180.f), glm::vec3(1.f, 0.f, 0.f));
-	glm::quat	rotY = glm::angleAxis(rot.y * (3.14159265359f / 180.f), glm::vec3(0.f, 1.f, 0.f));
-	glm::quat	rotZ = glm::angleAxis(rot.z * (3.14159265359f / 180.f), glm::vec3(0.f, 0.f, 1.f));
-	object->SetRotation(rotX * rotY * rotZ);
-	object->SetEulerAngles(rot);
+	if (ImGui::InputFloat3("Rotation", glm::value_ptr(rot), "%.4f", ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_AutoSelectAll))
+	{
+		glm::quat	rotX = glm::angleAxis(rot.x * (3.14159265359f / 180.f), glm::vec3(1.f, 0.f, 0.f));
+		glm::quat	rotY = glm::angleAxis(rot.y * (3.14159265359f / 180.f), glm::vec3(0.f, 1.f, 0.f));
+		glm::quat	rotZ = glm::angleAxis(rot.z * (3.14159265359f / 180.f), glm::vec3(0.f, 0.f, 1.f));
+		object->SetRotation(rotX * rotY * rotZ);
+		object->SetEulerAngles(rot);
+	}
 
 	glm::vec3	scale = object->GetScale();
-	ImGui::InputFloat3("Scale", glm::value_ptr(scale), "%.4f", ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_AutoSelectAll);
-	object->SetScale(scale);
+	if (ImGui::InputFloat3("Scale", glm::value_ptr(scale), "%.4f", ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_AutoSelectAll))
+		object->SetScale(scale);
 
 	if (object->GetType() == OBJECT_TYPE::Mesh)
 	{
@@ -327,6 +376,127 @@ void	UI::RenderCascadeShadowPanel()
 
 //----------------------------------------------------------------
 
+void	UI::RenderStatisticsPanel()
+{
+	ImGui::SetNextWindowSize({ 250.f, 460.f });
+	ImGui::SetNextWindowPos({ 0.f, 480.f });
+	ImGui::Begin("Statistics", &m_StatisticsVisible);
+
+	const Device		*device = Device::m_Device.get();
+	const FrameMetrics	&metrics = device->GetFrameMetrics();
+
+	ImGui::Text("Frame: %.3f ms", device->GetDeltaTime() * 1000.f);
+	ImGui::Text("Record: %.3f ms", m_CurrentScene->GetRecordTime());
+	ImGui::Text("CPU wait: %.3f ms", metrics.m_CpuWaitTime);
+	ImGui::Text("Input to present submit: %.3f ms", metrics.m_InputToPresentSubmitTime);
+	ImGui::Text("Pending loads: %u", device->GetAssetLoader()->GetPendingTasksCount());
+	ImGui::Text("Shared textures: %u", device->GetTextureRegistry()->GetTexturesCount());
+
+	const char			*presentMode = "FIFO";
+	if (device->GetPresentMode() == VK_PRESENT_MODE_MAILBOX_KHR)
+		presentMode = "Mailbox";
+	else if (device->GetPresentMode() == VK_PRESENT_MODE_IMMEDIATE_KHR)
+		presentMode = "Immediate";
+
+	ImGui::Text("Present: %s%s", presentMode, device->GetSettings().m_LowLatency ? " (low latency)" : "");
+	ImGui::Text("Pacing: %s", device->UsesTimelineSemaphore() ? "timeline semaphore" : "fences");
+
+	const MemoryStatistics	memoryStatistics = device->GetMemoryAllocator()->GetStatistics();
+	const float				megabyte = 1024.f * 1024.f;
+
+	ImGui::Text("GPU memory: %.1f / %.1f MB", memoryStatistics.m_UsedSize / megabyte, memoryStatistics.m_ReservedSize / megabyte);
+	ImGui::Text("Allocations: %u (%u blocks, %u dedicated)", memoryStatistics.m_AllocationsCount, memoryStatistics.m_BlocksCount, memoryStatistics.m_DedicatedCount);
+	ImGui::Text("Fragmentation: %.1f%% ext, %.1f%% int", memoryStatistics.GetExternalFragmentation() * 100.f, memoryStatistics.GetInternalFragmentation() * 100.f);
+
+	// requested above resident means the budget is too small for the current views
+	const TextureStreamingStatistics	streamingStatistics = device->GetTextureRegistry()->GetStreamingStatistics();
+
+	if (streamingStatistics.m_BudgetSize > 0)
+	{
+		ImGui::Text("Streamed: %.1f / %.1f MB (%u textures)", streamingStatistics.m_ResidentSize / megabyte, streamingStatistics.m_BudgetSize / megabyte, streamingStatistics.m_StreamedCount);
+		ImGui::Text("Requested: %.1f MB", streamingStatistics.m_RequestedSize / megabyte);
+		ImGui::Text("Mips: %llu uploaded, %llu evicted", static_cast<unsigned long long>(streamingStatistics.m_UploadedLevelsCount), static_cast<unsigned long long>(streamingStatistics.m_EvictedLevelsCount));
+	}
+	else
+		ImGui::Text("Streaming: off");
+
+	ImGui::Text("Visible meshes: %u / %u (%s culling)", m_CurrentScene->GetVisibleMeshesCount(), m_CurrentScene->GetMeshesCount(), FrustumCulling::GetKernelName());
+
+	// their visibility is only known by the GPU, they are left out of the counts of the CPU path
+	if (Device::m_Device->UsesGpuCulling())
+		ImGui::Text("GPU culled meshes: %u", m_CurrentScene->GetGpuCulledMeshesCount());
+
+	// counters of a frame back, the rate is smoothed
+	if (m_CurrentScene->UsesOcclusionCulling())
+	{
+		const GpuCulling	*gpuCulling = m_CurrentScene->GetGpuCulling();
+		ImGui::Text("Occlusion culled: %.1f%% (%u / %u meshes)", gpuCulling->GetOcclusionRate() * 100.f, gpuCulling->GetOccludedCount(), gpuCulling->GetTestedCount());
+	}
+
+	const DynamicBvh	&objectsBvh = m_CurrentScene->GetObjectsBvh();
+	ImGui::Text("Objects tree: cost %.1f, %u rebuilds", objectsBvh.GetCost(), objectsBvh.GetRebuildsCount());
+
+	const uint32_t	meshesCount = m_CurrentScene->GetMeshesCount();
+	const uint32_t	cascadeCastersCount = m_CurrentScene->GetCascadeCastersCount();
+	ImGui::Text("Cascade casters: %u (%.2f per mesh)", cascadeCastersCount, (meshesCount > 0) ? static_cast<float>(cascadeCastersCount) / meshesCount : 0.f);
+
+	float	cullingMinPixels = m_CurrentScene->GetCullingMinPixels();
+	ImGui::SliderFloat("Min size", &cullingMinPixels, 0.f, 16.f, "%.1f px");
+	m_CurrentScene->SetCullingMinPixels(cullingMinPixels);
+
+	// meshes levels of detail, the errors are in pixels of the camera view and in texels of the shadow maps
+	ImGui::Text("Triangles: %u objects, %u shadows", m_CurrentScene->GetObjectsTrianglesCount(), m_CurrentScene->GetShadowTrianglesCount());
+
+	float	lodErrorPixels = m_CurrentScene->GetLodErrorPixels();
+	ImGui::SliderFloat("LOD error", &lodErrorPixels, 0.f, 16.f, "%.1f px");
+	m_CurrentScene->SetLodErrorPixels(lodErrorPixels);
+
+	float	shadowLodErrorPixels = m_CurrentScene->GetShadowLodErrorPixels();
+	ImGui::SliderFloat("Shadow LOD error", &shadowLodErrorPixels, 0.f, 16.f, "%.1f px");
+	m_CurrentScene->SetShadowLodErrorPixels(shadowLodErrorPixels);
+
+	// 1 thread records inline in the primary command buffer
+	int32_t	recordThreadsCount = static_cast<int32_t>(m_CurrentScene->GetRecordThreadsCount());
+	ImGui::SliderInt("Threads", &recordThreadsCount, 1, static_cast<int32_t>(m_CurrentScene->GetMaxRecordThreadsCount()));
+	m_CurrentScene->SetRecordThreadsCount(static_cast<uint32_t>(recordThreadsCount));
+
+	ImGui::End();
+}
+
+//----------------------------------------------------------------
+
+void	UI::RenderGpuProfilerPanel()
+{
+	ImGui::SetNextWindowSize({ 250.f, 260.f });
+	ImGui::SetNextWindowPos({ 150.f, 0.f });
+	ImGui::Begin("GPU Profiler", &m_GpuProfilerVisible);
+
+	const GpuProfiler	*profiler = Device::m_Device->GetGpuProfiler();
+
+	if (!profiler->IsEnabled())
+	{
+		ImGui::Text("Timestamps not supported");
+		ImGui::End();
+		return;
+	}
+
+	// averages first, the last frame is noisy
+	ImGui::Text("GPU total: %.3f ms", profiler->GetFrameTime());
+	ImGui::Separator();
+
+	const std::vector<GpuScope>	&scopes = profiler->GetScopes();
+	const uint32_t				scopesCount = static_cast<uint32_t>(scopes.size());
+	for (uint32_t scopeIndex = 0; scopeIndex < scopesCount; ++scopeIndex)
+	{
+		const GpuScope	&scope = scopes[scopeIndex];
+		ImGui::Text("%s: %.3f ms (%.3f)", scope.m_Name.c_str(), scope.m_AverageTime, scope.m_Time);
+	}
+
+	ImGui::End();
+}
+
+//----------------------------------------------------------------
+
 void	UI::MeshObjectPanel(Object *object)
 {
 	ImGui::Text("Material");
@@ -335,27 +505,46 @@ void	UI::MeshObjectPanel(Object *object)
 
 	if (mesh != nullptr)
 	{
-		Material	&material = mesh->GetMaterial();
+		// edited on a copy, the mesh is flagged for the scene when it is set back
+		Material	material = mesh->GetMaterial();
+		bool		materialChanged = false;
 
 		glm::vec4	albedo = material.GetAlbedo();
-		ImGui::ColorEdit4("Color", glm::value_ptr(albedo), ImGuiColorEditFlags_AlphaBar | ImGuiColorEditFlags_InputRGB);
-		material.SetAlbedo(albedo);
+		if (ImGui::ColorEdit4("Color", glm::value_ptr(albedo), ImGuiColorEditFlags_AlphaBar | ImGuiColorEditFlags_InputRGB))
+		{
+			material.SetAlbedo(albedo);
+			materialChanged = true;
+		}
 
 		float		roughness = material.GetRoughness();
-		ImGui::SliderFloat("Roughness", &roughness, 0.f, 1.f, "%.4f");
-		material.SetRoughness(roughness);
+		if (ImGui::SliderFloat("Roughness", &roughness, 0.f, 1.f, "%.4f"))
+		{
+			material.SetRoughness(roughness);
+			materialChanged = true;
+		}
 
 		float		metallic = material.GetMetallic();
-		ImGui::SliderFloat("Metallic", &metallic, 0.f, 1.f, "%.4f");
-		material.SetMetallic(metallic);
+		if (ImGui::SliderFloat("Metallic", &metallic, 0.f, 1.f, "%.4f"))
+		{
+			material.SetMetallic(metallic);
+			materialChanged = true;
+		}
 
 		float		reflectance = material.GetReflectance();
-		ImGui::SliderFloat("Reflectance", &reflectance, 0.f, 1.f, "%.4f");
-		material.SetReflectance(reflectance);
+		if (ImGui::SliderFloat("Reflectance", &reflectance, 0.f, 1.f, "%.4f"))
+		{
+			material.SetReflectance(reflectance);
+			materialChanged = true;
+		}
+
+		if (materialChanged)
+			mesh->SetMaterial(material);
 
 		float		lodBias = mesh->GetLodBias();
-		ImGui::SliderFloat("Lod Bias", &lodBias, 0.f, 5.f, "%.3f");
-		mesh->SetLodBias(lodBias);
+		if (ImGui::SliderFloat("Texture Lod Bias", &lodBias, 0.f, 5.f, "%.3f"))
+			mesh->SetLodBias(lodBias);
+
+		ImGui::Text("Levels of detail: %u", static_cast<uint32_t>(mesh->GetLods().size()));
 	}
 }
 //----------------------------------------------------------------
@@ -381,8 +570,8 @@ void	UI::LightObjectPanel(Object *object)
 		case OBJECT_TYPE::PointLight:
 		{
 			float	radius = light->GetRadius();
-			ImGui::InputFloat("Radius", &radius, 0.f, 0.f, "%.4f", ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_AutoSelectAll);
-			light->SetRadius(radius);
+			if (ImGui::InputFloat("Radius", &radius, 0.f, 0.f, "%.4f", ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_AutoSelectAll))
+				light->SetRadius(radius);
 
 			float	attenuation = light->GetAttenuation();
 			ImGui::SliderFloat("Attenuation", &attenuation, 0.f, 1.f, "%.4f");
@@ -392,8 +581,8 @@ void	UI::LightObjectPanel(Object *object)
 		case OBJECT_TYPE::SpotLight:
 		{
 			float	radius = light->GetRadius();
-			ImGui::InputFloat("Radius", &radius, 0.f, 0.f, "%.4f", ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_AutoSelectAll);
-			light->SetRadius(radius);
+			if (ImGui::InputFloat("Radius", &radius, 0.f, 0.f, "%.4f", ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_AutoSelectAll))
+				light->SetRadius(radius);
 
 			float	attenuation = light->GetAttenuation();
 			ImGui::SliderFloat("Attenuation", &attenuation, 0.f, 1.f, "%.4f");
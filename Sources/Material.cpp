@@ -13,21 +13,11 @@ Material::Material()
 
 //----------------------------------------------------------------
 
-Material::Material(const std::string &texturePath)
+Material::Material(const TextureHandle &texture, const TextureHandle &normalTexture)
+:	m_Texture(texture),
+	m_NormalTexture(normalTexture)
 {
 	m_Data = MaterialData();
-
-	m_Texture = Texture(texturePath, 4);
-}
-
-//----------------------------------------------------------------
-
-Material::Material(const std::string &texturePath, const std::string &normalPath)
-{
-	m_Data = MaterialData();
-
-	m_Texture = Texture(texturePath, 4);
-	m_NormalTexture = Texture(normalPath, 4);
 }
 
 //----------------------------------------------------------------
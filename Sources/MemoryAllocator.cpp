@@ -0,0 +1,422 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+MemoryBlock::MemoryBlock(uint32_t poolIndex)
+:	m_Memory(nullptr),
+	m_MappedData(nullptr),
+	m_PoolIndex(poolIndex),
+	m_AllocatedSize(0),
+	m_FreeLists(std::vector<std::set<VkDeviceSize>>())
+{
+
+}
+
+//----------------------------------------------------------------
+
+MemoryBlock::~MemoryBlock()
+{
+
+}
+
+//----------------------------------------------------------------
+
+bool	MemoryBlock::Create(const VkDevice logicalDevice, uint32_t memoryTypeIndex, bool mapped)
+{
+	VkMemoryAllocateInfo	memAllocInfo = { };
+	{
+		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAllocInfo.allocationSize = MEMORY_BLOCK_SIZE;
+		memAllocInfo.memoryTypeIndex = memoryTypeIndex;
+	}
+
+	if (vkAllocateMemory(logicalDevice, &memAllocInfo, nullptr, &m_Memory) != VK_SUCCESS)
+		return false;
+
+	if (mapped)
+		CHECK_API_SUCCESS(vkMapMemory(logicalDevice, m_Memory, 0, VK_WHOLE_SIZE, 0, &m_MappedData));
+
+	// the whole block is free at the highest order
+	const uint32_t			maxOrder = GetOrder(MEMORY_BLOCK_SIZE);
+
+	m_FreeLists.resize(maxOrder + 1);
+	m_FreeLists[maxOrder].insert(0);
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	MemoryBlock::Destroy(const VkDevice logicalDevice)
+{
+	// freeing the memory unmaps it
+	if (m_Memory != nullptr)
+		vkFreeMemory(logicalDevice, m_Memory, nullptr);
+
+	m_Memory = nullptr;
+	m_MappedData = nullptr;
+
+	m_FreeLists.clear();
+}
+
+//----------------------------------------------------------------
+
+bool	MemoryBlock::Allocate(VkDeviceSize size, VkDeviceSize &outOffset, VkDeviceSize &outSize)
+{
+	const uint32_t	order = GetOrder(size);
+	const uint32_t	ordersCount = static_cast<uint32_t>(m_FreeLists.size());
+
+	// smallest free buddy big enough
+	uint32_t		freeOrder = order;
+	while (freeOrder < ordersCount && m_FreeLists[freeOrder].empty())
+		++freeOrder;
+
+	if (freeOrder >= ordersCount)
+		return false;
+
+	const VkDeviceSize	offset = *m_FreeLists[freeOrder].begin();
+	m_FreeLists[freeOrder].erase(m_FreeLists[freeOrder].begin());
+
+	// split it down, upper halves go back to the free lists
+	while (freeOrder > order)
+	{
+		--freeOrder;
+		m_FreeLists[freeOrder].insert(offset + (MEMORY_MIN_ALLOCATION_SIZE << freeOrder));
+	}
+
+	outOffset = offset;
+	outSize = MEMORY_MIN_ALLOCATION_SIZE << order;
+
+	m_AllocatedSize += outSize;
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	MemoryBlock::Free(VkDeviceSize offset, VkDeviceSize size)
+{
+	uint32_t		order = GetOrder(size);
+	const uint32_t	maxOrder = static_cast<uint32_t>(m_FreeLists.size()) - 1;
+
+	m_AllocatedSize -= MEMORY_MIN_ALLOCATION_SIZE << order;
+
+	// merge with the buddy as long as it is free
+	while (order < maxOrder)
+	{
+		const VkDeviceSize						buddyOffset = offset ^ (MEMORY_MIN_ALLOCATION_SIZE << order);
+		std::set<VkDeviceSize>::iterator		buddyFound = m_FreeLists[order].find(buddyOffset);
+
+		if (buddyFound == m_FreeLists[order].end())
+			break;
+
+		m_FreeLists[order].erase(buddyFound);
+
+		offset = std::min(offset, buddyOffset);
+		++order;
+	}
+
+	m_FreeLists[order].insert(offset);
+}
+
+//----------------------------------------------------------------
+
+VkDeviceSize	MemoryBlock::GetLargestFreeSize() const
+{
+	for (uint32_t order = static_cast<uint32_t>(m_FreeLists.size()); order > 0; --order)
+	{
+		if (!m_FreeLists[order - 1].empty())
+			return MEMORY_MIN_ALLOCATION_SIZE << (order - 1);
+	}
+
+	return 0;
+}
+
+//----------------------------------------------------------------
+
+uint32_t	MemoryBlock::GetOrder(VkDeviceSize size) const
+{
+	uint32_t	order = 0;
+	while ((MEMORY_MIN_ALLOCATION_SIZE << order) < size)
+		++order;
+
+	return order;
+}
+
+//----------------------------------------------------------------
+
+MemoryAllocator::MemoryAllocator()
+:	m_LogicalDevice(nullptr),
+	m_Pools(std::vector<std::vector<MemoryBlock*>>()),
+	m_DedicatedCount(0),
+	m_DedicatedSize(0),
+	m_SubAllocationsCount(0),
+	m_UsedSize(0)
+{
+
+}
+
+//----------------------------------------------------------------
+
+MemoryAllocator::~MemoryAllocator()
+{
+
+}
+
+//----------------------------------------------------------------
+
+bool	MemoryAllocator::Setup(const VkDevice logicalDevice, const VkPhysicalDeviceMemoryProperties &memoryProperties)
+{
+	m_LogicalDevice = logicalDevice;
+	m_MemoryProperties = memoryProperties;
+
+	// linear and optimal pool for each memory type
+	m_Pools.resize(m_MemoryProperties.memoryTypeCount * 2);
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	MemoryAllocator::Shutdown()
+{
+	std::lock_guard<std::mutex>	lock(m_Lock);
+
+	const uint32_t	poolsCount = static_cast<uint32_t>(m_Pools.size());
+	for (uint32_t poolIndex = 0; poolIndex < poolsCount; ++poolIndex)
+	{
+		const uint32_t	blocksCount = static_cast<uint32_t>(m_Pools[poolIndex].size());
+		for (uint32_t blockIndex = 0; blockIndex < blocksCount; ++blockIndex)
+		{
+			m_Pools[poolIndex][blockIndex]->Destroy(m_LogicalDevice);
+			delete m_Pools[poolIndex][blockIndex];
+		}
+	}
+
+	m_Pools.clear();
+}
+
+//----------------------------------------------------------------
+
+bool	MemoryAllocator::Allocate(	const VkMemoryRequirements &memoryRequirements,
+									VkMemoryPropertyFlags memoryType,
+									bool linearResource,
+									bool dedicated,
+									MemoryAllocation &outAllocation)
+{
+	std::lock_guard<std::mutex>	lock(m_Lock);
+
+	outAllocation = MemoryAllocation();
+	outAllocation.m_RequestedSize = memoryRequirements.size;
+
+	// render targets and big resources keep their own memory
+	const bool		ownMemory = dedicated || memoryRequirements.size > MEMORY_DEDICATED_THRESHOLD;
+
+	// the first matching type is the preferred one, when its heap is full the other types with the same properties are tried
+	uint32_t		typeFilter = memoryRequirements.memoryTypeBits;
+	uint32_t		memoryTypeIndex = 0;
+	while (FindMemoryType(typeFilter, memoryType, memoryTypeIndex))
+	{
+		if (ownMemory ? AllocateDedicated(memoryRequirements.size, memoryTypeIndex, outAllocation) : AllocateFromPool(memoryRequirements, memoryTypeIndex, linearResource, outAllocation))
+			return true;
+
+		typeFilter &= ~(1u << memoryTypeIndex);
+	}
+
+	// no room left for a new block, the request alone may still fit
+	if (!ownMemory)
+	{
+		typeFilter = memoryRequirements.memoryTypeBits;
+		while (FindMemoryType(typeFilter, memoryType, memoryTypeIndex))
+		{
+			if (AllocateDedicated(memoryRequirements.size, memoryTypeIndex, outAllocation))
+				return true;
+
+			typeFilter &= ~(1u << memoryTypeIndex);
+		}
+	}
+
+	std::cout << "Failed to allocate " << memoryRequirements.size << " bytes of memory with properties " << memoryType << std::endl; // TODO: change this for real logger
+
+	return false;
+}
+
+//----------------------------------------------------------------
+
+bool	MemoryAllocator::AllocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, MemoryAllocation &outAllocation)
+{
+	VkMemoryAllocateInfo	memAllocInfo = { };
+	{
+		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAllocInfo.allocationSize = size;
+		memAllocInfo.memoryTypeIndex = memoryTypeIndex;
+	}
+
+	if (vkAllocateMemory(m_LogicalDevice, &memAllocInfo, nullptr, &outAllocation.m_Memory) != VK_SUCCESS)
+	{
+		outAllocation.m_Memory = nullptr;
+		return false;
+	}
+
+	if ((m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
+		CHECK_API_SUCCESS(vkMapMemory(m_LogicalDevice, outAllocation.m_Memory, 0, VK_WHOLE_SIZE, 0, &outAllocation.m_MappedData));
+
+	outAllocation.m_Size = size;
+
+	++m_DedicatedCount;
+	m_DedicatedSize += outAllocation.m_Size;
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	MemoryAllocator::AllocateFromPool(const VkMemoryRequirements &memoryRequirements, uint32_t memoryTypeIndex, bool linearResource, MemoryAllocation &outAllocation)
+{
+	const bool					mapped = (m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+
+	// buddies are aligned on their size
+	const VkDeviceSize			size = std::max(memoryRequirements.size, memoryRequirements.alignment);
+
+	const uint32_t				poolIndex = memoryTypeIndex * 2 + ((linearResource) ? 0 : 1);
+	std::vector<MemoryBlock*>	&pool = m_Pools[poolIndex];
+
+	MemoryBlock					*block = nullptr;
+	VkDeviceSize				offset = 0;
+	VkDeviceSize				allocatedSize = 0;
+
+	const uint32_t				blocksCount = static_cast<uint32_t>(pool.size());
+	for (uint32_t blockIndex = 0; blockIndex < blocksCount; ++blockIndex)
+	{
+		if (pool[blockIndex]->Allocate(size, offset, allocatedSize))
+		{
+			block = pool[blockIndex];
+			break;
+		}
+	}
+
+	if (block == nullptr)
+	{
+		block = new MemoryBlock(poolIndex);
+		if (!block->Create(m_LogicalDevice, memoryTypeIndex, mapped))
+		{
+			delete block;
+			return false;
+		}
+
+		pool.push_back(block);
+		block->Allocate(size, offset, allocatedSize);
+	}
+
+	outAllocation.m_Memory = block->GetMemory();
+	outAllocation.m_Offset = offset;
+	outAllocation.m_Size = allocatedSize;
+	outAllocation.m_Block = block;
+
+	if (mapped)
+		outAllocation.m_MappedData = static_cast<char*>(block->GetMappedData()) + offset;
+
+	++m_SubAllocationsCount;
+	m_UsedSize += outAllocation.m_RequestedSize;
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	MemoryAllocator::Free(MemoryAllocation &allocation)
+{
+	if (allocation.m_Memory == nullptr)
+		return;
+
+	std::lock_guard<std::mutex>	lock(m_Lock);
+
+	MemoryBlock		*block = allocation.m_Block;
+
+	if (block == nullptr)
+	{
+		vkFreeMemory(m_LogicalDevice, allocation.m_Memory, nullptr);
+
+		--m_DedicatedCount;
+		m_DedicatedSize -= allocation.m_Size;
+	}
+	else
+	{
+		block->Free(allocation.m_Offset, allocation.m_Size);
+
+		--m_SubAllocationsCount;
+		m_UsedSize -= allocation.m_RequestedSize;
+
+		// keep a single block alive per pool to avoid reallocating on load/unload cycles
+		std::vector<MemoryBlock*>	&pool = m_Pools[block->GetPoolIndex()];
+		if (block->IsEmpty() && pool.size() > 1)
+		{
+			pool.erase(std::find(pool.begin(), pool.end(), block));
+
+			block->Destroy(m_LogicalDevice);
+			delete block;
+		}
+	}
+
+	allocation = MemoryAllocation();
+}
+
+//----------------------------------------------------------------
+
+MemoryStatistics	MemoryAllocator::GetStatistics() const
+{
+	std::lock_guard<std::mutex>	lock(m_Lock);
+
+	MemoryStatistics	statistics;
+
+	const uint32_t		poolsCount = static_cast<uint32_t>(m_Pools.size());
+	for (uint32_t poolIndex = 0; poolIndex < poolsCount; ++poolIndex)
+	{
+		const uint32_t	blocksCount = static_cast<uint32_t>(m_Pools[poolIndex].size());
+		for (uint32_t blockIndex = 0; blockIndex < blocksCount; ++blockIndex)
+		{
+			const MemoryBlock	*block = m_Pools[poolIndex][blockIndex];
+
+			++statistics.m_BlocksCount;
+			statistics.m_ReservedSize += MEMORY_BLOCK_SIZE;
+			statistics.m_AllocatedSize += block->GetAllocatedSize();
+			statistics.m_FreeSize += MEMORY_BLOCK_SIZE - block->GetAllocatedSize();
+			statistics.m_LargestFreeSize = std::max(statistics.m_LargestFreeSize, block->GetLargestFreeSize());
+		}
+	}
+
+	statistics.m_DedicatedCount = m_DedicatedCount;
+	statistics.m_AllocationsCount = m_SubAllocationsCount + m_DedicatedCount;
+
+	statistics.m_ReservedSize += m_DedicatedSize;
+	statistics.m_AllocatedSize += m_DedicatedSize;
+	statistics.m_UsedSize = m_UsedSize + m_DedicatedSize;
+
+	return statistics;
+}
+
+//----------------------------------------------------------------
+
+bool	MemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t &outTypeIndex) const
+{
+	for (uint32_t typeIndex = 0; typeIndex < m_MemoryProperties.memoryTypeCount; ++typeIndex)
+	{
+		if ((typeFilter & (1 << typeIndex)) && (m_MemoryProperties.memoryTypes[typeIndex].propertyFlags & properties) == properties)
+		{
+			outTypeIndex = typeIndex;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
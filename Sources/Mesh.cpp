@@ -1,6 +1,11 @@
 #include "Mesh.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "CpuProfiler.h"
 #include "Tools/LoaderFbx.h"
+#include "Tools/MeshOptimizer.h"
 
 //----------------------------------------------------------------
 
@@ -9,90 +14,581 @@ LIGHTLYY_BEGIN
 //----------------------------------------------------------------
 
 Mesh::Mesh(const VkDevice logicalDevice, const std::string &path, const std::string &name)
+:	Mesh(path, name)
+{
+	if (m_Path != "")
+	{
+		MeshSource	source;
+
+		if (!LoadSource(source) || !CreateFromSource(logicalDevice, source))
+			std::cout << "Can't load mesh " << m_Path << std::endl; // TODO: change this for real logger
+	}
+}
+
+//----------------------------------------------------------------
+
+Mesh::Mesh(const std::string &path, const std::string &name)
 :	Object(name),
-	m_Path(path)
+	m_Path(path),
+	m_IndexType(VK_INDEX_TYPE_UINT16),
+	m_BoundsMin(glm::vec3(0.f)),
+	m_BoundsMax(glm::vec3(0.f)),
+	m_BoundsRadius(0.f),
+	m_LodBias(0.f),
+	m_VertexLayout(Device::m_Device->GetSettings().m_VertexLayout),
+	m_Dequantization(glm::mat4(1.f)),
+	m_BuffersDevice(nullptr)
 {
 	m_IsOpaque = true;
+}
 
-	if (m_Path != "")
+//----------------------------------------------------------------
+
+Mesh::~Mesh()
+{
+	m_Indices.clear();
+
+	// reused once no frame in flight draws from it
+	if (m_GeometryRange.IsValid())
+		Device::m_Device->GetGeometryPool()->Free(m_GeometryRange);
+
+	// the scene deletes meshes once no frame in flight draws them
+	DestroyBuffers();
+}
+
+//----------------------------------------------------------------
+
+Task<bool>	Mesh::LoadAsync(AssetLoader &loader, const VkDevice logicalDevice)
+{
+	co_await loader.ToWorker();
+
+	// lives in the coroutine frame, the cache stays mapped until the upload copied it
+	MeshSource	source;
+	const bool	isLoaded = LoadSource(source);
+
+	co_await loader.ToRenderThread();
+
+	co_return isLoaded && CreateFromSource(logicalDevice, source);
+}
+
+//----------------------------------------------------------------
+
+void	Mesh::Render(const VkCommandBuffer commandBuffer, uint32_t isOpaque, uint32_t lodIndex)
+{
+	if (static_cast<uint32_t>(m_Material.GetAlbedo().a) == isOpaque)
+	{
+		if (m_GeometryRange.IsValid())
+			Device::m_Device->GetGeometryPool()->BindBuffers(commandBuffer, false);
+		else
+		{
+			const VkDeviceSize	offsets[2] = { 0, 0 };
+			const VkBuffer		vertexBuffers[2] = { m_PositionBuffer.GetApiBuffer(), m_AttributeBuffer.GetApiBuffer() };
+
+			vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer.GetApiBuffer(), 0, m_IndexType);
+		}
+
+		// one bound buffer, submesh indices are offset by their base vertex, the range is empty outside of the pool
+		const MeshLod	&lod = m_Lods[lodIndex];
+		for (uint32_t submeshIndex = lod.m_FirstSubmesh; submeshIndex < lod.m_FirstSubmesh + lod.m_SubmeshesCount; ++submeshIndex)
+		{
+			const Submesh	&submesh = m_Submeshes[submeshIndex];
+			vkCmdDrawIndexed(commandBuffer, submesh.m_IndicesCount, 1, m_GeometryRange.m_FirstIndex + submesh.m_FirstIndex, m_GeometryRange.m_FirstVertex + submesh.m_VertexOffset, 0);
+		}
+	}
+}
+
+//----------------------------------------------------------------
+
+void	Mesh::RenderDepth(const VkCommandBuffer commandBuffer, uint32_t lodIndex)
+{
+	if (m_GeometryRange.IsValid())
+		Device::m_Device->GetGeometryPool()->BindBuffers(commandBuffer, true);
+	else
+	{
+		const VkDeviceSize	offsets = 0;
+		const VkBuffer		positionBuffer = m_PositionBuffer.GetApiBuffer();
+
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &positionBuffer, &offsets);
+		vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer.GetApiBuffer(), 0, m_IndexType);
+	}
+
+	const MeshLod	&lod = m_Lods[lodIndex];
+	for (uint32_t submeshIndex = lod.m_FirstSubmesh; submeshIndex < lod.m_FirstSubmesh + lod.m_SubmeshesCount; ++submeshIndex)
+	{
+		const Submesh	&submesh = m_Submeshes[submeshIndex];
+		vkCmdDrawIndexed(commandBuffer, submesh.m_IndicesCount, 1, m_GeometryRange.m_FirstIndex + submesh.m_FirstIndex, m_GeometryRange.m_FirstVertex + submesh.m_VertexOffset, 0);
+	}
+}
+
+//----------------------------------------------------------------
+
+uint32_t	Mesh::SelectLod(const glm::mat4 &viewProj, float viewSize, float errorPixels) const
+{
+	const uint32_t	lodsCount = static_cast<uint32_t>(m_Lods.size());
+	if (lodsCount <= 1)
+		return 0;
+
+	const glm::mat4	&model = m_Model;
+	const glm::vec3	center = glm::vec3(model * glm::vec4((m_BoundsMin + m_BoundsMax) * 0.5f, 1.f));
+	const float		scale = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+	const float		radius = m_BoundsRadius * scale;
+
+	// rows of the matrix, x and y are the clip units per world unit and w the perspective divide, constant for an orthographic view
+	const glm::vec3	rowX = glm::vec3(viewProj[0][0], viewProj[1][0], viewProj[2][0]);
+	const glm::vec3	rowY = glm::vec3(viewProj[0][1], viewProj[1][1], viewProj[2][1]);
+	const glm::vec4	rowW = glm::vec4(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+	// divide at the closest point of the bounding sphere
+	const float		closestW = glm::dot(rowW, glm::vec4(center, 1.f)) - radius * glm::length(glm::vec3(rowW));
+	if (closestW <= 0.f)
+		return 0;
+
+	// clip space is 2 units across the target
+	const float		pixelsPerUnit = std::max(glm::length(rowX), glm::length(rowY)) * 0.5f * viewSize / closestW * scale;
+
+	uint32_t		lodIndex = 0;
+	while (lodIndex + 1 < lodsCount && m_Lods[lodIndex + 1].m_Error * pixelsPerUnit <= errorPixels)
+		++lodIndex;
+
+	return lodIndex;
+}
+
+//----------------------------------------------------------------
+
+uint32_t	Mesh::GetLodIndicesCount(uint32_t lodIndex) const
+{
+	const MeshLod	&lod = m_Lods[lodIndex];
+	uint32_t		indicesCount = 0;
+
+	for (uint32_t submeshIndex = lod.m_FirstSubmesh; submeshIndex < lod.m_FirstSubmesh + lod.m_SubmeshesCount; ++submeshIndex)
+		indicesCount += m_Submeshes[submeshIndex].m_IndicesCount;
+
+	return indicesCount;
+}
+
+//----------------------------------------------------------------
+
+bool	Mesh::UpdateData(const VkDevice logicalDevice, const std::vector<VertexData> &vertices, const std::vector<uint16_t> &indices)
+{
+	m_BoundsMin = glm::vec3(0.f);
+	m_BoundsMax = glm::vec3(0.f);
+
+	const uint32_t	verticesCount = static_cast<uint32_t>(vertices.size());
+	for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+	{
+		m_BoundsMin = (vertexIndex == 0) ? vertices[vertexIndex].m_Pos : glm::min(m_BoundsMin, vertices[vertexIndex].m_Pos);
+		m_BoundsMax = (vertexIndex == 0) ? vertices[vertexIndex].m_Pos : glm::max(m_BoundsMax, vertices[vertexIndex].m_Pos);
+	}
+
+	m_BoundsRadius = ComputeBoundsRadius(vertices.data(), verticesCount, m_BoundsMin, m_BoundsMax);
+
+	// procedural meshes are a single 16 bit submesh at full detail only
+	Submesh	submesh = { };
+	{
+		submesh.m_FirstIndex = 0;
+		submesh.m_IndicesCount = static_cast<uint32_t>(indices.size());
+		submesh.m_VertexOffset = 0;
+		submesh.m_MaterialIndex = 0;
+	}
+
+	MeshLod	lod = { };
+	{
+		lod.m_FirstSubmesh = 0;
+		lod.m_SubmeshesCount = 1;
+		lod.m_Error = 0.f;
+	}
+
+	m_Submeshes.assign(1, submesh);
+	m_Lods.assign(1, lod);
+	m_IndexType = VK_INDEX_TYPE_UINT16;
+
+	m_Dequantization = VertexFormat::GetDequantization(m_VertexLayout, m_BoundsMin, m_BoundsMax);
+
+	std::vector<uint8_t>	positions;
+	std::vector<uint8_t>	attributes;
+	VertexFormat::Encode(m_VertexLayout, vertices.data(), verticesCount, m_BoundsMin, m_BoundsMax, positions, attributes);
+
+	return UpdateData(logicalDevice, positions.data(), attributes.data(), indices.data());
+}
+
+//----------------------------------------------------------------
+
+bool	Mesh::UpdateData(const VkDevice logicalDevice, const void *positions, const void *attributes, const void *indices)
+{
+	const uint32_t	indexSize = (m_IndexType == VK_INDEX_TYPE_UINT32) ? sizeof(uint32_t) : sizeof(uint16_t);
+
+	if (m_GeometryRange.IsValid())
+		return Device::m_Device->GetGeometryPool()->Upload(m_GeometryRange, positions, attributes, indices, indexSize);
+
+	// device local buffers, the data is copied to staging right away and by the next upload batch to the GPU
+	UploadManager	*uploadManager = Device::m_Device->GetUploadManager();
+
+	return	uploadManager->UploadBuffer(m_PositionBuffer.GetApiBuffer(), positions, m_PositionBuffer.GetSize(), VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT) &&
+			uploadManager->UploadBuffer(m_AttributeBuffer.GetApiBuffer(), attributes, m_AttributeBuffer.GetSize(), VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT) &&
+			uploadManager->UploadBuffer(m_IndexBuffer.GetApiBuffer(), indices, m_IndexBuffer.GetSize(), VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+}
+
+//----------------------------------------------------------------
+
+bool	Mesh::Import(uint32_t importFlags, MeshCache::MeshData &outData) const
+{
+	std::vector<glm::vec3>				allPosition; 
+	std::vector<glm::vec2>				allUV;
+	std::vector<glm::vec3>				allNormal;
+	std::vector<glm::vec4>				allDiffuseColor;
+	std::vector<uint32_t>				allIndices;
+	std::vector<LoaderFbx::SubmeshRange>	allSubmeshes;
+	std::vector<std::string>			allDiffuseTextures;
+	std::vector<std::string>			allNormalTextures;
+
+	if (!LoaderFbx::Load(m_Path, importFlags, allPosition, allUV, allNormal, allDiffuseColor, allIndices, allSubmeshes, allDiffuseTextures, allNormalTextures))
+		return false;
+
+	// every submesh is optimized on its own, its vertices are appended once done and its indices kept for the simplification
+	const uint32_t							submeshesCount = static_cast<uint32_t>(allSubmeshes.size());
+	std::vector<std::vector<VertexData>>	submeshesVertices(submeshesCount);
+	std::vector<std::vector<uint32_t>>		submeshesIndices(submeshesCount);
+
+	// full detail first, then the simplified levels, all in the same index buffer
+	std::vector<uint32_t>	lodsIndices;
+	lodsIndices.reserve(allIndices.size() * 2);
+
+	MeshOptimizerReport		optimizerReport;
+
+	// indices are local to their submesh, 16 bits are enough as long as no submesh has more than 65536 vertices
+	uint32_t				maxSubmeshVertices = 0;
+
+	for (uint32_t submeshIndex = 0; submeshIndex < submeshesCount; ++submeshIndex)
+	{
+		const LoaderFbx::SubmeshRange	&range = allSubmeshes[submeshIndex];
+
+		std::vector<VertexData>	&vertices = submeshesVertices[submeshIndex];
+		std::vector<uint32_t>	&indices = submeshesIndices[submeshIndex];
+
+		vertices.resize(range.m_VerticesCount);
+		indices.assign(allIndices.begin() + range.m_FirstIndex, allIndices.begin() + range.m_FirstIndex + range.m_IndicesCount);
+
+		for (uint32_t vertexIndex = 0; vertexIndex < range.m_VerticesCount; ++vertexIndex)
+		{
+			VertexData	&data = vertices[vertexIndex];
+			data.m_Pos = allPosition[range.m_FirstVertex + vertexIndex];
+			data.m_TexCoord = allUV[range.m_FirstVertex + vertexIndex];
+			data.m_Normal = allNormal[range.m_FirstVertex + vertexIndex];
+			data.m_Color = allDiffuseColor[range.m_FirstVertex + vertexIndex];
+		}
+
+		MeshOptimizer::Optimize(vertices, indices, optimizerReport);
+
+		Submesh	submesh = { };
+		{
+			submesh.m_FirstIndex = static_cast<uint32_t>(lodsIndices.size());
+			submesh.m_IndicesCount = static_cast<uint32_t>(indices.size());
+			submesh.m_VertexOffset = static_cast<int32_t>(outData.m_Vertices.size());
+			submesh.m_MaterialIndex = range.m_MaterialIndex;
+		}
+
+		outData.m_Submeshes.push_back(submesh);
+		outData.m_Vertices.insert(outData.m_Vertices.end(), vertices.begin(), vertices.end());
+		lodsIndices.insert(lodsIndices.end(), indices.begin(), indices.end());
+
+		maxSubmeshVertices = std::max(maxSubmeshVertices, static_cast<uint32_t>(vertices.size()));
+	}
+
+	optimizerReport.Print(m_Path);
+
+	const uint32_t	verticesCount = static_cast<uint32_t>(outData.m_Vertices.size());
+
+	outData.m_BoundsMin = glm::vec3(0.f);
+	outData.m_BoundsMax = glm::vec3(0.f);
+
+	for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
 	{
-		std::vector<glm::vec3>		allPosition; 
-		std::vector<glm::vec2>		allUV;
-		std::vector<glm::vec3>		allNormal;
-		std::vector<glm::vec4>		allDiffuseColor;
-		std::vector<std::string>	allDiffuseTextures;
-		std::vector<std::string>	allNormalTextures;
-
-		if (LoaderFbx::Load(m_Path,
-							LoaderFbx::FLIP_UV | LoaderFbx::TRIANGULATE | LoaderFbx::PRE_TRANSFORM_VERTICES,
-							allPosition,
-							allUV,
-							allNormal,
-							allDiffuseColor,
-							m_Indices,
-							allDiffuseTextures,
-							allNormalTextures))
+		const VertexData	&data = outData.m_Vertices[vertexIndex];
+
+		outData.m_BoundsMin = (vertexIndex == 0) ? data.m_Pos : glm::min(outData.m_BoundsMin, data.m_Pos);
+		outData.m_BoundsMax = (vertexIndex == 0) ? data.m_Pos : glm::max(outData.m_BoundsMax, data.m_Pos);
+	}
+
+	outData.m_BoundsRadius = ComputeBoundsRadius(outData.m_Vertices.data(), verticesCount, outData.m_BoundsMin, outData.m_BoundsMax);
+
+	// each level simplifies the full detail submeshes further, down to the error bound
+	MeshLod	fullLod = { };
+	{
+		fullLod.m_FirstSubmesh = 0;
+		fullLod.m_SubmeshesCount = submeshesCount;
+		fullLod.m_Error = 0.f;
+	}
+
+	outData.m_Lods.push_back(fullLod);
+
+	const float				maxError = glm::length(outData.m_BoundsMax - outData.m_BoundsMin) * MESH_LOD_MAX_ERROR;
+	std::vector<uint32_t>	simplifiedIndices;
+
+	for (uint32_t lodIndex = 1; lodIndex < MESH_LOD_MAX_COUNT; ++lodIndex)
+	{
+		const MeshLod			previousLod = outData.m_Lods.back();
+
+		MeshLod					lod = { };
+		{
+			lod.m_FirstSubmesh = static_cast<uint32_t>(outData.m_Submeshes.size());
+			lod.m_SubmeshesCount = submeshesCount;
+			lod.m_Error = previousLod.m_Error;
+		}
+
+		std::vector<Submesh>	lodSubmeshes(outData.m_Submeshes.begin() + previousLod.m_FirstSubmesh, outData.m_Submeshes.begin() + previousLod.m_FirstSubmesh + submeshesCount);
+		std::vector<uint32_t>	lodIndices;
+
+		uint32_t				previousIndicesCount = 0;
+		uint32_t				lodIndicesCount = 0;
+
+		for (uint32_t submeshIndex = 0; submeshIndex < submeshesCount; ++submeshIndex)
 		{
-			std::vector<VertexData>	vertices;
-			for (int idx = 0; idx < allPosition.size(); ++idx)
+			Submesh					&submesh = lodSubmeshes[submeshIndex];
+			const uint32_t			targetIndicesCount = static_cast<uint32_t>(submeshesIndices[submeshIndex].size() >> lodIndex) / 3 * 3;
+
+			previousIndicesCount += submesh.m_IndicesCount;
+
+			// from the full detail each time, so that the error is measured against the imported surface
+			const float				error = MeshOptimizer::Simplify(submeshesVertices[submeshIndex], submeshesIndices[submeshIndex], targetIndicesCount, maxError, simplifiedIndices);
+
+			// a submesh that can't be simplified further keeps drawing the range of the previous level
+			if (simplifiedIndices.size() < submesh.m_IndicesCount)
 			{
-				VertexData	data;
-				data.m_Pos = allPosition[idx];
-				data.m_TexCoord = allUV[idx];
-				data.m_Normal = allNormal[idx];
-				data.m_Color = allDiffuseColor[idx];
+				MeshOptimizer::OptimizeVertexCache(simplifiedIndices, static_cast<uint32_t>(submeshesVertices[submeshIndex].size()));
 
-				vertices.push_back(data);
-			}
+				submesh.m_FirstIndex = static_cast<uint32_t>(lodsIndices.size() + lodIndices.size());
+				submesh.m_IndicesCount = static_cast<uint32_t>(simplifiedIndices.size());
+				lodIndices.insert(lodIndices.end(), simplifiedIndices.begin(), simplifiedIndices.end());
 
-			m_VertexBuffer = Buffer<VertexData>(logicalDevice, BUFFER_TYPE::Vertex, vertices.size());
-			m_IndexBuffer = Buffer<uint16_t>(logicalDevice, BUFFER_TYPE::Index, m_Indices.size());
-			UpdateData(logicalDevice, vertices, m_Indices);
+				lod.m_Error = std::max(lod.m_Error, error);
+			}
 
-			if (!allDiffuseTextures.empty() && !allNormalTextures.empty())
-				m_Material = Material(allDiffuseTextures[0], allNormalTextures[0]);
-			else if (!allDiffuseTextures.empty())
-				m_Material = Material(allDiffuseTextures[0]);
-			else
-				m_Material = Material();
+			lodIndicesCount += submesh.m_IndicesCount;
 		}
-		else
-			m_Material = Material(m_Path);
-	}	
+
+		if (lodIndicesCount >= previousIndicesCount || lodIndicesCount > previousIndicesCount * MESH_LOD_MIN_REDUCTION)
+			break;
+
+		outData.m_Submeshes.insert(outData.m_Submeshes.end(), lodSubmeshes.begin(), lodSubmeshes.end());
+		outData.m_Lods.push_back(lod);
+		lodsIndices.insert(lodsIndices.end(), lodIndices.begin(), lodIndices.end());
+
+		std::cout << "  LOD " << lodIndex << " triangles " << lodIndicesCount / 3 << " error " << lod.m_Error << std::endl; // TODO: change this for real logger
+	}
+
+	outData.m_IndicesCount = static_cast<uint32_t>(lodsIndices.size());
+	outData.m_IndexSize = (maxSubmeshVertices > 65536) ? sizeof(uint32_t) : sizeof(uint16_t);
+	outData.m_Indices.resize(outData.m_IndicesCount * outData.m_IndexSize);
+
+	if (outData.m_IndexSize == sizeof(uint32_t))
+		memcpy(outData.m_Indices.data(), lodsIndices.data(), outData.m_Indices.size());
+	else
+	{
+		uint16_t	*indices = reinterpret_cast<uint16_t*>(outData.m_Indices.data());
+		for (uint32_t indexIndex = 0; indexIndex < outData.m_IndicesCount; ++indexIndex)
+			indices[indexIndex] = static_cast<uint16_t>(lodsIndices[indexIndex]);
+	}
+
+	const uint32_t	materialsCount = static_cast<uint32_t>(allDiffuseTextures.size());
+	outData.m_Materials.resize(materialsCount);
+
+	for (uint32_t materialIndex = 0; materialIndex < materialsCount; ++materialIndex)
+	{
+		MeshCache::Material	&material = outData.m_Materials[materialIndex];
+		memset(&material, 0, sizeof(MeshCache::Material));
+
+		strncpy(material.m_DiffusePath, allDiffuseTextures[materialIndex].c_str(), MESH_CACHE_MAX_PATH - 1);
+		strncpy(material.m_NormalPath, allNormalTextures[materialIndex].c_str(), MESH_CACHE_MAX_PATH - 1);
+	}
+
+	return true;
 }
 
 //----------------------------------------------------------------
 
-Mesh::~Mesh()
+bool	Mesh::LoadSource(MeshSource &outSource) const
 {
-	m_Indices.clear();
+	PROFILE_ZONE("Mesh::LoadSource");
+
+	const uint32_t		importFlags = LoaderFbx::FLIP_UV | LoaderFbx::TRIANGULATE | LoaderFbx::PRE_TRANSFORM_VERTICES;
+	const uint64_t		sourceHash = MeshCache::HashSource(m_Path, importFlags);
+	const std::string	cachePath = MeshCache::GetCachePath(m_Path);
 
-	// Note: need to add desctruction of Buffer -> delete here? manager with refs on created buffer?
+	if (sourceHash == 0)
+		return false;
+
+	// the cache is mapped and uploaded as is, assimp only runs when it is missing or stale
+	if (outSource.m_Cache.Open(cachePath, sourceHash, importFlags))
+	{
+		const MeshCache::Header	&header = outSource.m_Cache.GetHeader();
+		DecodeMaterial(outSource.m_Cache.GetSubmeshes(), outSource.m_Cache.GetLods()[0].m_SubmeshesCount, outSource.m_Cache.GetMaterials(), header.m_MaterialsCount, outSource);
+
+		VertexFormat::Encode(	m_VertexLayout, outSource.m_Cache.GetVertices(), header.m_VerticesCount, header.m_BoundsMin, header.m_BoundsMax,
+								outSource.m_Positions, outSource.m_Attributes);
+
+		return true;
+	}
+
+	MeshCache::MeshData	&importedData = outSource.m_ImportedData;
+
+	if (!Import(importFlags, importedData))
+		return false;
+
+	// failing to write only costs the import again at next launch
+	if (!MeshCache::Write(cachePath, sourceHash, importFlags, importedData))
+		std::cout << "Mesh cache not written for " << m_Path << std::endl; // TODO: change this for real logger
+
+	DecodeMaterial(importedData.m_Submeshes.data(), importedData.m_Lods[0].m_SubmeshesCount, importedData.m_Materials.data(), static_cast<uint32_t>(importedData.m_Materials.size()), outSource);
+
+	// the cache keeps interleaved full precision vertices, the GPU streams are split and compressed
+	VertexFormat::Encode(	m_VertexLayout, importedData.m_Vertices.data(), static_cast<uint32_t>(importedData.m_Vertices.size()), importedData.m_BoundsMin, importedData.m_BoundsMax,
+							outSource.m_Positions, outSource.m_Attributes);
+
+	return true;
 }
 
 //----------------------------------------------------------------
 
-void	Mesh::Render(const VkCommandBuffer commandBuffer, uint32_t isOpaque)
+bool	Mesh::CreateFromSource(const VkDevice logicalDevice, MeshSource &source)
 {
-	if (static_cast<uint32_t>(m_Material.GetAlbedo().a) == isOpaque)
+	if (source.m_Cache.IsOpen())
 	{
-		VkDeviceSize	offsets = 0;
+		const MeshCache::Header	&header = source.m_Cache.GetHeader();
+
+		if (!CreateBuffers(	logicalDevice, source.m_Positions.data(), source.m_Attributes.data(), header.m_VerticesCount, source.m_Cache.GetIndices(), header.m_IndicesCount, header.m_IndexSize,
+								source.m_Cache.GetSubmeshes(), header.m_SubmeshesCount, source.m_Cache.GetLods(), header.m_LodsCount))
+			return false;
+
+		m_BoundsMin = header.m_BoundsMin;
+		m_BoundsMax = header.m_BoundsMax;
+		m_BoundsRadius = header.m_BoundsRadius;
+	}
+	else
+	{
+		const MeshCache::MeshData	&importedData = source.m_ImportedData;
+
+		if (!CreateBuffers(	logicalDevice, source.m_Positions.data(), source.m_Attributes.data(), static_cast<uint32_t>(importedData.m_Vertices.size()),
+								importedData.m_Indices.data(), importedData.m_IndicesCount, importedData.m_IndexSize,
+								importedData.m_Submeshes.data(), static_cast<uint32_t>(importedData.m_Submeshes.size()),
+								importedData.m_Lods.data(), static_cast<uint32_t>(importedData.m_Lods.size())))
+			return false;
+
+		m_BoundsMin = importedData.m_BoundsMin;
+		m_BoundsMax = importedData.m_BoundsMax;
+		m_BoundsRadius = importedData.m_BoundsRadius;
+	}
+
+	m_Dequantization = VertexFormat::GetDequantization(m_VertexLayout, m_BoundsMin, m_BoundsMax);
+
+	TextureRegistry	*textureRegistry = Device::m_Device->GetTextureRegistry();
+
+	m_Material = Material(	textureRegistry->Resolve(logicalDevice, std::move(source.m_Texture)),
+							textureRegistry->Resolve(logicalDevice, std::move(source.m_NormalTexture)));
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	Mesh::CreateBuffers(const VkDevice logicalDevice,
+							const void *positions, const void *attributes, uint32_t verticesCount,
+							const void *indices, uint32_t indicesCount, uint32_t indexSize,
+							const Submesh *submeshes, uint32_t submeshesCount, const MeshLod *lods, uint32_t lodsCount)
+{
+	m_Submeshes.assign(submeshes, submeshes + submeshesCount);
+	m_Lods.assign(lods, lods + lodsCount);
+
+	AllocateBuffers(logicalDevice, verticesCount, indicesCount, indexSize);
+
+	return UpdateData(logicalDevice, positions, attributes, indices);
+}
+
+//----------------------------------------------------------------
 
-		const VkBuffer vertexBuffer = m_VertexBuffer.GetApiBuffer();
+void	Mesh::AllocateBuffers(const VkDevice logicalDevice, uint32_t verticesCount, uint32_t indicesCount, uint32_t indexSize)
+{
+	m_IndexType = (indexSize == sizeof(uint32_t)) ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+
+	GeometryPool	*geometryPool = Device::m_Device->GetGeometryPool();
 
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offsets);
-		vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer.GetApiBuffer(), 0, VK_INDEX_TYPE_UINT16);
+	DestroyBuffers();
+
+	// only the GPU culling has a pool, its stream layout is the one of the device, the same as every mesh
+	if (geometryPool != nullptr)
+	{
+		geometryPool->Free(m_GeometryRange);
+		m_GeometryRange = GeometryRange();
 
-		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_Indices.size()), 1, 0, 0, 0);
+		if (geometryPool->Allocate(verticesCount, indicesCount, m_GeometryRange))
+			return;
+
+		std::cout << "Geometry pool full, " << GetName() << " gets buffers of its own" << std::endl; // TODO: change this for real logger
 	}
+
+	m_PositionBuffer = Buffer<uint8_t>(logicalDevice, static_cast<BUFFER_TYPE>(BUFFER_TYPE::Vertex | BUFFER_TYPE::TransferDest), verticesCount * VertexFormat::GetPositionStride(m_VertexLayout));
+	m_AttributeBuffer = Buffer<uint8_t>(logicalDevice, static_cast<BUFFER_TYPE>(BUFFER_TYPE::Vertex | BUFFER_TYPE::TransferDest), verticesCount * VertexFormat::GetAttributeStride(m_VertexLayout));
+	m_IndexBuffer = Buffer<uint8_t>(logicalDevice, static_cast<BUFFER_TYPE>(BUFFER_TYPE::Index | BUFFER_TYPE::TransferDest), indicesCount * indexSize);
+	m_BuffersDevice = logicalDevice;
+}
+
+//----------------------------------------------------------------
+
+void	Mesh::DestroyBuffers()
+{
+	if (m_BuffersDevice == nullptr)
+		return;
+
+	m_PositionBuffer.Destroy(m_BuffersDevice);
+	m_AttributeBuffer.Destroy(m_BuffersDevice);
+	m_IndexBuffer.Destroy(m_BuffersDevice);
+
+	m_PositionBuffer = Buffer<uint8_t>();
+	m_AttributeBuffer = Buffer<uint8_t>();
+	m_IndexBuffer = Buffer<uint8_t>();
+	m_BuffersDevice = nullptr;
+}
+
+//----------------------------------------------------------------
+
+float	Mesh::ComputeBoundsRadius(const VertexData *vertices, uint32_t verticesCount, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	// the farthest vertex from the box center, the box corners are usually empty
+	const glm::vec3	center = (boundsMin + boundsMax) * 0.5f;
+	float			radius = 0.f;
+
+	for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+		radius = std::max(radius, glm::length(vertices[vertexIndex].m_Pos - center));
+
+	return radius;
 }
 
 //----------------------------------------------------------------
 
-void	Mesh::UpdateData(const VkDevice logicalDevice, const std::vector<VertexData> &vertices, const std::vector<uint16_t> &indices)
+void	Mesh::DecodeMaterial(	const Submesh *submeshes, uint32_t submeshesCount, const MeshCache::Material *materials, uint32_t materialsCount,
+							MeshSource &outSource)
 {
-	m_VertexBuffer.UpdateData(logicalDevice, vertices);
-	m_IndexBuffer.UpdateData(logicalDevice, indices);
+	// textures are bound per mesh, the material covering the most triangles is used for all the submeshes
+	uint32_t	materialIndex = UINT32_MAX;
+	uint32_t	materialIndicesCount = 0;
+
+	for (uint32_t submeshIndex = 0; submeshIndex < submeshesCount; ++submeshIndex)
+	{
+		if (submeshes[submeshIndex].m_MaterialIndex < materialsCount && submeshes[submeshIndex].m_IndicesCount > materialIndicesCount)
+		{
+			materialIndex = submeshes[submeshIndex].m_MaterialIndex;
+			materialIndicesCount = submeshes[submeshIndex].m_IndicesCount;
+		}
+	}
+
+	if (materialIndex == UINT32_MAX)
+		return;
+
+	// textures another mesh already uses are shared instead of decoded again
+	const TextureRegistry	*textureRegistry = Device::m_Device->GetTextureRegistry();
+
+	outSource.m_Texture = textureRegistry->Decode(materials[materialIndex].m_DiffusePath, 4);
+	outSource.m_NormalTexture = textureRegistry->Decode(materials[materialIndex].m_NormalPath, 4);
 }
 
 //----------------------------------------------------------------
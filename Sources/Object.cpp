@@ -7,7 +7,9 @@ LIGHTLYY_BEGIN
 //----------------------------------------------------------------
 
 Object::Object(const std::string &name)
-:	m_Name(name)
+:	m_Name(name),
+	m_IsDirty(false),
+	m_DirtyObjects(nullptr)
 {
 	m_Position = glm::vec3(0.0f, 0.0f, 0.0f);
 	m_Rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
@@ -62,6 +64,21 @@ void	Object::UpdateMatrix()
 	m_Model = glm::scale(m_Model, m_Scale);
 	m_Model = glm::translate(m_Model, m_Position);
 	m_Model *= glm::toMat4(m_Rotation);
+
+	MarkDirty();
+}
+
+//----------------------------------------------------------------
+
+void	Object::MarkDirty()
+{
+	if (m_IsDirty)
+		return;
+
+	m_IsDirty = true;
+
+	if (m_DirtyObjects != nullptr)
+		m_DirtyObjects->push_back(this);
 }
 
 //----------------------------------------------------------------
@@ -0,0 +1,84 @@
+#include "RangeAllocator.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+void	RangeAllocator::Reset(uint32_t capacity)
+{
+	m_Capacity = capacity;
+	m_UsedCount = 0;
+
+	m_FreeRanges.clear();
+
+	if (capacity > 0)
+		m_FreeRanges.push_back({ 0, capacity });
+}
+
+//----------------------------------------------------------------
+
+uint32_t	RangeAllocator::Allocate(uint32_t count)
+{
+	if (count == 0)
+		return 0;
+
+	const uint32_t	freeRangesCount = static_cast<uint32_t>(m_FreeRanges.size());
+	for (uint32_t rangeIndex = 0; rangeIndex < freeRangesCount; ++rangeIndex)
+	{
+		Range	&freeRange = m_FreeRanges[rangeIndex];
+		if (freeRange.m_Count < count)
+			continue;
+
+		const uint32_t	first = freeRange.m_First;
+
+		freeRange.m_First += count;
+		freeRange.m_Count -= count;
+
+		if (freeRange.m_Count == 0)
+			m_FreeRanges.erase(m_FreeRanges.begin() + rangeIndex);
+
+		m_UsedCount += count;
+		return first;
+	}
+
+	return UINT32_MAX;
+}
+
+//----------------------------------------------------------------
+
+void	RangeAllocator::Free(uint32_t first, uint32_t count)
+{
+	if (count == 0)
+		return;
+
+	m_UsedCount -= count;
+
+	// first free range past the freed one
+	std::vector<Range>::iterator	next = m_FreeRanges.begin();
+	while (next != m_FreeRanges.end() && next->m_First < first)
+		++next;
+
+	const bool	mergesPrevious = (next != m_FreeRanges.begin() && (next - 1)->m_First + (next - 1)->m_Count == first);
+	const bool	mergesNext = (next != m_FreeRanges.end() && first + count == next->m_First);
+
+	if (mergesPrevious && mergesNext)
+	{
+		(next - 1)->m_Count += count + next->m_Count;
+		m_FreeRanges.erase(next);
+	}
+	else if (mergesPrevious)
+		(next - 1)->m_Count += count;
+	else if (mergesNext)
+	{
+		next->m_First = first;
+		next->m_Count += count;
+	}
+	else
+		m_FreeRanges.insert(next, { first, count });
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -1,7 +1,5 @@
 #include "RenderCommand.h"
 
-#include "Texture.h"
-
 //----------------------------------------------------------------
 
 LIGHTLYY_BEGIN
@@ -77,187 +75,6 @@ void	RenderCommand::Begin()
 
 //----------------------------------------------------------------
 
-void	RenderCommand::SingleSubmit(const Texture &texture, VkBuffer buffer, VkImageSubresourceRange subRange, bool generateMipmaps)
-{
-	// TODO: create function to encapsulate layout transition (barrier)
-	VkCommandBufferBeginInfo	beginInfo = { };
-	{
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	}
-
-	CHECK_API_SUCCESS(vkBeginCommandBuffer(m_CommandBuffer, &beginInfo));
-
-	VkImageMemoryBarrier		acquireBarrier = { };
-	{
-		acquireBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		acquireBarrier.image = texture.m_Image;
-		acquireBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		acquireBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		acquireBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		acquireBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		acquireBarrier.srcAccessMask = 0;
-		acquireBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		acquireBarrier.subresourceRange = subRange;
-	}
-
-	vkCmdPipelineBarrier(	m_CommandBuffer,
-							VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-							VK_PIPELINE_STAGE_TRANSFER_BIT,
-							0,
-							0, nullptr,
-							0, nullptr,
-							1, &acquireBarrier);
-	
-	const uint32_t				textureWidth = static_cast<uint32_t>(texture.GetWidth());
-	const uint32_t				textureHeight = static_cast<uint32_t>(texture.GetHeight());
-
-	VkBufferImageCopy			bufferImageCopy = { };
-	{
-		bufferImageCopy.bufferOffset = 0;
-		bufferImageCopy.bufferRowLength = 0;
-		bufferImageCopy.bufferImageHeight = 0;
-		bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferImageCopy.imageSubresource.mipLevel = 0;
-		bufferImageCopy.imageSubresource.baseArrayLayer = 0;
-		bufferImageCopy.imageSubresource.layerCount = subRange.layerCount;
-		bufferImageCopy.imageOffset = { 0, 0, 0 };
-		bufferImageCopy.imageExtent = { textureWidth, textureHeight, 1 };
-	}
-
-	vkCmdCopyBufferToImage(	m_CommandBuffer,
-							buffer,
-							texture.m_Image,
-							VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-							1,
-							&bufferImageCopy);
-
-	if (!generateMipmaps)
-	{
-		{
-			acquireBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			acquireBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			acquireBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			acquireBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		}
-
-		vkCmdPipelineBarrier(	m_CommandBuffer,
-								VK_PIPELINE_STAGE_TRANSFER_BIT,
-								VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-								0,
-								0, nullptr,
-								0, nullptr,
-								1, &acquireBarrier);
-	}
-
-	if (generateMipmaps)
-	{
-		for (uint32_t mipmapLevel = 1; mipmapLevel < texture.GetMipmapLevels(); ++mipmapLevel)
-		{
-			VkImageBlit				blitImage = { };
-
-			// source image
-			blitImage.srcOffsets[0] = { 0, 0, 0 };
-			blitImage.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			blitImage.srcSubresource.baseArrayLayer = 0;
-			blitImage.srcSubresource.layerCount = 1;
-			// -1 to get previous image
-			blitImage.srcSubresource.mipLevel = mipmapLevel - 1;
-			blitImage.srcOffsets[1] = { static_cast<int32_t>(textureWidth >> (mipmapLevel - 1)), static_cast<int32_t>(textureHeight >> (mipmapLevel - 1)), 1 };
-
-			// destination image
-			blitImage.dstOffsets[0] = { 0, 0, 0 };
-			blitImage.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			blitImage.dstSubresource.baseArrayLayer = 0;
-			blitImage.dstSubresource.layerCount = 1;
-			blitImage.dstSubresource.mipLevel = mipmapLevel;
-			blitImage.dstOffsets[1] = { static_cast<int32_t>(textureWidth >> (mipmapLevel)), static_cast<int32_t>(textureHeight >> (mipmapLevel)), 1 };
-
-			subRange.baseMipLevel = mipmapLevel - 1;
-			subRange.levelCount = 1;
-
-			VkImageMemoryBarrier	mipmapBarrier = { };
-			{
-				mipmapBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				mipmapBarrier.image = texture.m_Image;
-				mipmapBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-				mipmapBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-				mipmapBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				mipmapBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				mipmapBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				mipmapBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				mipmapBarrier.subresourceRange = subRange;
-			}
-
-			vkCmdPipelineBarrier(	m_CommandBuffer,
-									VK_PIPELINE_STAGE_TRANSFER_BIT,
-									VK_PIPELINE_STAGE_TRANSFER_BIT,
-									0,
-									0, nullptr,
-									0, nullptr,
-									1, &mipmapBarrier);
-
-			vkCmdBlitImage(	m_CommandBuffer,
-							texture.m_Image,
-							VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-							texture.m_Image,
-							VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-							1, &blitImage,
-							VK_FILTER_LINEAR);
-
-			{
-				mipmapBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				mipmapBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				mipmapBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				mipmapBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			}
-
-			vkCmdPipelineBarrier(m_CommandBuffer,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-				0,
-				0, nullptr,
-				0, nullptr,
-				1, &mipmapBarrier);
-		}
-
-		subRange.baseMipLevel = texture.GetMipmapLevels() - 1;
-		subRange.levelCount = 1;
-
-		{
-			acquireBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			acquireBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			acquireBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			acquireBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			acquireBarrier.subresourceRange = subRange;
-		}
-
-		vkCmdPipelineBarrier(	m_CommandBuffer,
-								VK_PIPELINE_STAGE_TRANSFER_BIT,
-								VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-								0,
-								0, nullptr,
-								0, nullptr,
-								1, &acquireBarrier);
-	}
-
-	CHECK_API_SUCCESS(vkEndCommandBuffer(m_CommandBuffer));
-
-	VkSubmitInfo				submitInfo = { };
-	{
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &m_CommandBuffer;
-	}
-
-	CHECK_API_SUCCESS(vkQueueSubmit(m_Queue.m_ApiQueue, 1, &submitInfo, VK_NULL_HANDLE));
-	CHECK_API_SUCCESS(vkQueueWaitIdle(m_Queue.m_ApiQueue));
-
-	Reset();
-}
-
-//----------------------------------------------------------------
-
 void	RenderCommand::End()
 {
 	CHECK_API_SUCCESS(vkEndCommandBuffer(m_CommandBuffer));
@@ -319,8 +136,25 @@ bool	RenderCommand::AllocateQueue(COMMAND_TYPE queue, const std::vector<VkQueueF
 {
 	bool			queueRetrieved = false;
 
-	// loop on family properties to find valid queue
 	const uint32_t	maxQueueFamilyCount = static_cast<uint32_t>(queuesFamilyProperties.size());
+
+	// transfer and compute work prefer a family without graphics to run alongside it
+	if (queue != COMMAND_TYPE::GraphicsOp)
+	{
+		for (uint32_t queueFamilyIndex = 0; queueFamilyIndex < maxQueueFamilyCount; ++queueFamilyIndex)
+		{
+			const VkQueueFamilyProperties	&currQueueFamilyProperty = queuesFamilyProperties[queueFamilyIndex];
+			if (currQueueFamilyProperty.queueCount > 0 &&
+				currQueueFamilyProperty.queueFlags & queue &&
+				!(currQueueFamilyProperty.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+			{
+				m_Queue = Queue(queueFamilyIndex, queue);
+				return true;
+			}
+		}
+	}
+
+	// loop on family properties to find valid queue
 	for (uint32_t queueFamilyIndex = 0; queueFamilyIndex < maxQueueFamilyCount; ++queueFamilyIndex)
 	{
 		const VkQueueFamilyProperties	&currQueueFamilyProperty = queuesFamilyProperties[queueFamilyIndex];
@@ -341,4 +175,95 @@ bool	RenderCommand::AllocateQueue(COMMAND_TYPE queue, const std::vector<VkQueueF
 
 //----------------------------------------------------------------
 
+SecondaryCommand::SecondaryCommand()
+:	m_LogicalDevice(nullptr),
+	m_CommandPool(nullptr),
+	m_CommandBuffers(std::vector<VkCommandBuffer>()),
+	m_UsedCount(0)
+{
+
+}
+
+//----------------------------------------------------------------
+
+SecondaryCommand::~SecondaryCommand()
+{
+
+}
+
+//----------------------------------------------------------------
+
+bool	SecondaryCommand::Prepare(const VkDevice logicalDevice, uint32_t queueFamilyIndex)
+{
+	m_LogicalDevice = logicalDevice;
+
+	VkCommandPoolCreateInfo	commandPoolCreateInfo = Initializers::Pool::CommandCreateInfo(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, queueFamilyIndex);
+
+	CHECK_API_SUCCESS(vkCreateCommandPool(logicalDevice, &commandPoolCreateInfo, nullptr, &m_CommandPool)); // TODO: add error management
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	SecondaryCommand::Shutdown()
+{
+	if (m_CommandBuffers.size() > 0)
+		vkFreeCommandBuffers(m_LogicalDevice, m_CommandPool, static_cast<uint32_t>(m_CommandBuffers.size()), m_CommandBuffers.data());
+
+	m_CommandBuffers.clear();
+
+	if (m_CommandPool != nullptr)
+		vkDestroyCommandPool(m_LogicalDevice, m_CommandPool, nullptr);
+
+	m_CommandPool = nullptr;
+}
+
+//----------------------------------------------------------------
+
+VkCommandBuffer	SecondaryCommand::Begin(const VkCommandBufferInheritanceInfo &inheritanceInfo)
+{
+	// grow the pool only when every buffer of this frame is already used
+	if (m_UsedCount == m_CommandBuffers.size())
+	{
+		VkCommandBufferAllocateInfo	commandBufferAllocateInfo = Initializers::Command::BufferAllocateInfo(m_CommandPool, 1, 1);
+		VkCommandBuffer				commandBuffer = nullptr;
+
+		CHECK_API_SUCCESS(vkAllocateCommandBuffers(m_LogicalDevice, &commandBufferAllocateInfo, &commandBuffer)); // TODO: add error management
+
+		m_CommandBuffers.push_back(commandBuffer);
+	}
+
+	const VkCommandBuffer		commandBuffer = m_CommandBuffers[m_UsedCount++];
+
+	VkCommandBufferBeginInfo	beginInfo = { };
+	{
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+	}
+
+	CHECK_API_SUCCESS(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+	return commandBuffer;
+}
+
+//----------------------------------------------------------------
+
+void	SecondaryCommand::End(const VkCommandBuffer commandBuffer)
+{
+	CHECK_API_SUCCESS(vkEndCommandBuffer(commandBuffer));
+}
+
+//----------------------------------------------------------------
+
+void	SecondaryCommand::Reset()
+{
+	CHECK_API_SUCCESS(vkResetCommandPool(m_LogicalDevice, m_CommandPool, 0));
+
+	m_UsedCount = 0;
+}
+
+//----------------------------------------------------------------
+
 LIGHTLYY_END
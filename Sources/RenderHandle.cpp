@@ -1,8 +1,13 @@
 #include "RenderHandle.h"
 
+#include <algorithm>
+#include <chrono>
+
 #include "Device.h"
+#include "CpuProfiler.h"
 #include "Mesh.h"
 #include "Skybox.h"
+#include "GeometryPool.h"
 
 //----------------------------------------------------------------
 
@@ -15,13 +20,22 @@ RenderHandle::RenderHandle()
 	m_Swapchain(nullptr),
 	m_SwapchainImages(std::vector<VkImage>()),
 	m_SwapchainImageViews(std::vector<VkImageView>()),
-	m_Fences(std::vector<VkFence>()),
-	m_AcquireSemaphores(std::vector<VkSemaphore>()),
-	m_PresentSemaphores(std::vector<VkSemaphore>()),
+	m_Headless(false),
+	m_OffscreenAllocations(std::vector<MemoryAllocation>()),
 	m_MaxQueueFamilyCount(0),
 	m_QueuesFamilyProperties(std::vector<VkQueueFamilyProperties>()),
+	m_Frames(std::vector<FrameContext>()),
+	m_FrameTimeline(nullptr),
+	m_FrameTimelineValue(0),
+	m_FrameWaitTime(0.f),
 	m_PresentQueue(Queue()),
+	m_UploadManager(nullptr),
+	m_GpuProfiler(nullptr),
+	m_TextureRegistry(nullptr),
+	m_GeometryPool(nullptr),
+	m_ThreadPool(nullptr),
 	m_ClearColor({ 0.55f, 0.55f, 0.55f, 1.f }),
+	m_PresentMode(VK_PRESENT_MODE_FIFO_KHR),
 	m_CurrentFrame(0)
 {
 	m_SurfaceFormat.format = VK_FORMAT_UNDEFINED;
@@ -44,72 +58,98 @@ RenderHandle::~RenderHandle()
 bool	RenderHandle::Setup(const VkInstance instance,
 							const Window *window,
 							const VkPhysicalDevice physicalDevice,
-							const std::vector<COMMAND_TYPE> &renderCommandsType,
-							uint32_t pendingFrames)
+							uint32_t pendingFrames,
+							uint32_t recordThreadsCount)
 {
+	m_Headless = (window == nullptr);
+
 	// create surface
+	if (!m_Headless)
+	{
 #if defined(_WIN32)
-	VkWin32SurfaceCreateInfoKHR	surfaceInfo = Initializers::Surface::CreateInfo(GetModuleHandle(NULL), window->GetWindowHandle());
+		VkWin32SurfaceCreateInfoKHR	surfaceInfo = Initializers::Surface::CreateInfo(GetModuleHandle(NULL), window->GetWindowHandle());
 
-	CHECK_API_SUCCESS(vkCreateWin32SurfaceKHR(instance, &surfaceInfo, nullptr, &m_Surface));
+		CHECK_API_SUCCESS(vkCreateWin32SurfaceKHR(instance, &surfaceInfo, nullptr, &m_Surface));
+#else
+		CHECK_API_SUCCESS(glfwCreateWindowSurface(instance, const_cast<GLFWwindow*>(window->GetApiWindow()), nullptr, &m_Surface));
 #endif
+	}
 
 	RetrieveQueueFamilyProperties(physicalDevice);
 
-	// setup all render commands
-	const uint32_t				renderCommandsCount = static_cast<uint32_t>(renderCommandsType.size());
+	// setup one frame context per frame in flight
+	m_PendingFrames = std::min(std::max(pendingFrames, 1u), static_cast<uint32_t>(MAX_PENDING_FRAMES));
 
-	m_RenderCommands.resize(renderCommandsCount);
+	m_Frames.resize(m_PendingFrames);
 
-	for (uint32_t renderCommandIndex = 0; renderCommandIndex < renderCommandsCount; ++renderCommandIndex)
+	for (uint32_t frameIndex = 0; frameIndex < m_PendingFrames; ++frameIndex)
 	{
-		m_RenderCommands[renderCommandIndex] = new RenderCommand(renderCommandsType[renderCommandIndex]);
-		if (!m_RenderCommands[renderCommandIndex]->Setup(m_QueuesFamilyProperties))
+		if (!m_Frames[frameIndex].Setup(m_QueuesFamilyProperties))
 			return false;
 	}
 
-	m_SingleCommand = new RenderCommand(COMMAND_TYPE::GraphicsOp);
-	if (!m_SingleCommand->Setup(m_QueuesFamilyProperties))
+	m_UploadManager = new UploadManager();
+	if (!m_UploadManager->Setup(m_QueuesFamilyProperties))
 		return false;
 
-	m_PendingFrames = pendingFrames;
-
-	m_Fences.resize(pendingFrames);
-	m_AcquireSemaphores.resize(pendingFrames);
-	m_PresentSemaphores.resize(pendingFrames);
+	m_ThreadPool = new ThreadPool(recordThreadsCount);
 
 	return true;
 }
 
 //----------------------------------------------------------------
 
-bool	RenderHandle::Prepare(const VkPhysicalDevice physicalDevice, const VkDevice logicalDevice)
+bool	RenderHandle::Prepare(const VkPhysicalDevice physicalDevice, const VkDevice logicalDevice, bool useTimelineSemaphore)
 {
-	// create queues, command pool and command buffer for each render command 
-	const uint32_t	renderCommandsCount = static_cast<uint32_t>(m_RenderCommands.size());
-	for (uint32_t renderCommandIndex = 0; renderCommandIndex < renderCommandsCount; ++renderCommandIndex)
+	// create queue, command buffers and synchronization objects of each frame context
+	// secondary command pools: one per worker and one for the main thread
+	const uint32_t	threadCommandsCount = m_ThreadPool->GetThreadsCount() + 1;
+	const uint64_t	uniformAlignment = Device::m_Device->GetUBOMinAlignment();
+
+	for (uint32_t frameIndex = 0; frameIndex < m_PendingFrames; ++frameIndex)
 	{
-		RenderCommand	*renderCommand = m_RenderCommands[renderCommandIndex];
-		if (!renderCommand->Prepare(logicalDevice))
+		FrameContext	&frame = m_Frames[frameIndex];
+		if (!frame.Prepare(logicalDevice, threadCommandsCount, uniformAlignment))
 			return false;
 
-		if (m_PresentQueue.m_ApiQueue == nullptr &&
-			renderCommand->CanPresentSurface(physicalDevice, m_Surface))
-			m_PresentQueue = renderCommand->GetQueue();
+		if (!m_Headless && m_PresentQueue.m_ApiQueue == nullptr &&
+			frame.m_RenderCommand->CanPresentSurface(physicalDevice, m_Surface))
+			m_PresentQueue = frame.m_RenderCommand->GetQueue();
 	}
 
-	m_SingleCommand->Prepare(logicalDevice);
+	if (!m_UploadManager->Prepare(logicalDevice))
+		return false;
 
-	// create fences and semaphores
-	VkFenceCreateInfo		fenceCreateInfo = Initializers::Fence::CreateInfo();
-	VkSemaphoreCreateInfo	semaphoreCreateInfo = Initializers::Semaphore::CreateInfo();
+	m_TextureRegistry = new TextureRegistry(this);
+	if (!m_TextureRegistry->Prepare(logicalDevice))
+		return false;
 
-	for (uint32_t frameIndex = 0; frameIndex < m_PendingFrames; ++frameIndex)
+	// shared buffers for the indirect draws, every mesh keeps its own buffers and 16 bit indices without them
+	if (Device::m_Device->UsesGpuCulling())
+	{
+		m_GeometryPool = new GeometryPool(this);
+		if (!m_GeometryPool->Prepare(logicalDevice, Device::m_Device->GetSettings().m_VertexLayout))
+			return false;
+	}
+
+	// timestamps are written on the graphics queue of the frames
+	VkPhysicalDeviceProperties	physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+
+	const uint32_t				graphicsFamilyIndex = m_Frames[0].m_RenderCommand->GetQueue().m_FamilyIndex;
+
+	m_GpuProfiler = new GpuProfiler();
+	if (!m_GpuProfiler->Prepare(logicalDevice, m_PendingFrames, physicalDeviceProperties.limits.timestampPeriod, m_QueuesFamilyProperties[graphicsFamilyIndex].timestampValidBits))
+		return false;
+
+	// one timeline for all frames, frame contexts remember the value they have to wait for
+	if (useTimelineSemaphore)
 	{
-		CHECK_API_SUCCESS(vkCreateFence(logicalDevice, &fenceCreateInfo, nullptr, &m_Fences[frameIndex])); // TODO: add error management
+		VkSemaphoreTypeCreateInfoKHR	semaphoreTypeInfo = Initializers::Semaphore::TypeCreateInfo(0);
+		VkSemaphoreCreateInfo			semaphoreCreateInfo = Initializers::Semaphore::CreateInfo();
+		semaphoreCreateInfo.pNext = &semaphoreTypeInfo;
 
-		CHECK_API_SUCCESS(vkCreateSemaphore(logicalDevice, &semaphoreCreateInfo, nullptr, &m_AcquireSemaphores[frameIndex])); // TODO: add error management
-		CHECK_API_SUCCESS(vkCreateSemaphore(logicalDevice, &semaphoreCreateInfo, nullptr, &m_PresentSemaphores[frameIndex]));
+		CHECK_API_SUCCESS(vkCreateSemaphore(logicalDevice, &semaphoreCreateInfo, nullptr, &m_FrameTimeline)); // TODO: add error management
 	}
 
 	return true;
@@ -119,16 +159,15 @@ bool	RenderHandle::Prepare(const VkPhysicalDevice physicalDevice, const VkDevice
 
 void	RenderHandle::Shutdown(const VkInstance instance, const VkDevice logicalDevice)
 {
+	// destroy swapchain image views
+	const uint32_t	imageViewsCount = static_cast<uint32_t>(m_SwapchainImageViews.size());
+	for (uint32_t imageViewIndex = 0; imageViewIndex < imageViewsCount; ++imageViewIndex)
+		vkDestroyImageView(logicalDevice, m_SwapchainImageViews[imageViewIndex], nullptr);
+
+	m_SwapchainImageViews.clear();
+
 	if (m_Surface != nullptr && m_Swapchain != nullptr)
 	{
-		// destroy swapchain image views
-		const uint32_t	imageViewsCount = static_cast<uint32_t>(m_SwapchainImageViews.size());
-		if (imageViewsCount > 0)
-		{
-			for (uint32_t imageViewIndex = 0; imageViewIndex < imageViewsCount; ++imageViewIndex)
-				vkDestroyImageView(logicalDevice, m_SwapchainImageViews[imageViewIndex], nullptr);
-		}
-
 		// destroy swapchain
 		vkDestroySwapchainKHR(logicalDevice, m_Swapchain, nullptr);
 
@@ -136,70 +175,203 @@ void	RenderHandle::Shutdown(const VkInstance instance, const VkDevice logicalDev
 		vkDestroySurfaceKHR(instance, m_Surface, nullptr);
 	}
 
-	// destroy command pool and buffers
-	const uint32_t	renderCommandsCount = static_cast<uint32_t>(m_RenderCommands.size());
-	for (uint32_t renderCommandIndex = 0; renderCommandIndex < renderCommandsCount; ++renderCommandIndex)
-		m_RenderCommands[renderCommandIndex]->Shutdown(logicalDevice);
+	// offscreen targets are owned by the render handle, swapchain images are not
+	const uint32_t	offscreenTargetsCount = static_cast<uint32_t>(m_OffscreenAllocations.size());
+	for (uint32_t imageIndex = 0; imageIndex < offscreenTargetsCount; ++imageIndex)
+	{
+		vkDestroyImage(logicalDevice, m_SwapchainImages[imageIndex], nullptr);
+		Device::m_Device->GetMemoryAllocator()->Free(m_OffscreenAllocations[imageIndex]);
+	}
 
-	m_SingleCommand->Shutdown(logicalDevice);
+	m_OffscreenAllocations.clear();
+	m_SwapchainImages.clear();
 
-	// destroy fences
-	for (uint32_t frameIndex = 0; frameIndex < m_PendingFrames; ++frameIndex)
+	// every mesh is gone with the scene too
+	if (m_GeometryPool != nullptr)
+	{
+		m_GeometryPool->Shutdown(logicalDevice);
+
+		delete m_GeometryPool;
+	}
+
+	m_GeometryPool = nullptr;
+
+	// every material is gone with the scene, destroy the released textures
+	if (m_TextureRegistry != nullptr)
 	{
-		vkDestroyFence(logicalDevice, m_Fences[frameIndex], nullptr);
+		m_TextureRegistry->Shutdown(logicalDevice);
 
-		vkDestroySemaphore(logicalDevice, m_AcquireSemaphores[frameIndex], nullptr);
-		vkDestroySemaphore(logicalDevice, m_PresentSemaphores[frameIndex], nullptr);
+		delete m_TextureRegistry;
 	}
+
+	m_TextureRegistry = nullptr;
+
+	if (m_UploadManager != nullptr)
+	{
+		m_UploadManager->Shutdown();
+
+		delete m_UploadManager;
+	}
+
+	m_UploadManager = nullptr;
+
+	if (m_GpuProfiler != nullptr)
+	{
+		m_GpuProfiler->Shutdown();
+
+		delete m_GpuProfiler;
+	}
+
+	m_GpuProfiler = nullptr;
+
+	// destroy frame contexts (command buffers, fences and semaphores)
+	const uint32_t	framesCount = static_cast<uint32_t>(m_Frames.size());
+	for (uint32_t frameIndex = 0; frameIndex < framesCount; ++frameIndex)
+		m_Frames[frameIndex].Shutdown(logicalDevice);
+
+	m_Frames.clear();
+
+	if (m_FrameTimeline != nullptr)
+		vkDestroySemaphore(logicalDevice, m_FrameTimeline, nullptr);
+
+	m_FrameTimeline = nullptr;
+
+	if (m_ThreadPool != nullptr)
+		delete m_ThreadPool;
+
+	m_ThreadPool = nullptr;
 }
 
 //----------------------------------------------------------------
 
 void	RenderHandle::BeginRender(const VkDevice logicalDevice)
 {
-	uint64_t		timeout = UINT64_MAX;
+	PROFILE_ZONE("RenderHandle::BeginRender");
+
+	FrameContext	&frame = m_Frames[m_CurrentFrame];
+
+	const auto		waitStartTime = std::chrono::high_resolution_clock::now();
+
+	// bounded waits so that a lost GPU is reported instead of hanging silently
+	if (m_FrameTimeline != nullptr)
+	{
+		PROFILE_ZONE("Wait frame timeline");
+
+		VkSemaphoreWaitInfoKHR	waitInfo = Initializers::Semaphore::WaitInfo(&m_FrameTimeline, &frame.m_TimelineValue);
+
+		while (vkWaitSemaphoresKHR(logicalDevice, &waitInfo, FRAME_WAIT_TIMEOUT) == VK_TIMEOUT)
+			std::cout << "Frame " << frame.m_TimelineValue << " still pending on GPU" << std::endl; // TODO: change this for real logger
+	}
+	else
+	{
+		PROFILE_ZONE("Wait frame fence");
+
+		while (vkWaitForFences(logicalDevice, 1, &frame.m_Fence, VK_TRUE, FRAME_WAIT_TIMEOUT) == VK_TIMEOUT)
+			std::cout << "Frame fence still pending on GPU" << std::endl; // TODO: change this for real logger
+
+		CHECK_API_SUCCESS(vkResetFences(logicalDevice, 1, &frame.m_Fence));
+	}
+
+	m_FrameWaitTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - waitStartTime).count();
+
+	// the wait guarantees the command buffers of this frame are no longer in use
+	frame.Reset();
+
+	// release staging memory of finished uploads
+	m_UploadManager->Update();
+
+	// and the textures no material uses anymore
+	m_TextureRegistry->Collect(logicalDevice, m_PendingFrames);
 
-	CHECK_API_SUCCESS(vkWaitForFences(logicalDevice, 1, &m_Fences[m_CurrentFrame], false, timeout));
-	CHECK_API_SUCCESS(vkResetFences(logicalDevice, 1, &m_Fences[m_CurrentFrame]));
+	// and the pool ranges of the deleted meshes
+	if (m_GeometryPool != nullptr)
+		m_GeometryPool->Collect(m_PendingFrames);
 
-	RenderCommand	*command = m_RenderCommands[m_CurrentFrame];
-	command->Reset();
+	// streamed levels asked by the last frame, uploads are flushed before this frame is submitted
+	m_TextureRegistry->Stream(logicalDevice);
 
-	VkSemaphore		*acquireSem = &m_AcquireSemaphores[m_CurrentFrame];
-	VkSemaphore		*presentSem = &m_PresentSemaphores[m_CurrentFrame];
+	// offscreen targets are owned by their frame, nothing to acquire
+	if (m_Headless)
+		m_CurrentSwapchainImage = m_CurrentFrame;
+	else
+	{
+		PROFILE_ZONE("Acquire image");
+		CHECK_API_SUCCESS(vkAcquireNextImageKHR(logicalDevice, m_Swapchain, UINT64_MAX, frame.m_AcquireSemaphore, VK_NULL_HANDLE, &m_CurrentSwapchainImage));
+	}
 
-	CHECK_API_SUCCESS(vkAcquireNextImageKHR(logicalDevice, m_Swapchain, timeout, *acquireSem, VK_NULL_HANDLE, &m_CurrentSwapchainImage));
-	command->Begin();
+	frame.m_RenderCommand->Begin();
+
+	// the frame slot is free again, its timestamps can be read without waiting
+	m_GpuProfiler->BeginFrame(frame.m_RenderCommand->GetBuffer(), m_CurrentFrame);
 }
 
 //----------------------------------------------------------------
 
 void	RenderHandle::EndRender()
 {
-	RenderCommand		*command = m_RenderCommands[m_CurrentFrame];
+	PROFILE_ZONE("RenderHandle::EndRender");
+
+	FrameContext		&frame = m_Frames[m_CurrentFrame];
+
+	RenderCommand		*command = frame.m_RenderCommand;
 	command->End();
 
+	// uploads recorded during this frame are submitted first, queue order makes them visible to it
+	m_UploadManager->Flush();
+
 	VkCommandBuffer		commandBuffer = command->GetBuffer();
 
-	VkSemaphore			*acquireSem = &m_AcquireSemaphores[m_CurrentFrame];
-	VkSemaphore			*presentSem = &m_PresentSemaphores[m_CurrentFrame];
+	VkSemaphore			*acquireSem = &frame.m_AcquireSemaphore;
+	VkSemaphore			*presentSem = &frame.m_PresentSemaphore;
+
+	VkPipelineStageFlags	stageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+	// the present semaphore is binary, its value is ignored
+	VkSemaphore			signalSems[] = { frame.m_PresentSemaphore, m_FrameTimeline };
+	uint64_t			signalValues[] = { 0, 0 };
+
+	// headless frames are neither acquired nor presented, only the timeline is signaled
+	const uint32_t		firstSignal = (m_Headless) ? 1 : 0;
+	const uint32_t		signalsCount = ((m_FrameTimeline != nullptr) ? 2 : 1) - firstSignal;
+
+	VkTimelineSemaphoreSubmitInfoKHR	timelineInfo = { };
+	if (m_FrameTimeline != nullptr)
+	{
+		frame.m_TimelineValue = ++m_FrameTimelineValue;
+		signalValues[1] = frame.m_TimelineValue;
+
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineInfo.signalSemaphoreValueCount = signalsCount;
+		timelineInfo.pSignalSemaphoreValues = &signalValues[firstSignal];
+	}
 
 	VkSubmitInfo		submitInfo = { };
 	{
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = (m_FrameTimeline != nullptr) ? &timelineInfo : nullptr;
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
-		VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		submitInfo.pWaitDstStageMask = &stageMask;
-		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.waitSemaphoreCount = (m_Headless) ? 0 : 1;
 		submitInfo.pWaitSemaphores = acquireSem;
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = presentSem;
+		submitInfo.signalSemaphoreCount = signalsCount;
+		submitInfo.pSignalSemaphores = &signalSems[firstSignal];
 	}
 
-	CHECK_API_SUCCESS(vkQueueSubmit(command->GetQueue().m_ApiQueue, 1, &submitInfo, m_Fences[m_CurrentFrame]));
+	const VkFence		fence = (m_FrameTimeline != nullptr) ? VK_NULL_HANDLE : frame.m_Fence;
+
+	{
+		PROFILE_ZONE("Submit");
+		CHECK_API_SUCCESS(vkQueueSubmit(command->GetQueue().m_ApiQueue, 1, &submitInfo, fence));
+	}
 	
 //	vkQueueWaitIdle(command->GetQueue().m_ApiQueue);
+
+	if (m_Headless)
+	{
+		m_CurrentFrame = (m_CurrentFrame + 1) % m_PendingFrames;
+		return;
+	}
 	
 	VkPresentInfoKHR	presentInfo = { };
 	{
@@ -211,7 +383,10 @@ void	RenderHandle::EndRender()
 		presentInfo.pImageIndices = &m_CurrentSwapchainImage;
 	}
 
-	CHECK_API_SUCCESS(vkQueuePresentKHR(m_PresentQueue.m_ApiQueue, &presentInfo));
+	{
+		PROFILE_ZONE("Present");
+		CHECK_API_SUCCESS(vkQueuePresentKHR(m_PresentQueue.m_ApiQueue, &presentInfo));
+	}
 
 //	vkQueueWaitIdle(command->GetQueue().m_ApiQueue);
 	
@@ -224,6 +399,7 @@ bool	RenderHandle::CreateSwapchain(	const VkPhysicalDevice physicalDevice,
 										const VkDevice logicalDevice,
 										const SWAPCHAIN_USAGE swapchainUsage,
 										bool useSRGB,
+										VkPresentModeKHR presentMode,
 										bool doubleBuffering)
 {
 	// retrieve surface formats count supported by surface
@@ -274,6 +450,19 @@ bool	RenderHandle::CreateSwapchain(	const VkPhysicalDevice physicalDevice,
 
 	m_DoubleBuffering = doubleBuffering;
 
+	// FIFO is the only mode guaranteed to be supported, fallback on it
+	uint32_t						presentModesCount = 0;
+	CHECK_API_SUCCESS(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, m_Surface, &presentModesCount, nullptr));
+
+	std::vector<VkPresentModeKHR>	presentModes(presentModesCount);
+	CHECK_API_SUCCESS(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, m_Surface, &presentModesCount, presentModes.data()));
+
+	m_PresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	if (std::find(presentModes.begin(), presentModes.end(), presentMode) != presentModes.end())
+		m_PresentMode = presentMode;
+	else
+		std::cout << "Present mode " << presentMode << " not supported, fallback on FIFO" << std::endl; // TODO: change this for real logger
+
 	VkSwapchainCreateInfoKHR	 swapchainCreateInfo = Initializers::Swapchain::CreateInfo(	m_Surface,
 																							m_SurfaceFormat,
 																							m_SwapchainExtent,
@@ -281,6 +470,16 @@ bool	RenderHandle::CreateSwapchain(	const VkPhysicalDevice physicalDevice,
 																							surfaceCapabilities.currentTransform,
 																							doubleBuffering);
 
+	swapchainCreateInfo.presentMode = m_PresentMode;
+
+	// at least one image per frame in flight, otherwise acquire blocks the ring (0 means no max)
+	// mailbox needs a spare image to replace the queued one without blocking
+	const uint32_t				minImagesCount = (m_PresentMode == VK_PRESENT_MODE_MAILBOX_KHR) ? std::max(m_PendingFrames + 1, 3u) : m_PendingFrames;
+
+	swapchainCreateInfo.minImageCount = std::max(std::max(swapchainCreateInfo.minImageCount, minImagesCount), surfaceCapabilities.minImageCount);
+	if (surfaceCapabilities.maxImageCount > 0)
+		swapchainCreateInfo.minImageCount = std::min(swapchainCreateInfo.minImageCount, surfaceCapabilities.maxImageCount);
+
 	CHECK_API_SUCCESS(vkCreateSwapchainKHR(logicalDevice, &swapchainCreateInfo, nullptr, &m_Swapchain));
 
 	// retrieve swapchain images count
@@ -301,15 +500,50 @@ bool	RenderHandle::CreateSwapchain(	const VkPhysicalDevice physicalDevice,
 
 //----------------------------------------------------------------
 
+bool	RenderHandle::CreateOffscreenTargets(const VkDevice logicalDevice, const VkExtent2D &extent, bool useSRGB)
+{
+	// same format as the preferred swapchain one so that render passes are shared with the windowed path
+	m_SurfaceFormat.format = (useSRGB) ? VK_FORMAT_B8G8R8A8_SRGB : VK_FORMAT_B8G8R8A8_UNORM;
+	m_SurfaceFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+
+	m_SwapchainExtent = extent;
+	m_DoubleBuffering = true;
+	m_PresentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+	// transfer source so that frames can be read back
+	VkImageCreateInfo		imageCreateInfo = Initializers::Image::CreateInfo(	VK_IMAGE_TYPE_2D,
+																				m_SwapchainExtent,
+																				1, 1,
+																				m_SurfaceFormat.format,
+																				VK_IMAGE_TILING_OPTIMAL,
+																				VK_IMAGE_LAYOUT_UNDEFINED,
+																				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+																				VK_SAMPLE_COUNT_1_BIT);
+
+	// one target per frame in flight, BeginRender picks the one of the current frame
+	if (!CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_PendingFrames, m_SwapchainImages, m_OffscreenAllocations))
+		return false;
+
+	const VkImageSubresourceRange	subRange = Initializers::Image::SubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, 1, 0);
+
+	return CreateImageViews(logicalDevice, m_SwapchainImages, VK_IMAGE_VIEW_TYPE_2D, m_SurfaceFormat.format, { VK_COMPONENT_SWIZZLE_IDENTITY }, subRange, m_SwapchainImageViews);
+}
+
+//----------------------------------------------------------------
+
 bool	RenderHandle::CreateImages(	const VkDevice logicalDevice,
 									const VkImageCreateInfo &imageCreateInfo,
 									VkMemoryPropertyFlags memoryType,
 									uint32_t imagesCount,
 									std::vector<VkImage> &outImages,
-									std::vector<VkDeviceMemory> &outMemories) const
+									std::vector<MemoryAllocation> &outAllocations) const
 {
 	outImages.resize(imagesCount);
-	outMemories.resize(imagesCount);
+	outAllocations.resize(imagesCount);
+
+	// render targets get their own memory, sampled images are sub-allocated
+	const bool	isAttachment = (imageCreateInfo.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+	const bool	isLinear = imageCreateInfo.tiling == VK_IMAGE_TILING_LINEAR;
 
 	for (uint32_t imageIndex = 0; imageIndex < imagesCount; ++imageIndex)
 	{
@@ -318,10 +552,10 @@ bool	RenderHandle::CreateImages(	const VkDevice logicalDevice,
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(logicalDevice, outImages[imageIndex], &memRequirements);
 
-		if (!Device::m_Device->AllocateMemory(memRequirements, memoryType, outMemories[imageIndex]))
+		if (!Device::m_Device->GetMemoryAllocator()->Allocate(memRequirements, memoryType, isLinear, isAttachment, outAllocations[imageIndex]))
 			return false;
 
-		CHECK_API_SUCCESS(vkBindImageMemory(logicalDevice, outImages[imageIndex], outMemories[imageIndex], 0));
+		CHECK_API_SUCCESS(vkBindImageMemory(logicalDevice, outImages[imageIndex], outAllocations[imageIndex].m_Memory, outAllocations[imageIndex].m_Offset));
 	}
 
 	return true;
@@ -380,31 +614,41 @@ bool	RenderHandle::PrepareTexture(const VkDevice logicalDevice, Texture &texture
 	if (pixels.size() == 0)
 		return false;
 
+	// files with their whole mip chain are copied level by level, only the blit source needs transfer reads
+	const bool			generateMipmaps = !texture.HasAllMipmaps();
+	VkImageUsageFlags	usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (generateMipmaps)
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+	// streamed textures only get the levels from the resident one down, it becomes the first mip of the image
+	const Ktx2::Level	&firstLevel = texture.GetLevels()[texture.m_ResidentLevel];
+	const uint32_t		mipmapLevels = texture.GetMipmapLevels() - texture.m_ResidentLevel;
+
 	VkExtent2D			extent2D = {};
 	{
-		extent2D.height = texture.GetHeight();
-		extent2D.width = texture.GetWidth();
+		extent2D.height = firstLevel.m_Height;
+		extent2D.width = firstLevel.m_Width;
 	}
 
 	// create texture image
 	VkImageCreateInfo	imageCreateInfo = Initializers::Image::CreateInfo(	VK_IMAGE_TYPE_2D, 
 																			extent2D,
-																			texture.GetMipmapLevels(),
+																			mipmapLevels,
 																			1,
-																			VK_FORMAT_R8G8B8A8_UNORM,
+																			texture.GetFormat(),
 																			VK_IMAGE_TILING_OPTIMAL,
 																			VK_IMAGE_LAYOUT_UNDEFINED,
-																			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+																			usage,
 																			VK_SAMPLE_COUNT_1_BIT);
 
 	std::vector<VkImage>			outImages;
-	std::vector<VkDeviceMemory>		outMemories;
-	CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, outImages, outMemories);
+	std::vector<MemoryAllocation>	outAllocations;
+	CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, outImages, outAllocations);
 
 	//create texture image view
-	VkImageSubresourceRange			subRange = Initializers::Image::SubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, texture.GetMipmapLevels(), 0, 1, 0);
+	VkImageSubresourceRange			subRange = Initializers::Image::SubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, mipmapLevels, 0, 1, 0);
 	std::vector<VkImageView>		outImageViews;
-	CreateImageViews(logicalDevice, outImages, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, { VK_COMPONENT_SWIZZLE_IDENTITY }, subRange, outImageViews);
+	CreateImageViews(logicalDevice, outImages, VK_IMAGE_VIEW_TYPE_2D, texture.GetFormat(), { VK_COMPONENT_SWIZZLE_IDENTITY }, subRange, outImageViews);
 
 	// create sampler
 	VkSamplerCreateInfo				samplerCreateInfo = {};
@@ -420,7 +664,7 @@ bool	RenderHandle::PrepareTexture(const VkDevice logicalDevice, Texture &texture
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
 		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
 		samplerCreateInfo.maxAnisotropy = 1.f;
-		samplerCreateInfo.maxLod = static_cast<float>(texture.GetMipmapLevels());
+		samplerCreateInfo.maxLod = static_cast<float>(mipmapLevels);
 		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
 		samplerCreateInfo.minLod = 0.0f;
 		samplerCreateInfo.mipLodBias = 0.0f;
@@ -431,19 +675,38 @@ bool	RenderHandle::PrepareTexture(const VkDevice logicalDevice, Texture &texture
 	std::vector<VkSampler>			outSamplers;
 	CreateSampler(logicalDevice, samplerCreateInfo, 1, outSamplers);
 
+	// a streamed texture keeps sampling its current image when the new one can't be uploaded
+	Texture							previousImage;
+	{
+		previousImage.m_Image = texture.m_Image;
+		previousImage.m_ImageView = texture.m_ImageView;
+		previousImage.m_Allocation = texture.m_Allocation;
+		previousImage.m_Sampler = texture.m_Sampler;
+	}
+
 	texture.m_Image = outImages[0];
 	texture.m_ImageView = outImageViews[0];
-	texture.m_Memory = outMemories[0];
+	texture.m_Allocation = outAllocations[0];
 	texture.m_Sampler = outSamplers[0];
 
-	// submit texture
-	const uint32_t	bufferSize = texture.GetWidth() * texture.GetHeight() * 4;
-	Buffer<stbi_uc>	stagingBuffer = Buffer<stbi_uc>(logicalDevice, BUFFER_TYPE::TransferSource, bufferSize);
-	stagingBuffer.UpdateData(logicalDevice, pixels);
+	// upload texture, pixels are copied to a staging buffer so they can be freed right away
+	const uint64_t	firstOffset = firstLevel.m_Offset;
+
+	if (!m_UploadManager->UploadTexture(texture, { pixels.data() + firstOffset }, pixels.size() - firstOffset, subRange, generateMipmaps, texture.m_UploadBatch))
+	{
+		DestroyTextureImage(logicalDevice, texture);
+
+		texture.m_Image = previousImage.m_Image;
+		texture.m_ImageView = previousImage.m_ImageView;
+		texture.m_Allocation = previousImage.m_Allocation;
+		texture.m_Sampler = previousImage.m_Sampler;
 
-	m_SingleCommand->SingleSubmit(texture, stagingBuffer.GetApiBuffer(), subRange, true); // FIXME: Retrieve correct graphic command
+		return false;
+	}
 
-	texture.FreeTexture();
+	// streamed textures upload other levels later
+	if (!texture.m_Streamed)
+		texture.FreeTexture();
 
 	return true;
 }
@@ -471,9 +734,9 @@ bool	RenderHandle::PrepareSkybox(const VkDevice logicalDevice, Skybox &skybox) c
 																					VK_SAMPLE_COUNT_1_BIT,
 																					VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
 
-	std::vector<VkImage>		outImages;
-	std::vector<VkDeviceMemory>	outMemories;
-	CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, outImages, outMemories);
+	std::vector<VkImage>			outImages;
+	std::vector<MemoryAllocation>	outAllocations;
+	CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, outImages, outAllocations);
 
 	//create skybox image view
 	VkImageSubresourceRange		subRange = Initializers::Image::SubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, 6, 0);
@@ -506,25 +769,32 @@ bool	RenderHandle::PrepareSkybox(const VkDevice logicalDevice, Skybox &skybox) c
 
 	texture.m_Image = outImages[0];
 	texture.m_ImageView = outImageViews[0];
-	texture.m_Memory = outMemories[0];
+	texture.m_Allocation = outAllocations[0];
 	texture.m_Sampler = outSamplers[0];
 
-	// submit skybox
-	Buffer<stbi_uc>					stagingBuffer = Buffer<stbi_uc>(logicalDevice, BUFFER_TYPE::TransferSource, skybox.GetSize());
+	// upload skybox, one layer per face
 	const std::vector<Texture>		&textures = skybox.GetTextures();
-	const std::vector<std::vector<stbi_uc>>	&pixels =
-	{
-		textures[0].GetPixels(),
-		textures[1].GetPixels(),
-		textures[2].GetPixels(),
-		textures[3].GetPixels(),
-		textures[4].GetPixels(),
-		textures[5].GetPixels()
+	const std::vector<const void*>	faces =
+	{
+		textures[0].GetPixels().data(),
+		textures[1].GetPixels().data(),
+		textures[2].GetPixels().data(),
+		textures[3].GetPixels().data(),
+		textures[4].GetPixels().data(),
+		textures[5].GetPixels().data()
 	};
 
-	stagingBuffer.UpdateData(logicalDevice, pixels);
+	if (!m_UploadManager->UploadTexture(texture, faces, textures[0].GetPixels().size(), subRange, false, texture.m_UploadBatch))
+	{
+		DestroyTextureImage(logicalDevice, texture);
+
+		texture.m_Image = nullptr;
+		texture.m_ImageView = nullptr;
+		texture.m_Allocation = MemoryAllocation();
+		texture.m_Sampler = nullptr;
 
-	m_SingleCommand->SingleSubmit(texture, stagingBuffer.GetApiBuffer(), subRange, false); // FIXME: Retrieve correct graphic command
+		return false;
+	}
 
 	// free skybox pixels (no longer useful)
 	skybox.FreeTextures();
@@ -532,6 +802,20 @@ bool	RenderHandle::PrepareSkybox(const VkDevice logicalDevice, Skybox &skybox) c
 	return true;
 }
 
+//----------------------------------------------------------------
+
+void	RenderHandle::DestroyTextureImage(const VkDevice logicalDevice, const Texture &texture) const
+{
+	vkDestroySampler(logicalDevice, texture.m_Sampler, nullptr);
+	vkDestroyImageView(logicalDevice, texture.m_ImageView, nullptr);
+	vkDestroyImage(logicalDevice, texture.m_Image, nullptr);
+
+	MemoryAllocation	allocation = texture.m_Allocation;
+	Device::m_Device->GetMemoryAllocator()->Free(allocation);
+}
+
+//----------------------------------------------------------------
+
 bool RenderHandle::PrepareShadow(const VkDevice logicalDevice, VkSampler &sampler) const
 {
 	VkSamplerCreateInfo shadowSampler = {};
@@ -1,10 +1,14 @@
 #include "Scene.h"
 
 #include <algorithm>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
 
 #include "Utility.h"
+#include "CpuProfiler.h"
 #include "Sphere.h"
-#include "ShadowData.h"
+#include "VertexData.h"
 
 //----------------------------------------------------------------
 
@@ -15,10 +19,27 @@ LIGHTLYY_BEGIN
 Scene::Scene(const RenderHandle *renderHandle)
 :	m_RenderHandle(renderHandle),
 	m_RenderPassObjects(nullptr),
+	m_RenderPassObjectsResume(nullptr),
 	m_FrameBuffersObjects(std::vector<VkFramebuffer>()),
 	m_ImagesObjects(std::vector<VkImage>()),
 	m_ImageViewsObjects(std::vector<VkImageView>()),
-	m_ObjectsMemories(std::vector<VkDeviceMemory>())
+	m_ObjectsAllocations(std::vector<MemoryAllocation>()),
+	m_SpotLightCount(0),
+	m_SkyboxUniformDescription(nullptr),
+	m_UniformOffsets(UniformOffsets()),
+	m_Frame(0),
+	m_MeshImageVersions(std::vector<uint64_t>()),
+	m_RecordThreadsCount(1),
+	m_RecordTime(0.f),
+	m_LastRecordTime(0.f),
+	m_LodErrorPixels(LOD_ERROR_PIXELS),
+	m_ShadowLodErrorPixels(LOD_SHADOW_ERROR_PIXELS),
+	m_ObjectsTrianglesCount(0),
+	m_ShadowTrianglesCount(0),
+	m_CullingMinPixels(CULLING_MIN_PIXELS),
+	m_CpuCulledMeshesCount(0),
+	m_GpuCulling(nullptr),
+	m_DepthPyramid(nullptr)
 {
 	m_Meshes = std::vector<Mesh*>();
 
@@ -72,26 +93,18 @@ bool	Scene::Setup(const VkDevice logicalDevice)
 	if (!CreateFrameBuffersShadowCascade(logicalDevice))
 		return false;
 
+	AssetLoader	*assetLoader = Device::m_Device->GetAssetLoader();
+
+	// every mesh descriptor set samples the skybox, its faces are decoded while the sphere is built
+	assetLoader->Spawn(LoadSkybox(logicalDevice, ENGINE_DATA_PATH"Skyboxes/Teide/", ".jpg"));
+
 	Mesh	*sphere = new Sphere(logicalDevice, 64, ENGINE_DATA_PATH"Textures/Basic.jpg", "Sphere");
 	AddObject(sphere);
 	m_Meshes.push_back(sphere);
-	m_RenderHandle->PrepareTexture(logicalDevice, sphere->GetMaterial().GetTexture());
+	m_MeshCullingSlots.push_back(UINT32_MAX); // given once the culling pass exists
+	++m_CpuCulledMeshesCount;
 	m_Meshes[0]->SetPosition({ -4.f, 0.f, 0.f });
 
-	Mesh	*teapot = new Mesh(logicalDevice, ENGINE_DATA_PATH"Models/Teapot/teapot.obj", "Teapot");
-	teapot->SetMaterial(Material(ENGINE_DATA_PATH"Textures/Basic.jpg"));
-	AddObject(teapot);
-	m_Meshes.push_back(teapot);
-	m_RenderHandle->PrepareTexture(logicalDevice, teapot->GetMaterial().GetTexture());
-	m_Meshes[1]->SetPosition({ 1.f, 0.f, 0.f });
-	m_Meshes[1]->SetScale({ 0.1f, 0.1f, 0.1f });
-
-	Mesh	*ironman = new Mesh(logicalDevice, ENGINE_DATA_PATH"Models/ironman/ironman.fbx", "IronMan");
-	AddObject(ironman);
-	m_Meshes.push_back(ironman);
-	m_RenderHandle->PrepareTexture(logicalDevice, ironman->GetMaterial().GetTexture());
-	m_Meshes[2]->SetPosition({ 0.f, 2.f, 0.f });
-
 	LightData lightData;
 	{
 		lightData.m_Color = glm::vec4(1, 1, 1, 1);
@@ -107,8 +120,8 @@ bool	Scene::Setup(const VkDevice logicalDevice)
 	AddLight(new Light(0, "Light", lightData));
 	m_Lights[0]->SetEulerAngles({ -45.f, 0.f, 0.f });
 
-	m_Skybox = Skybox(logicalDevice, ENGINE_DATA_PATH"Skyboxes/Teide/", ".jpg");
-	m_RenderHandle->PrepareSkybox(logicalDevice, m_Skybox);
+	// only the skybox is pending, nothing can be created without it
+	assetLoader->RunUntilIdle();
 
 	// load shaders
 	VkShaderModule	meshVertexShaderModule = nullptr;
@@ -135,12 +148,56 @@ bool	Scene::Setup(const VkDevice logicalDevice)
 		!CreateShaderModule(logicalDevice, LoadFile(ENGINE_DATA_PATH"Shaders/ShadowSpotLight.vert.spv", shadersOpenMode), shadowSpotLightVertexShaderModule)) // Only for SpotLight shadowMap
 		return false;
 
+	// the indirect path is optional, without its shaders every mesh stays on the CPU path
+	std::vector<VkShaderModule>	indirectModules;
+	if (Device::m_Device->UsesGpuCulling())
+	{
+		const std::vector<char>	indirectByteCodes[4] =
+		{
+			LoadFile(ENGINE_DATA_PATH"Shaders/MeshIndirect.vert.spv", shadersOpenMode),
+			LoadFile(ENGINE_DATA_PATH"Shaders/MeshIndirect.frag.spv", shadersOpenMode),
+			LoadFile(ENGINE_DATA_PATH"Shaders/ShadowCascadeIndirect.vert.spv", shadersOpenMode),
+			LoadFile(ENGINE_DATA_PATH"Shaders/CullMeshes.comp.spv", shadersOpenMode),
+		};
+
+		if (std::none_of(std::begin(indirectByteCodes), std::end(indirectByteCodes), [](const std::vector<char> &byteCode) { return byteCode.empty(); }))
+		{
+			indirectModules.resize(4, nullptr);
+			for (uint32_t moduleIndex = 0; moduleIndex < 4; ++moduleIndex)
+			{
+				if (!CreateShaderModule(logicalDevice, indirectByteCodes[moduleIndex], indirectModules[moduleIndex]))
+					return false;
+			}
+		}
+		else
+			std::cout << "GPU culling shaders not found, meshes are culled on the CPU" << std::endl; // TODO: change this for real logger
+
+		if (!indirectModules.empty() && Device::m_Device->UsesOcclusionCulling())
+		{
+			// the multisampled depth is resolved to its farthest sample by its own shader
+			const bool				isDepthMultisampled = (Device::m_Device->GetMaxAALevel() != VK_SAMPLE_COUNT_1_BIT);
+			const std::vector<char>	pyramidByteCode = LoadFile(ENGINE_DATA_PATH"Shaders/DepthPyramid.comp.spv", shadersOpenMode);
+			const std::vector<char>	pyramidResolveByteCode = (isDepthMultisampled) ? LoadFile(ENGINE_DATA_PATH"Shaders/DepthPyramidResolve.comp.spv", shadersOpenMode) : std::vector<char>();
+
+			if (!pyramidByteCode.empty() && (!isDepthMultisampled || !pyramidResolveByteCode.empty()))
+			{
+				indirectModules.resize(6, nullptr);
+				if (!CreateShaderModule(logicalDevice, pyramidByteCode, indirectModules[4]) ||
+					(isDepthMultisampled && !CreateShaderModule(logicalDevice, pyramidResolveByteCode, indirectModules[5])))
+					return false;
+			}
+			else
+				std::cout << "Depth pyramid shaders not found, meshes are not occlusion culled" << std::endl; // TODO: change this for real logger
+		}
+	}
+
 	if (!CreateGraphicsPipelines(logicalDevice,
 								{ meshVertexShaderModule, meshFragShaderModule },
 								{ offscreenVertexShaderModule, offscreenFragShaderModule },
 								{ skyboxVertexShaderModule, skyboxFragShaderModule }, 
 								{ shadowCascadeVertexShaderModule },
-								{ shadowSpotLightVertexShaderModule }))
+								{ shadowSpotLightVertexShaderModule },
+								indirectModules))
 		return false;
 
 	vkDestroyShaderModule(logicalDevice, meshVertexShaderModule, nullptr);
@@ -152,57 +209,101 @@ bool	Scene::Setup(const VkDevice logicalDevice)
 	vkDestroyShaderModule(logicalDevice, shadowCascadeVertexShaderModule, nullptr);
 	vkDestroyShaderModule(logicalDevice, shadowSpotLightVertexShaderModule, nullptr);
 
+	// the resolve module is null without multisampling
+	for (const VkShaderModule indirectModule : indirectModules)
+		vkDestroyShaderModule(logicalDevice, indirectModule, nullptr);
+
+	// imported meshes stream in from the next frames on, they need the pipelines and their descriptor layouts
+	assetLoader->Spawn(LoadMesh(logicalDevice, ENGINE_DATA_PATH"Models/Teapot/teapot.obj", "Teapot", ENGINE_DATA_PATH"Textures/Basic.jpg", { 1.f, 0.f, 0.f }, { 0.1f, 0.1f, 0.1f }));
+	assetLoader->Spawn(LoadMesh(logicalDevice, ENGINE_DATA_PATH"Models/ironman/ironman.fbx", "IronMan", "", { 0.f, 2.f, 0.f }, { 1.f, 1.f, 1.f }));
+
 	return true;
 }
 
 //----------------------------------------------------------------
 
-void	Scene::Prepare(const VkDevice logicalDevice)
+bool	Scene::Prepare(const VkDevice logicalDevice)
 {
-	const uint8_t	currentFrame = m_RenderHandle->GetCurrentFrame();
+	PROFILE_ZONE("Scene::Prepare");
 
-	VP				vp = { };
-	{
-		vp.m_View = m_Camera->GetView();
-		vp.m_Proj = m_Camera->GetProjection();
-	}
+	// the frame slot was waited for in BeginRender
+	CollectReleasedMeshes();
+
+	// before anything can bail out, the descriptor sets must not keep images the streaming released
+	UpdateMeshTextures(logicalDevice, m_Camera->GetView(), m_Camera->GetProjection());
+
+	UniformArena			*uniformArena = m_RenderHandle->GetCurrentUniformArena();
+	UniformOffsets			offsets;
+
+	const uint32_t			meshesCount = static_cast<uint32_t>(m_Meshes.size());
 
-	const std::vector<VP>	vpData = { vp };
-	m_VPBuffers[currentFrame].UpdateData(logicalDevice, vpData);
+	// before anything can bail out too, meshes added since the last selection are drawn at full detail,
+	// and every pass draws the meshes culled this frame
+	m_MeshLods.resize(meshesCount);
+
+	const glm::mat4			view = m_Camera->GetView();
+	const glm::mat4			proj = m_Camera->GetProjection();
 
 	if (m_Lights.size() > 0)
 	{
-		m_Shadow->UpdateCascadeShadow(m_Lights[0]->GetPosition(), vp.m_Proj, vp.m_View);
+		m_Shadow->UpdateCascadeShadow(m_Lights[0]->GetPosition(), proj, view);
 	}
 
-	const std::vector<ShadowInfoCascade> shadowInfoCascadeData = { m_Shadow->GetShadowInfoCascade() };
-	m_ShadowCascadeBuffers[currentFrame].UpdateData(logicalDevice, shadowInfoCascadeData);
+	UpdateObjectsBvh();
+	CullMeshes(proj * view);
+	UpdateGpuCulling(logicalDevice, proj * view);
+	ClearDirtyObjects();
 
-	const uint32_t			meshesCount = static_cast<uint32_t>(m_Meshes.size());
+	// per frame constants are written in place in the mapped arena of the frame,
+	// meshes get one aligned entry per cascade and spot light shadow views one aligned entry each
+	const VkDeviceSize		meshesSize = meshesCount * SHADOWMAP_CASCADE_COUNT * m_PerMeshBufferAlignment;
+	const VkDeviceSize		spotLightsSize = SHADOWMAP_SPOTLIGHT_COUNT * m_PerSpotShadowBufferAlignment;
+	const VkDeviceSize		uniformsSize =	uniformArena->GetAlignedSize(sizeof(VP)) +
+											uniformArena->GetAlignedSize(sizeof(ShadowInfoCascade)) +
+											uniformArena->GetAlignedSize(sizeof(UBOLights)) +
+											uniformArena->GetAlignedSize(meshesSize) +
+											uniformArena->GetAlignedSize(spotLightsSize);
+
+	// the offsets recorded this frame must all come from its arena, nothing is drawn when it can't hold them
+	if (!ReserveUniformArena(logicalDevice, uniformsSize))
+		return false;
+
+	VP						*vp = uniformArena->Allocate<VP>(1, offsets.m_VP);
+	ShadowInfoCascade		*shadowInfoCascade = uniformArena->Allocate<ShadowInfoCascade>(1, offsets.m_ShadowCascade);
+	UBOLights				*lightsData = uniformArena->Allocate<UBOLights>(1, offsets.m_Lights);
+	char					*meshesData = static_cast<char*>(uniformArena->Allocate(meshesSize, offsets.m_Meshes));
+	char					*spotLightsData = static_cast<char*>(uniformArena->Allocate(spotLightsSize, offsets.m_ShadowSpotLight));
+
+	m_UniformOffsets = offsets;
+
+	vp->m_View = view;
+	vp->m_Proj = proj;
+
+	(*shadowInfoCascade) = m_Shadow->GetShadowInfoCascade();
 
 	for (uint32_t meshIndex = 0; meshIndex < meshesCount; ++meshIndex)
 	{
+		Mesh		*mesh = m_Meshes[meshIndex];
+		const Material	&material = mesh->GetMaterial();
+
 		for (uint32_t cascadeIndex = 0; cascadeIndex < SHADOWMAP_CASCADE_COUNT; ++cascadeIndex)
 		{
-			MeshData	*meshData = reinterpret_cast<MeshData*>((reinterpret_cast<uint64_t>(m_MeshesData) + ((meshIndex * SHADOWMAP_CASCADE_COUNT + cascadeIndex) * m_PerMeshBufferAlignment)));
-			Mesh		*mesh = m_Meshes[meshIndex];
+			MeshData	*meshData = reinterpret_cast<MeshData*>(meshesData + (meshIndex * SHADOWMAP_CASCADE_COUNT + cascadeIndex) * m_PerMeshBufferAlignment);
 
-			(*meshData).m_Model = mesh->GetModel();
+			meshData->m_Model = mesh->GetModel() * mesh->GetDequantization();
 
-			Material	&material = mesh->GetMaterial();
-			(*meshData).m_Material.m_Albedo = material.GetAlbedo();
-			(*meshData).m_Material.m_Roughness = material.GetRoughness();
-			(*meshData).m_Material.m_Metallic = material.GetMetallic();
-			(*meshData).m_Material.m_Reflectance = material.GetReflectance();
+			meshData->m_Material.m_Albedo = material.GetAlbedo();
+			meshData->m_Material.m_Roughness = material.GetRoughness();
+			meshData->m_Material.m_Metallic = material.GetMetallic();
+			meshData->m_Material.m_Reflectance = material.GetReflectance();
 
-			(*meshData).m_CascadeShadowIndex = cascadeIndex;
+			meshData->m_CascadeShadowIndex = cascadeIndex;
 
-			(*meshData).m_LodBias = mesh->GetLodBias();
+			meshData->m_LodBias = mesh->GetLodBias();
 		}
 	}
 
-	m_PerMeshBuffers[currentFrame].UpdateData(logicalDevice, m_MeshesData);
-
+	// lights are transformed on the stack, mapped memory is only written once
 	UBOLights	lights = {};
 	lights.m_count = m_Lights.size();
 
@@ -214,17 +315,230 @@ void	Scene::Prepare(const VkDevice logicalDevice)
 		lights.m_lights[lightIndex].m_Direction = glm::vec4(lightDir, 1.0);
 	}
 
-	const std::vector<UBOLights> lightData = { lights };
-	m_LightBuffers[currentFrame].UpdateData(logicalDevice, lightData);
+	(*lightsData) = lights;
 
-	// WARNING only 4 max spotLight 
-	for (uint32_t lightIndex = 0; lightIndex < m_Lights.size(); ++lightIndex)
+	// one shadow view for each of the first SHADOWMAP_SPOTLIGHT_COUNT spot lights, views without light are cleared
+	memset(spotLightsData, 0, static_cast<size_t>(SHADOWMAP_SPOTLIGHT_COUNT * m_PerSpotShadowBufferAlignment));
+
+	uint32_t				spotLightShadowsCount = 0;
+	for (uint32_t lightIndex = 0; lightIndex < m_Lights.size() && spotLightShadowsCount < SHADOWMAP_SPOTLIGHT_COUNT; ++lightIndex)
+	{
+		if (m_Lights[lightIndex]->GetType() != (uint32_t)OBJECT_TYPE::SpotLight)
+			continue;
+
+		m_Shadow->UpdateSpotLightShadow(spotLightShadowsCount, m_Lights[lightIndex], proj, view);
+
+		ShadowInfoSpotLight	*shadowInfo = reinterpret_cast<ShadowInfoSpotLight*>(spotLightsData + spotLightShadowsCount * m_PerSpotShadowBufferAlignment);
+		(*shadowInfo) = m_Shadow->GetShadowInfoSpotLight(spotLightShadowsCount);
+
+		++spotLightShadowsCount;
+	}
+
+	// meshes in the light frustum cast in its view, views without light keep an empty caster list
+	const float				shadowHeight = static_cast<float>(m_Shadow->GetExtent2D().height);
+	const uint32_t			shadowViewsCount = static_cast<uint32_t>(m_ShadowViewsSpotLight.size());
+	for (uint32_t viewIndex = 0; viewIndex < shadowViewsCount; ++viewIndex)
+	{
+		ShadowView	&shadowView = m_ShadowViewsSpotLight[viewIndex];
+		shadowView.m_Casters.clear();
+
+		if (viewIndex >= spotLightShadowsCount)
+			continue;
+
+		QueryMeshes(FrustumCulling::MakeView(m_Shadow->GetShadowInfoSpotLight(viewIndex).m_LightSpace, shadowHeight, 0.f), shadowView.m_Casters);
+	}
+
+	SelectMeshLods(proj * view);
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	Scene::ReserveUniformArena(const VkDevice logicalDevice, VkDeviceSize size)
+{
+	const uint32_t	frameIndex = m_RenderHandle->GetCurrentFrame();
+	UniformArena	*uniformArena = m_RenderHandle->GetUniformArena(frameIndex);
+
+	if (size <= uniformArena->GetSize())
+		return true;
+
+	// the frame slot was waited for in BeginRender, neither the buffer nor the sets of the frame are in use
+	const VkBuffer	previousBuffer = uniformArena->GetApiBuffer();
+
+	if (!uniformArena->Reserve(logicalDevice, size))
+	{
+		std::cout << "Can't grow uniform arena to " << size << " bytes, frame not drawn" << std::endl; // TODO: change this for real logger
+		return false;
+	}
+
+	const VkBuffer	uniformBuffer = uniformArena->GetApiBuffer();
+
+	for (UniformDescription &uniformDescription : m_UniformDescriptions)
+		uniformDescription.ReplaceBuffer(logicalDevice, frameIndex, previousBuffer, uniformBuffer);
+
+	m_SkyboxUniformDescription->ReplaceBuffer(logicalDevice, frameIndex, previousBuffer, uniformBuffer);
+
+	if (m_GpuCulling != nullptr)
+		m_GpuCulling->UpdateUniformBuffer(logicalDevice, frameIndex);
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	Scene::CullMeshes(const glm::mat4 &viewProj)
+{
+	PROFILE_ZONE("Scene::CullMeshes");
+
+	const CullingView	cullingView = FrustumCulling::MakeView(viewProj, static_cast<float>(m_RenderHandle->GetSwapchainExtent().height), m_CullingMinPixels);
+
+	// the culling pass handles every mesh when none is left on the CPU path, the tree isn't walked for them
+	const bool			hasCpuMeshes = m_CpuCulledMeshesCount > 0;
+
+	// the tree rejects whole groups of boxes, the kernel tests the tighter bounds and the size of what is left
+	m_CullingMeshes.clear();
+	if (hasCpuMeshes)
+	{
+		QueryMeshes(cullingView, m_CullingMeshes);
+		RemoveGpuCulledMeshes(m_CullingMeshes);
+	}
+
+	const uint32_t		candidatesCount = static_cast<uint32_t>(m_CullingMeshes.size());
+
+	m_CullingBounds.Resize(candidatesCount);
+
+	for (uint32_t candidateIndex = 0; candidateIndex < candidatesCount; ++candidateIndex)
+	{
+		Mesh	*mesh = m_Meshes[m_CullingMeshes[candidateIndex]];
+		m_CullingBounds.SetTransformed(candidateIndex, mesh->GetModel(), mesh->GetBoundsMin(), mesh->GetBoundsMax(), mesh->GetBoundsRadius());
+	}
+
+	m_VisibleMeshes.clear();
+	FrustumCulling::Cull(cullingView, m_CullingBounds, m_VisibleMeshes);
+
+	for (uint32_t &visibleMesh : m_VisibleMeshes)
+		visibleMesh = m_CullingMeshes[visibleMesh];
+
+	// a mesh usually lies in one or two cascades, without light the cascades are only cleared
+	for (uint32_t cascadeIndex = 0; cascadeIndex < SHADOWMAP_CASCADE_COUNT; ++cascadeIndex)
+	{
+		m_CascadeCasters[cascadeIndex].clear();
+
+		if (hasCpuMeshes && m_Lights.size() > 0)
+		{
+			QueryMeshes(m_Shadow->GetCascadeCullingView(cascadeIndex), m_CascadeCasters[cascadeIndex]);
+			RemoveGpuCulledMeshes(m_CascadeCasters[cascadeIndex]);
+		}
+	}
+}
+
+//----------------------------------------------------------------
+
+void	Scene::RemoveGpuCulledMeshes(std::vector<uint32_t> &meshes) const
+{
+	if (m_GpuCulling == nullptr)
+		return;
+
+	// the culling pass handles them, the spot light views still draw them on the CPU
+	meshes.erase(std::remove_if(meshes.begin(), meshes.end(), [this](uint32_t meshIndex) { return m_MeshCullingSlots[meshIndex] != UINT32_MAX; }), meshes.end());
+}
+
+//----------------------------------------------------------------
+
+void	Scene::UpdateGpuCulling(const VkDevice logicalDevice, const glm::mat4 &viewProj)
+{
+	if (m_GpuCulling == nullptr)
+		return;
+
+	PROFILE_ZONE("Scene::UpdateGpuCulling");
+
+	// only the meshes moved or edited since the last frame are rebuilt and copied to the frame slots
+	for (Object *object : m_DirtyObjects)
+	{
+		if (object->GetType() != OBJECT_TYPE::Mesh)
+			continue;
+
+		const uint32_t	meshIndex = m_ProxyMeshes[m_ObjectsProxies[object]];
+		if (m_MeshCullingSlots[meshIndex] != UINT32_MAX)
+			m_GpuCulling->UpdateObject(m_MeshCullingSlots[meshIndex], m_Meshes[meshIndex]);
+	}
+
+	const CullingView	cameraView = FrustumCulling::MakeView(viewProj, static_cast<float>(m_RenderHandle->GetSwapchainExtent().height), m_CullingMinPixels);
+
+	// without light the cascades are only cleared, as on the CPU path
+	CullingView			cascadeViews[SHADOWMAP_CASCADE_COUNT];
+	const uint32_t		cascadeViewsCount = (m_Lights.size() > 0) ? SHADOWMAP_CASCADE_COUNT : 0;
+
+	for (uint32_t cascadeIndex = 0; cascadeIndex < cascadeViewsCount; ++cascadeIndex)
+		cascadeViews[cascadeIndex] = m_Shadow->GetCascadeCullingView(cascadeIndex);
+
+	m_GpuCulling->UpdateFrame(logicalDevice, m_RenderHandle->GetCurrentFrame(), cameraView, viewProj, m_LodErrorPixels, cascadeViews, cascadeViewsCount, m_ShadowLodErrorPixels);
+}
+
+//----------------------------------------------------------------
+
+uint32_t	Scene::GetCascadeCastersCount() const
+{
+	uint32_t	castersCount = 0;
+
+	for (const std::vector<uint32_t> &casters : m_CascadeCasters)
+		castersCount += static_cast<uint32_t>(casters.size());
+
+	return castersCount;
+}
+
+//----------------------------------------------------------------
+
+void	Scene::SelectMeshLods(const glm::mat4 &viewProj)
+{
+	PROFILE_ZONE("Scene::SelectMeshLods");
+
+	const float					screenHeight = static_cast<float>(m_RenderHandle->GetSwapchainExtent().height);
+	const float					shadowHeight = static_cast<float>(m_Shadow->GetExtent2D().height);
+	const ShadowInfoCascade		shadowInfoCascade = m_Shadow->GetShadowInfoCascade();
+
+	m_ObjectsTrianglesCount = 0;
+	m_ShadowTrianglesCount = 0;
+
+	// culled meshes aren't drawn by the main passes, their level is left as is
+	for (const uint32_t meshIndex : m_VisibleMeshes)
+	{
+		const Mesh			*mesh = m_Meshes[meshIndex];
+		MeshLodSelection	&meshLods = m_MeshLods[meshIndex];
+
+		meshLods.m_Objects = mesh->SelectLod(viewProj, screenHeight, m_LodErrorPixels);
+		m_ObjectsTrianglesCount += mesh->GetLodIndicesCount(meshLods.m_Objects) / 3;
+	}
+
+	// each shadow view selects on its own, a far cascade covers more of the world per texel than a near one
+	for (uint32_t cascadeIndex = 0; cascadeIndex < SHADOWMAP_CASCADE_COUNT; ++cascadeIndex)
 	{
-		if (m_Lights[lightIndex]->GetType() == (uint32_t)OBJECT_TYPE::SpotLight)
+		for (const uint32_t meshIndex : m_CascadeCasters[cascadeIndex])
 		{
-			m_Shadow->UpdateSpotLightShadow(m_Lights[lightIndex], vp.m_Proj, vp.m_View);
-			const std::vector<ShadowInfoSpotLight> shadowSpotLight = { m_Shadow->GetShadowInfoSpotLight() };
-			m_ShadowSpotLightBuffers[currentFrame].UpdateData(logicalDevice, shadowSpotLight);
+			const Mesh			*mesh = m_Meshes[meshIndex];
+			MeshLodSelection	&meshLods = m_MeshLods[meshIndex];
+
+			meshLods.m_Cascades[cascadeIndex] = mesh->SelectLod(shadowInfoCascade.m_LightSpace[cascadeIndex], shadowHeight, m_ShadowLodErrorPixels);
+			m_ShadowTrianglesCount += mesh->GetLodIndicesCount(meshLods.m_Cascades[cascadeIndex]) / 3;
+		}
+	}
+
+	const uint32_t				shadowViewsCount = static_cast<uint32_t>(m_ShadowViewsSpotLight.size());
+	for (uint32_t viewIndex = 0; viewIndex < shadowViewsCount; ++viewIndex)
+	{
+		ShadowView			&shadowView = m_ShadowViewsSpotLight[viewIndex];
+		const glm::mat4		lightSpace = m_Shadow->GetShadowInfoSpotLight(viewIndex).m_LightSpace;
+
+		shadowView.m_CasterLods.resize(shadowView.m_Casters.size());
+
+		const uint32_t		castersCount = static_cast<uint32_t>(shadowView.m_Casters.size());
+		for (uint32_t casterIndex = 0; casterIndex < castersCount; ++casterIndex)
+		{
+			const Mesh		*mesh = m_Meshes[shadowView.m_Casters[casterIndex]];
+
+			shadowView.m_CasterLods[casterIndex] = mesh->SelectLod(lightSpace, shadowHeight, m_ShadowLodErrorPixels);
+			m_ShadowTrianglesCount += mesh->GetLodIndicesCount(shadowView.m_CasterLods[casterIndex]) / 3;
 		}
 	}
 }
@@ -233,12 +547,34 @@ void	Scene::Prepare(const VkDevice logicalDevice)
 
 void	Scene::Render(const UI *ui)
 {
+	PROFILE_ZONE("Scene::Render");
+
+	const chrono_time				startTime = std::chrono::high_resolution_clock::now();
+
 	const VkCommandBuffer			commandBuffer = m_RenderHandle->GetCurrentCommandBuffer();
 
-	const uint32_t					imageIndex = m_RenderHandle->GetCurrentFrame();// SwapchainImage();
+	const uint32_t					frameIndex = m_RenderHandle->GetCurrentFrame();
+	const uint32_t					imageIndex = m_RenderHandle->GetCurrentSwapchainImage();
 	const std::vector<VkClearValue>	&clearValues = m_RenderHandle->GetClearValues();
-	const uint8_t					currentFrame = m_RenderHandle->GetCurrentFrame();
-	const uint32_t					meshesCount = static_cast<uint32_t>(m_Meshes.size());
+
+	const VkSubpassContents			subpassContents = (IsRecordingParallel()) ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+
+	// draw lists of the camera and the cascades, written before any render pass reads them
+	const bool						drawsIndirect = (m_GpuCulling != nullptr);
+	const bool						drawsCascadesIndirect = (drawsIndirect && m_Lights.size() > 0);
+
+	// with occlusion culling the camera opaque lists are split around the build of the depth pyramid, the first frame tests nothing
+	const bool						usesOcclusion = (m_DepthPyramid != nullptr);
+
+	if (drawsIndirect)
+	{
+		const uint32_t		cullingPhase = (usesOcclusion) ? GPU_CULLING_PHASE_EARLY : GPU_CULLING_PHASE_ALL;
+		const VkExtent2D	pyramidExtent = (usesOcclusion && m_DepthPyramid->IsBuilt()) ? m_DepthPyramid->GetExtent() : VkExtent2D{ 0, 0 };
+
+		const uint32_t		cullingScope = BeginGpuScope(commandBuffer, nullptr, "GPU culling");
+		m_GpuCulling->RecordCulling(commandBuffer, frameIndex, cullingPhase, pyramidExtent);
+		EndGpuScope(commandBuffer, nullptr, cullingScope);
+	}
 
 	// RenderPass Shadow
 	VkRenderPassBeginInfo			shadowRenderPassBeginInfo = { };
@@ -249,59 +585,65 @@ void	Scene::Render(const UI *ui)
 		shadowRenderPassBeginInfo.clearValueCount = 1;
 		shadowRenderPassBeginInfo.pClearValues = &clearValues[1];
 	}
-	// TODO -> RenderPass SpotLight -> sans cascade 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[5]);
 
-	// render meshes
-	for (uint32_t meshIndex = 0; meshIndex < meshesCount; ++meshIndex)
-	{
-		for (uint32_t spotLightIndex = 0; spotLightIndex < SHADOWMAP_SPOTLIGHT_COUNT; ++spotLightIndex)
-		{
-			shadowRenderPassBeginInfo.framebuffer = m_FrameBuffersShadowSpotLight[spotLightIndex]; // new for spotlight
-			vkCmdBeginRenderPass(commandBuffer, &shadowRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	// RenderPass SpotLight Shadow, one render pass per view for its whole caster list
+	const uint32_t					spotLightShadowScope = BeginGpuScope(commandBuffer, nullptr, "Shadow spot lights");
 
-			// Set depth bias (aka "Polygon offset")
-			// Required to avoid shadow mapping artefacts
-			vkCmdSetDepthBias(commandBuffer, 1.25f, 0.0f, 1.75f);
+	const uint32_t					shadowViewsCount = static_cast<uint32_t>(m_ShadowViewsSpotLight.size());
+	for (uint32_t viewIndex = 0; viewIndex < shadowViewsCount; ++viewIndex)
+	{
+		const ShadowView	&shadowView = m_ShadowViewsSpotLight[viewIndex];
+		const uint32_t		castersCount = static_cast<uint32_t>(shadowView.m_Casters.size());
 
-			uint32_t	perMeshBufferOffset = meshIndex * m_PerMeshBufferAlignment * SHADOWMAP_CASCADE_COUNT;
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PiplelineLayoutShadowCascade, 0, 1, &m_UniformDescriptions[1].GetDescriptors()[imageIndex], 1, &perMeshBufferOffset);
+		// a view without casters is still cleared so its layer stays readable by the objects pass
+		shadowRenderPassBeginInfo.framebuffer = shadowView.m_FrameBuffer;
+		vkCmdBeginRenderPass(commandBuffer, &shadowRenderPassBeginInfo, (castersCount > 0) ? subpassContents : VK_SUBPASS_CONTENTS_INLINE);
 
-			m_Meshes[meshIndex]->Render(commandBuffer, 0);
-			m_Meshes[meshIndex]->Render(commandBuffer, 1);
-			
-			vkCmdEndRenderPass(commandBuffer);
+		if (castersCount > 0)
+		{
+			RecordMeshes(commandBuffer, shadowRenderPassBeginInfo, castersCount, [this, &shadowView](const VkCommandBuffer recordBuffer, uint32_t firstCaster, uint32_t lastCaster)
+			{
+				RecordShadowView(recordBuffer, shadowView, firstCaster, lastCaster);
+			});
 		}
+
+		vkCmdEndRenderPass(commandBuffer);
 	}
 
+	EndGpuScope(commandBuffer, nullptr, spotLightShadowScope);
 
 	// RenderPass Directionnal Light Shadow Cascade
-
-	// bind pipeline
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[4]);
+	static const char				*cascadeScopeNames[SHADOWMAP_CASCADE_COUNT] = { "Shadow cascade 0", "Shadow cascade 1", "Shadow cascade 2", "Shadow cascade 3" };
 
 	for (uint32_t cascadeIndex = 0; cascadeIndex < SHADOWMAP_CASCADE_COUNT; ++cascadeIndex)
 	{
-		// Update framebuffer for cascade framebuffer
+		const uint32_t	cascadeScope = BeginGpuScope(commandBuffer, nullptr, cascadeScopeNames[cascadeIndex]);
+		const uint32_t	castersCount = static_cast<uint32_t>(m_CascadeCasters[cascadeIndex].size());
+
+		// Update framebuffer for cascade framebuffer, a cascade without casters is still cleared
 		shadowRenderPassBeginInfo.framebuffer = m_FrameBuffersShadowCascade[cascadeIndex];
-		vkCmdBeginRenderPass(commandBuffer, &shadowRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &shadowRenderPassBeginInfo, (castersCount > 0 || drawsCascadesIndirect) ? subpassContents : VK_SUBPASS_CONTENTS_INLINE);
 
-		// render meshes
-		for (uint32_t meshIndex = 0; meshIndex < meshesCount; ++meshIndex)
+		if (castersCount > 0)
 		{
-			// Set depth bias (aka "Polygon offset")
-			// Required to avoid shadow mapping artefacts
-			vkCmdSetDepthBias(commandBuffer, 1.25f, 0.0f, 1.75f);
-
-			uint32_t	perMeshBufferOffset = ((meshIndex * SHADOWMAP_CASCADE_COUNT + cascadeIndex) * m_PerMeshBufferAlignment);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PiplelineLayoutShadowCascade, 0, 1, &m_UniformDescriptions[1].GetDescriptors()[imageIndex], 1, &perMeshBufferOffset);
+			RecordMeshes(commandBuffer, shadowRenderPassBeginInfo, castersCount, [this, cascadeIndex](const VkCommandBuffer recordBuffer, uint32_t firstCaster, uint32_t lastCaster)
+			{
+				RecordShadowCascade(recordBuffer, cascadeIndex, firstCaster, lastCaster);
+			});
+		}
 
-			m_Meshes[meshIndex]->Render(commandBuffer, 0);
-			m_Meshes[meshIndex]->Render(commandBuffer, 1);
+		if (drawsCascadesIndirect)
+		{
+			RecordSingle(commandBuffer, shadowRenderPassBeginInfo, [this, cascadeIndex](const VkCommandBuffer recordBuffer)
+			{
+				RecordShadowCascadeIndirect(recordBuffer, cascadeIndex);
+			});
 		}
 
 		// end render
 		vkCmdEndRenderPass(commandBuffer);
+
+		EndGpuScope(commandBuffer, nullptr, cascadeScope);
 	}
 
 
@@ -316,60 +658,340 @@ void	Scene::Render(const UI *ui)
 		renderPassBeginInfo.pClearValues = clearValues.data();
 	}
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, subpassContents);
 
-	// bind pipeline
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[0]);
-	
 	// subpass 0
 	// render opaque meshes
-	for (uint32_t meshIndex = 0; meshIndex < meshesCount; ++meshIndex)
+	uint32_t						scope = BeginGpuScope(commandBuffer, &renderPassBeginInfo, "Opaque");
+
+	const uint32_t					visibleMeshesCount = static_cast<uint32_t>(m_VisibleMeshes.size());
+
+	RecordMeshes(commandBuffer, renderPassBeginInfo, visibleMeshesCount, [this](const VkCommandBuffer recordBuffer, uint32_t firstVisible, uint32_t lastVisible)
 	{
-		uint32_t	perMeshBufferOffset = meshIndex * m_PerMeshBufferAlignment * SHADOWMAP_CASCADE_COUNT;
+		RecordObjects(recordBuffer, 0, 1, firstVisible, lastVisible);
+	});
 
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayoutObjects, 0, 1, &m_UniformDescriptions[meshIndex + 2].GetDescriptors()[imageIndex], 1, &perMeshBufferOffset);
-	
-		m_Meshes[meshIndex]->Render(commandBuffer, 1);
+	if (drawsIndirect)
+	{
+		RecordSingle(commandBuffer, renderPassBeginInfo, [this](const VkCommandBuffer recordBuffer)
+		{
+			RecordObjectsIndirect(recordBuffer, 6, GPU_CULLING_LIST_OPAQUE);
+		});
 	}
-	
+
+	EndGpuScope(commandBuffer, &renderPassBeginInfo, scope);
+
+	if (usesOcclusion)
+	{
+		vkCmdEndRenderPass(commandBuffer);
+
+		// farthest depth of what was drawn so far, the meshes it doesn't hide are drawn when the pass resumes
+		scope = BeginGpuScope(commandBuffer, nullptr, "Depth pyramid");
+		m_DepthPyramid->Record(commandBuffer, m_DepthImage);
+		EndGpuScope(commandBuffer, nullptr, scope);
+
+		scope = BeginGpuScope(commandBuffer, nullptr, "Occlusion culling");
+		m_GpuCulling->RecordCulling(commandBuffer, frameIndex, GPU_CULLING_PHASE_LATE, m_DepthPyramid->GetExtent());
+		EndGpuScope(commandBuffer, nullptr, scope);
+
+		renderPassBeginInfo.renderPass = m_RenderPassObjectsResume;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, subpassContents);
+
+		scope = BeginGpuScope(commandBuffer, &renderPassBeginInfo, "Opaque late");
+
+		RecordSingle(commandBuffer, renderPassBeginInfo, [this](const VkCommandBuffer recordBuffer)
+		{
+			RecordObjectsIndirect(recordBuffer, 6, GPU_CULLING_LIST_OPAQUE_LATE);
+		});
+
+		EndGpuScope(commandBuffer, &renderPassBeginInfo, scope);
+	}
+
 	// render skybox
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[1]);
-	uint32_t	offset = 0;
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Skybox.m_PipelineLayout, 0, 1, &m_UniformDescriptions[2].GetDescriptors()[imageIndex], 1, &offset);
-	m_Skybox.Render(commandBuffer);
-	
+	scope = BeginGpuScope(commandBuffer, &renderPassBeginInfo, "Skybox");
+
+	RecordSingle(commandBuffer, renderPassBeginInfo, [this, frameIndex](const VkCommandBuffer recordBuffer)
+	{
+		vkCmdBindPipeline(recordBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[1]);
+		const uint32_t	dynamicOffsets[5] = { m_UniformOffsets.m_VP, m_UniformOffsets.m_Meshes, m_UniformOffsets.m_Lights, m_UniformOffsets.m_ShadowCascade, m_UniformOffsets.m_ShadowSpotLight };
+		vkCmdBindDescriptorSets(recordBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Skybox.m_PipelineLayout, 0, 1, &m_SkyboxUniformDescription->GetDescriptors()[frameIndex], 5, dynamicOffsets);
+		m_Skybox.Render(recordBuffer);
+	});
+
+	EndGpuScope(commandBuffer, &renderPassBeginInfo, scope);
+
 	// render transparent meshes
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[2]);
-	for (uint32_t meshIndex = 0; meshIndex < meshesCount; ++meshIndex)
+	scope = BeginGpuScope(commandBuffer, &renderPassBeginInfo, "Transparent 0");
+
+	RecordMeshes(commandBuffer, renderPassBeginInfo, visibleMeshesCount, [this](const VkCommandBuffer recordBuffer, uint32_t firstVisible, uint32_t lastVisible)
+	{
+		RecordObjects(recordBuffer, 2, 0, firstVisible, lastVisible);
+	});
+
+	if (drawsIndirect)
 	{
-		uint32_t	perMeshBufferOffset = meshIndex * m_PerMeshBufferAlignment * SHADOWMAP_CASCADE_COUNT;
+		RecordSingle(commandBuffer, renderPassBeginInfo, [this](const VkCommandBuffer recordBuffer)
+		{
+			RecordObjectsIndirect(recordBuffer, 7, GPU_CULLING_LIST_TRANSPARENT);
+		});
+	}
+
+	EndGpuScope(commandBuffer, &renderPassBeginInfo, scope);
+
+	scope = BeginGpuScope(commandBuffer, &renderPassBeginInfo, "Transparent 1");
 
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayoutObjects, 0, 1, &m_UniformDescriptions[meshIndex + 2].GetDescriptors()[imageIndex], 1, &perMeshBufferOffset);
+	RecordMeshes(commandBuffer, renderPassBeginInfo, visibleMeshesCount, [this](const VkCommandBuffer recordBuffer, uint32_t firstVisible, uint32_t lastVisible)
+	{
+		RecordObjects(recordBuffer, 3, 0, firstVisible, lastVisible);
+	});
 
-		m_Meshes[meshIndex]->Render(commandBuffer, 0);
+	if (drawsIndirect)
+	{
+		RecordSingle(commandBuffer, renderPassBeginInfo, [this](const VkCommandBuffer recordBuffer)
+		{
+			RecordObjectsIndirect(recordBuffer, 8, GPU_CULLING_LIST_TRANSPARENT);
+		});
 	}
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[3]);
-	for (uint32_t meshIndex = 0; meshIndex < meshesCount; ++meshIndex)
+	EndGpuScope(commandBuffer, &renderPassBeginInfo, scope);
+
+	// render UI, there is none when running headless
+	if (ui != nullptr)
 	{
-		uint32_t	perMeshBufferOffset = meshIndex * m_PerMeshBufferAlignment * SHADOWMAP_CASCADE_COUNT;
+		scope = BeginGpuScope(commandBuffer, &renderPassBeginInfo, "UI");
 
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayoutObjects, 0, 1, &m_UniformDescriptions[meshIndex + 2].GetDescriptors()[imageIndex], 1, &perMeshBufferOffset);
+		RecordSingle(commandBuffer, renderPassBeginInfo, [ui](const VkCommandBuffer recordBuffer)
+		{
+			const_cast<UI*>(ui)->Render(recordBuffer);
+		});
 
-		m_Meshes[meshIndex]->Render(commandBuffer, 0);
+		EndGpuScope(commandBuffer, &renderPassBeginInfo, scope);
 	}
 
-	// render UI
-	const_cast<UI*>(ui)->Render(commandBuffer);
-
 	// subpass 1
 	/*vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[1]);
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PiplelineLayoutOffscreen, 0, 1, &m_UniformDescriptions[0].GetDescriptors()[imageIndex], 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PiplelineLayoutOffscreen, 0, 1, &m_UniformDescriptions[0].GetDescriptors()[frameIndex], 0, nullptr);
 	vkCmdDraw(commandBuffer, 6, 1, 0, 0);*/
 
 	// end render
 	vkCmdEndRenderPass(commandBuffer);
+
+	// keep a smoothed record time so that thread counts can be compared from the UI
+	const float						recordTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+	m_RecordTime = (m_RecordTime == 0.f) ? recordTime : glm::mix(m_RecordTime, recordTime, 0.05f);
+	m_LastRecordTime = recordTime;
+}
+
+//----------------------------------------------------------------
+
+void	Scene::SetRecordThreadsCount(uint32_t threadsCount)
+{
+	m_RecordThreadsCount = glm::clamp(threadsCount, 1u, GetMaxRecordThreadsCount());
+}
+
+//----------------------------------------------------------------
+
+void	Scene::RecordMeshes(const VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo &renderPassBeginInfo, uint32_t meshesCount, const RecordMeshesFunction &recordFunction) const
+{
+	if (!IsRecordingParallel())
+	{
+		recordFunction(commandBuffer, 0, meshesCount);
+		return;
+	}
+
+	ThreadPool						*threadPool = m_RenderHandle->GetThreadPool();
+	const uint32_t					threadsCount = m_RecordThreadsCount;
+	const uint32_t					sliceSize = (meshesCount + threadsCount - 1) / threadsCount;
+
+	const VkCommandBufferInheritanceInfo	inheritanceInfo = Initializers::Command::InheritanceInfo(renderPassBeginInfo.renderPass, 0, renderPassBeginInfo.framebuffer);
+
+	std::vector<VkCommandBuffer>	secondaryBuffers(threadsCount);
+
+	for (uint32_t threadIndex = 0; threadIndex < threadsCount; ++threadIndex)
+	{
+		const uint32_t		firstMesh = std::min(threadIndex * sliceSize, meshesCount);
+		const uint32_t		lastMesh = std::min(firstMesh + sliceSize, meshesCount);
+
+		SecondaryCommand	*threadCommand = m_RenderHandle->GetThreadCommand(threadIndex);
+		VkCommandBuffer		*secondaryBuffer = &secondaryBuffers[threadIndex];
+
+		threadPool->Push(threadIndex, [threadCommand, secondaryBuffer, inheritanceInfo, firstMesh, lastMesh, &recordFunction]()
+		{
+			PROFILE_ZONE("Record meshes");
+
+			*secondaryBuffer = threadCommand->Begin(inheritanceInfo);
+			recordFunction(*secondaryBuffer, firstMesh, lastMesh);
+			threadCommand->End(*secondaryBuffer);
+		});
+	}
+
+	{
+		PROFILE_ZONE("Wait record threads");
+		threadPool->Wait();
+	}
+
+	// keep the mesh order by executing the slices in thread order
+	vkCmdExecuteCommands(commandBuffer, threadsCount, secondaryBuffers.data());
+}
+
+//----------------------------------------------------------------
+
+void	Scene::RecordSingle(const VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo &renderPassBeginInfo, const RecordFunction &recordFunction) const
+{
+	if (!IsRecordingParallel())
+	{
+		recordFunction(commandBuffer);
+		return;
+	}
+
+	// the last thread command is reserved to the main thread
+	SecondaryCommand						*mainCommand = m_RenderHandle->GetThreadCommand(GetMaxRecordThreadsCount());
+
+	const VkCommandBufferInheritanceInfo	inheritanceInfo = Initializers::Command::InheritanceInfo(renderPassBeginInfo.renderPass, 0, renderPassBeginInfo.framebuffer);
+	const VkCommandBuffer					secondaryBuffer = mainCommand->Begin(inheritanceInfo);
+
+	recordFunction(secondaryBuffer);
+
+	mainCommand->End(secondaryBuffer);
+
+	vkCmdExecuteCommands(commandBuffer, 1, &secondaryBuffer);
+}
+
+//----------------------------------------------------------------
+
+uint32_t	Scene::BeginGpuScope(const VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *renderPassBeginInfo, const char *name) const
+{
+	GpuProfiler	*profiler = m_RenderHandle->GetGpuProfiler();
+
+	if (renderPassBeginInfo == nullptr)
+		return profiler->BeginScope(commandBuffer, name);
+
+	// inside a render pass recorded with secondary command buffers, the timestamp has to go in one of them
+	uint32_t	scopeId = UINT32_MAX;
+	RecordSingle(commandBuffer, *renderPassBeginInfo, [profiler, name, &scopeId](const VkCommandBuffer recordBuffer)
+	{
+		scopeId = profiler->BeginScope(recordBuffer, name);
+	});
+
+	return scopeId;
+}
+
+//----------------------------------------------------------------
+
+void	Scene::EndGpuScope(const VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *renderPassBeginInfo, uint32_t scopeId) const
+{
+	GpuProfiler	*profiler = m_RenderHandle->GetGpuProfiler();
+
+	if (scopeId == UINT32_MAX)
+		return;
+
+	if (renderPassBeginInfo == nullptr)
+	{
+		profiler->EndScope(commandBuffer, scopeId);
+		return;
+	}
+
+	RecordSingle(commandBuffer, *renderPassBeginInfo, [profiler, scopeId](const VkCommandBuffer recordBuffer)
+	{
+		profiler->EndScope(recordBuffer, scopeId);
+	});
+}
+
+//----------------------------------------------------------------
+
+void	Scene::RecordShadowCascade(const VkCommandBuffer commandBuffer, uint32_t cascadeIndex, uint32_t firstCaster, uint32_t lastCaster) const
+{
+	const uint32_t	frameIndex = m_RenderHandle->GetCurrentFrame();
+
+	// bind pipeline
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[4]);
+
+	// Set depth bias (aka "Polygon offset")
+	// Required to avoid shadow mapping artefacts
+	vkCmdSetDepthBias(commandBuffer, 1.25f, 0.0f, 1.75f);
+
+	// render casters
+	for (uint32_t casterIndex = firstCaster; casterIndex < lastCaster; ++casterIndex)
+	{
+		const uint32_t	meshIndex = m_CascadeCasters[cascadeIndex][casterIndex];
+
+		// cascades offset, per mesh offset, then spot light shadow offset (unused by cascades)
+		const uint32_t	dynamicOffsets[3] = { m_UniformOffsets.m_ShadowCascade, m_UniformOffsets.m_Meshes + (meshIndex * SHADOWMAP_CASCADE_COUNT + cascadeIndex) * m_PerMeshBufferAlignment, m_UniformOffsets.m_ShadowSpotLight };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PiplelineLayoutShadowCascade, 0, 1, &m_UniformDescriptions[1].GetDescriptors()[frameIndex], 3, dynamicOffsets);
+
+		m_Meshes[meshIndex]->RenderDepth(commandBuffer, m_MeshLods[meshIndex].m_Cascades[cascadeIndex]);
+	}
+}
+
+//----------------------------------------------------------------
+
+void	Scene::RecordShadowView(const VkCommandBuffer commandBuffer, const ShadowView &shadowView, uint32_t firstCaster, uint32_t lastCaster) const
+{
+	const uint32_t	frameIndex = m_RenderHandle->GetCurrentFrame();
+
+	// bind pipeline
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[5]);
+
+	// Set depth bias (aka "Polygon offset")
+	// Required to avoid shadow mapping artefacts
+	vkCmdSetDepthBias(commandBuffer, 1.25f, 0.0f, 1.75f);
+
+	// render casters
+	for (uint32_t casterIndex = firstCaster; casterIndex < lastCaster; ++casterIndex)
+	{
+		const uint32_t	meshIndex = shadowView.m_Casters[casterIndex];
+
+		const uint32_t	dynamicOffsets[3] = { m_UniformOffsets.m_ShadowCascade, m_UniformOffsets.m_Meshes + meshIndex * m_PerMeshBufferAlignment * SHADOWMAP_CASCADE_COUNT, m_UniformOffsets.m_ShadowSpotLight + shadowView.m_InfoOffset };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PiplelineLayoutShadowCascade, 0, 1, &m_UniformDescriptions[1].GetDescriptors()[frameIndex], 3, dynamicOffsets);
+
+		m_Meshes[meshIndex]->RenderDepth(commandBuffer, shadowView.m_CasterLods[casterIndex]);
+	}
+}
+
+//----------------------------------------------------------------
+
+void	Scene::RecordObjects(const VkCommandBuffer commandBuffer, uint32_t pipelineIndex, uint32_t isOpaque, uint32_t firstVisible, uint32_t lastVisible) const
+{
+	const uint32_t	frameIndex = m_RenderHandle->GetCurrentFrame();
+
+	// bind pipeline
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[pipelineIndex]);
+
+	for (uint32_t visibleIndex = firstVisible; visibleIndex < lastVisible; ++visibleIndex)
+	{
+		const uint32_t	meshIndex = m_VisibleMeshes[visibleIndex];
+
+		// view and proj, per mesh, light, cascade shadow and spot light shadow offsets
+		const uint32_t	perMeshBufferOffset = m_UniformOffsets.m_Meshes + meshIndex * m_PerMeshBufferAlignment * SHADOWMAP_CASCADE_COUNT;
+		const uint32_t	dynamicOffsets[5] = { m_UniformOffsets.m_VP, perMeshBufferOffset, m_UniformOffsets.m_Lights, m_UniformOffsets.m_ShadowCascade, m_UniformOffsets.m_ShadowSpotLight };
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayoutObjects, 0, 1, &m_UniformDescriptions[meshIndex + 2].GetDescriptors()[frameIndex], 5, dynamicOffsets);
+
+		m_Meshes[meshIndex]->Render(commandBuffer, isOpaque, m_MeshLods[meshIndex].m_Objects);
+	}
+}
+
+//----------------------------------------------------------------
+
+void	Scene::RecordShadowCascadeIndirect(const VkCommandBuffer commandBuffer, uint32_t cascadeIndex) const
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[9]);
+	vkCmdSetDepthBias(commandBuffer, 1.25f, 0.0f, 1.75f);
+
+	m_GpuCulling->DrawCascade(commandBuffer, m_RenderHandle->GetCurrentFrame(), cascadeIndex, m_UniformOffsets.m_ShadowCascade);
+}
+
+//----------------------------------------------------------------
+
+void	Scene::RecordObjectsIndirect(const VkCommandBuffer commandBuffer, uint32_t pipelineIndex, uint32_t drawList) const
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinesObjects[pipelineIndex]);
+
+	// view and proj, light, cascade shadow and spot light shadow offsets, the objects come from the storage buffer
+	const uint32_t	dynamicOffsets[4] = { m_UniformOffsets.m_VP, m_UniformOffsets.m_Lights, m_UniformOffsets.m_ShadowCascade, m_UniformOffsets.m_ShadowSpotLight };
+
+	m_GpuCulling->DrawObjects(commandBuffer, m_RenderHandle->GetCurrentFrame(), drawList, dynamicOffsets);
 }
 
 //----------------------------------------------------------------
@@ -382,48 +1004,95 @@ void	Scene::Shutdown(const VkDevice logicalDevice)
 		delete m_Meshes[meshIndex];
 
 	m_Meshes.clear();
+	m_MeshCullingSlots.clear();
+	m_CpuCulledMeshesCount = 0;
+	m_DirtyObjects.clear();
 
-	const uint32_t	vpBuffersCount = static_cast<uint32_t>(m_VPBuffers.size());
-	for (uint32_t bufferIndex = 0; bufferIndex < vpBuffersCount; ++bufferIndex)
-		m_VPBuffers[bufferIndex].Destroy(logicalDevice);
+	// the device is idle, nothing in flight draws the released ones either
+	for (ReleasedMesh &releasedMesh : m_ReleasedMeshes)
+		delete releasedMesh.m_Mesh;
 
-	m_VPBuffers.clear();
+	m_ReleasedMeshes.clear();
 
-	const uint32_t	perMeshBuffersCount = static_cast<uint32_t>(m_PerMeshBuffers.size());
-	for (uint32_t bufferIndex = 0; bufferIndex < perMeshBuffersCount; ++bufferIndex)
-		m_PerMeshBuffers[bufferIndex].Destroy(logicalDevice);
+	if (m_GpuCulling != nullptr)
+	{
+		m_GpuCulling->Shutdown(logicalDevice);
+		delete m_GpuCulling;
+	}
 
-	m_PerMeshBuffers.clear();
+	m_GpuCulling = nullptr;
+
+	if (m_DepthPyramid != nullptr)
+	{
+		m_DepthPyramid->Shutdown(logicalDevice);
+		delete m_DepthPyramid;
+	}
+
+	m_DepthPyramid = nullptr;
 
 	// destroy frame buffers and pipelines
 	const uint32_t	frameBuffersCount = static_cast<uint32_t>(m_FrameBuffersObjects.size());
-	for (uint32_t frameIndex = 0; frameIndex < frameBuffersCount; ++frameIndex)
+	for (uint32_t imageIndex = 0; imageIndex < frameBuffersCount; ++imageIndex)
 	{
-		vkDestroyImage(logicalDevice, m_ImagesObjects[frameIndex], nullptr);
-		vkDestroyImageView(logicalDevice, m_ImageViewsObjects[frameIndex], nullptr);
-		vkFreeMemory(logicalDevice, m_ObjectsMemories[frameIndex], nullptr);
-
-		vkDestroyFramebuffer(logicalDevice, m_FrameBuffersObjects[frameIndex], nullptr);
+		vkDestroyImage(logicalDevice, m_ImagesObjects[imageIndex], nullptr);
+		vkDestroyImageView(logicalDevice, m_ImageViewsObjects[imageIndex], nullptr);
+		Device::m_Device->GetMemoryAllocator()->Free(m_ObjectsAllocations[imageIndex]);
 
-		vkDestroyPipeline(logicalDevice, m_GraphicsPipelinesObjects[frameIndex], nullptr);
+		vkDestroyFramebuffer(logicalDevice, m_FrameBuffersObjects[imageIndex], nullptr);
 	}
 
+	const uint32_t	pipelinesCount = static_cast<uint32_t>(m_GraphicsPipelinesObjects.size());
+	for (uint32_t pipelineIndex = 0; pipelineIndex < pipelinesCount; ++pipelineIndex)
+		vkDestroyPipeline(logicalDevice, m_GraphicsPipelinesObjects[pipelineIndex], nullptr);
+
+	m_GraphicsPipelinesObjects.clear();
+
 	vkDestroyPipelineLayout(logicalDevice, m_PipelineLayoutObjects, nullptr);
 	vkDestroyPipelineLayout(logicalDevice, m_PiplelineLayoutOffscreen, nullptr);
 
+	// frees the descriptor sets and layouts, before the frames destroy their descriptor pools
+	m_UniformDescriptions.clear();
+
+	delete m_SkyboxUniformDescription;
+	m_SkyboxUniformDescription = nullptr;
+
 	m_ImagesObjects.clear();
 	m_ImageViewsObjects.clear();
-	m_ObjectsMemories.clear();
+	m_ObjectsAllocations.clear();
 	m_FrameBuffersObjects.clear();
 
 	vkDestroyImage(logicalDevice, m_DepthImage, nullptr);
 	vkDestroyImageView(logicalDevice, m_DepthImageView, nullptr);
-	vkFreeMemory(logicalDevice, m_DepthMemory, nullptr);
+	Device::m_Device->GetMemoryAllocator()->Free(m_DepthAllocation);
+
+	// destroy shadow maps
+	const uint32_t	shadowCascadeImagesCount = static_cast<uint32_t>(m_ShadowCascadeImages.size());
+	for (uint32_t imageIndex = 0; imageIndex < shadowCascadeImagesCount; ++imageIndex)
+	{
+		vkDestroyImage(logicalDevice, m_ShadowCascadeImages[imageIndex], nullptr);
+		Device::m_Device->GetMemoryAllocator()->Free(m_ShadowCascadeAllocations[imageIndex]);
+	}
+
+	const uint32_t	shadowSpotLightImagesCount = static_cast<uint32_t>(m_ShadowSpotLightImages.size());
+	for (uint32_t imageIndex = 0; imageIndex < shadowSpotLightImagesCount; ++imageIndex)
+	{
+		vkDestroyImage(logicalDevice, m_ShadowSpotLightImages[imageIndex], nullptr);
+		Device::m_Device->GetMemoryAllocator()->Free(m_ShadowSpotLightAllocations[imageIndex]);
+	}
+
+	m_ShadowCascadeImages.clear();
+	m_ShadowCascadeAllocations.clear();
+	m_ShadowSpotLightImages.clear();
+	m_ShadowSpotLightAllocations.clear();
 
 	if (m_RenderPassObjects != nullptr)
 		vkDestroyRenderPass(logicalDevice, m_RenderPassObjects, nullptr);
 
+	if (m_RenderPassObjectsResume != nullptr)
+		vkDestroyRenderPass(logicalDevice, m_RenderPassObjectsResume, nullptr);
+
 	m_RenderPassObjects = nullptr;
+	m_RenderPassObjectsResume = nullptr;
 	m_RenderHandle = nullptr;
 }
 
@@ -434,6 +1103,22 @@ void	Scene::AddObject(Object *object)
 	object->SetName(GetDefinitiveObjectName(object->GetName()));
 
 	m_Objects.push_back(object);
+
+	glm::vec3		boundsMin;
+	glm::vec3		boundsMax;
+	GetObjectBounds(object, boundsMin, boundsMax);
+
+	const uint32_t	proxy = m_ObjectsBvh.Insert(boundsMin, boundsMax, object);
+	m_ObjectsProxies[object] = proxy;
+
+	// inserted with its current bounds, it is queued again on its next change
+	object->SetDirtyList(&m_DirtyObjects);
+
+	if (proxy >= m_ProxyMeshes.size())
+		m_ProxyMeshes.resize(proxy + 1, UINT32_MAX);
+
+	// meshes are appended right after their object
+	m_ProxyMeshes[proxy] = (object->GetType() == OBJECT_TYPE::Mesh) ? static_cast<uint32_t>(m_Meshes.size()) : UINT32_MAX;
 }
 
 //----------------------------------------------------------------
@@ -446,7 +1131,170 @@ void	Scene::RemoveObject(Object *object)
 		uint32_t	index = objectFound - m_Objects.begin();
 		m_Objects.erase(objectFound);
 		m_ObjectsNames.erase(m_ObjectsNames.begin() + index);
+
+		const uint32_t	proxy = m_ObjectsProxies[object];
+		m_ObjectsBvh.Remove(proxy);
+		m_ProxyMeshes[proxy] = UINT32_MAX;
+		m_ObjectsProxies.erase(object);
+
+		if (object->IsDirty())
+			m_DirtyObjects.erase(std::find(m_DirtyObjects.begin(), m_DirtyObjects.end(), object));
+
+		object->SetDirtyList(nullptr);
+	}
+}
+
+//----------------------------------------------------------------
+
+void	Scene::GetObjectBounds(Object *object, glm::vec3 &outMin, glm::vec3 &outMax) const
+{
+	if (object->GetType() == OBJECT_TYPE::Mesh)
+	{
+		const Mesh		*mesh = static_cast<const Mesh*>(object);
+		const glm::mat4	&model = object->GetModel();
+
+		// each world axis gets the projection of the 3 box axes on it
+		const glm::vec3	center = glm::vec3(model * glm::vec4((mesh->GetBoundsMin() + mesh->GetBoundsMax()) * 0.5f, 1.f));
+		const glm::vec3	extent = (mesh->GetBoundsMax() - mesh->GetBoundsMin()) * 0.5f;
+		const glm::vec3	worldExtent = glm::abs(glm::vec3(model[0])) * extent.x + glm::abs(glm::vec3(model[1])) * extent.y + glm::abs(glm::vec3(model[2])) * extent.z;
+
+		outMin = center - worldExtent;
+		outMax = center + worldExtent;
+		return;
+	}
+
+	// directional lights reach everything, only their position is boxed so that they can be picked
+	const Light		*light = static_cast<const Light*>(object);
+	const float		radius = (object->GetType() == OBJECT_TYPE::DirectionalLight) ? PICK_LIGHT_RADIUS : std::max(light->GetRadius(), PICK_LIGHT_RADIUS);
+
+	outMin = object->GetPosition() - glm::vec3(radius);
+	outMax = object->GetPosition() + glm::vec3(radius);
+}
+
+//----------------------------------------------------------------
+
+void	Scene::UpdateObjectsBvh()
+{
+	PROFILE_ZONE("Scene::UpdateObjectsBvh");
+
+	// only the objects changed since the last frame, most of them stay in their fat box and nothing changes then
+	for (Object *object : m_DirtyObjects)
+	{
+		glm::vec3	boundsMin;
+		glm::vec3	boundsMax;
+		GetObjectBounds(object, boundsMin, boundsMax);
+
+		m_ObjectsBvh.Update(m_ObjectsProxies[object], boundsMin, boundsMax);
+	}
+
+	m_ObjectsBvh.RebuildIfDegraded();
+}
+
+//----------------------------------------------------------------
+
+void	Scene::ClearDirtyObjects()
+{
+	for (Object *object : m_DirtyObjects)
+		object->ClearDirty();
+
+	m_DirtyObjects.clear();
+}
+
+//----------------------------------------------------------------
+
+void	Scene::UpdateProxyMeshes()
+{
+	std::unordered_map<const Object*, uint32_t>	meshIndices;
+
+	const uint32_t	meshesCount = static_cast<uint32_t>(m_Meshes.size());
+	for (uint32_t meshIndex = 0; meshIndex < meshesCount; ++meshIndex)
+		meshIndices[m_Meshes[meshIndex]] = meshIndex;
+
+	for (const std::pair<const Object* const, uint32_t> &objectProxy : m_ObjectsProxies)
+	{
+		std::unordered_map<const Object*, uint32_t>::const_iterator	meshFound = meshIndices.find(objectProxy.first);
+		if (meshFound != meshIndices.end())
+			m_ProxyMeshes[objectProxy.second] = meshFound->second;
+	}
+}
+
+//----------------------------------------------------------------
+
+void	Scene::QueryMeshes(const CullingView &view, std::vector<uint32_t> &outMeshes)
+{
+	outMeshes.clear();
+
+	m_QueryProxies.clear();
+	m_ObjectsBvh.QueryFrustum(view, m_QueryProxies);
+
+	for (const uint32_t proxy : m_QueryProxies)
+	{
+		if (m_ProxyMeshes[proxy] != UINT32_MAX)
+			outMeshes.push_back(m_ProxyMeshes[proxy]);
 	}
+
+	// same draw order as without culling
+	std::sort(outMeshes.begin(), outMeshes.end());
+}
+
+//----------------------------------------------------------------
+
+void	Scene::QueryObjectsInFrustum(const CullingView &view, std::vector<Object*> &outObjects) const
+{
+	std::vector<uint32_t>	proxies;
+	m_ObjectsBvh.QueryFrustum(view, proxies);
+
+	for (const uint32_t proxy : proxies)
+		outObjects.push_back(static_cast<Object*>(m_ObjectsBvh.GetUserData(proxy)));
+}
+
+//----------------------------------------------------------------
+
+void	Scene::QueryObjectsInSphere(const glm::vec3 &center, float radius, std::vector<Object*> &outObjects) const
+{
+	std::vector<uint32_t>	proxies;
+	m_ObjectsBvh.QuerySphere(center, radius, proxies);
+
+	for (const uint32_t proxy : proxies)
+		outObjects.push_back(static_cast<Object*>(m_ObjectsBvh.GetUserData(proxy)));
+}
+
+//----------------------------------------------------------------
+
+void	Scene::QueryObjectsInBox(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, std::vector<Object*> &outObjects) const
+{
+	std::vector<uint32_t>	proxies;
+	m_ObjectsBvh.QueryAabb(boundsMin, boundsMax, proxies);
+
+	for (const uint32_t proxy : proxies)
+		outObjects.push_back(static_cast<Object*>(m_ObjectsBvh.GetUserData(proxy)));
+}
+
+//----------------------------------------------------------------
+
+Object*	Scene::PickObject(const glm::vec3 &origin, const glm::vec3 &direction) const
+{
+	const float	directionLengthSquared = glm::dot(direction, direction);
+
+	if (directionLengthSquared <= 0.f)
+		return nullptr;
+
+	BvhRayHit	hit;
+	const bool	isHit = m_ObjectsBvh.Raycast(origin, direction, 1.f, [this, &origin, &direction, directionLengthSquared](uint32_t proxy, float boxDistance)
+	{
+		const Object	*object = static_cast<const Object*>(m_ObjectsBvh.GetUserData(proxy));
+
+		if (object->GetType() == OBJECT_TYPE::Mesh)
+			return boxDistance;
+
+		// the range box of a light is far too large, the ray must pass close to its position
+		const float		distance = glm::dot(object->GetPosition() - origin, direction) / directionLengthSquared;
+		const glm::vec3	offset = origin + direction * distance - object->GetPosition();
+
+		return (glm::dot(offset, offset) <= PICK_LIGHT_RADIUS * PICK_LIGHT_RADIUS) ? distance : -1.f;
+	}, hit);
+
+	return (isHit) ? static_cast<Object*>(m_ObjectsBvh.GetUserData(hit.m_Proxy)) : nullptr;
 }
 
 //----------------------------------------------------------------
@@ -458,12 +1306,66 @@ void	Scene::AddMesh(const VkDevice logicalDevice, Mesh *mesh)
 	AddObject(mesh);
 
 	m_Meshes.push_back(mesh);
+	m_MeshCullingSlots.push_back(AddGpuCullingMesh(mesh));
+
+	if (m_MeshCullingSlots.back() == UINT32_MAX)
+		++m_CpuCulledMeshesCount;
+
+	// textures are created by the registry when the material is loaded
+	UpdateMeshBuffer(logicalDevice, static_cast<uint32_t>(m_Meshes.size() - 1));
+}
+
+//----------------------------------------------------------------
+
+uint32_t	Scene::AddGpuCullingMesh(Mesh *mesh)
+{
+	uint32_t	slot = UINT32_MAX;
+
+	if (m_GpuCulling != nullptr && !m_GpuCulling->AddMesh(mesh, slot))
+		slot = UINT32_MAX;
+
+	return slot;
+}
+
+//----------------------------------------------------------------
+
+Task<>	Scene::LoadMesh(const VkDevice logicalDevice, std::string path, std::string name, std::string texturePath, glm::vec3 position, glm::vec3 scale)
+{
+	AssetLoader				*assetLoader = Device::m_Device->GetAssetLoader();
+
+	// owned by the task until added, dropped with it on shutdown
+	std::unique_ptr<Mesh>	mesh = std::make_unique<Mesh>(path, name);
+
+	if (!co_await mesh->LoadAsync(*assetLoader, logicalDevice))
+	{
+		std::cout << "Can't load mesh " << path << std::endl; // TODO: change this for real logger
+		co_return;
+	}
+
+	if (texturePath != "")
+	{
+		TextureRegistry	*textureRegistry = Device::m_Device->GetTextureRegistry();
+
+		Material		material;
+		material.SetTexture(co_await textureRegistry->LoadAsync(*assetLoader, logicalDevice, texturePath, 4));
+
+		mesh->SetMaterial(material);
+	}
+
+	mesh->SetPosition(position);
+	mesh->SetScale(scale);
+
+	AddMesh(logicalDevice, mesh.release());
+}
+
+//----------------------------------------------------------------
 
-	m_RenderHandle->PrepareTexture(logicalDevice, mesh->GetMaterial().GetTexture());
-	// TODO: finish that 
-	//m_RenderHandle->PrepareTexture(logicalDevice, mesh->GetMaterial().GetNormalTexture());
+Task<>	Scene::LoadSkybox(const VkDevice logicalDevice, std::string folderPath, std::string extension)
+{
+	m_Skybox = co_await Skybox::LoadAsync(*Device::m_Device->GetAssetLoader(), logicalDevice, folderPath, extension);
 
-	UpdateMeshBuffer(logicalDevice, static_cast<uint32_t>(m_Meshes.size() - 1));
+	if (!m_RenderHandle->PrepareSkybox(logicalDevice, m_Skybox))
+		std::cout << "Can't upload skybox " << folderPath << std::endl; // TODO: change this for real logger
 }
 
 //----------------------------------------------------------------
@@ -477,7 +1379,50 @@ void	Scene::DeleteMesh(Mesh *mesh)
 
 		uint32_t	index = meshFound - m_Meshes.begin();
 		m_Meshes.erase(meshFound);
-		m_UniformDescriptions.erase(m_UniformDescriptions.begin() + (index + 2));
+
+		if (m_MeshCullingSlots[index] != UINT32_MAX)
+			m_GpuCulling->RemoveMesh(m_MeshCullingSlots[index]);
+		else
+			--m_CpuCulledMeshesCount;
+
+		m_MeshCullingSlots.erase(m_MeshCullingSlots.begin() + index);
+		UpdateProxyMeshes();
+
+		// the frames in flight may still draw it with its descriptor sets, both are deleted by CollectReleasedMeshes,
+		// its textures are released with the material once no frame in flight samples them
+		std::vector<UniformDescription>::iterator	uniformDescription = m_UniformDescriptions.begin() + (index + 2);
+		m_ReleasedMeshes.push_back({ mesh, std::move(*uniformDescription), m_Frame });
+		m_UniformDescriptions.erase(uniformDescription);
+
+		const uint32_t	framesCount = m_RenderHandle->GetPendingFramesCount();
+		m_MeshImageVersions.erase(m_MeshImageVersions.begin() + index * framesCount, m_MeshImageVersions.begin() + (index + 1) * framesCount);
+	}
+}
+
+//----------------------------------------------------------------
+
+void	Scene::CollectReleasedMeshes()
+{
+	++m_Frame;
+
+	// a mesh released while recording frame N is drawn at most by the frames already in flight,
+	// all of them are done once pendingFramesCount frame slots have been waited for
+	const uint32_t	pendingFramesCount = m_RenderHandle->GetPendingFramesCount();
+
+	uint32_t		releasedIndex = 0;
+	while (releasedIndex < static_cast<uint32_t>(m_ReleasedMeshes.size()))
+	{
+		ReleasedMesh	&releasedMesh = m_ReleasedMeshes[releasedIndex];
+
+		if (m_Frame >= releasedMesh.m_ReleaseFrame + pendingFramesCount)
+		{
+			delete releasedMesh.m_Mesh;
+
+			releasedMesh = std::move(m_ReleasedMeshes.back());
+			m_ReleasedMeshes.pop_back();
+		}
+		else
+			++releasedIndex;
 	}
 }
 
@@ -535,7 +1480,8 @@ bool	Scene::CreateRenderPasses(const VkDevice logicalDevice) // TODO: better man
 
 		attachmentsDescription[1] = { };
 		attachmentsDescription[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachmentsDescription[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		// the depth pyramid and the resumed pass read it after the opaque meshes with occlusion culling
+		attachmentsDescription[1].storeOp = (Device::m_Device->UsesOcclusionCulling()) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		attachmentsDescription[1].format = VK_FORMAT_D32_SFLOAT;
 		attachmentsDescription[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		attachmentsDescription[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
@@ -558,7 +1504,8 @@ bool	Scene::CreateRenderPasses(const VkDevice logicalDevice) // TODO: better man
 		attachmentsDescription[2].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attachmentsDescription[2].format = surfaceFormat;
 		attachmentsDescription[2].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachmentsDescription[2].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		// headless targets are never presented, leave them ready to be read back
+		attachmentsDescription[2].finalLayout = (m_RenderHandle->IsHeadless()) ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 		attachmentsDescription[2].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		attachmentsDescription[2].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		attachmentsDescription[2].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -647,6 +1594,28 @@ bool	Scene::CreateRenderPasses(const VkDevice logicalDevice) // TODO: better man
 
 	CHECK_API_SUCCESS(vkCreateRenderPass(logicalDevice, &renderPassCreateInfo, nullptr, &m_RenderPassObjects)); // TODO: add error management
 
+	if (!Device::m_Device->UsesOcclusionCulling())
+		return true;
+
+	// same attachments loaded back once the depth pyramid is built, compatible with the framebuffers and pipelines of the objects pass
+	attachmentsDescription[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachmentsDescription[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	attachmentsDescription[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachmentsDescription[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachmentsDescription[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	// color and depth written by the first pass
+	subpassesDependency[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	subpassesDependency[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	subpassesDependency[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	subpassesDependency[0].dstAccessMask =	VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+											VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	const VkRenderPassCreateInfo	resumeCreateInfo = Initializers::RenderPass::CreateInfo(attachmentsDescription, subpassesDescription, subpassesDependency);
+
+	CHECK_API_SUCCESS(vkCreateRenderPass(logicalDevice, &resumeCreateInfo, nullptr, &m_RenderPassObjectsResume)); // TODO: add error management
+
 	return true;
 }
 
@@ -658,18 +1627,19 @@ bool	Scene::CreateFrameBuffers(const VkDevice logicalDevice)
 																									std::vector<VkImageView>(),
 																									m_RenderHandle->GetSwapchainExtent(), 1);
 
-	const uint32_t					framesCount = m_RenderHandle->GetPendingFramesCount();
-	m_FrameBuffersObjects.resize(framesCount);
-
+	// one framebuffer per swapchain image, the acquired image can differ from the current frame index
 	const std::vector<VkImageView>	&swapchainImageViews = m_RenderHandle->GetSwapchainImageViews();
+	const uint32_t					imagesCount = static_cast<uint32_t>(swapchainImageViews.size());
 
-	for (uint32_t frameIndex = 0; frameIndex < framesCount; ++frameIndex)
+	m_FrameBuffersObjects.resize(imagesCount);
+
+	for (uint32_t imageIndex = 0; imageIndex < imagesCount; ++imageIndex)
 	{
-		const VkImageView	attachments[3] = { m_ImageViewsObjects[frameIndex], m_DepthImageView, swapchainImageViews[frameIndex] };
+		const VkImageView	attachments[3] = { m_ImageViewsObjects[imageIndex], m_DepthImageView, swapchainImageViews[imageIndex] };
 		frameBufferCreateInfo.attachmentCount = 3;
 		frameBufferCreateInfo.pAttachments = attachments;
 
-		CHECK_API_SUCCESS(vkCreateFramebuffer(logicalDevice, &frameBufferCreateInfo, nullptr, &m_FrameBuffersObjects[frameIndex])); // TODO: add error management
+		CHECK_API_SUCCESS(vkCreateFramebuffer(logicalDevice, &frameBufferCreateInfo, nullptr, &m_FrameBuffersObjects[imageIndex])); // TODO: add error management
 	}
 	
 	return true;
@@ -739,7 +1709,7 @@ bool Scene::CreateFrameBuffersShadowCascade(const VkDevice logicalDevice)
 		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		VK_SAMPLE_COUNT_1_BIT);
 
-	m_RenderHandle->CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, m_ShadowCascadeImages, m_ShadowCascadeMemories);
+	m_RenderHandle->CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, m_ShadowCascadeImages, m_ShadowCascadeAllocations);
 
 	VkImageSubresourceRange subRange = { };
 	{
@@ -793,7 +1763,7 @@ bool Scene::CreateFrameBuffersShadowSpotLight(const VkDevice logicalDevice)
 		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		VK_SAMPLE_COUNT_1_BIT);
 
-	m_RenderHandle->CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, m_ShadowSpotLightImages, m_ShadowSpotLightMemories);
+	m_RenderHandle->CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, m_ShadowSpotLightImages, m_ShadowSpotLightAllocations);
 
 	VkImageSubresourceRange subRange = { };
 	{
@@ -807,6 +1777,7 @@ bool Scene::CreateFrameBuffersShadowSpotLight(const VkDevice logicalDevice)
 	m_RenderHandle->CreateImageViews(logicalDevice, m_ShadowSpotLightImages, VK_IMAGE_VIEW_TYPE_2D_ARRAY, VK_FORMAT_D32_SFLOAT, { VK_COMPONENT_SWIZZLE_IDENTITY }, subRange, m_ShadowSpotLightImageViews);
 
 	m_FrameBuffersShadowSpotLight.resize(SHADOWMAP_SPOTLIGHT_COUNT);
+	m_ShadowViewsSpotLight.resize(SHADOWMAP_SPOTLIGHT_COUNT);
 
 	// One image and frambuffer per light
 	for (uint32_t spotLightIndex = 0; spotLightIndex < SHADOWMAP_SPOTLIGHT_COUNT; ++spotLightIndex)
@@ -821,6 +1792,9 @@ bool Scene::CreateFrameBuffersShadowSpotLight(const VkDevice logicalDevice)
 		frameBufferCreateInfo.pAttachments = &spotLightImageViews[0];
 
 		CHECK_API_SUCCESS(vkCreateFramebuffer(logicalDevice, &frameBufferCreateInfo, nullptr, &m_FrameBuffersShadowSpotLight[spotLightIndex]));
+
+		m_ShadowViewsSpotLight[spotLightIndex] = { };
+		m_ShadowViewsSpotLight[spotLightIndex].m_FrameBuffer = m_FrameBuffersShadowSpotLight[spotLightIndex];
 	}
 
 	return true;
@@ -833,36 +1807,18 @@ bool	Scene::CreateGraphicsPipelines(	const VkDevice logicalDevice,
 										const std::vector<VkShaderModule> &offscreenModules,
 										const std::vector<VkShaderModule> &skyboxModules,
 										const std::vector<VkShaderModule> &shadowCascadeModule,
-										const std::vector<VkShaderModule> &shadowSpotLightModule)
+										const std::vector<VkShaderModule> &shadowSpotLightModule,
+										const std::vector<VkShaderModule> &indirectModules)
 {
-	// TODO : Encapsulate
-	m_ShadowCascadeBuffers = { Buffer<ShadowInfoCascade>(logicalDevice, BUFFER_TYPE::Uniform, 1), Buffer<ShadowInfoCascade>(logicalDevice, BUFFER_TYPE::Uniform, 1) };
-	m_ShadowSpotLightBuffers = { Buffer<ShadowInfoSpotLight>(logicalDevice, BUFFER_TYPE::Uniform, 1), Buffer<ShadowInfoSpotLight>(logicalDevice, BUFFER_TYPE::Uniform, 1) };
-
 	uint64_t						uboMinAlignment = Device::m_Device->GetUBOMinAlignment();
 	m_PerMeshBufferAlignment = static_cast<uint32_t>((sizeof(MeshData) + uboMinAlignment - 1) & ~(uboMinAlignment - 1));
-
-	const uint32_t					meshesCount = static_cast<uint32_t>(m_Meshes.size());
-
-	m_VPBuffers = { Buffer<VP>(logicalDevice, BUFFER_TYPE::Uniform, 1), Buffer<VP>(logicalDevice, BUFFER_TYPE::Uniform, 1) };
-	// TODO: pre allocate buffer, if it exceeds, create new buffer chunk
-	m_PerMeshBuffers =
-	{
-		Buffer<MeshData>(logicalDevice, static_cast<BUFFER_TYPE>(BUFFER_TYPE::Uniform), 100, m_PerMeshBufferAlignment),
-		Buffer<MeshData>(logicalDevice, static_cast<BUFFER_TYPE>(BUFFER_TYPE::Uniform), 100, m_PerMeshBufferAlignment)
-	};
-
-	m_MeshesData = static_cast<MeshData*>(_aligned_malloc(static_cast<size_t>(meshesCount * SHADOWMAP_CASCADE_COUNT), static_cast<size_t>(m_PerMeshBufferAlignment)));
-
-	// TODO : Multi light
-	m_LightBuffers =
-	{
-		Buffer<UBOLights>(logicalDevice, BUFFER_TYPE::Uniform, 1),
-		Buffer<UBOLights>(logicalDevice, BUFFER_TYPE::Uniform, 1)
-	};
-
 	m_PerSpotShadowBufferAlignment = static_cast<uint32_t>((sizeof(ShadowInfoSpotLight) + uboMinAlignment - 1) & ~(uboMinAlignment - 1));
 
+	// uniforms live in the frame uniform arenas, offsets are relative to the spot light entries of the frame
+	const uint32_t					shadowViewsCount = static_cast<uint32_t>(m_ShadowViewsSpotLight.size());
+	for (uint32_t viewIndex = 0; viewIndex < shadowViewsCount; ++viewIndex)
+		m_ShadowViewsSpotLight[viewIndex].m_InfoOffset = viewIndex * m_PerSpotShadowBufferAlignment;
+
 	if (!CreatePipelineLayoutOffscreen(logicalDevice))
 		return false;
 
@@ -878,6 +1834,10 @@ bool	Scene::CreateGraphicsPipelines(	const VkDevice logicalDevice,
 	if (!CreatePipelineLayoutSkybox(logicalDevice))
 		return false;
 
+	// the depth pyramid modules follow when occlusion culling is used
+	if (!indirectModules.empty() && !SetupGpuCulling(logicalDevice, indirectModules[3], (indirectModules.size() > 4) ? indirectModules[4] : nullptr, (indirectModules.size() > 5) ? indirectModules[5] : nullptr))
+		return false;
+
 	VkPipelineShaderStageCreateInfo			meshVertexStage = { };
 	{
 		meshVertexStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -955,15 +1915,28 @@ bool	Scene::CreateGraphicsPipelines(	const VkDevice logicalDevice,
 
 	VkPipelineShaderStageCreateInfo			shadowSpotLightShaderStages[] = { shadowSpotLightVertexStage };
 
-	VertexDescription						meshVertexDesc = VertexDescription();
-	const VkVertexInputBindingDescription	&meshVertexBindingDesc = meshVertexDesc.GetBindingDesc();
+	// indirect draws, same states as the CPU path, the modules are only read when the culling pass exists
+	VkPipelineShaderStageCreateInfo			meshIndirectShaderStages[2] = { meshVertexStage, meshFragStage };
+	VkPipelineShaderStageCreateInfo			shadowCascadeIndirectShaderStages[1] = { shadowCascadeVertexStage };
+
+	if (m_GpuCulling != nullptr)
+	{
+		meshIndirectShaderStages[0].module = indirectModules[0];
+		meshIndirectShaderStages[1].module = indirectModules[1];
+		shadowCascadeIndirectShaderStages[0].module = indirectModules[2];
+	}
+
+	const VERTEX_LAYOUT						vertexLayout = Device::m_Device->GetSettings().m_VertexLayout;
+
+	VertexDescription						meshVertexDesc = VertexDescription(vertexLayout);
+	const std::vector<VkVertexInputBindingDescription>		&meshVertexBindingsDesc = meshVertexDesc.GetBindingsDesc();
 	const std::vector<VkVertexInputAttributeDescription>	&meshAttribsDesc = meshVertexDesc.GetAttributesDesc();
 
 	VkPipelineVertexInputStateCreateInfo	meshVertexStateCreateInfo = { };
 	{
 		meshVertexStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		meshVertexStateCreateInfo.vertexBindingDescriptionCount = 1;
-		meshVertexStateCreateInfo.pVertexBindingDescriptions = &meshVertexBindingDesc;
+		meshVertexStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(meshVertexBindingsDesc.size());
+		meshVertexStateCreateInfo.pVertexBindingDescriptions = meshVertexBindingsDesc.data();
 		meshVertexStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(meshAttribsDesc.size());
 		meshVertexStateCreateInfo.pVertexAttributeDescriptions = meshAttribsDesc.data();
 	}
@@ -984,18 +1957,19 @@ bool	Scene::CreateGraphicsPipelines(	const VkDevice logicalDevice,
 		skyboxVertexStateCreateInfo.pVertexAttributeDescriptions = &m_Skybox.GetAttributesDesc();
 	}
 
-	/*ShadowDescription						shadowVertexDesc = ShadowDescription();
-	const VkVertexInputBindingDescription	&shadowVertexBindingDesc = shadowVertexDesc.GetBindingDesc();
+	// shadow passes only fetch positions
+	ShadowDescription						shadowVertexDesc = ShadowDescription(vertexLayout);
+	const std::vector<VkVertexInputBindingDescription>		&shadowVertexBindingsDesc = shadowVertexDesc.GetBindingsDesc();
 	const std::vector<VkVertexInputAttributeDescription>	&shadowAttribsDesc = shadowVertexDesc.GetAttributesDesc();
 
 	VkPipelineVertexInputStateCreateInfo	shadowVertexStateCreateInfo = { };
 	{
 		shadowVertexStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		shadowVertexStateCreateInfo.vertexBindingDescriptionCount = 1;
-		shadowVertexStateCreateInfo.pVertexBindingDescriptions = &shadowVertexBindingDesc;
-		shadowVertexStateCreateInfo.vertexAttributeDescriptionCount = 1;
+		shadowVertexStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(shadowVertexBindingsDesc.size());
+		shadowVertexStateCreateInfo.pVertexBindingDescriptions = shadowVertexBindingsDesc.data();
+		shadowVertexStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(shadowAttribsDesc.size());
 		shadowVertexStateCreateInfo.pVertexAttributeDescriptions = shadowAttribsDesc.data();
-	}*/
+	}
 
 	VkPipelineInputAssemblyStateCreateInfo	pipelineInputAssembly = { };
 	{
@@ -1029,6 +2003,10 @@ bool	Scene::CreateGraphicsPipelines(	const VkDevice logicalDevice,
 	VkPipelineRasterizationStateCreateInfo	shadowRasterizerStateCreateInfo = rasterizerStateCreateInfo;
 	shadowRasterizerStateCreateInfo.depthBiasEnable = VK_TRUE;
 
+	// cascades are culled open toward the light, casters in front of their near plane are clamped onto it
+	VkPipelineRasterizationStateCreateInfo	cascadeRasterizerStateCreateInfo = shadowRasterizerStateCreateInfo;
+	cascadeRasterizerStateCreateInfo.depthClampEnable = (Device::m_Device->SupportsDepthClamp()) ? VK_TRUE : VK_FALSE;
+
 	std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_DEPTH_BIAS };
 
 	VkPipelineDynamicStateCreateInfo shadowDynamicStateCreateInfo = { };
@@ -1164,7 +2142,7 @@ bool	Scene::CreateGraphicsPipelines(	const VkDevice logicalDevice,
 		shadowViewportState.pScissors = &shadowScissor;
 	}
 
-	VkGraphicsPipelineCreateInfo			pipelinesInfoObjects[6];
+	VkGraphicsPipelineCreateInfo			pipelinesInfoObjects[10];
 	{
 		// opaque objects
 		pipelinesInfoObjects[0] = { };
@@ -1250,10 +2228,10 @@ bool	Scene::CreateGraphicsPipelines(	const VkDevice logicalDevice,
 		pipelinesInfoObjects[4].sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		pipelinesInfoObjects[4].stageCount = 1;
 		pipelinesInfoObjects[4].pStages = shadowCascadeShaderStages;
-		pipelinesInfoObjects[4].pVertexInputState = &meshVertexStateCreateInfo;
+		pipelinesInfoObjects[4].pVertexInputState = &shadowVertexStateCreateInfo;
 		pipelinesInfoObjects[4].pInputAssemblyState = &pipelineInputAssembly;
 		pipelinesInfoObjects[4].pViewportState = &shadowViewportState;
-		pipelinesInfoObjects[4].pRasterizationState = &shadowRasterizerStateCreateInfo;
+		pipelinesInfoObjects[4].pRasterizationState = &cascadeRasterizerStateCreateInfo;
 		pipelinesInfoObjects[4].pMultisampleState = &shadowMultisampling;
 		pipelinesInfoObjects[4].layout = m_PiplelineLayoutShadowCascade;
 		pipelinesInfoObjects[4].renderPass = m_RenderPassShadow;
@@ -1266,7 +2244,7 @@ bool	Scene::CreateGraphicsPipelines(	const VkDevice logicalDevice,
 		pipelinesInfoObjects[5].sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		pipelinesInfoObjects[5].stageCount = 1;
 		pipelinesInfoObjects[5].pStages = shadowSpotLightShaderStages;
-		pipelinesInfoObjects[5].pVertexInputState = &meshVertexStateCreateInfo;
+		pipelinesInfoObjects[5].pVertexInputState = &shadowVertexStateCreateInfo;
 		pipelinesInfoObjects[5].pInputAssemblyState = &pipelineInputAssembly;
 		pipelinesInfoObjects[5].pViewportState = &shadowViewportState;
 		pipelinesInfoObjects[5].pRasterizationState = &shadowRasterizerStateCreateInfo;
@@ -1276,11 +2254,24 @@ bool	Scene::CreateGraphicsPipelines(	const VkDevice logicalDevice,
 		pipelinesInfoObjects[5].subpass = 0;
 		pipelinesInfoObjects[5].pDepthStencilState = &shadowStencilCreateInfo;
 		pipelinesInfoObjects[5].pDynamicState = &shadowDynamicStateCreateInfo;
+
+		// indirect opaque, transparent front and back, and cascade
+		const uint32_t	indirectSources[4] = { 0, 2, 3, 4 };
+		for (uint32_t indirectIndex = 0; indirectIndex < 4; ++indirectIndex)
+		{
+			VkGraphicsPipelineCreateInfo	&pipelineInfo = pipelinesInfoObjects[6 + indirectIndex];
+
+			pipelineInfo = pipelinesInfoObjects[indirectSources[indirectIndex]];
+			pipelineInfo.pStages = (indirectIndex < 3) ? meshIndirectShaderStages : shadowCascadeIndirectShaderStages;
+			pipelineInfo.layout = (m_GpuCulling != nullptr) ? ((indirectIndex < 3) ? m_GpuCulling->GetDrawPipelineLayout() : m_GpuCulling->GetShadowPipelineLayout()) : VK_NULL_HANDLE;
+		}
 	}
 
-	m_GraphicsPipelinesObjects.resize(6);
+	const uint32_t							pipelinesCount = (m_GpuCulling != nullptr) ? 10 : 6;
+
+	m_GraphicsPipelinesObjects.resize(pipelinesCount);
 	// TODO: add pipeline cache?
-	CHECK_API_SUCCESS(vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 6, pipelinesInfoObjects, nullptr, m_GraphicsPipelinesObjects.data()));
+	CHECK_API_SUCCESS(vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, pipelinesCount, pipelinesInfoObjects, nullptr, m_GraphicsPipelinesObjects.data()));
 
 	return true;
 }
@@ -1289,169 +2280,24 @@ bool	Scene::CreateGraphicsPipelines(	const VkDevice logicalDevice,
 
 bool	Scene::CreatePipelineLayoutObjects(const VkDevice logicalDevice)
 {
-	const std::vector<std::tuple<DESCRIPTION_TYPE, SHADER_STAGE>>	descriptions =
-	{
-		std::make_tuple(DESCRIPTION_TYPE::UniformBuffer, SHADER_STAGE::Vertex), // matrices view and proj
-		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, static_cast<SHADER_STAGE>((int)SHADER_STAGE::Vertex | (int)SHADER_STAGE::Fragment)), // dynamic per mesh
-		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // mesh texture
-		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // skybox
-		std::make_tuple(DESCRIPTION_TYPE::UniformBuffer, SHADER_STAGE::Fragment), // light
-		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // shadowMapCascadeSampler
-		std::make_tuple(DESCRIPTION_TYPE::UniformBuffer, static_cast<SHADER_STAGE>((int)SHADER_STAGE::Vertex | (int)SHADER_STAGE::Fragment)), // shadowBufferCasacade
-		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // shadowMapSpotLight
-		std::make_tuple(DESCRIPTION_TYPE::UniformBuffer, SHADER_STAGE::Vertex), // shadowBufferSpotLight
-	};
-
-	std::vector<DescriptionInfo>	infos = std::vector<DescriptionInfo>(descriptions.size() * m_RenderHandle->GetPendingFramesCount(), DescriptionInfo());
-
-	// matrices view and proj buffer
-	VkDescriptorBufferInfo			bufferInfoFirstFrame = { };
-	{
-		bufferInfoFirstFrame.buffer = m_VPBuffers[0].GetApiBuffer();
-		bufferInfoFirstFrame.offset = 0;
-		bufferInfoFirstFrame.range = sizeof(VP);
-	}
-
-	VkDescriptorBufferInfo			bufferInfoSecondFrame = { };
-	{
-		bufferInfoSecondFrame.buffer = m_VPBuffers[1].GetApiBuffer();
-		bufferInfoSecondFrame.offset = 0;
-		bufferInfoSecondFrame.range = sizeof(VP);
-	}
-
-	// dynamic per mesh buffer
-	VkDescriptorBufferInfo			bufferInfoDynamicFirstFrame = { };
-	{
-		bufferInfoDynamicFirstFrame.buffer = m_PerMeshBuffers[0].GetApiBuffer();
-		bufferInfoDynamicFirstFrame.offset = 0;
-		bufferInfoDynamicFirstFrame.range = VK_WHOLE_SIZE;
-	}
-
-	VkDescriptorBufferInfo			bufferInfoDynamicSecondFrame = { };
-	{
-		bufferInfoDynamicSecondFrame.buffer = m_PerMeshBuffers[1].GetApiBuffer();
-		bufferInfoDynamicSecondFrame.offset = 0;
-		bufferInfoDynamicSecondFrame.range = VK_WHOLE_SIZE;
-	}
-
-	// light buffer
-	VkDescriptorBufferInfo			lightBufferFirstFrame = { };
-	{
-		lightBufferFirstFrame.buffer = m_LightBuffers[0].GetApiBuffer();
-		lightBufferFirstFrame.offset = 0;
-		lightBufferFirstFrame.range = sizeof(UBOLights);
-	}
-
-	VkDescriptorBufferInfo			lightBufferSecondFrame = { };
-	{
-		lightBufferSecondFrame.buffer = m_LightBuffers[1].GetApiBuffer();
-		lightBufferSecondFrame.offset = 0;
-		lightBufferSecondFrame.range = sizeof(UBOLights);
-	}
-
-	// cascade shadow buffer -> Directionnal
-	VkDescriptorBufferInfo			shadowCascadeBufferInfoFirstFrame = { };
-	{
-		shadowCascadeBufferInfoFirstFrame.buffer = m_ShadowCascadeBuffers[0].GetApiBuffer();
-		shadowCascadeBufferInfoFirstFrame.offset = 0;
-		shadowCascadeBufferInfoFirstFrame.range = sizeof(ShadowInfoCascade);
-	}
-
-	VkDescriptorBufferInfo			shadowCascadeBufferInfoSecondFrame = { };
-	{
-		shadowCascadeBufferInfoSecondFrame.buffer = m_ShadowCascadeBuffers[1].GetApiBuffer();
-		shadowCascadeBufferInfoSecondFrame.offset = 0;
-		shadowCascadeBufferInfoSecondFrame.range = sizeof(ShadowInfoCascade);
-	}
-
-	// spotLight shadow buffer 
-	VkDescriptorBufferInfo			shadowSpotLightBufferInfoFirstFrame = { };
-	{
-		shadowSpotLightBufferInfoFirstFrame.buffer = m_ShadowSpotLightBuffers[0].GetApiBuffer();
-		shadowSpotLightBufferInfoFirstFrame.offset = 0;
-		shadowSpotLightBufferInfoFirstFrame.range = sizeof(ShadowInfoSpotLight);
-	}
-
-	VkDescriptorBufferInfo			shadowSpotLightBufferInfoSecondFrame = { };
-	{
-		shadowSpotLightBufferInfoSecondFrame.buffer = m_ShadowSpotLightBuffers[1].GetApiBuffer();
-		shadowSpotLightBufferInfoSecondFrame.offset = 0;
-		shadowSpotLightBufferInfoSecondFrame.range = sizeof(ShadowInfoSpotLight);
-	}
-
-	// skybox image
-	const Texture					&skyboxTexture = m_Skybox.GetTextures()[0];
-	VkDescriptorImageInfo			imageInfoSkybox = { };
-	{
-		imageInfoSkybox.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfoSkybox.imageView = skyboxTexture.m_ImageView;
-		imageInfoSkybox.sampler = skyboxTexture.m_Sampler;
-	}
-
 	m_RenderHandle->PrepareShadow(logicalDevice, m_ShadowCascadeSampler);
-
-	// Shadow image
-	VkDescriptorImageInfo			imageInfoShadowMapCascade = { };
-	{
-		imageInfoShadowMapCascade.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfoShadowMapCascade.imageView = m_ShadowCascadeImageViews[0];
-		imageInfoShadowMapCascade.sampler = m_ShadowCascadeSampler;
-	}
-
 	m_RenderHandle->PrepareShadow(logicalDevice, m_ShadowSpotLightSampler);
 
-	VkDescriptorImageInfo			imageInfoShadowMapSpotLight = { };
-	{
-		imageInfoShadowMapSpotLight.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfoShadowMapSpotLight.imageView = m_ShadowSpotLightImageViews[0];
-		imageInfoShadowMapSpotLight.sampler = m_ShadowSpotLightSampler;
-	}
-
+	// the skybox has its own sets, the layouts don't depend on any mesh, the mesh texture binding is unused there
+	m_SkyboxUniformDescription = new UniformDescription(CreateMeshDescription(logicalDevice, *m_RenderHandle->GetTextureRegistry()->GetFallback()));
 
-	const uint32_t					meshesCount = static_cast<uint32_t>(m_Meshes.size());
+	const uint32_t				meshesCount = static_cast<uint32_t>(m_Meshes.size());
 	for (uint32_t meshIndex = 0; meshIndex < meshesCount; ++meshIndex)
 	{
-		const Texture			&texture = m_Meshes[meshIndex]->GetMaterial().GetTexture();
-
-		// mesh image
-		VkDescriptorImageInfo	imageInfo = { };
-		{
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = texture.m_ImageView;
-			imageInfo.sampler = texture.m_Sampler;
-		}
-
-		// FIXME: dirty 
-		// First Frame
-		infos[0].m_DescBufferInfo = &bufferInfoFirstFrame;
-		infos[1].m_DescBufferInfo = &bufferInfoDynamicFirstFrame;
-		infos[2].m_DescImageInfo = &imageInfo;
-		infos[3].m_DescImageInfo = &imageInfoSkybox;
-		infos[4].m_DescBufferInfo = &lightBufferFirstFrame;
-		infos[5].m_DescImageInfo = &imageInfoShadowMapCascade;	
-		infos[6].m_DescBufferInfo = &shadowCascadeBufferInfoFirstFrame;
-		infos[7].m_DescImageInfo = &imageInfoShadowMapSpotLight;
-		infos[8].m_DescBufferInfo = &shadowSpotLightBufferInfoFirstFrame;
-
-		// 2E Frame
-		infos[9].m_DescBufferInfo = &bufferInfoSecondFrame;
-		infos[10].m_DescBufferInfo = &bufferInfoDynamicSecondFrame;
-		infos[11].m_DescImageInfo = &imageInfo;
-		infos[12].m_DescImageInfo = &imageInfoSkybox;
-		infos[13].m_DescBufferInfo = &lightBufferSecondFrame;
-		infos[14].m_DescImageInfo = &imageInfoShadowMapCascade;
-		infos[15].m_DescBufferInfo = &shadowCascadeBufferInfoSecondFrame;
-		infos[16].m_DescImageInfo = &imageInfoShadowMapSpotLight;
-		infos[17].m_DescBufferInfo = &shadowSpotLightBufferInfoSecondFrame;
-
-		m_UniformDescriptions.push_back(UniformDescription(logicalDevice, descriptions, infos, m_RenderHandle->GetPendingFramesCount(), true));
+		if (!UpdateMeshBuffer(logicalDevice, meshIndex))
+			return false;
 	}
 
 	VkPipelineLayoutCreateInfo	pipelineLayoutObjectsInfo = { };
 	{
 		pipelineLayoutObjectsInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutObjectsInfo.setLayoutCount = 2;
-		pipelineLayoutObjectsInfo.pSetLayouts = m_UniformDescriptions[2].GetDescriptorLayouts().data();
+		pipelineLayoutObjectsInfo.pSetLayouts = m_SkyboxUniformDescription->GetDescriptorLayouts().data();
 	}
 
 	CHECK_API_SUCCESS(vkCreatePipelineLayout(logicalDevice, &pipelineLayoutObjectsInfo, nullptr, &m_PipelineLayoutObjects)); // TODO: add error management
@@ -1468,26 +2314,25 @@ bool	Scene::CreatePipelineLayoutOffscreen(const VkDevice logicalDevice)
 		std::make_tuple(DESCRIPTION_TYPE::InputAttachment, SHADER_STAGE::Fragment)
 	};
 
-	std::vector<DescriptionInfo>	infos = std::vector<DescriptionInfo>(2, DescriptionInfo());
+	const uint32_t						framesCount = m_RenderHandle->GetPendingFramesCount();
+	const std::vector<VkImageView>		&swapchainImageViews = m_RenderHandle->GetSwapchainImageViews();
 
-	VkDescriptorImageInfo			imageInfoFirstFrame = { };
-	{
-		imageInfoFirstFrame.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfoFirstFrame.imageView = m_RenderHandle->GetSwapchainImageViews()[0];
-		imageInfoFirstFrame.sampler = VK_NULL_HANDLE;
-	}
+	std::vector<DescriptionInfo>		infos = std::vector<DescriptionInfo>(framesCount, DescriptionInfo());
+	std::vector<VkDescriptorImageInfo>	imageInfos = std::vector<VkDescriptorImageInfo>(framesCount, VkDescriptorImageInfo());
 
-	VkDescriptorImageInfo			imageInfoSecondFrame = { };
+	for (uint32_t frameIndex = 0; frameIndex < framesCount; ++frameIndex)
 	{
-		imageInfoSecondFrame.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfoSecondFrame.imageView = m_RenderHandle->GetSwapchainImageViews()[1];
-		imageInfoSecondFrame.sampler = VK_NULL_HANDLE;
-	}
+		VkDescriptorImageInfo	&imageInfo = imageInfos[frameIndex];
+		{
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageInfo.imageView = swapchainImageViews[frameIndex % swapchainImageViews.size()];
+			imageInfo.sampler = VK_NULL_HANDLE;
+		}
 
-	infos[0].m_DescImageInfo = &imageInfoFirstFrame;
-	infos[1].m_DescImageInfo = &imageInfoSecondFrame;
+		infos[frameIndex].m_DescImageInfo = &imageInfo;
+	}
 
-	m_UniformDescriptions.push_back(UniformDescription(logicalDevice, descriptions, infos, 2, true));
+	m_UniformDescriptions.push_back(UniformDescription(logicalDevice, descriptions, infos, framesCount, true));
 
 	VkPipelineLayoutCreateInfo	pipelineLayoutOffscreenInfo = { };
 	{
@@ -1509,7 +2354,7 @@ bool	Scene::CreatePipelineLayoutSkybox(const VkDevice logicalDevice)
 	{
 		skyboxPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		skyboxPipelineLayoutCreateInfo.setLayoutCount = 2;
-		skyboxPipelineLayoutCreateInfo.pSetLayouts = m_UniformDescriptions[3].GetDescriptorLayouts().data();
+		skyboxPipelineLayoutCreateInfo.pSetLayouts = m_SkyboxUniformDescription->GetDescriptorLayouts().data();
 	}
 
 	CHECK_API_SUCCESS(vkCreatePipelineLayout(logicalDevice, &skyboxPipelineLayoutCreateInfo, nullptr, &m_Skybox.m_PipelineLayout));
@@ -1523,65 +2368,38 @@ bool Scene::CreatePipelineLayoutShadowCascade(const VkDevice logicalDevice)
 {
 	const std::vector<std::tuple<DESCRIPTION_TYPE, SHADER_STAGE>>	descriptions =
 	{
-		std::make_tuple(DESCRIPTION_TYPE::UniformBuffer, SHADER_STAGE::Vertex), // shadowBuffer
+		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, SHADER_STAGE::Vertex), // shadowBuffer
 		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, SHADER_STAGE::Vertex), // dynamic per mesh
-		std::make_tuple(DESCRIPTION_TYPE::UniformBuffer, SHADER_STAGE::Vertex), // shadowBuffer
+		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, SHADER_STAGE::Vertex), // dynamic per spot light shadow view
 	};
 
-	std::vector<DescriptionInfo>	infos = std::vector<DescriptionInfo>(descriptions.size() * m_RenderHandle->GetPendingFramesCount(), DescriptionInfo());
+	const uint32_t						framesCount = m_RenderHandle->GetPendingFramesCount();
+	const uint32_t						descriptionsCount = static_cast<uint32_t>(descriptions.size());
 
-	VkDescriptorBufferInfo			bufferInfoFirstFrame = { };
-	{
-		bufferInfoFirstFrame.buffer = m_ShadowCascadeBuffers[0].GetApiBuffer();
-		bufferInfoFirstFrame.offset = 0;
-		bufferInfoFirstFrame.range = sizeof(ShadowInfoCascade);
-	}
+	std::vector<DescriptionInfo>		infos = std::vector<DescriptionInfo>(descriptionsCount * framesCount, DescriptionInfo());
+	std::vector<VkDescriptorBufferInfo>	bufferInfos = std::vector<VkDescriptorBufferInfo>(descriptionsCount * framesCount, VkDescriptorBufferInfo());
 
-	VkDescriptorBufferInfo			bufferInfoSecondFrame = { };
+	for (uint32_t frameIndex = 0; frameIndex < framesCount; ++frameIndex)
 	{
-		bufferInfoSecondFrame.buffer = m_ShadowCascadeBuffers[1].GetApiBuffer();
-		bufferInfoSecondFrame.offset = 0;
-		bufferInfoSecondFrame.range = sizeof(ShadowInfoCascade);
-	}
+		const VkBuffer			uniformBuffer = m_RenderHandle->GetUniformArena(frameIndex)->GetApiBuffer();
 
-	// dynamic per mesh buffer
-	VkDescriptorBufferInfo			bufferInfoDynamicFirstFrame = { };
-	{
-		bufferInfoDynamicFirstFrame.buffer = m_PerMeshBuffers[0].GetApiBuffer();
-		bufferInfoDynamicFirstFrame.offset = 0;
-		bufferInfoDynamicFirstFrame.range = VK_WHOLE_SIZE;
-	}
+		VkDescriptorBufferInfo	*frameBufferInfos = &bufferInfos[frameIndex * descriptionsCount];
+		{
+			frameBufferInfos[0].buffer = uniformBuffer;
+			frameBufferInfos[0].range = sizeof(ShadowInfoCascade);
 
-	VkDescriptorBufferInfo			bufferInfoDynamicSecondFrame = { };
-	{
-		bufferInfoDynamicSecondFrame.buffer = m_PerMeshBuffers[1].GetApiBuffer();
-		bufferInfoDynamicSecondFrame.offset = 0;
-		bufferInfoDynamicSecondFrame.range = VK_WHOLE_SIZE;
-	}
+			frameBufferInfos[1].buffer = uniformBuffer;
+			frameBufferInfos[1].range = sizeof(MeshData);
 
-	VkDescriptorBufferInfo			bufferInfoSpotLightFirstFrame = { };
-	{
-		bufferInfoSpotLightFirstFrame.buffer = m_ShadowSpotLightBuffers[0].GetApiBuffer();
-		bufferInfoSpotLightFirstFrame.offset = 0;
-		bufferInfoSpotLightFirstFrame.range = sizeof(ShadowInfoSpotLight);
-	}
+			frameBufferInfos[2].buffer = uniformBuffer;
+			frameBufferInfos[2].range = sizeof(ShadowInfoSpotLight);
+		}
 
-	VkDescriptorBufferInfo			bufferInfoSpotLightSecondFrame = { };
-	{
-		bufferInfoSpotLightSecondFrame.buffer = m_ShadowSpotLightBuffers[1].GetApiBuffer();
-		bufferInfoSpotLightSecondFrame.offset = 0;
-		bufferInfoSpotLightSecondFrame.range = sizeof(ShadowInfoSpotLight);
+		for (uint32_t descIndex = 0; descIndex < descriptionsCount; ++descIndex)
+			infos[frameIndex * descriptionsCount + descIndex].m_DescBufferInfo = &frameBufferInfos[descIndex];
 	}
 
-	// FIXME: dirty
-	infos[0].m_DescBufferInfo = &bufferInfoFirstFrame;
-	infos[1].m_DescBufferInfo = &bufferInfoDynamicFirstFrame;
-	infos[2].m_DescBufferInfo = &bufferInfoSpotLightFirstFrame;
-	infos[3].m_DescBufferInfo = &bufferInfoSecondFrame;
-	infos[4].m_DescBufferInfo = &bufferInfoDynamicSecondFrame;
-	infos[5].m_DescBufferInfo = &bufferInfoSpotLightSecondFrame;
-
-	m_UniformDescriptions.push_back(UniformDescription(logicalDevice, descriptions, infos, m_RenderHandle->GetPendingFramesCount(), true));
+	m_UniformDescriptions.push_back(UniformDescription(logicalDevice, descriptions, infos, framesCount, true));
 
 	VkPipelineLayoutCreateInfo	shadowPipelineLayoutCreateInfo = { };
 	{
@@ -1601,54 +2419,40 @@ bool Scene::CreatePipelineLayoutShadowSpotLight(const VkDevice logicalDevice)
 {
 	const std::vector<std::tuple<DESCRIPTION_TYPE, SHADER_STAGE>>	descriptions =
 	{
-		std::make_tuple(DESCRIPTION_TYPE::UniformBuffer, SHADER_STAGE::Vertex), // shadowBuffer
+		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, SHADER_STAGE::Vertex), // shadowBuffer
 		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, SHADER_STAGE::Vertex), // dynamic per mesh
 	};
 
-	std::vector<DescriptionInfo>	infos = std::vector<DescriptionInfo>(descriptions.size() * m_RenderHandle->GetPendingFramesCount(), DescriptionInfo());
+	const uint32_t						framesCount = m_RenderHandle->GetPendingFramesCount();
+	const uint32_t						descriptionsCount = static_cast<uint32_t>(descriptions.size());
 
-	VkDescriptorBufferInfo			bufferInfoFirstFrame = { };
-	{
-		bufferInfoFirstFrame.buffer = m_ShadowSpotLightBuffers[0].GetApiBuffer();
-		bufferInfoFirstFrame.offset = 0;
-		bufferInfoFirstFrame.range = sizeof(ShadowInfoSpotLight);
-	}
+	std::vector<DescriptionInfo>		infos = std::vector<DescriptionInfo>(descriptionsCount * framesCount, DescriptionInfo());
+	std::vector<VkDescriptorBufferInfo>	bufferInfos = std::vector<VkDescriptorBufferInfo>(descriptionsCount * framesCount, VkDescriptorBufferInfo());
 
-	VkDescriptorBufferInfo			bufferInfoSecondFrame = { };
+	for (uint32_t frameIndex = 0; frameIndex < framesCount; ++frameIndex)
 	{
-		bufferInfoSecondFrame.buffer = m_ShadowSpotLightBuffers[1].GetApiBuffer();
-		bufferInfoSecondFrame.offset = 0;
-		bufferInfoSecondFrame.range = sizeof(ShadowInfoSpotLight);
-	}
+		const VkBuffer			uniformBuffer = m_RenderHandle->GetUniformArena(frameIndex)->GetApiBuffer();
 
-	// dynamic per mesh buffer
-	VkDescriptorBufferInfo			bufferInfoDynamicFirstFrame = { };
-	{
-		bufferInfoDynamicFirstFrame.buffer = m_PerMeshBuffers[0].GetApiBuffer();
-		bufferInfoDynamicFirstFrame.offset = 0;
-		bufferInfoDynamicFirstFrame.range = VK_WHOLE_SIZE;
-	}
+		VkDescriptorBufferInfo	*frameBufferInfos = &bufferInfos[frameIndex * descriptionsCount];
+		{
+			frameBufferInfos[0].buffer = uniformBuffer;
+			frameBufferInfos[0].range = sizeof(ShadowInfoSpotLight);
 
-	VkDescriptorBufferInfo			bufferInfoDynamicSecondFrame = { };
-	{
-		bufferInfoDynamicSecondFrame.buffer = m_PerMeshBuffers[1].GetApiBuffer();
-		bufferInfoDynamicSecondFrame.offset = 0;
-		bufferInfoDynamicSecondFrame.range = VK_WHOLE_SIZE;
-	}
+			frameBufferInfos[1].buffer = uniformBuffer;
+			frameBufferInfos[1].range = sizeof(MeshData);
+		}
 
-	// FIXME: dirty
-	infos[0].m_DescBufferInfo = &bufferInfoFirstFrame;
-	infos[1].m_DescBufferInfo = &bufferInfoDynamicFirstFrame;
-	infos[2].m_DescBufferInfo = &bufferInfoSecondFrame;
-	infos[3].m_DescBufferInfo = &bufferInfoDynamicSecondFrame;
+		for (uint32_t descIndex = 0; descIndex < descriptionsCount; ++descIndex)
+			infos[frameIndex * descriptionsCount + descIndex].m_DescBufferInfo = &frameBufferInfos[descIndex];
+	}
 
-	m_UniformDescriptions.push_back(UniformDescription(logicalDevice, descriptions, infos, m_RenderHandle->GetPendingFramesCount(), true));
+	m_UniformDescriptions.push_back(UniformDescription(logicalDevice, descriptions, infos, framesCount, true));
 
 	VkPipelineLayoutCreateInfo	shadowPipelineLayoutCreateInfo = { };
 	{
 		shadowPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		shadowPipelineLayoutCreateInfo.setLayoutCount = 2;
-		shadowPipelineLayoutCreateInfo.pSetLayouts = m_UniformDescriptions[2].GetDescriptorLayouts().data();
+		shadowPipelineLayoutCreateInfo.pSetLayouts = m_SkyboxUniformDescription->GetDescriptorLayouts().data();
 	}
 
 	CHECK_API_SUCCESS(vkCreatePipelineLayout(logicalDevice, &shadowPipelineLayoutCreateInfo, nullptr, &m_PiplelineLayoutShadowSpotLight));
@@ -1666,18 +2470,18 @@ bool	Scene::CreateDepthBuffer(const VkDevice logicalDevice)
 																					VK_FORMAT_D32_SFLOAT,
 																					VK_IMAGE_TILING_OPTIMAL,
 																					VK_IMAGE_LAYOUT_UNDEFINED,
-																					VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+																					VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | ((Device::m_Device->UsesOcclusionCulling()) ? VK_IMAGE_USAGE_SAMPLED_BIT : 0),
 																					Device::m_Device->GetMaxAALevel());
 
-	std::vector<VkImage>		outImages;
-	std::vector<VkDeviceMemory>	outMemories;
-	if (!m_RenderHandle->CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, outImages, outMemories))
+	std::vector<VkImage>			outImages;
+	std::vector<MemoryAllocation>	outAllocations;
+	if (!m_RenderHandle->CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, outImages, outAllocations))
 	{
 		return false; // TODO: add log error
 	}
 
 	m_DepthImage = outImages[0];
-	m_DepthMemory = outMemories[0];
+	m_DepthAllocation = outAllocations[0];
 
 	VkImageSubresourceRange		subRange = Initializers::Image::SubresourceRange(VK_IMAGE_ASPECT_DEPTH_BIT, 1, 0, 1, 0);
 
@@ -1712,7 +2516,7 @@ bool	Scene::CreateImagesForObjects(const VkDevice logicalDevice)
 																				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
 																				Device::m_Device->GetMaxAALevel());
 
-	if (!m_RenderHandle->CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_RenderHandle->GetPendingFramesCount(), m_ImagesObjects, m_ObjectsMemories))
+	if (!m_RenderHandle->CreateImages(logicalDevice, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, static_cast<uint32_t>(m_RenderHandle->GetSwapchainImageViews().size()), m_ImagesObjects, m_ObjectsAllocations))
 	{
 		return false; // TODO: add log error
 	}
@@ -1751,98 +2555,86 @@ bool	Scene::CreateShaderModule(const VkDevice logicalDevice, const std::vector<c
 
 //----------------------------------------------------------------
 
-bool	Scene::UpdateMeshBuffer(const VkDevice logicalDevice, uint32_t newMeshIndex)
+bool	Scene::SetupGpuCulling(const VkDevice logicalDevice, const VkShaderModule cullModule, const VkShaderModule pyramidModule, const VkShaderModule pyramidResolveModule)
 {
-	// add uniform description
-	const std::vector<std::tuple<DESCRIPTION_TYPE, SHADER_STAGE>>	descriptions =
+	if (pyramidModule != nullptr)
 	{
-		std::make_tuple(DESCRIPTION_TYPE::UniformBuffer, SHADER_STAGE::Vertex), // matrices view and proj
-		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, static_cast<SHADER_STAGE>((int)SHADER_STAGE::Vertex | (int)SHADER_STAGE::Fragment)), // dynamic per mesh
-		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // mesh texture
-		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // skybox
-		std::make_tuple(DESCRIPTION_TYPE::UniformBuffer, SHADER_STAGE::Fragment), // light
-		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // shadowMapCascadeSampler
-		std::make_tuple(DESCRIPTION_TYPE::UniformBuffer, static_cast<SHADER_STAGE>((int)SHADER_STAGE::Vertex | (int)SHADER_STAGE::Fragment)), // shadowBufferCasacade
-		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // shadowMapSpotLight
-		std::make_tuple(DESCRIPTION_TYPE::UniformBuffer, SHADER_STAGE::Vertex), // shadowBufferSpotLight
-	};
+		m_DepthPyramid = new DepthPyramid(m_RenderHandle);
+		if (!m_DepthPyramid->Setup(logicalDevice, m_DepthImageView, m_RenderHandle->GetSwapchainExtent(), Device::m_Device->GetMaxAALevel(), pyramidModule, pyramidResolveModule))
+			return false;
+	}
 
-	std::vector<DescriptionInfo>	infos = std::vector<DescriptionInfo>(descriptions.size() * m_RenderHandle->GetPendingFramesCount(), DescriptionInfo());
+	// same images and uniform ranges as the per mesh descriptor sets
+	const Texture		&fallbackTexture = *m_RenderHandle->GetTextureRegistry()->GetFallback();
+	const Texture		&skyboxTexture = m_Skybox.GetTextures()[0];
 
-	// matrices view and proj buffer
-	VkDescriptorBufferInfo			bufferInfoFirstFrame = { };
+	GpuCullingBindings	bindings = { };
 	{
-		bufferInfoFirstFrame.buffer = m_VPBuffers[0].GetApiBuffer();
-		bufferInfoFirstFrame.offset = 0;
-		bufferInfoFirstFrame.range = sizeof(VP);
-	}
+		bindings.m_Fallback = { fallbackTexture.m_Sampler, fallbackTexture.m_ImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		bindings.m_Skybox = { skyboxTexture.m_Sampler, skyboxTexture.m_ImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		bindings.m_ShadowCascade = { m_ShadowCascadeSampler, m_ShadowCascadeImageViews[0], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		bindings.m_ShadowSpotLight = { m_ShadowSpotLightSampler, m_ShadowSpotLightImageViews[0], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		bindings.m_DepthPyramid = (m_DepthPyramid != nullptr) ? m_DepthPyramid->GetImageInfo() : bindings.m_Fallback;
 
-	VkDescriptorBufferInfo			bufferInfoSecondFrame = { };
-	{
-		bufferInfoSecondFrame.buffer = m_VPBuffers[1].GetApiBuffer();
-		bufferInfoSecondFrame.offset = 0;
-		bufferInfoSecondFrame.range = sizeof(VP);
+		bindings.m_VPRange = sizeof(VP);
+		bindings.m_LightsRange = sizeof(UBOLights);
+		bindings.m_ShadowCascadeRange = sizeof(ShadowInfoCascade);
+		bindings.m_ShadowSpotLightRange = sizeof(ShadowInfoSpotLight);
 	}
 
-	// dynamic per mesh buffer
-	VkDescriptorBufferInfo			bufferInfoDynamicFirstFrame = { };
-	{
-		bufferInfoDynamicFirstFrame.buffer = m_PerMeshBuffers[0].GetApiBuffer();
-		bufferInfoDynamicFirstFrame.offset = 0;
-		bufferInfoDynamicFirstFrame.range = VK_WHOLE_SIZE;
-	}
+	m_GpuCulling = new GpuCulling(m_RenderHandle);
+	if (!m_GpuCulling->Setup(logicalDevice, cullModule, bindings))
+		return false;
 
-	VkDescriptorBufferInfo			bufferInfoDynamicSecondFrame = { };
+	// meshes created before the pass, the sphere
+	const uint32_t		meshesCount = static_cast<uint32_t>(m_Meshes.size());
+	for (uint32_t meshIndex = 0; meshIndex < meshesCount; ++meshIndex)
 	{
-		bufferInfoDynamicSecondFrame.buffer = m_PerMeshBuffers[1].GetApiBuffer();
-		bufferInfoDynamicSecondFrame.offset = 0;
-		bufferInfoDynamicSecondFrame.range = VK_WHOLE_SIZE;
-	}
+		m_MeshCullingSlots[meshIndex] = AddGpuCullingMesh(m_Meshes[meshIndex]);
 
-	// light buffer
-	VkDescriptorBufferInfo			lightBufferFirstFrame = { };
-	{
-		lightBufferFirstFrame.buffer = m_LightBuffers[0].GetApiBuffer();
-		lightBufferFirstFrame.offset = 0;
-		lightBufferFirstFrame.range = sizeof(UBOLights);
+		if (m_MeshCullingSlots[meshIndex] != UINT32_MAX)
+			--m_CpuCulledMeshesCount;
 	}
 
-	VkDescriptorBufferInfo			lightBufferSecondFrame = { };
-	{
-		lightBufferSecondFrame.buffer = m_LightBuffers[1].GetApiBuffer();
-		lightBufferSecondFrame.offset = 0;
-		lightBufferSecondFrame.range = sizeof(UBOLights);
-	}
+	return true;
+}
 
-	// cascade shadow buffer -> Directionnal
-	VkDescriptorBufferInfo			shadowCascadeBufferInfoFirstFrame = { };
-	{
-		shadowCascadeBufferInfoFirstFrame.buffer = m_ShadowCascadeBuffers[0].GetApiBuffer();
-		shadowCascadeBufferInfoFirstFrame.offset = 0;
-		shadowCascadeBufferInfoFirstFrame.range = sizeof(ShadowInfoCascade);
-	}
+//----------------------------------------------------------------
 
-	VkDescriptorBufferInfo			shadowCascadeBufferInfoSecondFrame = { };
-	{
-		shadowCascadeBufferInfoSecondFrame.buffer = m_ShadowCascadeBuffers[1].GetApiBuffer();
-		shadowCascadeBufferInfoSecondFrame.offset = 0;
-		shadowCascadeBufferInfoSecondFrame.range = sizeof(ShadowInfoCascade);
-	}
+bool	Scene::UpdateMeshBuffer(const VkDevice logicalDevice, uint32_t newMeshIndex)
+{
+	// materials without texture sample white
+	const TextureHandle	&materialTexture = m_Meshes[newMeshIndex]->GetMaterial().GetTexture();
+	const Texture		&texture = (materialTexture != nullptr) ? *materialTexture : *m_RenderHandle->GetTextureRegistry()->GetFallback();
 
-	// spotLight shadow buffer 
-	VkDescriptorBufferInfo			shadowSpotLightBufferInfoFirstFrame = { };
-	{
-		shadowSpotLightBufferInfoFirstFrame.buffer = m_ShadowSpotLightBuffers[0].GetApiBuffer();
-		shadowSpotLightBufferInfoFirstFrame.offset = 0;
-		shadowSpotLightBufferInfoFirstFrame.range = sizeof(ShadowInfoSpotLight);
-	}
+	// add uniform description
+	m_UniformDescriptions.push_back(CreateMeshDescription(logicalDevice, texture));
+	m_MeshImageVersions.insert(m_MeshImageVersions.end(), m_RenderHandle->GetPendingFramesCount(), texture.m_ImageVersion);
+
+	return true;
+}
+
+//----------------------------------------------------------------
 
-	VkDescriptorBufferInfo			shadowSpotLightBufferInfoSecondFrame = { };
+UniformDescription	Scene::CreateMeshDescription(const VkDevice logicalDevice, const Texture &texture) const
+{
+	const std::vector<std::tuple<DESCRIPTION_TYPE, SHADER_STAGE>>	descriptions =
 	{
-		shadowSpotLightBufferInfoSecondFrame.buffer = m_ShadowSpotLightBuffers[1].GetApiBuffer();
-		shadowSpotLightBufferInfoSecondFrame.offset = 0;
-		shadowSpotLightBufferInfoSecondFrame.range = sizeof(ShadowInfoSpotLight);
-	}
+		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, SHADER_STAGE::Vertex), // matrices view and proj
+		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, static_cast<SHADER_STAGE>((int)SHADER_STAGE::Vertex | (int)SHADER_STAGE::Fragment)), // dynamic per mesh
+		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // mesh texture
+		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // skybox
+		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, SHADER_STAGE::Fragment), // light
+		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // shadowMapCascadeSampler
+		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, static_cast<SHADER_STAGE>((int)SHADER_STAGE::Vertex | (int)SHADER_STAGE::Fragment)), // shadowBufferCasacade
+		std::make_tuple(DESCRIPTION_TYPE::CombinedImageSampler, SHADER_STAGE::Fragment), // shadowMapSpotLight
+		std::make_tuple(DESCRIPTION_TYPE::UniformBufferDynamic, SHADER_STAGE::Vertex), // shadowBufferSpotLight
+	};
+
+	const uint32_t					framesCount = m_RenderHandle->GetPendingFramesCount();
+	const uint32_t					descriptionsCount = static_cast<uint32_t>(descriptions.size());
+
+	std::vector<DescriptionInfo>	infos = std::vector<DescriptionInfo>(descriptionsCount * framesCount, DescriptionInfo());
 
 	// skybox image
 	const Texture					&skyboxTexture = m_Skybox.GetTextures()[0];
@@ -1861,8 +2653,6 @@ bool	Scene::UpdateMeshBuffer(const VkDevice logicalDevice, uint32_t newMeshIndex
 		imageInfoShadowMapCascade.sampler = m_ShadowCascadeSampler;
 	}
 
-	m_RenderHandle->PrepareShadow(logicalDevice, m_ShadowSpotLightSampler);
-
 	VkDescriptorImageInfo			imageInfoShadowMapSpotLight = { };
 	{
 		imageInfoShadowMapSpotLight.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -1870,8 +2660,6 @@ bool	Scene::UpdateMeshBuffer(const VkDevice logicalDevice, uint32_t newMeshIndex
 		imageInfoShadowMapSpotLight.sampler = m_ShadowSpotLightSampler;
 	}
 
-	const Texture					&texture = m_Meshes[newMeshIndex]->GetMaterial().GetTexture();
-
 	// mesh image
 	VkDescriptorImageInfo			imageInfo = { };
 	{
@@ -1880,31 +2668,102 @@ bool	Scene::UpdateMeshBuffer(const VkDevice logicalDevice, uint32_t newMeshIndex
 		imageInfo.sampler = texture.m_Sampler;
 	}
 
-	// FIXME: dirty 
-	// First Frame
-	infos[0].m_DescBufferInfo = &bufferInfoFirstFrame;
-	infos[1].m_DescBufferInfo = &bufferInfoDynamicFirstFrame;
-	infos[2].m_DescImageInfo = &imageInfo;
-	infos[3].m_DescImageInfo = &imageInfoSkybox;
-	infos[4].m_DescBufferInfo = &lightBufferFirstFrame;
-	infos[5].m_DescImageInfo = &imageInfoShadowMapCascade;
-	infos[6].m_DescBufferInfo = &shadowCascadeBufferInfoFirstFrame;
-	infos[7].m_DescImageInfo = &imageInfoShadowMapSpotLight;
-	infos[8].m_DescBufferInfo = &shadowSpotLightBufferInfoFirstFrame;
-
-	// 2E Frame
-	infos[9].m_DescBufferInfo = &bufferInfoSecondFrame;
-	infos[10].m_DescBufferInfo = &bufferInfoDynamicSecondFrame;
-	infos[11].m_DescImageInfo = &imageInfo;
-	infos[12].m_DescImageInfo = &imageInfoSkybox;
-	infos[13].m_DescBufferInfo = &lightBufferSecondFrame;
-	infos[14].m_DescImageInfo = &imageInfoShadowMapCascade;
-	infos[15].m_DescBufferInfo = &shadowCascadeBufferInfoSecondFrame;
-	infos[16].m_DescImageInfo = &imageInfoShadowMapSpotLight;
-	infos[17].m_DescBufferInfo = &shadowSpotLightBufferInfoSecondFrame;
-
-	m_UniformDescriptions.push_back(UniformDescription(logicalDevice, descriptions, infos, m_RenderHandle->GetPendingFramesCount(), true));
-	return true;
+	// per frame uniforms, all in the frame arena: view and proj, dynamic per mesh, light, cascade shadow and spotLight shadow
+	const uint32_t						frameBuffersCount = 5;
+	std::vector<VkDescriptorBufferInfo>	bufferInfos = std::vector<VkDescriptorBufferInfo>(frameBuffersCount * framesCount, VkDescriptorBufferInfo());
+
+	for (uint32_t frameIndex = 0; frameIndex < framesCount; ++frameIndex)
+	{
+		const VkBuffer			uniformBuffer = m_RenderHandle->GetUniformArena(frameIndex)->GetApiBuffer();
+
+		VkDescriptorBufferInfo	*frameBufferInfos = &bufferInfos[frameIndex * frameBuffersCount];
+		{
+			frameBufferInfos[0].buffer = uniformBuffer;
+			frameBufferInfos[0].range = sizeof(VP);
+
+			frameBufferInfos[1].buffer = uniformBuffer;
+			frameBufferInfos[1].range = sizeof(MeshData);
+
+			frameBufferInfos[2].buffer = uniformBuffer;
+			frameBufferInfos[2].range = sizeof(UBOLights);
+
+			frameBufferInfos[3].buffer = uniformBuffer;
+			frameBufferInfos[3].range = sizeof(ShadowInfoCascade);
+
+			frameBufferInfos[4].buffer = uniformBuffer;
+			frameBufferInfos[4].range = sizeof(ShadowInfoSpotLight);
+		}
+
+		DescriptionInfo			*frameInfos = &infos[frameIndex * descriptionsCount];
+		{
+			frameInfos[0].m_DescBufferInfo = &frameBufferInfos[0];
+			frameInfos[1].m_DescBufferInfo = &frameBufferInfos[1];
+			frameInfos[2].m_DescImageInfo = &imageInfo;
+			frameInfos[3].m_DescImageInfo = &imageInfoSkybox;
+			frameInfos[4].m_DescBufferInfo = &frameBufferInfos[2];
+			frameInfos[5].m_DescImageInfo = &imageInfoShadowMapCascade;
+			frameInfos[6].m_DescBufferInfo = &frameBufferInfos[3];
+			frameInfos[7].m_DescImageInfo = &imageInfoShadowMapSpotLight;
+			frameInfos[8].m_DescBufferInfo = &frameBufferInfos[4];
+		}
+	}
+
+	return UniformDescription(logicalDevice, descriptions, infos, framesCount, true);
+}
+
+//----------------------------------------------------------------
+
+void	Scene::UpdateMeshTextures(const VkDevice logicalDevice, const glm::mat4 &view, const glm::mat4 &proj)
+{
+	TextureRegistry		*textureRegistry = m_RenderHandle->GetTextureRegistry();
+
+	const uint32_t		frameIndex = m_RenderHandle->GetCurrentFrame();
+	const uint32_t		framesCount = m_RenderHandle->GetPendingFramesCount();
+	const float			screenHeight = static_cast<float>(m_RenderHandle->GetSwapchainExtent().height);
+	const float			projectionScale = fabsf(proj[1][1]);
+
+	const uint32_t		meshesCount = static_cast<uint32_t>(m_Meshes.size());
+	for (uint32_t meshIndex = 0; meshIndex < meshesCount; ++meshIndex)
+	{
+		Mesh			*mesh = m_Meshes[meshIndex];
+		const Material	&material = mesh->GetMaterial();
+
+		// bounding sphere projected on the screen, the whole screen when the camera is inside
+		const glm::mat4	model = mesh->GetModel();
+		const glm::vec3	center = glm::vec3(model * glm::vec4((mesh->GetBoundsMin() + mesh->GetBoundsMax()) * 0.5f, 1.f));
+		const float		scale = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+		const float		radius = glm::length(mesh->GetBoundsMax() - mesh->GetBoundsMin()) * 0.5f * scale;
+		const float		distance = glm::length(glm::vec3(view * glm::vec4(center, 1.f)));
+
+		const float		screenSize = (distance > radius) ? projectionScale * radius / distance * screenHeight : screenHeight;
+
+		if (material.GetTexture() != nullptr)
+			textureRegistry->RequestScreenSize(*material.GetTexture(), screenSize);
+
+		if (material.GetNormalTexture() != nullptr)
+			textureRegistry->RequestScreenSize(*material.GetNormalTexture(), screenSize);
+
+		// materials without texture sample white
+		const Texture	&texture = (material.GetTexture() != nullptr) ? *material.GetTexture() : *textureRegistry->GetFallback();
+
+		// the textures array of the indirect draws keeps its own versions
+		if (m_MeshCullingSlots[meshIndex] != UINT32_MAX)
+			m_GpuCulling->UpdateTexture(logicalDevice, frameIndex, m_MeshCullingSlots[meshIndex], texture);
+
+		uint64_t		&imageVersion = m_MeshImageVersions[meshIndex * framesCount + frameIndex];
+		if (imageVersion == texture.m_ImageVersion)
+			continue;
+
+		VkDescriptorImageInfo	imageInfo = { };
+		{
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageInfo.imageView = texture.m_ImageView;
+			imageInfo.sampler = texture.m_Sampler;
+		}
+
+		m_UniformDescriptions[meshIndex + 2].UpdateImage(logicalDevice, frameIndex, 2, imageInfo); // mesh texture binding
+		imageVersion = texture.m_ImageVersion;
+	}
 }
 
 //----------------------------------------------------------------
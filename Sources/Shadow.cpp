@@ -20,11 +20,15 @@ Shadow::Shadow(float nearClip, float farClip)
 	m_ShadowInfoCascade.m_ShowPCFFilter = 1;
 
 	m_Extent = { SHADOWMAP_DIM, SHADOWMAP_DIM };
+
+	// every caster passes a zeroed view, until the first cascades update
+	for (CullingView &cullingView : m_CascadeCullingViews)
+		cullingView = CullingView();
 }
 
 //----------------------------------------------------------------
 
-void Shadow::UpdateSpotLightShadow(const Light* spotLight, const glm::mat4 & cameraProj, const glm::mat4 & cameraView)
+void Shadow::UpdateSpotLightShadow(uint32_t shadowIndex, const Light* spotLight, const glm::mat4 & cameraProj, const glm::mat4 & cameraView)
 {
 	glm::mat4	depthProjectionMatrix = glm::perspective(spotLight->GetAngle(), 1280.f / 720.0f, 1.0f, spotLight->GetRadius());
 	depthProjectionMatrix[1][1] *= -1.f;
@@ -32,7 +36,7 @@ void Shadow::UpdateSpotLightShadow(const Light* spotLight, const glm::mat4 & cam
 	lightDir *= -1;
 	glm::mat4	depthViewMatrix = glm::lookAt(spotLight->GetPosition(), lightDir - spotLight->GetPosition(), glm::vec3(0.0f, 1.0f, 0.0f)); // value to the light -> TODO
 
-	m_ShadowInfoSpotLight.m_LightSpace = depthProjectionMatrix * depthViewMatrix;
+	m_ShadowInfoSpotLights[shadowIndex].m_LightSpace = depthProjectionMatrix * depthViewMatrix;
 }
 
 //----------------------------------------------------------------
@@ -128,6 +132,10 @@ void		Shadow::CalculateOrthoFrustum(const glm::vec3& directionnalLightPos, const
 		m_ShadowInfoCascade.m_CascadeSplits[idxSplitDist] = (m_NearClip + splitDist * m_ClipRange) * -1.0f;
 		m_ShadowInfoCascade.m_LightSpace[idxSplitDist] = lightOrthoMatrix * lightViewMatrix;
 
+		// casters behind the near plane of the ortho box still shadow the cascade, no size test in shadow maps
+		m_CascadeCullingViews[idxSplitDist] = FrustumCulling::MakeView(m_ShadowInfoCascade.m_LightSpace[idxSplitDist], static_cast<float>(m_Extent.height), 0.f);
+		FrustumCulling::ExtendTowardEye(m_CascadeCullingViews[idxSplitDist]);
+
 		lastSplitDist = m_CascadeSplits[idxSplitDist];
 	}
 }
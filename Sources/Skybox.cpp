@@ -7,6 +7,31 @@ LIGHTLYY_BEGIN
 //----------------------------------------------------------------
 
 Skybox::Skybox(const VkDevice logicalDevice, const std::string &folderPath, const std::string &extension)
+{
+	LoadFaces(folderPath, extension);
+	CreateBuffers(logicalDevice);
+}
+
+//----------------------------------------------------------------
+
+Task<Skybox>	Skybox::LoadAsync(AssetLoader &loader, const VkDevice logicalDevice, std::string folderPath, std::string extension)
+{
+	Skybox	skybox;
+
+	co_await loader.ToWorker();
+
+	skybox.LoadFaces(folderPath, extension);
+
+	co_await loader.ToRenderThread();
+
+	skybox.CreateBuffers(logicalDevice);
+
+	co_return skybox;
+}
+
+//----------------------------------------------------------------
+
+void	Skybox::LoadFaces(const std::string &folderPath, const std::string &extension)
 {
 	m_Size = 0;
 
@@ -24,11 +49,16 @@ Skybox::Skybox(const VkDevice logicalDevice, const std::string &folderPath, cons
 	for (uint32_t textureIndex = 0; textureIndex < 6; ++textureIndex)
 	{
 		Texture	&texture = m_Textures[textureIndex];
-		texture = Texture(folderPath + skyboxFaces[textureIndex] + extension, 4);
+		texture = Texture(folderPath + skyboxFaces[textureIndex] + extension, 4, false); // faces are uploaded as layers of a single RGBA8 level
 
 		m_Size += texture.GetWidth() * texture.GetHeight() * 4;
 	}
+}
+
+//----------------------------------------------------------------
 
+void	Skybox::CreateBuffers(const VkDevice logicalDevice)
+{
 	m_VertexBuffer = Buffer<glm::vec3>(logicalDevice, BUFFER_TYPE::Vertex, 8); // 8 = cube points
 	m_VertexBuffer.UpdateData(logicalDevice, m_Vertices);
 
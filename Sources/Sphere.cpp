@@ -11,8 +11,11 @@ LIGHTLYY_BEGIN
 //----------------------------------------------------------------
 
 Sphere::Sphere(const VkDevice logicalDevice, uint32_t precision, const std::string &path, const std::string &name, const bool bTriangleStrip)
-:	Mesh(logicalDevice, path, name)
+:	Mesh(path, name)
 {
+	// procedural, the path is the texture of the sphere
+	m_Material = Material(Device::m_Device->GetTextureRegistry()->Load(logicalDevice, path, 4));
+
 	std::vector<VertexData>	vertices;
 
 	if (bTriangleStrip)
@@ -129,9 +132,9 @@ Sphere::Sphere(const VkDevice logicalDevice, uint32_t precision, const std::stri
 		}
 	}
 
-	m_VertexBuffer = Buffer<VertexData>(logicalDevice, BUFFER_TYPE::Vertex, static_cast<uint32_t>(vertices.size()));
-	m_IndexBuffer = Buffer<uint16_t>(logicalDevice, BUFFER_TYPE::Index, static_cast<uint32_t>(m_Indices.size()));
-	UpdateData(logicalDevice, vertices, m_Indices);
+	AllocateBuffers(logicalDevice, static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(m_Indices.size()), sizeof(uint16_t));
+	if (!UpdateData(logicalDevice, vertices, m_Indices))
+		std::cout << "Can't upload sphere " << GetName() << std::endl; // TODO: change this for real logger
 }
 
 //----------------------------------------------------------------
@@ -1,6 +1,9 @@
 #include "Texture.h"
 
 #include <algorithm>
+#include <filesystem>
+
+#include "Device.h"
 
 //----------------------------------------------------------------
 
@@ -8,12 +11,74 @@ LIGHTLYY_BEGIN
 
 //----------------------------------------------------------------
 
-Texture::Texture(const std::string &path, uint32_t desiredChannelCount)
-:	m_Path(path)
+Texture::Texture()
+:	m_Image(nullptr),
+	m_ImageView(nullptr),
+	m_Sampler(nullptr),
+	m_UploadBatch(0),
+	m_Streamed(false),
+	m_ResidentLevel(0),
+	m_RequestedLevel(0),
+	m_LastRequestFrame(0),
+	m_ImageVersion(0),
+	m_Width(0),
+	m_Height(0),
+	m_Channel(0),
+	m_DesiredChannelCount(0),
+	m_MipmapLevels(0),
+	m_Format(VK_FORMAT_R8G8B8A8_UNORM)
 {
+
+}
+
+//----------------------------------------------------------------
+
+Texture::Texture(const std::string &path, uint32_t desiredChannelCount, bool useCompressed)
+:	Texture()
+{
+	m_Path = path;
+	m_DesiredChannelCount = desiredChannelCount;
+
+	std::filesystem::path	sourcePath = std::filesystem::path(path);
+
+	if (sourcePath.extension() == KTX2_EXTENSION)
+	{
+		LoadKtx2(path);
+		return;
+	}
+
+	// the converted file is skipped once the source is edited again
+	if (useCompressed)
+	{
+		std::filesystem::path	compressedPath = sourcePath;
+		compressedPath.replace_extension(KTX2_EXTENSION);
+
+		std::error_code			error;
+		if (std::filesystem::exists(compressedPath, error) &&
+			std::filesystem::last_write_time(compressedPath, error) >= std::filesystem::last_write_time(sourcePath, error) &&
+			!error && LoadKtx2(compressedPath.string()))
+			return;
+	}
+
 	m_Pixels = LoadImageTextureWithSTB(m_Path, &m_Width, &m_Height, &m_Channel, desiredChannelCount);
 
-	m_MipmapLevels = floor(log2(std::max(m_Width, m_Height))) + 1;
+	if (!m_Pixels.empty())
+		SetBaseLevel();
+}
+
+//----------------------------------------------------------------
+
+Texture::Texture(const std::string &name, uint32_t width, uint32_t height, std::vector<stbi_uc> &&pixels)
+:	Texture()
+{
+	m_Path = name;
+	m_Width = width;
+	m_Height = height;
+	m_Channel = 4;
+	m_DesiredChannelCount = 4;
+	m_Pixels = std::move(pixels);
+
+	SetBaseLevel();
 }
 
 //----------------------------------------------------------------
@@ -25,4 +90,64 @@ void	Texture::FreeTexture()
 
 //----------------------------------------------------------------
 
+uint64_t	Texture::GetChainSize(uint32_t firstLevel) const
+{
+	uint64_t		chainSize = 0;
+
+	const uint32_t	levelsCount = static_cast<uint32_t>(m_Levels.size());
+	for (uint32_t levelIndex = firstLevel; levelIndex < levelsCount; ++levelIndex)
+		chainSize += m_Levels[levelIndex].m_Size;
+
+	return chainSize;
+}
+
+//----------------------------------------------------------------
+
+bool	Texture::LoadKtx2(const std::string &path)
+{
+	Ktx2::Image		image;
+	if (!Ktx2::Read(path, image))
+		return false;
+
+	// BC formats are optional, the source image is decoded instead on devices without them
+	if (Device::m_Device != nullptr && !Device::m_Device->SupportsSampledFormat(image.m_Format))
+		return false;
+
+	m_Width = image.m_Width;
+	m_Height = image.m_Height;
+	m_Channel = 4;
+	m_Format = image.m_Format;
+	m_Pixels = std::move(image.m_Data);
+	m_Levels = std::move(image.m_Levels);
+
+	// compressed blocks can't be blitted, they are sampled with the levels stored in the file only
+	const uint32_t	levelsCount = static_cast<uint32_t>(m_Levels.size());
+	if (Ktx2::IsBlockCompressed(m_Format) || levelsCount > 1)
+		m_MipmapLevels = levelsCount;
+	else
+		m_MipmapLevels = floor(log2(std::max(m_Width, m_Height))) + 1;
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	Texture::SetBaseLevel()
+{
+	m_Format = VK_FORMAT_R8G8B8A8_UNORM;
+	m_MipmapLevels = floor(log2(std::max(m_Width, m_Height))) + 1;
+
+	Ktx2::Level		baseLevel = { };
+	{
+		baseLevel.m_Offset = 0;
+		baseLevel.m_Size = m_Pixels.size();
+		baseLevel.m_Width = m_Width;
+		baseLevel.m_Height = m_Height;
+	}
+
+	m_Levels = { baseLevel };
+}
+
+//----------------------------------------------------------------
+
 LIGHTLYY_END
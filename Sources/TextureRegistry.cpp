@@ -0,0 +1,479 @@
+#include "TextureRegistry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+#include "Device.h"
+#include "CpuProfiler.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+TextureRegistry::TextureRegistry(const RenderHandle *renderHandle)
+:	m_RenderHandle(renderHandle),
+	m_Textures(std::unordered_map<std::string, std::weak_ptr<const Texture>>()),
+	m_ReleasedTextures(std::vector<ReleasedTexture>()),
+	m_Frame(0),
+	m_ImageVersion(0),
+	m_StreamedTextures(std::vector<Texture*>()),
+	m_StreamingBudget(0),
+	m_StreamingStatistics(TextureStreamingStatistics()),
+	m_Fallback(nullptr)
+{
+
+}
+
+//----------------------------------------------------------------
+
+TextureRegistry::~TextureRegistry()
+{
+	m_RenderHandle = nullptr;
+}
+
+//----------------------------------------------------------------
+
+bool	TextureRegistry::Prepare(const VkDevice logicalDevice)
+{
+	m_Fallback = Register(logicalDevice, Texture("Fallback", 1, 1, std::vector<stbi_uc>(4, 255)));
+
+	return m_Fallback != nullptr;
+}
+
+//----------------------------------------------------------------
+
+void	TextureRegistry::Shutdown(const VkDevice logicalDevice)
+{
+	m_Fallback = nullptr;
+
+	// the device is idle, nothing waits for the frames anymore
+	std::lock_guard<std::mutex>	lock(m_Mutex);
+
+	const uint32_t	releasedCount = static_cast<uint32_t>(m_ReleasedTextures.size());
+	for (uint32_t releasedIndex = 0; releasedIndex < releasedCount; ++releasedIndex)
+		Destroy(logicalDevice, m_ReleasedTextures[releasedIndex].m_Texture);
+
+	m_ReleasedTextures.clear();
+	m_StreamedTextures.clear();
+
+	if (!m_Textures.empty())
+		std::cout << m_Textures.size() << " textures still referenced on shutdown" << std::endl; // TODO: change this for real logger
+
+	m_Textures.clear();
+}
+
+//----------------------------------------------------------------
+
+PendingTexture	TextureRegistry::Decode(const std::string &path, uint32_t desiredChannelCount) const
+{
+	PendingTexture	pendingTexture;
+
+	if (path.empty())
+		return pendingTexture;
+
+	const std::string	key = GetKey(path, desiredChannelCount);
+	{
+		std::lock_guard<std::mutex>	lock(m_Mutex);
+
+		std::unordered_map<std::string, std::weak_ptr<const Texture>>::const_iterator	textureFound = m_Textures.find(key);
+		if (textureFound != m_Textures.end())
+			pendingTexture.m_Handle = textureFound->second.lock();
+	}
+
+	if (pendingTexture.m_Handle == nullptr)
+	{
+		PROFILE_ZONE("Decode texture");
+
+		pendingTexture.m_Decoded = Texture(path, desiredChannelCount);
+	}
+
+	return pendingTexture;
+}
+
+//----------------------------------------------------------------
+
+TextureHandle	TextureRegistry::Resolve(const VkDevice logicalDevice, PendingTexture &&pendingTexture)
+{
+	if (pendingTexture.m_Handle != nullptr)
+		return std::move(pendingTexture.m_Handle);
+
+	if (pendingTexture.m_Decoded.GetPixels().empty())
+		return nullptr;
+
+	return Register(logicalDevice, std::move(pendingTexture.m_Decoded));
+}
+
+//----------------------------------------------------------------
+
+TextureHandle	TextureRegistry::Load(const VkDevice logicalDevice, const std::string &path, uint32_t desiredChannelCount)
+{
+	return Resolve(logicalDevice, Decode(path, desiredChannelCount));
+}
+
+//----------------------------------------------------------------
+
+Task<TextureHandle>	TextureRegistry::LoadAsync(AssetLoader &loader, const VkDevice logicalDevice, std::string path, uint32_t desiredChannelCount)
+{
+	co_await loader.ToWorker();
+
+	PendingTexture	pendingTexture = Decode(path, desiredChannelCount);
+
+	co_await loader.ToRenderThread();
+
+	co_return Resolve(logicalDevice, std::move(pendingTexture));
+}
+
+//----------------------------------------------------------------
+
+void	TextureRegistry::Collect(const VkDevice logicalDevice, uint32_t pendingFramesCount)
+{
+	std::lock_guard<std::mutex>	lock(m_Mutex);
+
+	++m_Frame;
+
+	const UploadManager	*uploadManager = m_RenderHandle->GetUploadManager();
+
+	// a texture released while recording frame N is sampled at most by the frames already in flight,
+	// all of them are done once pendingFramesCount frame slots have been waited for
+	uint32_t		releasedIndex = 0;
+	while (releasedIndex < static_cast<uint32_t>(m_ReleasedTextures.size()))
+	{
+		const ReleasedTexture	&releasedTexture = m_ReleasedTextures[releasedIndex];
+
+		if (m_Frame >= releasedTexture.m_ReleaseFrame + pendingFramesCount && uploadManager->IsComplete(releasedTexture.m_Texture->m_UploadBatch))
+		{
+			Destroy(logicalDevice, releasedTexture.m_Texture);
+
+			m_ReleasedTextures[releasedIndex] = m_ReleasedTextures.back();
+			m_ReleasedTextures.pop_back();
+		}
+		else
+			++releasedIndex;
+	}
+}
+
+//----------------------------------------------------------------
+
+void	TextureRegistry::SetStreamingBudget(uint64_t budgetSize)
+{
+	std::lock_guard<std::mutex>	lock(m_Mutex);
+
+	m_StreamingBudget = budgetSize;
+	m_StreamingStatistics.m_BudgetSize = budgetSize;
+}
+
+//----------------------------------------------------------------
+
+void	TextureRegistry::RequestScreenSize(const Texture &texture, float screenSize)
+{
+	if (!texture.m_Streamed)
+		return;
+
+	// one level per halving of the texels covering a pixel
+	const float		texelsPerPixel = static_cast<float>(std::max(texture.GetWidth(), texture.GetHeight())) / std::max(screenSize, 1.f);
+	const uint32_t	lastLevel = texture.GetMipmapLevels() - 1;
+	const uint32_t	level = (texelsPerPixel > 1.f) ? std::min(static_cast<uint32_t>(floor(log2(texelsPerPixel))), lastLevel) : 0;
+
+	// the registry owns the textures, only it changes their streaming state
+	Texture			*streamedTexture = const_cast<Texture*>(&texture);
+
+	if (streamedTexture->m_LastRequestFrame != m_Frame)
+		streamedTexture->m_RequestedLevel = level;
+	else
+		streamedTexture->m_RequestedLevel = std::min(streamedTexture->m_RequestedLevel, level);
+
+	streamedTexture->m_LastRequestFrame = m_Frame;
+}
+
+//----------------------------------------------------------------
+
+void	TextureRegistry::Stream(const VkDevice logicalDevice)
+{
+	PROFILE_ZONE("TextureRegistry::Stream");
+
+	std::lock_guard<std::mutex>	lock(m_Mutex);
+
+	if (m_StreamingBudget == 0)
+		return;
+
+	// requests of the last frame are still wanted, textures no longer drawn only need their base levels
+	const uint32_t			texturesCount = static_cast<uint32_t>(m_StreamedTextures.size());
+	std::vector<uint32_t>	wantedLevels(texturesCount);
+
+	uint64_t				residentSize = 0;
+	uint64_t				requestedSize = 0;
+
+	for (uint32_t textureIndex = 0; textureIndex < texturesCount; ++textureIndex)
+	{
+		const Texture	*texture = m_StreamedTextures[textureIndex];
+		const bool		isRequested = texture->m_LastRequestFrame + 1 >= m_Frame;
+
+		wantedLevels[textureIndex] = (isRequested) ? std::min(texture->m_RequestedLevel, GetStreamingBaseLevel(*texture)) : GetStreamingBaseLevel(*texture);
+
+		residentSize += texture->GetChainSize(texture->m_ResidentLevel);
+		requestedSize += texture->GetChainSize(wantedLevels[textureIndex]);
+	}
+
+	// least recently requested first, they lose the levels they don't want anymore
+	std::vector<uint32_t>	evictionOrder;
+	std::vector<uint32_t>	upgradeOrder;
+
+	for (uint32_t textureIndex = 0; textureIndex < texturesCount; ++textureIndex)
+	{
+		const Texture	*texture = m_StreamedTextures[textureIndex];
+
+		if (texture->m_ResidentLevel < wantedLevels[textureIndex])
+			evictionOrder.push_back(textureIndex);
+		else if (texture->m_ResidentLevel > wantedLevels[textureIndex])
+			upgradeOrder.push_back(textureIndex);
+	}
+
+	std::sort(evictionOrder.begin(), evictionOrder.end(), [this](uint32_t first, uint32_t second)
+	{
+		return m_StreamedTextures[first]->m_LastRequestFrame < m_StreamedTextures[second]->m_LastRequestFrame;
+	});
+
+	// the blurriest textures first
+	std::sort(upgradeOrder.begin(), upgradeOrder.end(), [this, &wantedLevels](uint32_t first, uint32_t second)
+	{
+		return	m_StreamedTextures[first]->m_ResidentLevel - wantedLevels[first] > m_StreamedTextures[second]->m_ResidentLevel - wantedLevels[second];
+	});
+
+	uint32_t				evictionIndex = 0;
+	const uint32_t			evictionsCount = static_cast<uint32_t>(evictionOrder.size());
+
+	// evicts until the extra size fits in the budget, false when nothing is left to evict
+	auto					makeRoom = [&](uint64_t extraSize)
+	{
+		while (residentSize + extraSize > m_StreamingBudget && evictionIndex < evictionsCount)
+		{
+			const uint32_t	textureIndex = evictionOrder[evictionIndex++];
+			Texture			*texture = m_StreamedTextures[textureIndex];
+
+			const uint64_t	previousSize = texture->GetChainSize(texture->m_ResidentLevel);
+
+			if (SetResidentLevel(logicalDevice, texture, wantedLevels[textureIndex]))
+				residentSize -= previousSize - texture->GetChainSize(texture->m_ResidentLevel);
+		}
+
+		return residentSize + extraSize <= m_StreamingBudget;
+	};
+
+	// a lowered budget is honored even without upgrades
+	makeRoom(0);
+
+	const uint32_t			upgradesCount = std::min(static_cast<uint32_t>(upgradeOrder.size()), static_cast<uint32_t>(TEXTURE_STREAMING_MAX_UPDATES));
+	for (uint32_t upgradeIndex = 0; upgradeIndex < upgradesCount; ++upgradeIndex)
+	{
+		const uint32_t	textureIndex = upgradeOrder[upgradeIndex];
+		Texture			*texture = m_StreamedTextures[textureIndex];
+
+		const uint64_t	residentChainSize = texture->GetChainSize(texture->m_ResidentLevel);
+
+		// the finest wanted level that fits once the least recently requested levels are gone
+		uint32_t		residentLevel = wantedLevels[textureIndex];
+		while (residentLevel < texture->m_ResidentLevel && !makeRoom(texture->GetChainSize(residentLevel) - residentChainSize))
+			++residentLevel;
+
+		if (residentLevel == texture->m_ResidentLevel)
+			continue;
+
+		if (SetResidentLevel(logicalDevice, texture, residentLevel))
+			residentSize += texture->GetChainSize(residentLevel) - residentChainSize;
+	}
+
+	m_StreamingStatistics.m_ResidentSize = residentSize;
+	m_StreamingStatistics.m_RequestedSize = requestedSize;
+	m_StreamingStatistics.m_StreamedCount = texturesCount;
+}
+
+//----------------------------------------------------------------
+
+std::string	TextureRegistry::GetKey(const std::string &path, uint32_t desiredChannelCount)
+{
+	// different spellings of the same file share one entry
+	std::error_code			error;
+	std::filesystem::path	canonicalPath = std::filesystem::weakly_canonical(std::filesystem::path(path), error);
+
+	const std::string		keyPath = (error) ? path : canonicalPath.generic_string();
+
+	return keyPath + "|" + std::to_string(desiredChannelCount);
+}
+
+//----------------------------------------------------------------
+
+uint32_t	TextureRegistry::GetTexturesCount() const
+{
+	std::lock_guard<std::mutex>	lock(m_Mutex);
+
+	return static_cast<uint32_t>(m_Textures.size());
+}
+
+//----------------------------------------------------------------
+
+TextureStreamingStatistics	TextureRegistry::GetStreamingStatistics() const
+{
+	std::lock_guard<std::mutex>	lock(m_Mutex);
+
+	return m_StreamingStatistics;
+}
+
+//----------------------------------------------------------------
+
+TextureHandle	TextureRegistry::Register(const VkDevice logicalDevice, Texture &&texture)
+{
+	const std::string	key = GetKey(texture.GetPath(), texture.GetDesiredChannelCount());
+
+	// two loads of the same file can both decode it, the first one registered wins
+	{
+		std::lock_guard<std::mutex>	lock(m_Mutex);
+
+		std::unordered_map<std::string, std::weak_ptr<const Texture>>::const_iterator	textureFound = m_Textures.find(key);
+		if (textureFound != m_Textures.end())
+		{
+			TextureHandle	handle = textureFound->second.lock();
+			if (handle != nullptr)
+				return handle;
+		}
+	}
+
+	Texture				*sharedTexture = new Texture(std::move(texture));
+
+	// textures without their whole chain in memory can't get their levels back once evicted
+	const uint32_t		baseLevel = GetStreamingBaseLevel(*sharedTexture);
+	{
+		std::lock_guard<std::mutex>	lock(m_Mutex);
+
+		sharedTexture->m_Streamed = m_StreamingBudget > 0 && sharedTexture->HasAllMipmaps() && baseLevel > 0;
+		sharedTexture->m_ResidentLevel = (sharedTexture->m_Streamed) ? baseLevel : 0;
+		sharedTexture->m_RequestedLevel = sharedTexture->m_ResidentLevel;
+		sharedTexture->m_LastRequestFrame = m_Frame;
+	}
+
+	if (!m_RenderHandle->PrepareTexture(logicalDevice, *sharedTexture))
+	{
+		delete sharedTexture;
+		return nullptr;
+	}
+
+	// the deleter only queues the texture, the GPU may still be sampling it
+	TextureHandle		handle = TextureHandle(sharedTexture, [this](const Texture *texture)
+	{
+		Release(const_cast<Texture*>(texture));
+	});
+
+	std::lock_guard<std::mutex>	lock(m_Mutex);
+	m_Textures[key] = handle;
+
+	sharedTexture->m_ImageVersion = ++m_ImageVersion;
+
+	if (sharedTexture->m_Streamed)
+		m_StreamedTextures.push_back(sharedTexture);
+
+	return handle;
+}
+
+//----------------------------------------------------------------
+
+void	TextureRegistry::Release(Texture *texture)
+{
+	const std::string	key = GetKey(texture->GetPath(), texture->GetDesiredChannelCount());
+
+	std::lock_guard<std::mutex>	lock(m_Mutex);
+
+	// the entry may already point to a texture loaded again since
+	std::unordered_map<std::string, std::weak_ptr<const Texture>>::iterator	textureFound = m_Textures.find(key);
+	if (textureFound != m_Textures.end() && textureFound->second.expired())
+		m_Textures.erase(textureFound);
+
+	if (texture->m_Streamed)
+	{
+		std::vector<Texture*>::iterator	streamedFound = std::find(m_StreamedTextures.begin(), m_StreamedTextures.end(), texture);
+		if (streamedFound != m_StreamedTextures.end())
+			m_StreamedTextures.erase(streamedFound);
+	}
+
+	ReleasedTexture	releasedTexture = { };
+	{
+		releasedTexture.m_Texture = texture;
+		releasedTexture.m_ReleaseFrame = m_Frame;
+	}
+
+	m_ReleasedTextures.push_back(releasedTexture);
+}
+
+//----------------------------------------------------------------
+
+void	TextureRegistry::Destroy(const VkDevice logicalDevice, Texture *texture) const
+{
+	vkDestroySampler(logicalDevice, texture->m_Sampler, nullptr);
+	vkDestroyImageView(logicalDevice, texture->m_ImageView, nullptr);
+	vkDestroyImage(logicalDevice, texture->m_Image, nullptr);
+	Device::m_Device->GetMemoryAllocator()->Free(texture->m_Allocation);
+
+	delete texture;
+}
+
+//----------------------------------------------------------------
+
+bool	TextureRegistry::SetResidentLevel(const VkDevice logicalDevice, Texture *texture, uint32_t residentLevel)
+{
+	Texture			*previousImage = new Texture();
+	{
+		previousImage->m_Image = texture->m_Image;
+		previousImage->m_ImageView = texture->m_ImageView;
+		previousImage->m_Allocation = texture->m_Allocation;
+		previousImage->m_Sampler = texture->m_Sampler;
+		previousImage->m_UploadBatch = texture->m_UploadBatch;
+	}
+
+	const uint32_t	previousLevel = texture->m_ResidentLevel;
+	texture->m_ResidentLevel = residentLevel;
+
+	if (!m_RenderHandle->PrepareTexture(logicalDevice, *texture))
+	{
+		texture->m_ResidentLevel = previousLevel;
+		delete previousImage;
+		return false;
+	}
+
+	texture->m_ImageVersion = ++m_ImageVersion;
+
+	if (residentLevel < previousLevel)
+		m_StreamingStatistics.m_UploadedLevelsCount += previousLevel - residentLevel;
+	else
+		m_StreamingStatistics.m_EvictedLevelsCount += residentLevel - previousLevel;
+
+	ReleasedTexture	releasedTexture = { };
+	{
+		releasedTexture.m_Texture = previousImage;
+		releasedTexture.m_ReleaseFrame = m_Frame;
+	}
+
+	m_ReleasedTextures.push_back(releasedTexture);
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+uint32_t	TextureRegistry::GetStreamingBaseLevel(const Texture &texture)
+{
+	const std::vector<Ktx2::Level>	&levels = texture.GetLevels();
+	const uint32_t					levelsCount = static_cast<uint32_t>(levels.size());
+
+	for (uint32_t levelIndex = 0; levelIndex < levelsCount; ++levelIndex)
+	{
+		if (std::max(levels[levelIndex].m_Width, levels[levelIndex].m_Height) <= TEXTURE_STREAMING_BASE_SIZE)
+			return levelIndex;
+	}
+
+	return 0;
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,106 @@
+#include "ThreadPool.h"
+
+#include "CpuProfiler.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+ThreadPool::ThreadPool(uint32_t threadsCount)
+{
+	m_Workers.resize(threadsCount);
+
+	for (uint32_t threadIndex = 0; threadIndex < threadsCount; ++threadIndex)
+	{
+		Worker	*worker = new Worker();
+		worker->m_Thread = std::thread(&ThreadPool::Loop, this, worker);
+
+		m_Workers[threadIndex] = worker;
+	}
+}
+
+//----------------------------------------------------------------
+
+ThreadPool::~ThreadPool()
+{
+	const uint32_t	threadsCount = static_cast<uint32_t>(m_Workers.size());
+	for (uint32_t threadIndex = 0; threadIndex < threadsCount; ++threadIndex)
+	{
+		Worker	*worker = m_Workers[threadIndex];
+		{
+			std::lock_guard<std::mutex>	lock(worker->m_Mutex);
+			worker->m_IsDestroying = true;
+		}
+
+		worker->m_Condition.notify_all();
+		worker->m_Thread.join();
+
+		delete worker;
+	}
+
+	m_Workers.clear();
+}
+
+//----------------------------------------------------------------
+
+void	ThreadPool::Push(uint32_t threadIndex, const std::function<void()> &job)
+{
+	Worker	*worker = m_Workers[threadIndex];
+	{
+		std::lock_guard<std::mutex>	lock(worker->m_Mutex);
+		worker->m_Jobs.push(job);
+	}
+
+	worker->m_Condition.notify_all();
+}
+
+//----------------------------------------------------------------
+
+void	ThreadPool::Wait()
+{
+	const uint32_t	threadsCount = static_cast<uint32_t>(m_Workers.size());
+	for (uint32_t threadIndex = 0; threadIndex < threadsCount; ++threadIndex)
+	{
+		Worker							*worker = m_Workers[threadIndex];
+		std::unique_lock<std::mutex>	lock(worker->m_Mutex);
+
+		worker->m_Condition.wait(lock, [worker]() { return worker->m_Jobs.empty(); });
+	}
+}
+
+//----------------------------------------------------------------
+
+void	ThreadPool::Loop(Worker *worker)
+{
+	CpuProfiler::m_Profiler.SetThreadName("Worker");
+
+	while (true)
+	{
+		std::function<void()>	job;
+		{
+			std::unique_lock<std::mutex>	lock(worker->m_Mutex);
+			worker->m_Condition.wait(lock, [worker]() { return !worker->m_Jobs.empty() || worker->m_IsDestroying; });
+
+			if (worker->m_Jobs.empty()) // only reached when destroying
+				break;
+
+			job = worker->m_Jobs.front();
+		}
+
+		job();
+
+		// pop after execution so Wait() returns once the job is really done
+		{
+			std::lock_guard<std::mutex>	lock(worker->m_Mutex);
+			worker->m_Jobs.pop();
+		}
+
+		worker->m_Condition.notify_all();
+	}
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
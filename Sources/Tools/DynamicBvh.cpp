@@ -0,0 +1,872 @@
+#include "Tools/DynamicBvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+namespace
+{
+
+//----------------------------------------------------------------
+
+enum class BVH_OVERLAP
+{
+	Outside = 0,
+	Intersect = 1,
+	Inside = 2 // the whole subtree passes, its leaves aren't tested
+};
+
+//----------------------------------------------------------------
+
+// half the surface, only ever compared
+float	GetArea(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	const glm::vec3	size = boundsMax - boundsMin;
+
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+//----------------------------------------------------------------
+
+bool	Contains(const glm::vec3 &outerMin, const glm::vec3 &outerMax, const glm::vec3 &innerMin, const glm::vec3 &innerMax)
+{
+	return	outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+			innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+}
+
+//----------------------------------------------------------------
+
+bool	Overlaps(const glm::vec3 &aMin, const glm::vec3 &aMax, const glm::vec3 &bMin, const glm::vec3 &bMax)
+{
+	return	aMin.x <= bMax.x && bMin.x <= aMax.x && aMin.y <= bMax.y && bMin.y <= aMax.y && aMin.z <= bMax.z && bMin.z <= aMax.z;
+}
+
+//----------------------------------------------------------------
+
+BVH_OVERLAP	TestFrustum(const CullingView &view, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	const glm::vec3	center = (boundsMin + boundsMax) * 0.5f;
+	const glm::vec3	extent = (boundsMax - boundsMin) * 0.5f;
+	BVH_OVERLAP		overlap = BVH_OVERLAP::Inside;
+
+	for (const glm::vec4 &plane : view.m_Planes)
+	{
+		const float	distance = glm::dot(glm::vec3(plane), center) + plane.w;
+		const float	boxRadius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+
+		if (distance + boxRadius < 0.f)
+			return BVH_OVERLAP::Outside;
+
+		if (distance - boxRadius < 0.f)
+			overlap = BVH_OVERLAP::Intersect;
+	}
+
+	return overlap;
+}
+
+//----------------------------------------------------------------
+
+// entry distance of the ray in the box, negative when missed, invDirection components may be infinite
+float	IntersectRay(const glm::vec3 &origin, const glm::vec3 &invDirection, float maxDistance, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	float	entry = 0.f;
+	float	exit = maxDistance;
+
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		float	slabEntry = (boundsMin[axis] - origin[axis]) * invDirection[axis];
+		float	slabExit = (boundsMax[axis] - origin[axis]) * invDirection[axis];
+
+		if (slabEntry > slabExit)
+			std::swap(slabEntry, slabExit);
+
+		// NaN from 0 * infinity, the ray lies on a face of the box, is ignored by the comparisons
+		entry = (slabEntry > entry) ? slabEntry : entry;
+		exit = (slabExit < exit) ? slabExit : exit;
+
+		if (entry > exit)
+			return -1.f;
+	}
+
+	return entry;
+}
+
+//----------------------------------------------------------------
+
+struct BuildTask
+{
+	uint32_t	m_Begin;
+	uint32_t	m_End;
+	uint32_t	m_Parent;
+	uint32_t	m_Slot; // child of the parent the subtree goes into
+}; // struct BuildTask
+
+//----------------------------------------------------------------
+
+} // namespace
+
+//----------------------------------------------------------------
+
+DynamicBvh::DynamicBvh()
+:	m_Root(BVH_NULL_NODE),
+	m_FreeNode(BVH_NULL_NODE),
+	m_ProxiesCount(0),
+	m_RebuildsCount(0),
+	m_InnerArea(0.0),
+	m_RebuildCost(0.f)
+{
+}
+
+//----------------------------------------------------------------
+
+uint32_t	DynamicBvh::Insert(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, void *userData)
+{
+	const glm::vec3	margin = (boundsMax - boundsMin) * BVH_FAT_MARGIN;
+
+	const uint32_t	leaf = AllocateNode();
+	{
+		Node	&node = m_Nodes[leaf];
+		node.m_Min = boundsMin - margin;
+		node.m_Max = boundsMax + margin;
+		node.m_UserData = userData;
+	}
+
+	++m_ProxiesCount;
+
+	if (m_Root == BVH_NULL_NODE)
+	{
+		m_Root = leaf;
+		return leaf;
+	}
+
+	const uint32_t	sibling = FindBestSibling(m_Nodes[leaf].m_Min, m_Nodes[leaf].m_Max);
+	const uint32_t	oldParent = m_Nodes[sibling].m_Parent;
+
+	// the new parent takes the place of the sibling
+	const uint32_t	newParent = AllocateNode();
+	{
+		Node	&node = m_Nodes[newParent];
+		node.m_Min = glm::min(m_Nodes[sibling].m_Min, m_Nodes[leaf].m_Min);
+		node.m_Max = glm::max(m_Nodes[sibling].m_Max, m_Nodes[leaf].m_Max);
+		node.m_Parent = oldParent;
+		node.m_Children[0] = sibling;
+		node.m_Children[1] = leaf;
+	}
+
+	m_InnerArea += GetArea(m_Nodes[newParent].m_Min, m_Nodes[newParent].m_Max);
+
+	if (oldParent == BVH_NULL_NODE)
+		m_Root = newParent;
+	else
+	{
+		Node	&parent = m_Nodes[oldParent];
+		parent.m_Children[(parent.m_Children[0] == sibling) ? 0 : 1] = newParent;
+	}
+
+	m_Nodes[sibling].m_Parent = newParent;
+	m_Nodes[leaf].m_Parent = newParent;
+
+	Refit(oldParent);
+
+	return leaf;
+}
+
+//----------------------------------------------------------------
+
+void	DynamicBvh::Remove(uint32_t proxy)
+{
+	--m_ProxiesCount;
+
+	const uint32_t	parent = m_Nodes[proxy].m_Parent;
+
+	FreeNode(proxy);
+
+	if (parent == BVH_NULL_NODE)
+	{
+		m_Root = BVH_NULL_NODE;
+		return;
+	}
+
+	// the sibling takes the place of the parent
+	const uint32_t	sibling = m_Nodes[parent].m_Children[(m_Nodes[parent].m_Children[0] == proxy) ? 1 : 0];
+	const uint32_t	grandParent = m_Nodes[parent].m_Parent;
+
+	m_InnerArea -= GetArea(m_Nodes[parent].m_Min, m_Nodes[parent].m_Max);
+	FreeNode(parent);
+
+	m_Nodes[sibling].m_Parent = grandParent;
+
+	if (grandParent == BVH_NULL_NODE)
+	{
+		m_Root = sibling;
+		return;
+	}
+
+	Node	&node = m_Nodes[grandParent];
+	node.m_Children[(node.m_Children[0] == parent) ? 0 : 1] = sibling;
+
+	Refit(grandParent);
+}
+
+//----------------------------------------------------------------
+
+bool	DynamicBvh::Update(uint32_t proxy, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	Node	&leaf = m_Nodes[proxy];
+
+	if (Contains(leaf.m_Min, leaf.m_Max, boundsMin, boundsMax))
+		return false;
+
+	const glm::vec3	margin = (boundsMax - boundsMin) * BVH_FAT_MARGIN;
+
+	leaf.m_Min = boundsMin - margin;
+	leaf.m_Max = boundsMax + margin;
+
+	Refit(leaf.m_Parent);
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	DynamicBvh::RebuildIfDegraded()
+{
+	if (m_ProxiesCount < 3)
+		return false;
+
+	if (m_RebuildCost > 0.f && GetCost() <= m_RebuildCost * BVH_REBUILD_COST_RATIO)
+		return false;
+
+	Rebuild();
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	DynamicBvh::Rebuild()
+{
+	std::vector<uint32_t>	leaves;
+	leaves.reserve(m_ProxiesCount);
+
+	// inner nodes are freed, leaves keep their index so that the proxies stay valid
+	const uint32_t			nodesCount = static_cast<uint32_t>(m_Nodes.size());
+	std::vector<bool>		isFree(nodesCount, false);
+
+	for (uint32_t nodeIndex = m_FreeNode; nodeIndex != BVH_NULL_NODE; nodeIndex = m_Nodes[nodeIndex].m_Parent)
+		isFree[nodeIndex] = true;
+
+	for (uint32_t nodeIndex = 0; nodeIndex < nodesCount; ++nodeIndex)
+	{
+		if (isFree[nodeIndex])
+			continue;
+
+		if (m_Nodes[nodeIndex].IsLeaf())
+			leaves.push_back(nodeIndex);
+		else
+			FreeNode(nodeIndex);
+	}
+
+	m_Root = BVH_NULL_NODE;
+	m_InnerArea = 0.0;
+	++m_RebuildsCount;
+
+	if (leaves.empty())
+		return;
+
+	std::vector<glm::vec3>	centroids(nodesCount);
+	for (const uint32_t leaf : leaves)
+		centroids[leaf] = (m_Nodes[leaf].m_Min + m_Nodes[leaf].m_Max) * 0.5f;
+
+	// explicit stack, a degenerate split sequence could be as deep as the leaves count
+	std::vector<BuildTask>	tasks;
+	tasks.push_back({ 0, static_cast<uint32_t>(leaves.size()), BVH_NULL_NODE, 0 });
+
+	while (!tasks.empty())
+	{
+		const BuildTask	task = tasks.back();
+		tasks.pop_back();
+
+		uint32_t		subtree = BVH_NULL_NODE;
+
+		if (task.m_End - task.m_Begin == 1)
+			subtree = leaves[task.m_Begin];
+		else
+		{
+			glm::vec3	boundsMin = m_Nodes[leaves[task.m_Begin]].m_Min;
+			glm::vec3	boundsMax = m_Nodes[leaves[task.m_Begin]].m_Max;
+			glm::vec3	centroidMin = centroids[leaves[task.m_Begin]];
+			glm::vec3	centroidMax = centroidMin;
+
+			for (uint32_t leafIndex = task.m_Begin + 1; leafIndex < task.m_End; ++leafIndex)
+			{
+				const uint32_t	leaf = leaves[leafIndex];
+				boundsMin = glm::min(boundsMin, m_Nodes[leaf].m_Min);
+				boundsMax = glm::max(boundsMax, m_Nodes[leaf].m_Max);
+				centroidMin = glm::min(centroidMin, centroids[leaf]);
+				centroidMax = glm::max(centroidMax, centroids[leaf]);
+			}
+
+			const glm::vec3	centroidSize = centroidMax - centroidMin;
+			const uint32_t	axis = (centroidSize.x >= centroidSize.y && centroidSize.x >= centroidSize.z) ? 0 : ((centroidSize.y >= centroidSize.z) ? 1 : 2);
+
+			uint32_t		middle = task.m_Begin + (task.m_End - task.m_Begin) / 2;
+
+			if (centroidSize[axis] > 0.f)
+			{
+				// leaves count and bounds per bin, then the cost of each split between two bins
+				uint32_t	binCounts[BVH_SAH_BINS] = { };
+				glm::vec3	binMins[BVH_SAH_BINS];
+				glm::vec3	binMaxs[BVH_SAH_BINS];
+
+				const float	binScale = BVH_SAH_BINS / centroidSize[axis];
+
+				auto		getBin = [&](uint32_t leaf)
+				{
+					return std::min(static_cast<uint32_t>((centroids[leaf][axis] - centroidMin[axis]) * binScale), static_cast<uint32_t>(BVH_SAH_BINS - 1));
+				};
+
+				for (uint32_t leafIndex = task.m_Begin; leafIndex < task.m_End; ++leafIndex)
+				{
+					const uint32_t	leaf = leaves[leafIndex];
+					const uint32_t	bin = getBin(leaf);
+
+					binMins[bin] = (binCounts[bin] == 0) ? m_Nodes[leaf].m_Min : glm::min(binMins[bin], m_Nodes[leaf].m_Min);
+					binMaxs[bin] = (binCounts[bin] == 0) ? m_Nodes[leaf].m_Max : glm::max(binMaxs[bin], m_Nodes[leaf].m_Max);
+					++binCounts[bin];
+				}
+
+				float		rightCosts[BVH_SAH_BINS] = { };
+				uint32_t	rightCount = 0;
+				glm::vec3	rightMin = glm::vec3(0.f);
+				glm::vec3	rightMax = glm::vec3(0.f);
+
+				for (uint32_t bin = BVH_SAH_BINS - 1; bin > 0; --bin)
+				{
+					if (binCounts[bin] > 0)
+					{
+						rightMin = (rightCount == 0) ? binMins[bin] : glm::min(rightMin, binMins[bin]);
+						rightMax = (rightCount == 0) ? binMaxs[bin] : glm::max(rightMax, binMaxs[bin]);
+						rightCount += binCounts[bin];
+					}
+
+					rightCosts[bin] = rightCount * GetArea(rightMin, rightMax);
+				}
+
+				float		bestCost = 0.f;
+				uint32_t	bestBin = 0; // none yet
+				uint32_t	leftCount = 0;
+				glm::vec3	leftMin = glm::vec3(0.f);
+				glm::vec3	leftMax = glm::vec3(0.f);
+
+				// the split goes after bin, both sides keep at least one leaf
+				for (uint32_t bin = 0; bin < BVH_SAH_BINS - 1; ++bin)
+				{
+					if (binCounts[bin] > 0)
+					{
+						leftMin = (leftCount == 0) ? binMins[bin] : glm::min(leftMin, binMins[bin]);
+						leftMax = (leftCount == 0) ? binMaxs[bin] : glm::max(leftMax, binMaxs[bin]);
+						leftCount += binCounts[bin];
+					}
+
+					if (leftCount == 0 || leftCount == task.m_End - task.m_Begin)
+						continue;
+
+					const float	cost = leftCount * GetArea(leftMin, leftMax) + rightCosts[bin + 1];
+					if (bestBin == 0 || cost < bestCost)
+					{
+						bestCost = cost;
+						bestBin = bin + 1;
+					}
+				}
+
+				if (bestBin > 0)
+				{
+					const uint32_t	*partition = std::partition(leaves.data() + task.m_Begin, leaves.data() + task.m_End, [&](uint32_t leaf) { return getBin(leaf) < bestBin; });
+					middle = static_cast<uint32_t>(partition - leaves.data());
+				}
+			}
+
+			subtree = AllocateNode();
+			{
+				Node	&node = m_Nodes[subtree];
+				node.m_Min = boundsMin;
+				node.m_Max = boundsMax;
+			}
+
+			m_InnerArea += GetArea(boundsMin, boundsMax);
+
+			tasks.push_back({ task.m_Begin, middle, subtree, 0 });
+			tasks.push_back({ middle, task.m_End, subtree, 1 });
+		}
+
+		m_Nodes[subtree].m_Parent = task.m_Parent;
+
+		if (task.m_Parent == BVH_NULL_NODE)
+			m_Root = subtree;
+		else
+			m_Nodes[task.m_Parent].m_Children[task.m_Slot] = subtree;
+	}
+
+	m_RebuildCost = GetCost();
+}
+
+//----------------------------------------------------------------
+
+template<typename TestFunction>
+void	DynamicBvh::Query(const TestFunction &testFunction, std::vector<uint32_t> &outProxies) const
+{
+	if (m_Root == BVH_NULL_NODE)
+		return;
+
+	// the high bit marks the subtrees already known to be inside
+	const uint32_t			insideBit = 0x80000000;
+	std::vector<uint32_t>	stack;
+	stack.reserve(64);
+	stack.push_back(m_Root);
+
+	while (!stack.empty())
+	{
+		const uint32_t	entry = stack.back();
+		stack.pop_back();
+
+		const uint32_t	nodeIndex = entry & ~insideBit;
+		const Node		&node = m_Nodes[nodeIndex];
+		BVH_OVERLAP		overlap = BVH_OVERLAP::Inside;
+
+		if ((entry & insideBit) == 0)
+		{
+			overlap = testFunction(node.m_Min, node.m_Max);
+
+			if (overlap == BVH_OVERLAP::Outside)
+				continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			outProxies.push_back(nodeIndex);
+			continue;
+		}
+
+		const uint32_t	childBit = (overlap == BVH_OVERLAP::Inside) ? insideBit : 0;
+		stack.push_back(node.m_Children[1] | childBit);
+		stack.push_back(node.m_Children[0] | childBit);
+	}
+}
+
+//----------------------------------------------------------------
+
+void	DynamicBvh::QueryFrustum(const CullingView &view, std::vector<uint32_t> &outProxies) const
+{
+	Query([&view](const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+	{
+		return TestFrustum(view, boundsMin, boundsMax);
+	}, outProxies);
+}
+
+//----------------------------------------------------------------
+
+void	DynamicBvh::QuerySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &outProxies) const
+{
+	const float	radiusSquared = radius * radius;
+
+	Query([&center, radiusSquared](const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+	{
+		// closest point of the box, then its farthest corner for the inside test
+		const glm::vec3	closest = glm::max(boundsMin, glm::min(center, boundsMax)) - center;
+		if (glm::dot(closest, closest) > radiusSquared)
+			return BVH_OVERLAP::Outside;
+
+		const glm::vec3	farthest = glm::max(glm::abs(boundsMin - center), glm::abs(boundsMax - center));
+		return (glm::dot(farthest, farthest) <= radiusSquared) ? BVH_OVERLAP::Inside : BVH_OVERLAP::Intersect;
+	}, outProxies);
+}
+
+//----------------------------------------------------------------
+
+void	DynamicBvh::QueryAabb(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, std::vector<uint32_t> &outProxies) const
+{
+	Query([&boundsMin, &boundsMax](const glm::vec3 &nodeMin, const glm::vec3 &nodeMax)
+	{
+		if (!Overlaps(boundsMin, boundsMax, nodeMin, nodeMax))
+			return BVH_OVERLAP::Outside;
+
+		return Contains(boundsMin, boundsMax, nodeMin, nodeMax) ? BVH_OVERLAP::Inside : BVH_OVERLAP::Intersect;
+	}, outProxies);
+}
+
+//----------------------------------------------------------------
+
+bool	DynamicBvh::Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, const RaycastFunction &hitFunction, BvhRayHit &outHit) const
+{
+	outHit = BvhRayHit();
+
+	if (m_Root == BVH_NULL_NODE)
+		return false;
+
+	const glm::vec3			invDirection = glm::vec3(1.f / direction.x, 1.f / direction.y, 1.f / direction.z);
+	float					closestDistance = maxDistance;
+
+	// nodes with their entry distance, the nearer child is visited first
+	std::vector<std::pair<uint32_t, float>>	stack;
+	stack.reserve(64);
+
+	const float				rootDistance = IntersectRay(origin, invDirection, closestDistance, m_Nodes[m_Root].m_Min, m_Nodes[m_Root].m_Max);
+	if (rootDistance >= 0.f)
+		stack.push_back({ m_Root, rootDistance });
+
+	while (!stack.empty())
+	{
+		const std::pair<uint32_t, float>	entry = stack.back();
+		stack.pop_back();
+
+		if (entry.second > closestDistance)
+			continue;
+
+		const Node		&node = m_Nodes[entry.first];
+
+		if (node.IsLeaf())
+		{
+			const float	distance = hitFunction(entry.first, entry.second);
+
+			if (distance >= 0.f && distance <= closestDistance)
+			{
+				closestDistance = distance;
+				outHit.m_Proxy = entry.first;
+				outHit.m_Distance = distance;
+			}
+
+			continue;
+		}
+
+		const float		distance0 = IntersectRay(origin, invDirection, closestDistance, m_Nodes[node.m_Children[0]].m_Min, m_Nodes[node.m_Children[0]].m_Max);
+		const float		distance1 = IntersectRay(origin, invDirection, closestDistance, m_Nodes[node.m_Children[1]].m_Min, m_Nodes[node.m_Children[1]].m_Max);
+		const bool		isFirstNearer = distance1 < 0.f || (distance0 >= 0.f && distance0 <= distance1);
+
+		// pushed last is popped first
+		if (isFirstNearer)
+		{
+			if (distance1 >= 0.f)
+				stack.push_back({ node.m_Children[1], distance1 });
+			if (distance0 >= 0.f)
+				stack.push_back({ node.m_Children[0], distance0 });
+		}
+		else
+		{
+			if (distance0 >= 0.f)
+				stack.push_back({ node.m_Children[0], distance0 });
+			stack.push_back({ node.m_Children[1], distance1 });
+		}
+	}
+
+	return outHit.m_Proxy != BVH_NULL_NODE;
+}
+
+//----------------------------------------------------------------
+
+float	DynamicBvh::GetCost() const
+{
+	if (m_Root == BVH_NULL_NODE || m_Nodes[m_Root].IsLeaf())
+		return 0.f;
+
+	const float	rootArea = GetArea(m_Nodes[m_Root].m_Min, m_Nodes[m_Root].m_Max);
+
+	return (rootArea > 0.f) ? static_cast<float>(m_InnerArea / rootArea) : 0.f;
+}
+
+//----------------------------------------------------------------
+
+uint32_t	DynamicBvh::AllocateNode()
+{
+	uint32_t	nodeIndex = m_FreeNode;
+
+	if (nodeIndex != BVH_NULL_NODE)
+		m_FreeNode = m_Nodes[nodeIndex].m_Parent;
+	else
+	{
+		nodeIndex = static_cast<uint32_t>(m_Nodes.size());
+		m_Nodes.push_back(Node());
+	}
+
+	Node	&node = m_Nodes[nodeIndex];
+	node.m_Parent = BVH_NULL_NODE;
+	node.m_Children[0] = BVH_NULL_NODE;
+	node.m_Children[1] = BVH_NULL_NODE;
+	node.m_UserData = nullptr;
+
+	return nodeIndex;
+}
+
+//----------------------------------------------------------------
+
+void	DynamicBvh::FreeNode(uint32_t nodeIndex)
+{
+	m_Nodes[nodeIndex].m_Parent = m_FreeNode;
+	m_FreeNode = nodeIndex;
+}
+
+//----------------------------------------------------------------
+
+void	DynamicBvh::Refit(uint32_t nodeIndex)
+{
+	while (nodeIndex != BVH_NULL_NODE)
+	{
+		Node			&node = m_Nodes[nodeIndex];
+		const Node		&child0 = m_Nodes[node.m_Children[0]];
+		const Node		&child1 = m_Nodes[node.m_Children[1]];
+
+		const glm::vec3	boundsMin = glm::min(child0.m_Min, child1.m_Min);
+		const glm::vec3	boundsMax = glm::max(child0.m_Max, child1.m_Max);
+
+		if (Contains(boundsMin, boundsMax, node.m_Min, node.m_Max) && Contains(node.m_Min, node.m_Max, boundsMin, boundsMax))
+			return;
+
+		m_InnerArea += GetArea(boundsMin, boundsMax) - GetArea(node.m_Min, node.m_Max);
+
+		node.m_Min = boundsMin;
+		node.m_Max = boundsMax;
+
+		nodeIndex = node.m_Parent;
+	}
+}
+
+//----------------------------------------------------------------
+
+uint32_t	DynamicBvh::FindBestSibling(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const
+{
+	// descends toward the child whose box grows the least, each level above pays for its own growth too
+	uint32_t	nodeIndex = m_Root;
+
+	while (!m_Nodes[nodeIndex].IsLeaf())
+	{
+		const Node	&node = m_Nodes[nodeIndex];
+
+		const float	area = GetArea(node.m_Min, node.m_Max);
+		const float	combinedArea = GetArea(glm::min(node.m_Min, boundsMin), glm::max(node.m_Max, boundsMax));
+
+		// a new parent here, or the cost pushed down to the children
+		const float	siblingCost = 2.f * combinedArea;
+		const float	inheritedCost = 2.f * (combinedArea - area);
+
+		float		childCosts[2];
+		for (uint32_t childIndex = 0; childIndex < 2; ++childIndex)
+		{
+			const Node	&child = m_Nodes[node.m_Children[childIndex]];
+			const float	childArea = GetArea(glm::min(child.m_Min, boundsMin), glm::max(child.m_Max, boundsMax));
+
+			childCosts[childIndex] = inheritedCost + (child.IsLeaf() ? childArea : childArea - GetArea(child.m_Min, child.m_Max));
+		}
+
+		if (siblingCost < childCosts[0] && siblingCost < childCosts[1])
+			break;
+
+		nodeIndex = node.m_Children[(childCosts[0] <= childCosts[1]) ? 0 : 1];
+	}
+
+	return nodeIndex;
+}
+
+//----------------------------------------------------------------
+
+void	DynamicBvh::Benchmark(uint32_t maxProxiesCount)
+{
+	using clock = std::chrono::high_resolution_clock;
+
+	const uint32_t	queriesCount = 1000;
+
+	// the tree finds the fat boxes, a few more than the scans
+	std::cout << "BVH benchmark, microseconds per query, tree / linear scan" << std::endl; // TODO: change this for real logger
+
+	for (uint32_t proxiesCount = 100; proxiesCount <= maxProxiesCount; proxiesCount *= 10)
+	{
+		// same density at every count, unit sized boxes spread in a cube
+		std::mt19937							random(proxiesCount);
+		const float								side = std::cbrt(static_cast<float>(proxiesCount)) * 4.f;
+		std::uniform_real_distribution<float>	position(0.f, side);
+		std::uniform_real_distribution<float>	size(0.5f, 2.f);
+
+		std::vector<glm::vec3>	boxMins(proxiesCount);
+		std::vector<glm::vec3>	boxMaxs(proxiesCount);
+
+		for (uint32_t boxIndex = 0; boxIndex < proxiesCount; ++boxIndex)
+		{
+			boxMins[boxIndex] = glm::vec3(position(random), position(random), position(random));
+			boxMaxs[boxIndex] = boxMins[boxIndex] + glm::vec3(size(random), size(random), size(random));
+		}
+
+		const clock::time_point	buildStart = clock::now();
+
+		DynamicBvh				bvh;
+		std::vector<uint32_t>	proxies(proxiesCount);
+
+		for (uint32_t boxIndex = 0; boxIndex < proxiesCount; ++boxIndex)
+			proxies[boxIndex] = bvh.Insert(boxMins[boxIndex], boxMaxs[boxIndex], nullptr);
+
+		const clock::time_point	rebuildStart = clock::now();
+		const float				insertedCost = bvh.GetCost();
+
+		bvh.Rebuild();
+
+		const clock::time_point	buildEnd = clock::now();
+		const float				rebuiltCost = bvh.GetCost();
+
+		// moves every box once, the refits only, the linear scans below see the moved boxes too
+		const clock::time_point	updateStart = clock::now();
+
+		for (uint32_t boxIndex = 0; boxIndex < proxiesCount; ++boxIndex)
+		{
+			const glm::vec3	offset = glm::vec3(size(random), size(random), size(random)) - glm::vec3(1.25f);
+
+			boxMins[boxIndex] = boxMins[boxIndex] + offset;
+			boxMaxs[boxIndex] = boxMaxs[boxIndex] + offset;
+			bvh.Update(proxies[boxIndex], boxMins[boxIndex], boxMaxs[boxIndex]);
+		}
+
+		const clock::time_point	updateEnd = clock::now();
+
+		std::vector<uint32_t>	results;
+		uint64_t				treeResultsCount = 0;
+		uint64_t				linearResultsCount = 0;
+
+		auto	measure = [&](const std::function<void()> &treeQuery, const std::function<void()> &linearQuery, const char *name)
+		{
+			treeResultsCount = 0;
+			linearResultsCount = 0;
+
+			const clock::time_point	treeStart = clock::now();
+			treeQuery();
+			const clock::time_point	linearStart = clock::now();
+			linearQuery();
+			const clock::time_point	linearEnd = clock::now();
+
+			const float	treeTime = std::chrono::duration<float, std::micro>(linearStart - treeStart).count() / queriesCount;
+			const float	linearTime = std::chrono::duration<float, std::micro>(linearEnd - linearStart).count() / queriesCount;
+
+			std::cout << "\t" << name << " " << treeTime << " / " << linearTime << " (" << static_cast<float>(treeResultsCount) / queriesCount << " / " << static_cast<float>(linearResultsCount) / queriesCount << " found)" << std::endl; // TODO: change this for real logger
+		};
+
+		std::uniform_real_distribution<float>	direction(-1.f, 1.f);
+		std::vector<glm::vec3>					queryPoints(queriesCount);
+		std::vector<glm::vec3>					queryDirections(queriesCount);
+
+		for (uint32_t queryIndex = 0; queryIndex < queriesCount; ++queryIndex)
+		{
+			queryPoints[queryIndex] = glm::vec3(position(random), position(random), position(random));
+			queryDirections[queryIndex] = glm::vec3(direction(random), direction(random), direction(random));
+		}
+
+		std::cout << proxiesCount << " boxes, build " << std::chrono::duration<float, std::milli>(buildEnd - buildStart).count() << " ms ("
+				  << std::chrono::duration<float, std::milli>(buildEnd - rebuildStart).count() << " ms rebuild), cost " << insertedCost << " inserted, "
+				  << rebuiltCost << " rebuilt, update " << std::chrono::duration<float, std::milli>(updateEnd - updateStart).count() << " ms, cost "
+				  << bvh.GetCost() << " refit" << std::endl; // TODO: change this for real logger
+
+		measure([&]()
+		{
+			for (const glm::vec3 &center : queryPoints)
+			{
+				results.clear();
+				bvh.QuerySphere(center, 4.f, results);
+				treeResultsCount += results.size();
+			}
+		}, [&]()
+		{
+			for (const glm::vec3 &center : queryPoints)
+			{
+				for (uint32_t boxIndex = 0; boxIndex < proxiesCount; ++boxIndex)
+				{
+					const glm::vec3	closest = glm::max(boxMins[boxIndex], glm::min(center, boxMaxs[boxIndex])) - center;
+					linearResultsCount += (glm::dot(closest, closest) <= 16.f) ? 1 : 0;
+				}
+			}
+		}, "sphere");
+
+		measure([&]()
+		{
+			for (const glm::vec3 &point : queryPoints)
+			{
+				results.clear();
+				bvh.QueryAabb(point, point + glm::vec3(8.f), results);
+				treeResultsCount += results.size();
+			}
+		}, [&]()
+		{
+			for (const glm::vec3 &point : queryPoints)
+			{
+				for (uint32_t boxIndex = 0; boxIndex < proxiesCount; ++boxIndex)
+					linearResultsCount += Overlaps(point, point + glm::vec3(8.f), boxMins[boxIndex], boxMaxs[boxIndex]) ? 1 : 0;
+			}
+		}, "aabb");
+
+		measure([&]()
+		{
+			for (uint32_t queryIndex = 0; queryIndex < queriesCount; ++queryIndex)
+			{
+				BvhRayHit	hit;
+				if (bvh.Raycast(queryPoints[queryIndex], queryDirections[queryIndex], side, [](uint32_t, float boxDistance) { return boxDistance; }, hit))
+					++treeResultsCount;
+			}
+		}, [&]()
+		{
+			for (uint32_t queryIndex = 0; queryIndex < queriesCount; ++queryIndex)
+			{
+				const glm::vec3	&direction = queryDirections[queryIndex];
+				const glm::vec3	invDirection = glm::vec3(1.f / direction.x, 1.f / direction.y, 1.f / direction.z);
+				float			closestDistance = -1.f;
+
+				for (uint32_t boxIndex = 0; boxIndex < proxiesCount; ++boxIndex)
+				{
+					const float	distance = IntersectRay(queryPoints[queryIndex], invDirection, side, boxMins[boxIndex], boxMaxs[boxIndex]);
+					if (distance >= 0.f && (closestDistance < 0.f || distance < closestDistance))
+						closestDistance = distance;
+				}
+
+				linearResultsCount += (closestDistance >= 0.f) ? 1 : 0;
+			}
+		}, "ray");
+
+		// axis aligned views a quarter of the cube wide, looking down z
+		std::vector<CullingView>	views(queriesCount);
+		for (uint32_t queryIndex = 0; queryIndex < queriesCount; ++queryIndex)
+		{
+			const glm::vec3	&point = queryPoints[queryIndex];
+			CullingView		&view = views[queryIndex];
+
+			view = CullingView();
+			view.m_Planes[0] = glm::vec4(1.f, 0.f, 0.f, -point.x);
+			view.m_Planes[1] = glm::vec4(-1.f, 0.f, 0.f, point.x + side * 0.25f);
+			view.m_Planes[2] = glm::vec4(0.f, 1.f, 0.f, -point.y);
+			view.m_Planes[3] = glm::vec4(0.f, -1.f, 0.f, point.y + side * 0.25f);
+			view.m_Planes[4] = glm::vec4(0.f, 0.f, 1.f, 0.f);
+			view.m_Planes[5] = glm::vec4(0.f, 0.f, -1.f, side);
+		}
+
+		measure([&]()
+		{
+			for (const CullingView &view : views)
+			{
+				results.clear();
+				bvh.QueryFrustum(view, results);
+				treeResultsCount += results.size();
+			}
+		}, [&]()
+		{
+			for (const CullingView &view : views)
+			{
+				for (uint32_t boxIndex = 0; boxIndex < proxiesCount; ++boxIndex)
+					linearResultsCount += (TestFrustum(view, boxMins[boxIndex], boxMaxs[boxIndex]) != BVH_OVERLAP::Outside) ? 1 : 0;
+			}
+		}, "frustum");
+	}
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,339 @@
+#include "Tools/FrustumCulling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(__AVX__)
+#define FRUSTUM_CULLING_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+void	CullingBounds::Resize(uint32_t objectsCount)
+{
+	// padding lanes are read by the kernels and masked out of the results
+	const size_t	paddedCount = (objectsCount + FRUSTUM_CULLING_LANES - 1) / FRUSTUM_CULLING_LANES * FRUSTUM_CULLING_LANES;
+
+	m_CenterX.assign(paddedCount, 0.f);
+	m_CenterY.assign(paddedCount, 0.f);
+	m_CenterZ.assign(paddedCount, 0.f);
+	m_ExtentX.assign(paddedCount, 0.f);
+	m_ExtentY.assign(paddedCount, 0.f);
+	m_ExtentZ.assign(paddedCount, 0.f);
+	m_Radius.assign(paddedCount, 0.f);
+
+	m_Count = objectsCount;
+}
+
+//----------------------------------------------------------------
+
+void	CullingBounds::Set(uint32_t objectIndex, const glm::vec3 &center, const glm::vec3 &extent, float radius)
+{
+	m_CenterX[objectIndex] = center.x;
+	m_CenterY[objectIndex] = center.y;
+	m_CenterZ[objectIndex] = center.z;
+	m_ExtentX[objectIndex] = extent.x;
+	m_ExtentY[objectIndex] = extent.y;
+	m_ExtentZ[objectIndex] = extent.z;
+	m_Radius[objectIndex] = radius;
+}
+
+//----------------------------------------------------------------
+
+void	CullingBounds::SetTransformed(uint32_t objectIndex, const glm::mat4 &model, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float radius)
+{
+	const glm::vec3	center = glm::vec3(model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.f));
+	const glm::vec3	extent = (boundsMax - boundsMin) * 0.5f;
+
+	// each world axis gets the projection of the 3 box axes on it
+	const glm::vec3	worldExtent = glm::abs(glm::vec3(model[0])) * extent.x + glm::abs(glm::vec3(model[1])) * extent.y + glm::abs(glm::vec3(model[2])) * extent.z;
+	const float		scale = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+
+	Set(objectIndex, center, worldExtent, radius * scale);
+}
+
+//----------------------------------------------------------------
+
+namespace FrustumCulling
+{
+
+//----------------------------------------------------------------
+
+CullingView		MakeView(const glm::mat4 &viewProj, float viewHeight, float minPixels)
+{
+	const glm::vec4	rowX = glm::vec4(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+	const glm::vec4	rowY = glm::vec4(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+	const glm::vec4	rowZ = glm::vec4(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+	const glm::vec4	rowW = glm::vec4(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+	CullingView	view = { };
+	{
+		// left, right, bottom, top, near and far, clip space depth goes from 0 to w
+		view.m_Planes[0] = rowW + rowX;
+		view.m_Planes[1] = rowW - rowX;
+		view.m_Planes[2] = rowW + rowY;
+		view.m_Planes[3] = rowW - rowY;
+		view.m_Planes[4] = rowZ;
+		view.m_Planes[5] = rowW - rowZ;
+
+		for (glm::vec4 &plane : view.m_Planes)
+			plane /= glm::length(glm::vec3(plane));
+
+		view.m_RowW = rowW;
+		view.m_RowWLength = glm::length(glm::vec3(rowW));
+
+		// clip space is 2 units across the view
+		view.m_PixelsPerUnit = std::max(glm::length(glm::vec3(rowX)), glm::length(glm::vec3(rowY))) * 0.5f * viewHeight;
+		view.m_MinPixels = minPixels;
+	}
+
+	return view;
+}
+
+//----------------------------------------------------------------
+
+void	ExtendTowardEye(CullingView &view)
+{
+	// every distance to this plane is 1
+	view.m_Planes[4] = glm::vec4(0.f, 0.f, 0.f, 1.f);
+}
+
+//----------------------------------------------------------------
+
+void	CullScalar(const CullingView &view, const CullingBounds &bounds, std::vector<uint32_t> &outVisible)
+{
+	for (uint32_t objectIndex = 0; objectIndex < bounds.m_Count; ++objectIndex)
+	{
+		const glm::vec3	center = glm::vec3(bounds.m_CenterX[objectIndex], bounds.m_CenterY[objectIndex], bounds.m_CenterZ[objectIndex]);
+		const glm::vec3	extent = glm::vec3(bounds.m_ExtentX[objectIndex], bounds.m_ExtentY[objectIndex], bounds.m_ExtentZ[objectIndex]);
+		const float		radius = bounds.m_Radius[objectIndex];
+
+		// outside when fully behind one plane, the tighter of the box and the sphere decides,
+		// the sums are in the order of the kernels so that a box exactly on a plane gets the same answer,
+		// which also needs the multiplies and adds left unfused, see LIGHTLYY_STRICT_FP_OPTIONS
+		bool			isVisible = true;
+
+		for (uint32_t planeIndex = 0; planeIndex < 6 && isVisible; ++planeIndex)
+		{
+			const glm::vec4	&plane = view.m_Planes[planeIndex];
+			const float		distance = (center.x * plane.x + center.y * plane.y) + (center.z * plane.z + plane.w);
+			const float		boxRadius = (extent.x * std::fabs(plane.x) + extent.y * std::fabs(plane.y)) + extent.z * std::fabs(plane.z);
+
+			isVisible = distance + std::min(boxRadius, radius) >= 0.f;
+		}
+
+		// smaller than the minimum size at the closest point of the sphere, kept when the view is inside it
+		const glm::vec4	&rowW = view.m_RowW;
+		const float		closestW = ((center.x * rowW.x + center.y * rowW.y) + (center.z * rowW.z + rowW.w)) - radius * view.m_RowWLength;
+
+		if (isVisible && (closestW <= 0.f || radius * (2.f * view.m_PixelsPerUnit) >= view.m_MinPixels * closestW))
+			outVisible.push_back(objectIndex);
+	}
+}
+
+//----------------------------------------------------------------
+
+#if defined(FRUSTUM_CULLING_AVX)
+
+void	Cull(const CullingView &view, const CullingBounds &bounds, std::vector<uint32_t> &outVisible)
+{
+	const __m256	zero = _mm256_setzero_ps();
+	const __m256	rowWX = _mm256_set1_ps(view.m_RowW.x);
+	const __m256	rowWY = _mm256_set1_ps(view.m_RowW.y);
+	const __m256	rowWZ = _mm256_set1_ps(view.m_RowW.z);
+	const __m256	rowWW = _mm256_set1_ps(view.m_RowW.w);
+	const __m256	rowWLength = _mm256_set1_ps(view.m_RowWLength);
+	const __m256	diameterScale = _mm256_set1_ps(2.f * view.m_PixelsPerUnit);
+	const __m256	minPixels = _mm256_set1_ps(view.m_MinPixels);
+
+	for (uint32_t firstObject = 0; firstObject < bounds.m_Count; firstObject += 8)
+	{
+		const __m256	centerX = _mm256_loadu_ps(&bounds.m_CenterX[firstObject]);
+		const __m256	centerY = _mm256_loadu_ps(&bounds.m_CenterY[firstObject]);
+		const __m256	centerZ = _mm256_loadu_ps(&bounds.m_CenterZ[firstObject]);
+		const __m256	extentX = _mm256_loadu_ps(&bounds.m_ExtentX[firstObject]);
+		const __m256	extentY = _mm256_loadu_ps(&bounds.m_ExtentY[firstObject]);
+		const __m256	extentZ = _mm256_loadu_ps(&bounds.m_ExtentZ[firstObject]);
+		const __m256	radius = _mm256_loadu_ps(&bounds.m_Radius[firstObject]);
+
+		__m256			isVisible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (const glm::vec4 &plane : view.m_Planes)
+		{
+			const __m256	distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(centerX, _mm256_set1_ps(plane.x)), _mm256_mul_ps(centerY, _mm256_set1_ps(plane.y))),
+													_mm256_add_ps(_mm256_mul_ps(centerZ, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+			const __m256	boxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(extentX, _mm256_set1_ps(fabsf(plane.x))), _mm256_mul_ps(extentY, _mm256_set1_ps(fabsf(plane.y)))),
+													_mm256_mul_ps(extentZ, _mm256_set1_ps(fabsf(plane.z))));
+
+			isVisible = _mm256_and_ps(isVisible, _mm256_cmp_ps(_mm256_add_ps(distance, _mm256_min_ps(boxRadius, radius)), zero, _CMP_GE_OQ));
+		}
+
+		const __m256	w = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(centerX, rowWX), _mm256_mul_ps(centerY, rowWY)), _mm256_add_ps(_mm256_mul_ps(centerZ, rowWZ), rowWW));
+		const __m256	closestW = _mm256_sub_ps(w, _mm256_mul_ps(radius, rowWLength));
+		const __m256	isLarge = _mm256_or_ps(	_mm256_cmp_ps(closestW, zero, _CMP_LE_OQ),
+												_mm256_cmp_ps(_mm256_mul_ps(radius, diameterScale), _mm256_mul_ps(minPixels, closestW), _CMP_GE_OQ));
+
+		const uint32_t	lanesCount = std::min(bounds.m_Count - firstObject, 8u);
+		const uint32_t	visibleMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_and_ps(isVisible, isLarge))) & ((1u << lanesCount) - 1);
+
+		for (uint32_t laneIndex = 0; laneIndex < lanesCount; ++laneIndex)
+		{
+			if (visibleMask & (1u << laneIndex))
+				outVisible.push_back(firstObject + laneIndex);
+		}
+	}
+}
+
+const char*		GetKernelName() { return "AVX"; }
+
+#elif defined(FRUSTUM_CULLING_SSE)
+
+void	Cull(const CullingView &view, const CullingBounds &bounds, std::vector<uint32_t> &outVisible)
+{
+	const __m128	zero = _mm_setzero_ps();
+	const __m128	rowWX = _mm_set1_ps(view.m_RowW.x);
+	const __m128	rowWY = _mm_set1_ps(view.m_RowW.y);
+	const __m128	rowWZ = _mm_set1_ps(view.m_RowW.z);
+	const __m128	rowWW = _mm_set1_ps(view.m_RowW.w);
+	const __m128	rowWLength = _mm_set1_ps(view.m_RowWLength);
+	const __m128	diameterScale = _mm_set1_ps(2.f * view.m_PixelsPerUnit);
+	const __m128	minPixels = _mm_set1_ps(view.m_MinPixels);
+
+	for (uint32_t firstObject = 0; firstObject < bounds.m_Count; firstObject += 4)
+	{
+		const __m128	centerX = _mm_loadu_ps(&bounds.m_CenterX[firstObject]);
+		const __m128	centerY = _mm_loadu_ps(&bounds.m_CenterY[firstObject]);
+		const __m128	centerZ = _mm_loadu_ps(&bounds.m_CenterZ[firstObject]);
+		const __m128	extentX = _mm_loadu_ps(&bounds.m_ExtentX[firstObject]);
+		const __m128	extentY = _mm_loadu_ps(&bounds.m_ExtentY[firstObject]);
+		const __m128	extentZ = _mm_loadu_ps(&bounds.m_ExtentZ[firstObject]);
+		const __m128	radius = _mm_loadu_ps(&bounds.m_Radius[firstObject]);
+
+		__m128			isVisible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (const glm::vec4 &plane : view.m_Planes)
+		{
+			const __m128	distance = _mm_add_ps(	_mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(plane.x)), _mm_mul_ps(centerY, _mm_set1_ps(plane.y))),
+													_mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			const __m128	boxRadius = _mm_add_ps(	_mm_add_ps(_mm_mul_ps(extentX, _mm_set1_ps(fabsf(plane.x))), _mm_mul_ps(extentY, _mm_set1_ps(fabsf(plane.y)))),
+													_mm_mul_ps(extentZ, _mm_set1_ps(fabsf(plane.z))));
+
+			isVisible = _mm_and_ps(isVisible, _mm_cmpge_ps(_mm_add_ps(distance, _mm_min_ps(boxRadius, radius)), zero));
+		}
+
+		const __m128	w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, rowWX), _mm_mul_ps(centerY, rowWY)), _mm_add_ps(_mm_mul_ps(centerZ, rowWZ), rowWW));
+		const __m128	closestW = _mm_sub_ps(w, _mm_mul_ps(radius, rowWLength));
+		const __m128	isLarge = _mm_or_ps(_mm_cmple_ps(closestW, zero), _mm_cmpge_ps(_mm_mul_ps(radius, diameterScale), _mm_mul_ps(minPixels, closestW)));
+
+		const uint32_t	lanesCount = std::min(bounds.m_Count - firstObject, 4u);
+		const uint32_t	visibleMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_and_ps(isVisible, isLarge))) & ((1u << lanesCount) - 1);
+
+		for (uint32_t laneIndex = 0; laneIndex < lanesCount; ++laneIndex)
+		{
+			if (visibleMask & (1u << laneIndex))
+				outVisible.push_back(firstObject + laneIndex);
+		}
+	}
+}
+
+const char*		GetKernelName() { return "SSE"; }
+
+#else
+
+void	Cull(const CullingView &view, const CullingBounds &bounds, std::vector<uint32_t> &outVisible)
+{
+	CullScalar(view, bounds, outVisible);
+}
+
+const char*		GetKernelName() { return "scalar"; }
+
+#endif
+
+//----------------------------------------------------------------
+
+void	Benchmark(uint32_t maxObjectsCount)
+{
+	using clock = std::chrono::high_resolution_clock;
+
+	const uint32_t	viewsCount = 100;
+
+	// 90 degrees perspective looking down -z, depth from 0 to 1
+	const float		nearPlane = 0.1f;
+	const float		farPlane = 200.f;
+
+	glm::mat4		projection(0.f);
+	{
+		projection[0][0] = 1.f;
+		projection[1][1] = 1.f;
+		projection[2][2] = farPlane / (nearPlane - farPlane);
+		projection[2][3] = -1.f;
+		projection[3][2] = -(farPlane * nearPlane) / (farPlane - nearPlane);
+	}
+
+	std::cout << "Frustum culling benchmark, microseconds per view, " << GetKernelName() << " / scalar" << std::endl; // TODO: change this for real logger
+
+	for (uint32_t objectsCount = 1000; objectsCount <= maxObjectsCount; objectsCount *= 10)
+	{
+		// objects all around the eye, about an eighth of them in the view
+		std::mt19937							random(objectsCount);
+		std::uniform_real_distribution<float>	position(-100.f, 100.f);
+		std::uniform_real_distribution<float>	size(0.05f, 2.f);
+
+		CullingBounds	bounds;
+		bounds.Resize(objectsCount);
+
+		for (uint32_t objectIndex = 0; objectIndex < objectsCount; ++objectIndex)
+		{
+			const glm::vec3	extent(size(random), size(random), size(random));
+			bounds.Set(objectIndex, glm::vec3(position(random), position(random), position(random)), extent, glm::length(extent));
+		}
+
+		const CullingView		view = MakeView(projection, 720.f, 2.f);
+
+		std::vector<uint32_t>	visible;
+		std::vector<uint32_t>	scalarVisible;
+		visible.reserve(objectsCount);
+		scalarVisible.reserve(objectsCount);
+
+		const clock::time_point	kernelStart = clock::now();
+
+		for (uint32_t viewIndex = 0; viewIndex < viewsCount; ++viewIndex)
+		{
+			visible.clear();
+			Cull(view, bounds, visible);
+		}
+
+		const clock::time_point	scalarStart = clock::now();
+
+		for (uint32_t viewIndex = 0; viewIndex < viewsCount; ++viewIndex)
+		{
+			scalarVisible.clear();
+			CullScalar(view, bounds, scalarVisible);
+		}
+
+		const clock::time_point	scalarEnd = clock::now();
+
+		const float	kernelTime = std::chrono::duration<float, std::micro>(scalarStart - kernelStart).count() / viewsCount;
+		const float	scalarTime = std::chrono::duration<float, std::micro>(scalarEnd - scalarStart).count() / viewsCount;
+
+		std::cout << "\t" << objectsCount << " objects " << kernelTime << " / " << scalarTime << " (" << visible.size() << " visible" << ((visible == scalarVisible) ? "" : ", the paths disagree") << ")" << std::endl; // TODO: change this for real logger
+	}
+}
+
+//----------------------------------------------------------------
+
+} // namespace FrustumCulling
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
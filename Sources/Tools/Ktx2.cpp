@@ -0,0 +1,382 @@
+#include "Tools/Ktx2.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+namespace Ktx2
+{
+
+//----------------------------------------------------------------
+
+namespace
+{
+	const uint8_t	IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	struct Header
+	{
+		uint8_t		m_Identifier[12];
+		uint32_t	m_VkFormat;
+		uint32_t	m_TypeSize;
+		uint32_t	m_PixelWidth;
+		uint32_t	m_PixelHeight;
+		uint32_t	m_PixelDepth;
+		uint32_t	m_LayerCount;
+		uint32_t	m_FaceCount;
+		uint32_t	m_LevelCount;
+		uint32_t	m_SupercompressionScheme;
+
+		uint32_t	m_DfdByteOffset;
+		uint32_t	m_DfdByteLength;
+		uint32_t	m_KvdByteOffset;
+		uint32_t	m_KvdByteLength;
+		uint64_t	m_SgdByteOffset;
+		uint64_t	m_SgdByteLength;
+	}; // struct Header
+
+	struct LevelIndex
+	{
+		uint64_t	m_ByteOffset;
+		uint64_t	m_ByteLength;
+		uint64_t	m_UncompressedByteLength;
+	}; // struct LevelIndex
+
+	static_assert(sizeof(Header) == 80, "KTX2 header must be packed");
+	static_assert(sizeof(LevelIndex) == 24, "KTX2 level index must be packed");
+
+	// Khronos data format descriptor values
+	const uint8_t	KHR_DF_MODEL_RGBSDA = 1;
+	const uint8_t	KHR_DF_MODEL_BC1A = 128;
+	const uint8_t	KHR_DF_MODEL_BC3 = 130;
+	const uint8_t	KHR_DF_MODEL_BC5 = 132;
+	const uint8_t	KHR_DF_MODEL_BC7 = 134;
+	const uint8_t	KHR_DF_PRIMARIES_BT709 = 1;
+	const uint8_t	KHR_DF_TRANSFER_LINEAR = 1;
+	const uint8_t	KHR_DF_TRANSFER_SRGB = 2;
+	const uint8_t	KHR_DF_CHANNEL_ALPHA = 15;
+
+	struct DfdSample
+	{
+		uint16_t	m_BitOffset;
+		uint8_t		m_BitLength; // minus one
+		uint8_t		m_ChannelType;
+		uint8_t		m_SamplePosition[4];
+		uint32_t	m_SampleLower;
+		uint32_t	m_SampleUpper;
+	}; // struct DfdSample
+
+	static_assert(sizeof(DfdSample) == 16, "DFD sample must be packed");
+
+	bool	IsSRGB(VkFormat format)
+	{
+		return	format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+				format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+	}
+
+	// basic descriptor block, one sample per channel for RGBA8 and per 64 bit half block for BC formats
+	std::vector<uint8_t>	BuildDataFormatDescriptor(VkFormat format)
+	{
+		uint8_t					colorModel = KHR_DF_MODEL_RGBSDA;
+		uint8_t					bytesPlane0 = 16;
+		std::vector<DfdSample>	samples;
+
+		DfdSample				sample = { };
+		{
+			sample.m_SampleLower = 0;
+			sample.m_SampleUpper = UINT32_MAX;
+		}
+
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			bytesPlane0 = 4;
+			for (uint8_t channelIndex = 0; channelIndex < 4; ++channelIndex)
+			{
+				sample.m_BitOffset = channelIndex * 8;
+				sample.m_BitLength = 7;
+				sample.m_ChannelType = (channelIndex == 3) ? KHR_DF_CHANNEL_ALPHA : channelIndex;
+				sample.m_SampleUpper = 255;
+				samples.push_back(sample);
+			}
+			break;
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			colorModel = KHR_DF_MODEL_BC1A;
+			bytesPlane0 = 8;
+			sample.m_BitLength = 63;
+			samples.push_back(sample);
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			colorModel = KHR_DF_MODEL_BC3;
+			sample.m_BitLength = 63;
+			sample.m_ChannelType = KHR_DF_CHANNEL_ALPHA;
+			samples.push_back(sample);
+			sample.m_BitOffset = 64;
+			sample.m_ChannelType = 0;
+			samples.push_back(sample);
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			colorModel = KHR_DF_MODEL_BC5;
+			sample.m_BitLength = 63;
+			samples.push_back(sample);
+			sample.m_BitOffset = 64;
+			sample.m_ChannelType = 1;
+			samples.push_back(sample);
+			break;
+		default:
+			colorModel = KHR_DF_MODEL_BC7;
+			sample.m_BitLength = 127;
+			samples.push_back(sample);
+			break;
+		}
+
+		const uint16_t			blockSize = static_cast<uint16_t>(24 + samples.size() * sizeof(DfdSample));
+		const uint32_t			totalSize = sizeof(uint32_t) + blockSize;
+		const bool				isCompressed = IsBlockCompressed(format);
+
+		std::vector<uint8_t>	descriptor(totalSize, 0);
+		uint8_t					*data = descriptor.data();
+
+		const uint16_t			versionNumber = 2; // KDF 1.3
+
+		memcpy(data, &totalSize, sizeof(uint32_t));
+		// vendor and descriptor type are both 0 (Khronos, basic)
+		memcpy(data + 8, &versionNumber, sizeof(uint16_t));
+		memcpy(data + 10, &blockSize, sizeof(uint16_t));
+		data[12] = colorModel;
+		data[13] = KHR_DF_PRIMARIES_BT709;
+		data[14] = IsSRGB(format) ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR;
+		data[15] = 0; // straight alpha
+		data[16] = (isCompressed) ? 3 : 0; // texel block dimensions minus one
+		data[17] = (isCompressed) ? 3 : 0;
+		data[20] = bytesPlane0;
+		memcpy(data + 28, samples.data(), samples.size() * sizeof(DfdSample));
+
+		return descriptor;
+	}
+
+	uint64_t	AlignOffset(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+}
+
+//----------------------------------------------------------------
+
+bool	Read(const std::string &path, Image &outImage)
+{
+	std::ifstream			file(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	const uint64_t			fileSize = static_cast<uint64_t>(file.tellg());
+	if (fileSize < sizeof(Header))
+		return false;
+
+	std::vector<uint8_t>	content(static_cast<size_t>(fileSize));
+
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(content.data()), static_cast<std::streamsize>(fileSize));
+	file.close();
+
+	Header					header;
+	memcpy(&header, content.data(), sizeof(Header));
+
+	const VkFormat			format = static_cast<VkFormat>(header.m_VkFormat);
+	const uint32_t			levelsCount = std::max(header.m_LevelCount, 1u); // 0 asks the loader to generate the mips
+
+	const bool				isValid =	memcmp(header.m_Identifier, IDENTIFIER, sizeof(IDENTIFIER)) == 0 &&
+										IsSupportedFormat(format) &&
+										header.m_PixelWidth > 0 && header.m_PixelHeight > 0 && header.m_PixelDepth == 0 &&
+										header.m_LayerCount <= 1 && header.m_FaceCount == 1 &&
+										header.m_SupercompressionScheme == 0 &&
+										sizeof(Header) + levelsCount * sizeof(LevelIndex) <= fileSize;
+
+	if (!isValid)
+	{
+		std::cout << "Unsupported KTX2 file " << path << std::endl; // TODO: change this for real logger
+		return false;
+	}
+
+	outImage.m_Format = format;
+	outImage.m_Width = header.m_PixelWidth;
+	outImage.m_Height = header.m_PixelHeight;
+	outImage.m_Levels.resize(levelsCount);
+	outImage.m_Data.clear();
+
+	// the file stores the smallest level first, the image the base level first
+	uint64_t				dataSize = 0;
+	for (uint32_t levelIndex = 0; levelIndex < levelsCount; ++levelIndex)
+	{
+		LevelIndex	levelRange;
+		memcpy(&levelRange, content.data() + sizeof(Header) + levelIndex * sizeof(LevelIndex), sizeof(LevelIndex));
+
+		Level		&level = outImage.m_Levels[levelIndex];
+		{
+			level.m_Width = std::max(header.m_PixelWidth >> levelIndex, 1u);
+			level.m_Height = std::max(header.m_PixelHeight >> levelIndex, 1u);
+			level.m_Offset = dataSize;
+			level.m_Size = GetLevelSize(format, level.m_Width, level.m_Height);
+		}
+
+		if (levelRange.m_ByteLength != level.m_Size || levelRange.m_ByteOffset > fileSize || level.m_Size > fileSize - levelRange.m_ByteOffset)
+		{
+			std::cout << "Truncated KTX2 file " << path << std::endl; // TODO: change this for real logger
+			return false;
+		}
+
+		dataSize += level.m_Size;
+	}
+
+	outImage.m_Data.resize(static_cast<size_t>(dataSize));
+
+	for (uint32_t levelIndex = 0; levelIndex < levelsCount; ++levelIndex)
+	{
+		LevelIndex	levelRange;
+		memcpy(&levelRange, content.data() + sizeof(Header) + levelIndex * sizeof(LevelIndex), sizeof(LevelIndex));
+
+		const Level	&level = outImage.m_Levels[levelIndex];
+		memcpy(outImage.m_Data.data() + level.m_Offset, content.data() + levelRange.m_ByteOffset, static_cast<size_t>(level.m_Size));
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	Write(const std::string &path, const Image &image)
+{
+	const uint32_t				levelsCount = static_cast<uint32_t>(image.m_Levels.size());
+	const std::vector<uint8_t>	descriptor = BuildDataFormatDescriptor(image.m_Format);
+
+	Header						header = { };
+	{
+		memcpy(header.m_Identifier, IDENTIFIER, sizeof(IDENTIFIER));
+		header.m_VkFormat = static_cast<uint32_t>(image.m_Format);
+		header.m_TypeSize = 1; // byte sized RGBA8 components, 1 as well for block compressed formats
+		header.m_PixelWidth = image.m_Width;
+		header.m_PixelHeight = image.m_Height;
+		header.m_PixelDepth = 0;
+		header.m_LayerCount = 0;
+		header.m_FaceCount = 1;
+		header.m_LevelCount = levelsCount;
+		header.m_SupercompressionScheme = 0;
+
+		header.m_DfdByteOffset = static_cast<uint32_t>(sizeof(Header) + levelsCount * sizeof(LevelIndex));
+		header.m_DfdByteLength = static_cast<uint32_t>(descriptor.size());
+		header.m_KvdByteOffset = 0;
+		header.m_KvdByteLength = 0;
+		header.m_SgdByteOffset = 0;
+		header.m_SgdByteLength = 0;
+	}
+
+	// levels are aligned on the texel block size and laid out from the smallest one
+	const uint64_t				alignment = IsBlockCompressed(image.m_Format) ? GetLevelSize(image.m_Format, 1, 1) : 4;
+
+	std::vector<LevelIndex>		levelIndices(levelsCount);
+	uint64_t					fileSize = header.m_DfdByteOffset + header.m_DfdByteLength;
+
+	for (uint32_t levelIndex = levelsCount; levelIndex-- > 0; )
+	{
+		fileSize = AlignOffset(fileSize, alignment);
+
+		levelIndices[levelIndex].m_ByteOffset = fileSize;
+		levelIndices[levelIndex].m_ByteLength = image.m_Levels[levelIndex].m_Size;
+		levelIndices[levelIndex].m_UncompressedByteLength = image.m_Levels[levelIndex].m_Size;
+
+		fileSize += image.m_Levels[levelIndex].m_Size;
+	}
+
+	std::vector<char>			content(static_cast<size_t>(fileSize), 0);
+
+	memcpy(content.data(), &header, sizeof(Header));
+	memcpy(content.data() + sizeof(Header), levelIndices.data(), levelsCount * sizeof(LevelIndex));
+	memcpy(content.data() + header.m_DfdByteOffset, descriptor.data(), descriptor.size());
+
+	for (uint32_t levelIndex = 0; levelIndex < levelsCount; ++levelIndex)
+		memcpy(content.data() + levelIndices[levelIndex].m_ByteOffset, image.m_Data.data() + image.m_Levels[levelIndex].m_Offset, static_cast<size_t>(image.m_Levels[levelIndex].m_Size));
+
+	const std::string			temporaryPath = path + ".tmp";
+
+	std::ofstream				file(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "Can't write texture " << path << std::endl; // TODO: change this for real logger
+		return false;
+	}
+
+	file.write(content.data(), static_cast<std::streamsize>(content.size()));
+	file.close();
+
+	if (file.fail())
+	{
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+
+	// rename doesn't replace an existing file on Windows
+	std::remove(path.c_str());
+
+	if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+	{
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	IsSupportedFormat(VkFormat format)
+{
+	return	format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB || IsBlockCompressed(format);
+}
+
+//----------------------------------------------------------------
+
+bool	IsBlockCompressed(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//----------------------------------------------------------------
+
+uint64_t	GetLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	if (!IsBlockCompressed(format))
+		return static_cast<uint64_t>(width) * height * 4;
+
+	const uint64_t	blocksCount = static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4);
+	const bool		isHalfBlock = (format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK);
+
+	return blocksCount * (isHalfBlock ? 8 : 16);
+}
+
+//----------------------------------------------------------------
+
+} // namespace Ktx2
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -9,7 +9,7 @@ namespace LoaderFbx
 
 //----------------------------------------------------------------
 
-extern bool	Load(const std::string& path, const int flags, std::vector<glm::vec3>& allPosition, std::vector<glm::vec2>& allUV, std::vector<glm::vec3>& allNormal, std::vector<glm::vec4>& allDiffuseColor, std::vector<uint16_t>& allIndices, std::vector<std::string>& allDiffuseTextures, std::vector<std::string>& allNormalTextures)
+extern bool	Load(const std::string& path, const int flags, std::vector<glm::vec3>& allPosition, std::vector<glm::vec2>& allUV, std::vector<glm::vec3>& allNormal, std::vector<glm::vec4>& allDiffuseColor, std::vector<uint32_t>& allIndices, std::vector<SubmeshRange>& allSubmeshes, std::vector<std::string>& allDiffuseTextures, std::vector<std::string>& allNormalTextures)
 {
 	Assimp::Importer	importer;
 
@@ -31,6 +31,13 @@ extern bool	Load(const std::string& path, const int flags, std::vector<glm::vec3
 
 			// Vertex
 			unsigned int numVertex = scene->mMeshes[idxMesh]->mNumVertices;
+
+			SubmeshRange submesh;
+			submesh.m_FirstIndex = static_cast<uint32_t>(allIndices.size());
+			submesh.m_FirstVertex = static_cast<uint32_t>(allPosition.size());
+			submesh.m_VerticesCount = numVertex;
+			submesh.m_MaterialIndex = scene->mMeshes[idxMesh]->mMaterialIndex;
+
 			for (uint32_t idxVert = 0; idxVert < numVertex; ++idxVert)
 			{
 				//Vertices
@@ -71,7 +78,7 @@ extern bool	Load(const std::string& path, const int flags, std::vector<glm::vec3
 				allUV.push_back(texCoord);
 
 				// VertexColors
-				glm::vec4 color;
+				glm::vec4 color(1.0f);
 				if (scene->mMeshes[idxMesh]->HasVertexColors(0))
 				{
 					color.x = scene->mMeshes[idxMesh]->mColors[0][idxVert].r;
@@ -100,11 +107,11 @@ extern bool	Load(const std::string& path, const int flags, std::vector<glm::vec3
 				allDiffuseColor.push_back(color);
 			}
 
-			//Faces
+			//Faces, indices stay local to the submesh and are offset at draw time
 			unsigned int numFaces = scene->mMeshes[idxMesh]->mNumFaces;
 			for (uint32_t idxFace = 0; idxFace < numFaces; ++idxFace)
 			{
-				unsigned int numIndices = scene->mMeshes[idxMesh]->mFaces->mNumIndices;
+				unsigned int numIndices = scene->mMeshes[idxMesh]->mFaces[idxFace].mNumIndices;
 				if (numIndices == 3)
 				{
 					allIndices.push_back(scene->mMeshes[idxMesh]->mFaces[idxFace].mIndices[0]);
@@ -113,52 +120,53 @@ extern bool	Load(const std::string& path, const int flags, std::vector<glm::vec3
 				}
 			}
 
-			if (mtl)
-			{
-				aiString diffuse_path;
-				if (aiGetMaterialTexture(mtl, aiTextureType::aiTextureType_DIFFUSE, 0, &diffuse_path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS)
-				{
-					size_t pos = path.find_last_of("/");
-					std::string folderPath = "";
-					if (pos != std::string::npos)
-						folderPath = path.substr(0, pos);
+			submesh.m_IndicesCount = static_cast<uint32_t>(allIndices.size()) - submesh.m_FirstIndex;
 
-					if (folderPath.size() > 0)
-					{
-						char lastChar = folderPath[folderPath.size() - 1];
-						if (lastChar != '/')
-							folderPath.push_back('/');
-					}
+			allSubmeshes.push_back(submesh);
+		}
 
-					std::string	diffusePath = diffuse_path.data;
-					pos = diffusePath.find_last_of("/");
-					if (pos == std::string::npos)
-						pos = diffusePath.find_last_of("\\");
+		// textures per material, submeshes refer to them by index
+		unsigned int numMaterials = scene->mNumMaterials;
 
-					if (pos != std::string::npos)
-						diffusePath = diffusePath.substr(pos + 1, diffusePath.size() - pos);
+		size_t pos = path.find_last_of("/");
+		std::string folderPath = "";
+		if (pos != std::string::npos)
+			folderPath = path.substr(0, pos);
 
-					allDiffuseTextures.push_back(folderPath + diffusePath);
-				}
+		if (folderPath.size() > 0)
+		{
+			char lastChar = folderPath[folderPath.size() - 1];
+			if (lastChar != '/')
+				folderPath.push_back('/');
+		}
 
-				aiString normal_path;
-				if (aiGetMaterialTexture(mtl, aiTextureType::aiTextureType_NORMALS, 0, &normal_path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS)
-				{
-					size_t pos = path.find_last_of("/");
-					std::string folderPath = "";
-					if (pos != std::string::npos)
-						folderPath = path.substr(0, pos);
+		for (uint32_t idxMtl = 0; idxMtl < numMaterials; ++idxMtl)
+		{
+			const aiMaterial* mtl = scene->mMaterials[idxMtl];
 
-					if (folderPath.size() > 0)
-					{
-						char lastChar = folderPath[folderPath.size() - 1];
-						if (lastChar != '/')
-							folderPath.push_back('/');
-					}
+			std::string diffuseTexture = "";
+			std::string normalTexture = "";
 
-					allNormalTextures.push_back(folderPath + normal_path.data);
-				}
+			aiString diffuse_path;
+			if (aiGetMaterialTexture(mtl, aiTextureType::aiTextureType_DIFFUSE, 0, &diffuse_path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS)
+			{
+				std::string	diffusePath = diffuse_path.data;
+				pos = diffusePath.find_last_of("/");
+				if (pos == std::string::npos)
+					pos = diffusePath.find_last_of("\\");
+
+				if (pos != std::string::npos)
+					diffusePath = diffusePath.substr(pos + 1, diffusePath.size() - pos);
+
+				diffuseTexture = folderPath + diffusePath;
 			}
+
+			aiString normal_path;
+			if (aiGetMaterialTexture(mtl, aiTextureType::aiTextureType_NORMALS, 0, &normal_path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS)
+				normalTexture = folderPath + normal_path.data;
+
+			allDiffuseTextures.push_back(diffuseTexture);
+			allNormalTextures.push_back(normalTexture);
 		}
 
 		return true;
@@ -0,0 +1,313 @@
+#include "Tools/MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+MappedFile::MappedFile()
+:	m_Data(nullptr),
+	m_Size(0)
+#if defined(_WIN32)
+	, m_File(nullptr),
+	m_Mapping(nullptr)
+#endif
+{
+
+}
+
+//----------------------------------------------------------------
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+//----------------------------------------------------------------
+
+bool	MappedFile::Open(const std::string &path)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER	fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	m_Data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_Data == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_File = file;
+	m_Mapping = mapping;
+	m_Size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+	const int		file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat		fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	void			*data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+	// the mapping keeps its own reference on the file
+	close(file);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	m_Data = data;
+	m_Size = static_cast<uint64_t>(fileStat.st_size);
+#endif
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	MappedFile::Close()
+{
+	if (m_Data == nullptr)
+		return;
+
+#if defined(_WIN32)
+	UnmapViewOfFile(m_Data);
+	CloseHandle(m_Mapping);
+	CloseHandle(m_File);
+
+	m_File = nullptr;
+	m_Mapping = nullptr;
+#else
+	munmap(const_cast<void*>(m_Data), static_cast<size_t>(m_Size));
+#endif
+
+	m_Data = nullptr;
+	m_Size = 0;
+}
+
+//----------------------------------------------------------------
+
+namespace MeshCache
+{
+
+//----------------------------------------------------------------
+
+namespace
+{
+	const uint64_t	FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+	const uint64_t	FNV_PRIME = 0x100000001b3ull;
+
+	uint64_t	HashBytes(uint64_t hash, const void *data, uint64_t size)
+	{
+		const uint8_t	*bytes = static_cast<const uint8_t*>(data);
+		for (uint64_t byteIndex = 0; byteIndex < size; ++byteIndex)
+		{
+			hash ^= bytes[byteIndex];
+			hash *= FNV_PRIME;
+		}
+
+		return hash;
+	}
+
+	uint64_t	AlignSection(uint64_t offset)
+	{
+		return (offset + MESH_CACHE_SECTION_ALIGNMENT - 1) & ~static_cast<uint64_t>(MESH_CACHE_SECTION_ALIGNMENT - 1);
+	}
+
+	bool		IsSectionValid(uint64_t offset, uint64_t size, uint64_t fileSize)
+	{
+		return (offset % MESH_CACHE_SECTION_ALIGNMENT == 0) && offset <= fileSize && size <= fileSize - offset;
+	}
+}
+
+//----------------------------------------------------------------
+
+bool	View::Open(const std::string &path, uint64_t sourceHash, uint32_t importFlags)
+{
+	if (!m_File.Open(path))
+		return false;
+
+	if (m_File.GetSize() < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	const Header	&header = GetHeader();
+	const uint64_t	fileSize = m_File.GetSize();
+
+	const bool		isValid =	header.m_Magic == MESH_CACHE_MAGIC &&
+								header.m_Version == MESH_CACHE_VERSION &&
+								header.m_SourceHash == sourceHash &&
+								header.m_ImportFlags == importFlags &&
+								header.m_VertexStride == sizeof(VertexData) &&
+								(header.m_IndexSize == sizeof(uint16_t) || header.m_IndexSize == sizeof(uint32_t)) &&
+								IsSectionValid(header.m_VerticesOffset, static_cast<uint64_t>(header.m_VerticesCount) * sizeof(VertexData), fileSize) &&
+								IsSectionValid(header.m_IndicesOffset, static_cast<uint64_t>(header.m_IndicesCount) * header.m_IndexSize, fileSize) &&
+								IsSectionValid(header.m_SubmeshesOffset, static_cast<uint64_t>(header.m_SubmeshesCount) * sizeof(Submesh), fileSize) &&
+								IsSectionValid(header.m_MaterialsOffset, static_cast<uint64_t>(header.m_MaterialsCount) * sizeof(Material), fileSize) &&
+								header.m_LodsCount > 0 && header.m_LodsCount <= MESH_LOD_MAX_COUNT &&
+								IsSectionValid(header.m_LodsOffset, static_cast<uint64_t>(header.m_LodsCount) * sizeof(MeshLod), fileSize);
+
+	if (!isValid)
+	{
+		Close();
+		return false;
+	}
+
+	// submeshes are drawn straight from the levels ranges
+	const MeshLod	*lods = GetLods();
+
+	for (uint32_t lodIndex = 0; lodIndex < header.m_LodsCount; ++lodIndex)
+	{
+		if (static_cast<uint64_t>(lods[lodIndex].m_FirstSubmesh) + lods[lodIndex].m_SubmeshesCount > header.m_SubmeshesCount)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+uint64_t	HashSource(const std::string &sourcePath, uint32_t importFlags)
+{
+	MappedFile	source;
+	if (!source.Open(sourcePath))
+		return 0;
+
+	uint64_t	hash = HashBytes(FNV_OFFSET_BASIS, source.GetData(), source.GetSize());
+	hash = HashBytes(hash, &importFlags, sizeof(importFlags));
+
+	// 0 means no source
+	return (hash == 0) ? 1 : hash;
+}
+
+//----------------------------------------------------------------
+
+std::string	GetCachePath(const std::string &sourcePath)
+{
+	return sourcePath + MESH_CACHE_EXTENSION;
+}
+
+//----------------------------------------------------------------
+
+bool	Write(const std::string &path, uint64_t sourceHash, uint32_t importFlags, const MeshData &data)
+{
+	Header	header = { };
+	{
+		header.m_Magic = MESH_CACHE_MAGIC;
+		header.m_Version = MESH_CACHE_VERSION;
+		header.m_SourceHash = sourceHash;
+		header.m_ImportFlags = importFlags;
+		header.m_VertexStride = sizeof(VertexData);
+
+		header.m_VerticesCount = static_cast<uint32_t>(data.m_Vertices.size());
+		header.m_IndicesCount = data.m_IndicesCount;
+		header.m_IndexSize = data.m_IndexSize;
+		header.m_SubmeshesCount = static_cast<uint32_t>(data.m_Submeshes.size());
+		header.m_MaterialsCount = static_cast<uint32_t>(data.m_Materials.size());
+		header.m_LodsCount = static_cast<uint32_t>(data.m_Lods.size());
+
+		header.m_BoundsMin = data.m_BoundsMin;
+		header.m_BoundsMax = data.m_BoundsMax;
+		header.m_BoundsRadius = data.m_BoundsRadius;
+
+		header.m_VerticesOffset = AlignSection(sizeof(Header));
+		header.m_IndicesOffset = AlignSection(header.m_VerticesOffset + data.m_Vertices.size() * sizeof(VertexData));
+		header.m_SubmeshesOffset = AlignSection(header.m_IndicesOffset + data.m_Indices.size());
+		header.m_MaterialsOffset = AlignSection(header.m_SubmeshesOffset + data.m_Submeshes.size() * sizeof(Submesh));
+		header.m_LodsOffset = AlignSection(header.m_MaterialsOffset + data.m_Materials.size() * sizeof(Material));
+	}
+
+	const uint64_t		fileSize = header.m_LodsOffset + data.m_Lods.size() * sizeof(MeshLod);
+
+	// assembled in memory, sections are small compared to the import itself
+	std::vector<char>	content(static_cast<size_t>(fileSize), 0);
+
+	memcpy(content.data(), &header, sizeof(Header));
+	memcpy(content.data() + header.m_VerticesOffset, data.m_Vertices.data(), data.m_Vertices.size() * sizeof(VertexData));
+	memcpy(content.data() + header.m_IndicesOffset, data.m_Indices.data(), data.m_Indices.size());
+	memcpy(content.data() + header.m_SubmeshesOffset, data.m_Submeshes.data(), data.m_Submeshes.size() * sizeof(Submesh));
+	memcpy(content.data() + header.m_MaterialsOffset, data.m_Materials.data(), data.m_Materials.size() * sizeof(Material));
+	memcpy(content.data() + header.m_LodsOffset, data.m_Lods.data(), data.m_Lods.size() * sizeof(MeshLod));
+
+	const std::string	temporaryPath = path + ".tmp";
+
+	std::ofstream		file(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "Can't write mesh cache " << path << std::endl; // TODO: change this for real logger
+		return false;
+	}
+
+	file.write(content.data(), static_cast<std::streamsize>(content.size()));
+	file.close();
+
+	if (file.fail())
+	{
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+
+	// rename doesn't replace an existing file on Windows
+	std::remove(path.c_str());
+
+	if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+	{
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+} // namespace MeshCache
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
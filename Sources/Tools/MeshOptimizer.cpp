@@ -0,0 +1,953 @@
+#include "Tools/MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+VertexCacheStatistics&	VertexCacheStatistics::operator+=(const VertexCacheStatistics &other)
+{
+	m_TrianglesCount += other.m_TrianglesCount;
+	m_VerticesCount += other.m_VerticesCount;
+	m_TransformedCount += other.m_TransformedCount;
+
+	return *this;
+}
+
+//----------------------------------------------------------------
+
+OverdrawStatistics&		OverdrawStatistics::operator+=(const OverdrawStatistics &other)
+{
+	m_CoveredPixels += other.m_CoveredPixels;
+	m_ShadedPixels += other.m_ShadedPixels;
+
+	return *this;
+}
+
+//----------------------------------------------------------------
+
+void	MeshOptimizerReport::Print(const std::string &name) const
+{
+	const char	*passesName[MESH_OPTIMIZER_PASS_COUNT] = { "source", "weld", "vertex cache", "overdraw", "vertex fetch" };
+
+	std::cout << "Mesh optimized " << name << std::endl; // TODO: change this for real logger
+
+	for (uint32_t passIndex = 0; passIndex < MESH_OPTIMIZER_PASS_COUNT; ++passIndex)
+	{
+		std::cout	<< "  " << std::left << std::setw(12) << passesName[passIndex] << std::right << std::fixed << std::setprecision(3)
+					<< " vertices " << m_VertexCache[passIndex].m_VerticesCount
+					<< " ACMR " << m_VertexCache[passIndex].GetAcmr()
+					<< " ATVR " << m_VertexCache[passIndex].GetAtvr()
+					<< " overdraw " << m_Overdraw[passIndex].GetOverdraw() << std::endl; // TODO: change this for real logger
+	}
+
+	std::cout.unsetf(std::ios::fixed);
+}
+
+//----------------------------------------------------------------
+
+namespace MeshOptimizer
+{
+
+//----------------------------------------------------------------
+
+namespace
+{
+	// LRU cache modeled by the ordering, the scores favor the 3 last vertices and the ones with few triangles left
+	const uint32_t	FORSYTH_CACHE_SIZE = 32;
+	const float		FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+	const float		FORSYTH_CACHE_DECAY_POWER = 1.5f;
+	const float		FORSYTH_VALENCE_BOOST_SCALE = 2.f;
+	const float		FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+	float	GetVertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+	{
+		// no triangle left to draw
+		if (remainingTriangles == 0)
+			return -1.f;
+
+		float	score = 0.f;
+
+		if (cachePosition >= 3)
+			score = powf(1.f - static_cast<float>(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+		else if (cachePosition >= 0)
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+
+		return score + FORSYTH_VALENCE_BOOST_SCALE * powf(static_cast<float>(remainingTriangles), -FORSYTH_VALENCE_BOOST_POWER);
+	}
+
+	struct VertexHash
+	{
+		size_t	operator()(const VertexData &vertex) const
+		{
+			// FNV-1a of the bytes, vertices have no padding
+			const uint8_t	*bytes = reinterpret_cast<const uint8_t*>(&vertex);
+			uint64_t		hash = 0xcbf29ce484222325ull;
+
+			for (uint32_t byteIndex = 0; byteIndex < sizeof(VertexData); ++byteIndex)
+			{
+				hash ^= bytes[byteIndex];
+				hash *= 0x100000001b3ull;
+			}
+
+			return static_cast<size_t>(hash);
+		}
+	}; // struct VertexHash
+
+	struct VertexEqual
+	{
+		bool	operator()(const VertexData &first, const VertexData &second) const
+		{
+			return memcmp(&first, &second, sizeof(VertexData)) == 0;
+		}
+	}; // struct VertexEqual
+
+	struct PositionHash
+	{
+		size_t	operator()(const glm::vec3 &position) const
+		{
+			const uint8_t	*bytes = reinterpret_cast<const uint8_t*>(&position);
+			uint64_t		hash = 0xcbf29ce484222325ull;
+
+			for (uint32_t byteIndex = 0; byteIndex < sizeof(glm::vec3); ++byteIndex)
+			{
+				hash ^= bytes[byteIndex];
+				hash *= 0x100000001b3ull;
+			}
+
+			return static_cast<size_t>(hash);
+		}
+	}; // struct PositionHash
+
+	struct PositionEqual
+	{
+		bool	operator()(const glm::vec3 &first, const glm::vec3 &second) const
+		{
+			return memcmp(&first, &second, sizeof(glm::vec3)) == 0;
+		}
+	}; // struct PositionEqual
+
+	// sum of the squared distances to the planes of the triangles around a vertex, weighted by their area
+	struct Quadric
+	{
+		Quadric() : m_XX(0.f), m_YY(0.f), m_ZZ(0.f), m_XY(0.f), m_XZ(0.f), m_YZ(0.f), m_X(0.f), m_Y(0.f), m_Z(0.f), m_Constant(0.f), m_Weight(0.f) { }
+
+		// unit normal and distance of the plane, dot(normal, position) + distance is 0 on the plane
+		void	AddPlane(const glm::vec3 &normal, float distance, float weight)
+		{
+			m_XX += weight * normal.x * normal.x;
+			m_YY += weight * normal.y * normal.y;
+			m_ZZ += weight * normal.z * normal.z;
+			m_XY += weight * normal.x * normal.y;
+			m_XZ += weight * normal.x * normal.z;
+			m_YZ += weight * normal.y * normal.z;
+			m_X += weight * normal.x * distance;
+			m_Y += weight * normal.y * distance;
+			m_Z += weight * normal.z * distance;
+			m_Constant += weight * distance * distance;
+			m_Weight += weight;
+		}
+
+		void	Add(const Quadric &other)
+		{
+			m_XX += other.m_XX;
+			m_YY += other.m_YY;
+			m_ZZ += other.m_ZZ;
+			m_XY += other.m_XY;
+			m_XZ += other.m_XZ;
+			m_YZ += other.m_YZ;
+			m_X += other.m_X;
+			m_Y += other.m_Y;
+			m_Z += other.m_Z;
+			m_Constant += other.m_Constant;
+			m_Weight += other.m_Weight;
+		}
+
+		// mean squared distance of the position to the planes
+		float	Evaluate(const glm::vec3 &position) const
+		{
+			if (m_Weight <= 0.f)
+				return 0.f;
+
+			const float	x = m_XX * position.x + m_XY * position.y + m_XZ * position.z;
+			const float	y = m_XY * position.x + m_YY * position.y + m_YZ * position.z;
+			const float	z = m_XZ * position.x + m_YZ * position.y + m_ZZ * position.z;
+
+			const float	error = x * position.x + y * position.y + z * position.z + 2.f * (m_X * position.x + m_Y * position.y + m_Z * position.z) + m_Constant;
+
+			return std::max(error, 0.f) / m_Weight;
+		}
+
+		float	m_XX, m_YY, m_ZZ, m_XY, m_XZ, m_YZ;
+		float	m_X, m_Y, m_Z;
+		float	m_Constant;
+		float	m_Weight;
+	}; // struct Quadric
+
+	uint64_t	GetEdgeKey(uint32_t first, uint32_t second)
+	{
+		return (static_cast<uint64_t>(first) << 32) | second;
+	}
+
+	// FIFO cache simulated with the miss counter as time, a vertex is cached while less than the cache size misses happened since its own
+	struct CacheSimulation
+	{
+		CacheSimulation(uint32_t verticesCount) : m_Timestamps(verticesCount, 0), m_Time(MESH_OPTIMIZER_CACHE_SIZE + 1) { }
+
+		bool	Fetch(uint32_t vertexIndex)
+		{
+			if (m_Time - m_Timestamps[vertexIndex] <= MESH_OPTIMIZER_CACHE_SIZE)
+				return false;
+
+			m_Timestamps[vertexIndex] = m_Time++;
+			return true;
+		}
+
+		void	Flush() { m_Time += MESH_OPTIMIZER_CACHE_SIZE + 1; }
+
+		std::vector<uint32_t>	m_Timestamps;
+		uint32_t				m_Time;
+	}; // struct CacheSimulation
+
+	float	GetEdge(const glm::vec3 &first, const glm::vec3 &second, float x, float y)
+	{
+		return (second.x - first.x) * (y - first.y) - (second.y - first.y) * (x - first.x);
+	}
+
+	// x and y in pixels, z the depth, smaller is closer
+	void	RasterizeTriangle(const glm::vec3 &first, const glm::vec3 &second, const glm::vec3 &third, std::vector<float> &depths, OverdrawStatistics &outStatistics)
+	{
+		const float		area = GetEdge(first, second, third.x, third.y);
+		if (std::abs(area) < 1e-8f)
+			return;
+
+		const int32_t	resolution = MESH_OPTIMIZER_OVERDRAW_RESOLUTION;
+		const int32_t	minX = std::max(static_cast<int32_t>(std::floor(std::min(std::min(first.x, second.x), third.x))), 0);
+		const int32_t	maxX = std::min(static_cast<int32_t>(std::ceil(std::max(std::max(first.x, second.x), third.x))), resolution - 1);
+		const int32_t	minY = std::max(static_cast<int32_t>(std::floor(std::min(std::min(first.y, second.y), third.y))), 0);
+		const int32_t	maxY = std::min(static_cast<int32_t>(std::ceil(std::max(std::max(first.y, second.y), third.y))), resolution - 1);
+
+		const float		inverseArea = 1.f / area;
+
+		for (int32_t y = minY; y <= maxY; ++y)
+		{
+			for (int32_t x = minX; x <= maxX; ++x)
+			{
+				const float	centerX = x + 0.5f;
+				const float	centerY = y + 0.5f;
+
+				// barycentrics, positive inside whatever the winding on screen
+				const float	firstWeight = GetEdge(second, third, centerX, centerY) * inverseArea;
+				const float	secondWeight = GetEdge(third, first, centerX, centerY) * inverseArea;
+				const float	thirdWeight = GetEdge(first, second, centerX, centerY) * inverseArea;
+
+				if (firstWeight < 0.f || secondWeight < 0.f || thirdWeight < 0.f)
+					continue;
+
+				const float	depth = firstWeight * first.z + secondWeight * second.z + thirdWeight * third.z;
+				float		&storedDepth = depths[y * resolution + x];
+
+				if (depth < storedDepth)
+				{
+					storedDepth = depth;
+					++outStatistics.m_ShadedPixels;
+				}
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------
+
+VertexCacheStatistics	AnalyzeVertexCache(const std::vector<uint32_t> &indices, uint32_t verticesCount)
+{
+	VertexCacheStatistics	statistics;
+	CacheSimulation			cache(verticesCount);
+	std::vector<bool>		isReferenced(verticesCount, false);
+
+	const uint32_t	indicesCount = static_cast<uint32_t>(indices.size());
+	for (uint32_t indexIndex = 0; indexIndex < indicesCount; ++indexIndex)
+	{
+		const uint32_t	vertexIndex = indices[indexIndex];
+
+		if (cache.Fetch(vertexIndex))
+			++statistics.m_TransformedCount;
+
+		if (!isReferenced[vertexIndex])
+		{
+			isReferenced[vertexIndex] = true;
+			++statistics.m_VerticesCount;
+		}
+	}
+
+	statistics.m_TrianglesCount = indicesCount / 3;
+
+	return statistics;
+}
+
+//----------------------------------------------------------------
+
+OverdrawStatistics	AnalyzeOverdraw(const std::vector<VertexData> &vertices, const std::vector<uint32_t> &indices)
+{
+	OverdrawStatistics	statistics;
+
+	if (vertices.empty() || indices.empty())
+		return statistics;
+
+	glm::vec3	boundsMin = vertices[0].m_Pos;
+	glm::vec3	boundsMax = vertices[0].m_Pos;
+
+	const uint32_t	verticesCount = static_cast<uint32_t>(vertices.size());
+	for (uint32_t vertexIndex = 1; vertexIndex < verticesCount; ++vertexIndex)
+	{
+		boundsMin = glm::min(boundsMin, vertices[vertexIndex].m_Pos);
+		boundsMax = glm::max(boundsMax, vertices[vertexIndex].m_Pos);
+	}
+
+	// same scale on every axis so that the triangles keep their proportions
+	const glm::vec3	extent = boundsMax - boundsMin;
+	const float		scale = std::max(std::max(extent.x, extent.y), extent.z);
+
+	if (scale <= 0.f)
+		return statistics;
+
+	const float			pixelsScale = MESH_OPTIMIZER_OVERDRAW_RESOLUTION / scale;
+	const uint32_t		trianglesCount = static_cast<uint32_t>(indices.size() / 3);
+	std::vector<float>	depths(MESH_OPTIMIZER_OVERDRAW_RESOLUTION * MESH_OPTIMIZER_OVERDRAW_RESOLUTION);
+
+	for (uint32_t viewIndex = 0; viewIndex < 6; ++viewIndex)
+	{
+		// looking down the axis from its positive then its negative side
+		const uint32_t	axis = viewIndex / 2;
+		const float		side = (viewIndex % 2 == 0) ? 1.f : -1.f;
+		const uint32_t	axisX = (axis + 1) % 3;
+		const uint32_t	axisY = (axis + 2) % 3;
+
+		std::fill(depths.begin(), depths.end(), FLT_MAX);
+
+		for (uint32_t triangleIndex = 0; triangleIndex < trianglesCount; ++triangleIndex)
+		{
+			const glm::vec3	&first = vertices[indices[triangleIndex * 3 + 0]].m_Pos;
+			const glm::vec3	&second = vertices[indices[triangleIndex * 3 + 1]].m_Pos;
+			const glm::vec3	&third = vertices[indices[triangleIndex * 3 + 2]].m_Pos;
+
+			// back faces are culled like in the object pipelines
+			const glm::vec3	normal = glm::cross(second - first, third - first);
+			if (normal[axis] * side <= 0.f)
+				continue;
+
+			glm::vec3	screen[3];
+			const glm::vec3	*positions[3] = { &first, &second, &third };
+
+			for (uint32_t cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+			{
+				const glm::vec3	position = *positions[cornerIndex] - boundsMin;
+				screen[cornerIndex] = glm::vec3(position[axisX] * pixelsScale, position[axisY] * pixelsScale, -side * position[axis]);
+			}
+
+			RasterizeTriangle(screen[0], screen[1], screen[2], depths, statistics);
+		}
+
+		for (const float depth : depths)
+		{
+			if (depth != FLT_MAX)
+				++statistics.m_CoveredPixels;
+		}
+	}
+
+	return statistics;
+}
+
+//----------------------------------------------------------------
+
+void	WeldVertices(std::vector<VertexData> &vertices, std::vector<uint32_t> &indices)
+{
+	std::unordered_map<VertexData, uint32_t, VertexHash, VertexEqual>	uniqueVertices;
+	uniqueVertices.reserve(vertices.size());
+
+	const uint32_t			verticesCount = static_cast<uint32_t>(vertices.size());
+	std::vector<uint32_t>	remap(verticesCount);
+	uint32_t				uniqueCount = 0;
+
+	for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+	{
+		const auto	insertion = uniqueVertices.insert(std::make_pair(vertices[vertexIndex], uniqueCount));
+
+		remap[vertexIndex] = insertion.first->second;
+
+		// unique vertices are compacted in place, the write never passes the read
+		if (insertion.second)
+			vertices[uniqueCount++] = vertices[vertexIndex];
+	}
+
+	vertices.resize(uniqueCount);
+
+	for (uint32_t &index : indices)
+		index = remap[index];
+}
+
+//----------------------------------------------------------------
+
+void	OptimizeVertexCache(std::vector<uint32_t> &indices, uint32_t verticesCount)
+{
+	const uint32_t	trianglesCount = static_cast<uint32_t>(indices.size() / 3);
+
+	if (trianglesCount == 0)
+		return;
+
+	// triangles of each vertex, the live ones first in its range
+	std::vector<uint32_t>	remainingTriangles(verticesCount, 0);
+	std::vector<uint32_t>	adjacencyOffsets(verticesCount + 1, 0);
+	std::vector<uint32_t>	adjacency(trianglesCount * 3);
+
+	for (const uint32_t index : indices)
+		++remainingTriangles[index];
+
+	for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+		adjacencyOffsets[vertexIndex + 1] = adjacencyOffsets[vertexIndex] + remainingTriangles[vertexIndex];
+
+	std::vector<uint32_t>	adjacencyCounts(verticesCount, 0);
+	for (uint32_t triangleIndex = 0; triangleIndex < trianglesCount; ++triangleIndex)
+	{
+		for (uint32_t cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+		{
+			const uint32_t	vertexIndex = indices[triangleIndex * 3 + cornerIndex];
+			adjacency[adjacencyOffsets[vertexIndex] + adjacencyCounts[vertexIndex]++] = triangleIndex;
+		}
+	}
+
+	std::vector<float>		vertexScores(verticesCount);
+	std::vector<float>		triangleScores(trianglesCount, 0.f);
+	std::vector<bool>		isEmitted(trianglesCount, false);
+
+	for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+		vertexScores[vertexIndex] = GetVertexScore(-1, remainingTriangles[vertexIndex]);
+
+	uint32_t	bestTriangle = 0;
+	for (uint32_t triangleIndex = 0; triangleIndex < trianglesCount; ++triangleIndex)
+	{
+		for (uint32_t cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+			triangleScores[triangleIndex] += vertexScores[indices[triangleIndex * 3 + cornerIndex]];
+
+		if (triangleScores[triangleIndex] > triangleScores[bestTriangle])
+			bestTriangle = triangleIndex;
+	}
+
+	std::vector<uint32_t>	optimizedIndices(indices.size());
+	uint32_t				cache[FORSYTH_CACHE_SIZE + 3];
+	uint32_t				cacheCount = 0;
+	uint32_t				nextTriangle = 0;
+
+	for (uint32_t outputIndex = 0; outputIndex < trianglesCount; ++outputIndex)
+	{
+		// nothing left around the cache, restart from the first triangle not drawn
+		if (bestTriangle == UINT32_MAX)
+		{
+			while (isEmitted[nextTriangle])
+				++nextTriangle;
+
+			bestTriangle = nextTriangle;
+		}
+
+		const uint32_t	*triangle = &indices[bestTriangle * 3];
+
+		memcpy(&optimizedIndices[outputIndex * 3], triangle, 3 * sizeof(uint32_t));
+		isEmitted[bestTriangle] = true;
+
+		// the triangle leaves the live range of its vertices
+		for (uint32_t cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+		{
+			const uint32_t	vertexIndex = triangle[cornerIndex];
+			uint32_t		*vertexTriangles = &adjacency[adjacencyOffsets[vertexIndex]];
+
+			for (uint32_t liveIndex = 0; liveIndex < remainingTriangles[vertexIndex]; ++liveIndex)
+			{
+				if (vertexTriangles[liveIndex] == bestTriangle)
+				{
+					std::swap(vertexTriangles[liveIndex], vertexTriangles[remainingTriangles[vertexIndex] - 1]);
+					--remainingTriangles[vertexIndex];
+					break;
+				}
+			}
+		}
+
+		// the triangle vertices move to the front, the ones pushed past the end are evicted
+		uint32_t	newCache[FORSYTH_CACHE_SIZE + 3];
+		uint32_t	newCacheCount = 0;
+
+		for (uint32_t cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+		{
+			if (std::find(newCache, newCache + newCacheCount, triangle[cornerIndex]) == newCache + newCacheCount)
+				newCache[newCacheCount++] = triangle[cornerIndex];
+		}
+
+		for (uint32_t cacheIndex = 0; cacheIndex < cacheCount; ++cacheIndex)
+		{
+			if (std::find(newCache, newCache + newCacheCount, cache[cacheIndex]) == newCache + newCacheCount)
+				newCache[newCacheCount++] = cache[cacheIndex];
+		}
+
+		bestTriangle = UINT32_MAX;
+		float	bestScore = -FLT_MAX;
+
+		for (uint32_t cacheIndex = 0; cacheIndex < newCacheCount; ++cacheIndex)
+		{
+			const uint32_t	vertexIndex = newCache[cacheIndex];
+			const int32_t	cachePosition = (cacheIndex < FORSYTH_CACHE_SIZE) ? static_cast<int32_t>(cacheIndex) : -1;
+			const float		score = GetVertexScore(cachePosition, remainingTriangles[vertexIndex]);
+			const float		scoreDelta = score - vertexScores[vertexIndex];
+
+			vertexScores[vertexIndex] = score;
+
+			const uint32_t	*vertexTriangles = &adjacency[adjacencyOffsets[vertexIndex]];
+			for (uint32_t liveIndex = 0; liveIndex < remainingTriangles[vertexIndex]; ++liveIndex)
+				triangleScores[vertexTriangles[liveIndex]] += scoreDelta;
+		}
+
+		// best triangle among the ones around the cache, once every score is up to date
+		for (uint32_t cacheIndex = 0; cacheIndex < newCacheCount && cacheIndex < FORSYTH_CACHE_SIZE; ++cacheIndex)
+		{
+			const uint32_t	vertexIndex = newCache[cacheIndex];
+			const uint32_t	*vertexTriangles = &adjacency[adjacencyOffsets[vertexIndex]];
+
+			for (uint32_t liveIndex = 0; liveIndex < remainingTriangles[vertexIndex]; ++liveIndex)
+			{
+				if (triangleScores[vertexTriangles[liveIndex]] > bestScore)
+				{
+					bestScore = triangleScores[vertexTriangles[liveIndex]];
+					bestTriangle = vertexTriangles[liveIndex];
+				}
+			}
+		}
+
+		cacheCount = std::min(newCacheCount, FORSYTH_CACHE_SIZE);
+		memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+	}
+
+	indices.swap(optimizedIndices);
+}
+
+//----------------------------------------------------------------
+
+void	OptimizeOverdraw(const std::vector<VertexData> &vertices, std::vector<uint32_t> &indices, float threshold)
+{
+	const uint32_t	trianglesCount = static_cast<uint32_t>(indices.size() / 3);
+	const uint32_t	verticesCount = static_cast<uint32_t>(vertices.size());
+
+	if (trianglesCount == 0)
+		return;
+
+	// hard boundaries where the cache order starts over, every vertex of the triangle misses
+	std::vector<uint32_t>	hardClusters;
+	std::vector<uint32_t>	hardClustersMisses;
+	CacheSimulation			cache(verticesCount);
+
+	for (uint32_t triangleIndex = 0; triangleIndex < trianglesCount; ++triangleIndex)
+	{
+		uint32_t	missesCount = 0;
+		for (uint32_t cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+			missesCount += cache.Fetch(indices[triangleIndex * 3 + cornerIndex]) ? 1 : 0;
+
+		if (triangleIndex == 0 || missesCount == 3)
+		{
+			hardClusters.push_back(triangleIndex);
+			hardClustersMisses.push_back(0);
+		}
+
+		hardClustersMisses.back() += missesCount;
+	}
+
+	hardClusters.push_back(trianglesCount);
+
+	// soft boundaries as soon as a cluster started with a cold cache is within the threshold of the cache order
+	std::vector<uint32_t>	clusters;
+	const uint32_t			hardClustersCount = static_cast<uint32_t>(hardClustersMisses.size());
+
+	for (uint32_t hardClusterIndex = 0; hardClusterIndex < hardClustersCount; ++hardClusterIndex)
+	{
+		const uint32_t	clusterStart = hardClusters[hardClusterIndex];
+		const uint32_t	clusterEnd = hardClusters[hardClusterIndex + 1];
+		const float		maxAcmr = threshold * hardClustersMisses[hardClusterIndex] / (clusterEnd - clusterStart);
+
+		uint32_t	softStart = clusterStart;
+		uint32_t	missesCount = 0;
+
+		cache.Flush();
+		clusters.push_back(clusterStart);
+
+		for (uint32_t triangleIndex = clusterStart; triangleIndex < clusterEnd; ++triangleIndex)
+		{
+			for (uint32_t cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+				missesCount += cache.Fetch(indices[triangleIndex * 3 + cornerIndex]) ? 1 : 0;
+
+			if (triangleIndex + 1 < clusterEnd && static_cast<float>(missesCount) / (triangleIndex + 1 - softStart) <= maxAcmr)
+			{
+				softStart = triangleIndex + 1;
+				missesCount = 0;
+
+				cache.Flush();
+				clusters.push_back(softStart);
+			}
+		}
+	}
+
+	const uint32_t	clustersCount = static_cast<uint32_t>(clusters.size());
+	clusters.push_back(trianglesCount);
+
+	// area weighted centroid and normal of every cluster and of the whole mesh
+	std::vector<glm::vec3>	clustersCentroid(clustersCount, glm::vec3(0.f));
+	std::vector<glm::vec3>	clustersNormal(clustersCount, glm::vec3(0.f));
+	glm::vec3				meshCentroid = glm::vec3(0.f);
+	float					meshArea = 0.f;
+
+	for (uint32_t clusterIndex = 0; clusterIndex < clustersCount; ++clusterIndex)
+	{
+		float	clusterArea = 0.f;
+
+		for (uint32_t triangleIndex = clusters[clusterIndex]; triangleIndex < clusters[clusterIndex + 1]; ++triangleIndex)
+		{
+			const glm::vec3	&first = vertices[indices[triangleIndex * 3 + 0]].m_Pos;
+			const glm::vec3	&second = vertices[indices[triangleIndex * 3 + 1]].m_Pos;
+			const glm::vec3	&third = vertices[indices[triangleIndex * 3 + 2]].m_Pos;
+
+			const glm::vec3	normal = glm::cross(second - first, third - first);
+			const float		area = glm::length(normal);
+
+			clustersCentroid[clusterIndex] += (first + second + third) * (area / 3.f);
+			clustersNormal[clusterIndex] += normal;
+			clusterArea += area;
+		}
+
+		meshCentroid += clustersCentroid[clusterIndex];
+		meshArea += clusterArea;
+
+		clustersCentroid[clusterIndex] = (clusterArea > 0.f) ? clustersCentroid[clusterIndex] / clusterArea : clustersCentroid[clusterIndex];
+	}
+
+	meshCentroid = (meshArea > 0.f) ? meshCentroid / meshArea : meshCentroid;
+
+	// clusters facing away from the center are the most likely to hide the others
+	std::vector<float>		clustersKey(clustersCount);
+	std::vector<uint32_t>	clustersOrder(clustersCount);
+
+	for (uint32_t clusterIndex = 0; clusterIndex < clustersCount; ++clusterIndex)
+	{
+		const float	normalLength = glm::length(clustersNormal[clusterIndex]);
+		const float	outwardDistance = glm::dot(clustersCentroid[clusterIndex] - meshCentroid, clustersNormal[clusterIndex]);
+
+		clustersKey[clusterIndex] = (normalLength > 0.f) ? outwardDistance / normalLength : 0.f;
+		clustersOrder[clusterIndex] = clusterIndex;
+	}
+
+	std::stable_sort(clustersOrder.begin(), clustersOrder.end(), [&clustersKey](uint32_t first, uint32_t second)
+	{
+		return clustersKey[first] > clustersKey[second];
+	});
+
+	std::vector<uint32_t>	sortedIndices;
+	sortedIndices.reserve(indices.size());
+
+	for (const uint32_t clusterIndex : clustersOrder)
+		sortedIndices.insert(sortedIndices.end(), indices.begin() + clusters[clusterIndex] * 3, indices.begin() + clusters[clusterIndex + 1] * 3);
+
+	indices.swap(sortedIndices);
+}
+
+//----------------------------------------------------------------
+
+void	OptimizeVertexFetch(std::vector<VertexData> &vertices, std::vector<uint32_t> &indices)
+{
+	std::vector<uint32_t>	remap(vertices.size(), UINT32_MAX);
+	std::vector<VertexData>	orderedVertices;
+	orderedVertices.reserve(vertices.size());
+
+	for (uint32_t &index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = static_cast<uint32_t>(orderedVertices.size());
+			orderedVertices.push_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices.swap(orderedVertices);
+}
+
+//----------------------------------------------------------------
+
+void	Optimize(std::vector<VertexData> &vertices, std::vector<uint32_t> &indices, MeshOptimizerReport &report)
+{
+	// the overdraw only changes with the triangles order, the passes keeping it copy the sums of the previous one
+	report.m_VertexCache[0] += AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+	report.m_Overdraw[0] += AnalyzeOverdraw(vertices, indices);
+
+	WeldVertices(vertices, indices);
+
+	report.m_VertexCache[1] += AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+	report.m_Overdraw[1] = report.m_Overdraw[0];
+
+	OptimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+
+	report.m_VertexCache[2] += AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+	report.m_Overdraw[2] += AnalyzeOverdraw(vertices, indices);
+
+	OptimizeOverdraw(vertices, indices, MESH_OPTIMIZER_OVERDRAW_THRESHOLD);
+
+	report.m_VertexCache[3] += AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+	report.m_Overdraw[3] += AnalyzeOverdraw(vertices, indices);
+
+	OptimizeVertexFetch(vertices, indices);
+
+	report.m_VertexCache[4] += AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+	report.m_Overdraw[4] = report.m_Overdraw[3];
+}
+
+//----------------------------------------------------------------
+
+float	Simplify(	const std::vector<VertexData> &vertices, const std::vector<uint32_t> &indices, uint32_t targetIndicesCount, float targetError,
+					std::vector<uint32_t> &outIndices)
+{
+	const uint32_t	verticesCount = static_cast<uint32_t>(vertices.size());
+
+	outIndices = indices;
+
+	// vertices split by a uv or normal seam share their position, the first one stands for all of them
+	std::unordered_map<glm::vec3, uint32_t, PositionHash, PositionEqual>	firstVertices;
+	firstVertices.reserve(verticesCount);
+
+	std::vector<uint32_t>	positionRemap(verticesCount);
+	std::vector<uint32_t>	wedgesCount(verticesCount, 0);
+
+	for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+	{
+		positionRemap[vertexIndex] = firstVertices.insert(std::make_pair(vertices[vertexIndex].m_Pos, vertexIndex)).first->second;
+		++wedgesCount[positionRemap[vertexIndex]];
+	}
+
+	// an edge without its opposite is on an open border, moving its vertices would open holes
+	const uint32_t	indicesCount = static_cast<uint32_t>(indices.size());
+
+	std::unordered_set<uint64_t>	edges;
+	edges.reserve(indicesCount);
+
+	for (uint32_t indexIndex = 0; indexIndex < indicesCount; ++indexIndex)
+	{
+		const uint32_t	nextIndex = (indexIndex % 3 == 2) ? indexIndex - 2 : indexIndex + 1;
+		edges.insert(GetEdgeKey(positionRemap[indices[indexIndex]], positionRemap[indices[nextIndex]]));
+	}
+
+	std::vector<bool>	isBorder(verticesCount, false);
+
+	for (uint32_t indexIndex = 0; indexIndex < indicesCount; ++indexIndex)
+	{
+		const uint32_t	nextIndex = (indexIndex % 3 == 2) ? indexIndex - 2 : indexIndex + 1;
+		const uint32_t	first = positionRemap[indices[indexIndex]];
+		const uint32_t	second = positionRemap[indices[nextIndex]];
+
+		if (edges.find(GetEdgeKey(second, first)) == edges.end())
+		{
+			isBorder[first] = true;
+			isBorder[second] = true;
+		}
+	}
+
+	std::vector<bool>	isLocked(verticesCount);
+
+	for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+		isLocked[vertexIndex] = isBorder[positionRemap[vertexIndex]] || wedgesCount[positionRemap[vertexIndex]] > 1;
+
+	std::vector<Quadric>	quadrics(verticesCount);
+
+	for (uint32_t indexIndex = 0; indexIndex < indicesCount; indexIndex += 3)
+	{
+		const glm::vec3	&first = vertices[indices[indexIndex + 0]].m_Pos;
+		const glm::vec3	normal = glm::cross(vertices[indices[indexIndex + 1]].m_Pos - first, vertices[indices[indexIndex + 2]].m_Pos - first);
+		const float		normalLength = glm::length(normal);
+
+		if (normalLength <= 0.f)
+			continue;
+
+		const glm::vec3	unitNormal = normal / normalLength;
+
+		for (uint32_t cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+			quadrics[indices[indexIndex + cornerIndex]].AddPlane(unitNormal, -glm::dot(unitNormal, first), normalLength * 0.5f);
+	}
+
+	const float				maxError = targetError * targetError;
+	float					resultError = 0.f;
+
+	std::vector<uint32_t>	triangleOffsets;
+	std::vector<uint32_t>	vertexTriangles;
+	std::vector<float>		collapseErrors(verticesCount);
+	std::vector<uint32_t>	collapseTargets(verticesCount);
+	std::vector<uint32_t>	collapseOrder;
+	std::vector<uint32_t>	remap(verticesCount);
+	std::vector<bool>		isTouched(verticesCount);
+
+	// each pass collapses independent edges, cheapest first, then rebuilds the triangles
+	while (outIndices.size() > targetIndicesCount)
+	{
+		const uint32_t	trianglesCount = static_cast<uint32_t>(outIndices.size() / 3);
+
+		// triangles of each vertex
+		triangleOffsets.assign(verticesCount + 1, 0);
+		for (const uint32_t index : outIndices)
+			++triangleOffsets[index + 1];
+
+		std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+
+		vertexTriangles.resize(outIndices.size());
+		std::vector<uint32_t>	triangleCursors(triangleOffsets.begin(), triangleOffsets.end() - 1);
+
+		for (uint32_t triangleIndex = 0; triangleIndex < trianglesCount; ++triangleIndex)
+		{
+			for (uint32_t cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+				vertexTriangles[triangleCursors[outIndices[triangleIndex * 3 + cornerIndex]]++] = triangleIndex;
+		}
+
+		// cheapest collapse of every free vertex onto one of its neighbours
+		std::fill(collapseErrors.begin(), collapseErrors.end(), FLT_MAX);
+
+		for (uint32_t indexIndex = 0; indexIndex < outIndices.size(); ++indexIndex)
+		{
+			const uint32_t	source = outIndices[indexIndex];
+			if (isLocked[source])
+				continue;
+
+			const uint32_t	triangleStart = indexIndex - indexIndex % 3;
+
+			for (uint32_t cornerIndex = 1; cornerIndex < 3; ++cornerIndex)
+			{
+				const uint32_t	target = outIndices[triangleStart + (indexIndex + cornerIndex) % 3];
+				const float		error = quadrics[source].Evaluate(vertices[target].m_Pos);
+
+				if (error < collapseErrors[source])
+				{
+					collapseErrors[source] = error;
+					collapseTargets[source] = target;
+				}
+			}
+		}
+
+		collapseOrder.clear();
+		for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+		{
+			if (collapseErrors[vertexIndex] <= maxError)
+				collapseOrder.push_back(vertexIndex);
+		}
+
+		std::sort(collapseOrder.begin(), collapseOrder.end(), [&collapseErrors](uint32_t first, uint32_t second) { return collapseErrors[first] < collapseErrors[second]; });
+
+		// a pass stops once it removed enough triangles, so that the cheapest collapses of the next pass get their turn
+		const uint32_t	trianglesGoal = static_cast<uint32_t>((outIndices.size() - targetIndicesCount) / 3);
+		uint32_t		removedCount = 0;
+		uint32_t		collapsesCount = 0;
+
+		std::iota(remap.begin(), remap.end(), 0);
+		std::fill(isTouched.begin(), isTouched.end(), false);
+
+		for (const uint32_t source : collapseOrder)
+		{
+			if (removedCount >= trianglesGoal)
+				break;
+
+			const uint32_t	target = collapseTargets[source];
+
+			// the triangles around a collapsed vertex are checked against their current shape, they must not change twice in a pass
+			if (isTouched[source] || isTouched[target])
+				continue;
+
+			bool		isFlipping = false;
+			uint32_t	collapsedCount = 0;
+
+			for (uint32_t triangleOffset = triangleOffsets[source]; triangleOffset < triangleOffsets[source + 1] && !isFlipping; ++triangleOffset)
+			{
+				const uint32_t	*triangle = &outIndices[vertexTriangles[triangleOffset] * 3];
+
+				const glm::vec3	&first = vertices[triangle[0]].m_Pos;
+				const glm::vec3	&second = vertices[triangle[1]].m_Pos;
+				const glm::vec3	&third = vertices[triangle[2]].m_Pos;
+
+				if (positionRemap[triangle[0]] == positionRemap[target] || positionRemap[triangle[1]] == positionRemap[target] || positionRemap[triangle[2]] == positionRemap[target])
+				{
+					++collapsedCount;
+					continue;
+				}
+
+				const glm::vec3	&targetPosition = vertices[target].m_Pos;
+				const glm::vec3	&collapsedFirst = (triangle[0] == source) ? targetPosition : first;
+				const glm::vec3	&collapsedSecond = (triangle[1] == source) ? targetPosition : second;
+				const glm::vec3	&collapsedThird = (triangle[2] == source) ? targetPosition : third;
+
+				const glm::vec3	normal = glm::cross(second - first, third - first);
+				const glm::vec3	collapsedNormal = glm::cross(collapsedSecond - collapsedFirst, collapsedThird - collapsedFirst);
+
+				isFlipping = glm::dot(normal, collapsedNormal) < MESH_OPTIMIZER_SIMPLIFY_MIN_COSINE * glm::length(normal) * glm::length(collapsedNormal);
+			}
+
+			if (isFlipping)
+				continue;
+
+			for (uint32_t triangleOffset = triangleOffsets[source]; triangleOffset < triangleOffsets[source + 1]; ++triangleOffset)
+			{
+				const uint32_t	*triangle = &outIndices[vertexTriangles[triangleOffset] * 3];
+
+				isTouched[triangle[0]] = true;
+				isTouched[triangle[1]] = true;
+				isTouched[triangle[2]] = true;
+			}
+
+			remap[source] = target;
+			quadrics[target].Add(quadrics[source]);
+			resultError = std::max(resultError, collapseErrors[source]);
+
+			removedCount += collapsedCount;
+			++collapsesCount;
+		}
+
+		if (collapsesCount == 0)
+			break;
+
+		// triangles with two corners at the same position collapsed
+		uint32_t	writeIndex = 0;
+
+		for (uint32_t triangleIndex = 0; triangleIndex < trianglesCount; ++triangleIndex)
+		{
+			const uint32_t	first = remap[outIndices[triangleIndex * 3 + 0]];
+			const uint32_t	second = remap[outIndices[triangleIndex * 3 + 1]];
+			const uint32_t	third = remap[outIndices[triangleIndex * 3 + 2]];
+
+			if (positionRemap[first] == positionRemap[second] || positionRemap[second] == positionRemap[third] || positionRemap[third] == positionRemap[first])
+				continue;
+
+			outIndices[writeIndex++] = first;
+			outIndices[writeIndex++] = second;
+			outIndices[writeIndex++] = third;
+		}
+
+		outIndices.resize(writeIndex);
+	}
+
+	return sqrtf(resultError);
+}
+
+//----------------------------------------------------------------
+
+} // namespace MeshOptimizer
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
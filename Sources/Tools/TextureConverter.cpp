@@ -0,0 +1,444 @@
+#include "Tools/TextureConverter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+#include "CpuProfiler.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+namespace TextureConverter
+{
+
+//----------------------------------------------------------------
+
+namespace
+{
+	const char	*SOURCE_EXTENSIONS[] = { ".jpg", ".jpeg", ".png", ".tga", ".bmp" };
+
+	std::string	ToLower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+
+		return text;
+	}
+
+	// 2x2 box filter, the last row or column is repeated on odd sizes
+	std::vector<uint8_t>	Downsample(const std::vector<uint8_t> &pixels, uint32_t width, uint32_t height, uint32_t nextWidth, uint32_t nextHeight)
+	{
+		std::vector<uint8_t>	nextPixels(static_cast<size_t>(nextWidth) * nextHeight * 4);
+
+		for (uint32_t y = 0; y < nextHeight; ++y)
+		{
+			const uint32_t	y0 = std::min(y * 2, height - 1);
+			const uint32_t	y1 = std::min(y * 2 + 1, height - 1);
+
+			for (uint32_t x = 0; x < nextWidth; ++x)
+			{
+				const uint32_t	x0 = std::min(x * 2, width - 1);
+				const uint32_t	x1 = std::min(x * 2 + 1, width - 1);
+
+				for (uint32_t channelIndex = 0; channelIndex < 4; ++channelIndex)
+				{
+					const uint32_t	sum =	pixels[(y0 * width + x0) * 4 + channelIndex] + pixels[(y0 * width + x1) * 4 + channelIndex] +
+											pixels[(y1 * width + x0) * 4 + channelIndex] + pixels[(y1 * width + x1) * 4 + channelIndex];
+
+					nextPixels[(y * nextWidth + x) * 4 + channelIndex] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+
+		return nextPixels;
+	}
+
+	// 4x4 texels around (blockX, blockY), clamped on the image borders
+	void	FetchBlock(const std::vector<uint8_t> &pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t outBlock[16][4])
+	{
+		for (uint32_t texelIndex = 0; texelIndex < 16; ++texelIndex)
+		{
+			const uint32_t	x = std::min(blockX * 4 + texelIndex % 4, width - 1);
+			const uint32_t	y = std::min(blockY * 4 + texelIndex / 4, height - 1);
+
+			memcpy(outBlock[texelIndex], &pixels[(y * width + x) * 4], 4);
+		}
+	}
+
+	uint16_t	PackRGB565(const float color[3])
+	{
+		const uint32_t	r = static_cast<uint32_t>(std::clamp(color[0], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+		const uint32_t	g = static_cast<uint32_t>(std::clamp(color[1], 0.f, 255.f) * 63.f / 255.f + 0.5f);
+		const uint32_t	b = static_cast<uint32_t>(std::clamp(color[2], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void	UnpackRGB565(uint16_t packed, float outColor[3])
+	{
+		outColor[0] = static_cast<float>((packed >> 11) & 31) * 255.f / 31.f;
+		outColor[1] = static_cast<float>((packed >> 5) & 63) * 255.f / 63.f;
+		outColor[2] = static_cast<float>(packed & 31) * 255.f / 31.f;
+	}
+
+	// endpoints at both ends of the colors projected on their principal axis, 4 colors mode
+	void	EncodeColorBlock(const uint8_t block[16][4], uint8_t *outData)
+	{
+		float	mean[3] = { 0.f, 0.f, 0.f };
+		for (uint32_t texelIndex = 0; texelIndex < 16; ++texelIndex)
+		{
+			for (uint32_t channelIndex = 0; channelIndex < 3; ++channelIndex)
+				mean[channelIndex] += block[texelIndex][channelIndex] / 16.f;
+		}
+
+		float	covariance[6] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f }; // rr rg rb gg gb bb
+		for (uint32_t texelIndex = 0; texelIndex < 16; ++texelIndex)
+		{
+			const float	r = block[texelIndex][0] - mean[0];
+			const float	g = block[texelIndex][1] - mean[1];
+			const float	b = block[texelIndex][2] - mean[2];
+
+			covariance[0] += r * r;
+			covariance[1] += r * g;
+			covariance[2] += r * b;
+			covariance[3] += g * g;
+			covariance[4] += g * b;
+			covariance[5] += b * b;
+		}
+
+		// a few power iterations are enough to pick the axis
+		float	axis[3] = { 1.f, 1.f, 1.f };
+		for (uint32_t iterationIndex = 0; iterationIndex < 8; ++iterationIndex)
+		{
+			const float	x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+			const float	y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+			const float	z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+
+			const float	length = std::max(std::max(fabsf(x), fabsf(y)), fabsf(z));
+			if (length <= 0.f)
+				break;
+
+			axis[0] = x / length;
+			axis[1] = y / length;
+			axis[2] = z / length;
+		}
+
+		float	minProjection = FLT_MAX;
+		float	maxProjection = -FLT_MAX;
+		for (uint32_t texelIndex = 0; texelIndex < 16; ++texelIndex)
+		{
+			const float	projection =	(block[texelIndex][0] - mean[0]) * axis[0] +
+										(block[texelIndex][1] - mean[1]) * axis[1] +
+										(block[texelIndex][2] - mean[2]) * axis[2];
+
+			minProjection = std::min(minProjection, projection);
+			maxProjection = std::max(maxProjection, projection);
+		}
+
+		const float	axisLengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		float		minColor[3];
+		float		maxColor[3];
+		for (uint32_t channelIndex = 0; channelIndex < 3; ++channelIndex)
+		{
+			const float	direction = (axisLengthSquared > 0.f) ? axis[channelIndex] / axisLengthSquared : 0.f;
+
+			minColor[channelIndex] = mean[channelIndex] + direction * minProjection;
+			maxColor[channelIndex] = mean[channelIndex] + direction * maxProjection;
+		}
+
+		uint16_t	color0 = PackRGB565(maxColor);
+		uint16_t	color1 = PackRGB565(minColor);
+
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		uint32_t	indices = 0;
+
+		// equal endpoints would switch the block to 3 colors mode, index 0 is right for every texel
+		if (color0 != color1)
+		{
+			float	palette[4][3];
+			UnpackRGB565(color0, palette[0]);
+			UnpackRGB565(color1, palette[1]);
+
+			for (uint32_t channelIndex = 0; channelIndex < 3; ++channelIndex)
+			{
+				palette[2][channelIndex] = (2.f * palette[0][channelIndex] + palette[1][channelIndex]) / 3.f;
+				palette[3][channelIndex] = (palette[0][channelIndex] + 2.f * palette[1][channelIndex]) / 3.f;
+			}
+
+			for (uint32_t texelIndex = 0; texelIndex < 16; ++texelIndex)
+			{
+				uint32_t	bestIndex = 0;
+				float		bestDistance = FLT_MAX;
+
+				for (uint32_t paletteIndex = 0; paletteIndex < 4; ++paletteIndex)
+				{
+					const float	r = block[texelIndex][0] - palette[paletteIndex][0];
+					const float	g = block[texelIndex][1] - palette[paletteIndex][1];
+					const float	b = block[texelIndex][2] - palette[paletteIndex][2];
+					const float	distance = r * r + g * g + b * b;
+
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIndex = paletteIndex;
+					}
+				}
+
+				indices |= bestIndex << (texelIndex * 2);
+			}
+		}
+
+		memcpy(outData, &color0, sizeof(uint16_t));
+		memcpy(outData + 2, &color1, sizeof(uint16_t));
+		memcpy(outData + 4, &indices, sizeof(uint32_t));
+	}
+
+	// single channel block of BC3 alpha and BC5, 8 values mode between the extremes
+	void	EncodeChannelBlock(const uint8_t block[16][4], uint32_t channelIndex, uint8_t *outData)
+	{
+		uint8_t		minValue = 255;
+		uint8_t		maxValue = 0;
+		for (uint32_t texelIndex = 0; texelIndex < 16; ++texelIndex)
+		{
+			minValue = std::min(minValue, block[texelIndex][channelIndex]);
+			maxValue = std::max(maxValue, block[texelIndex][channelIndex]);
+		}
+
+		uint64_t	bits = static_cast<uint64_t>(maxValue) | (static_cast<uint64_t>(minValue) << 8);
+
+		if (maxValue != minValue)
+		{
+			float	palette[8];
+			palette[0] = maxValue;
+			palette[1] = minValue;
+			for (uint32_t paletteIndex = 2; paletteIndex < 8; ++paletteIndex)
+				palette[paletteIndex] = ((8 - paletteIndex) * maxValue + (paletteIndex - 1) * minValue) / 7.f;
+
+			for (uint32_t texelIndex = 0; texelIndex < 16; ++texelIndex)
+			{
+				uint64_t	bestIndex = 0;
+				float		bestDistance = FLT_MAX;
+
+				for (uint32_t paletteIndex = 0; paletteIndex < 8; ++paletteIndex)
+				{
+					const float	distance = fabsf(block[texelIndex][channelIndex] - palette[paletteIndex]);
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIndex = paletteIndex;
+					}
+				}
+
+				bits |= bestIndex << (16 + texelIndex * 3);
+			}
+		}
+
+		memcpy(outData, &bits, sizeof(uint64_t));
+	}
+
+	void	EncodeLevel(const std::vector<uint8_t> &pixels, uint32_t width, uint32_t height, VkFormat format, uint8_t *outData)
+	{
+		if (format == VK_FORMAT_R8G8B8A8_UNORM)
+		{
+			memcpy(outData, pixels.data(), pixels.size());
+			return;
+		}
+
+		const uint32_t	blocksWidth = (width + 3) / 4;
+		const uint32_t	blocksHeight = (height + 3) / 4;
+		const uint32_t	blockSize = (format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK) ? 8 : 16;
+
+		uint8_t			block[16][4];
+
+		for (uint32_t blockY = 0; blockY < blocksHeight; ++blockY)
+		{
+			for (uint32_t blockX = 0; blockX < blocksWidth; ++blockX)
+			{
+				FetchBlock(pixels, width, height, blockX, blockY, block);
+
+				uint8_t	*blockData = outData + (blockY * blocksWidth + blockX) * blockSize;
+
+				switch (format)
+				{
+				case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+					EncodeColorBlock(block, blockData);
+					break;
+				case VK_FORMAT_BC3_UNORM_BLOCK:
+					EncodeChannelBlock(block, 3, blockData);
+					EncodeColorBlock(block, blockData + 8);
+					break;
+				default:
+					EncodeChannelBlock(block, 0, blockData);
+					EncodeChannelBlock(block, 1, blockData + 8);
+					break;
+				}
+			}
+		}
+	}
+
+	bool	IsSourceImage(const std::filesystem::path &path)
+	{
+		const std::string	extension = ToLower(path.extension().string());
+
+		for (const char *sourceExtension : SOURCE_EXTENSIONS)
+		{
+			if (extension == sourceExtension)
+				return true;
+		}
+
+		return false;
+	}
+}
+
+//----------------------------------------------------------------
+
+VkFormat	ChooseFormat(const std::string &sourcePath, const std::vector<uint8_t> &pixels, TEXTURE_COMPRESSION compression)
+{
+	switch (compression)
+	{
+	case TEXTURE_COMPRESSION::RGBA8:
+		return VK_FORMAT_R8G8B8A8_UNORM;
+	case TEXTURE_COMPRESSION::BC1:
+		return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case TEXTURE_COMPRESSION::BC3:
+		return VK_FORMAT_BC3_UNORM_BLOCK;
+	case TEXTURE_COMPRESSION::BC5:
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	default:
+		break;
+	}
+
+	// normal maps only need two channels, z is rebuilt when sampling
+	const std::string	fileName = ToLower(std::filesystem::path(sourcePath).filename().string());
+	if (fileName.find("normal") != std::string::npos)
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+
+	const size_t		pixelsCount = pixels.size() / 4;
+	for (size_t pixelIndex = 0; pixelIndex < pixelsCount; ++pixelIndex)
+	{
+		if (pixels[pixelIndex * 4 + 3] != 255)
+			return VK_FORMAT_BC3_UNORM_BLOCK;
+	}
+
+	return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+}
+
+//----------------------------------------------------------------
+
+bool	Encode(const std::vector<uint8_t> &pixels, uint32_t width, uint32_t height, VkFormat format, Ktx2::Image &outImage)
+{
+	if (width == 0 || height == 0 || pixels.size() != static_cast<size_t>(width) * height * 4 || !Ktx2::IsSupportedFormat(format))
+		return false;
+
+	outImage.m_Format = format;
+	outImage.m_Width = width;
+	outImage.m_Height = height;
+	outImage.m_Levels.clear();
+	outImage.m_Data.clear();
+
+	const uint32_t			levelsCount = static_cast<uint32_t>(floor(log2(std::max(width, height)))) + 1;
+
+	std::vector<uint8_t>	levelPixels = pixels;
+	uint32_t				levelWidth = width;
+	uint32_t				levelHeight = height;
+
+	for (uint32_t levelIndex = 0; levelIndex < levelsCount; ++levelIndex)
+	{
+		Ktx2::Level	level = { };
+		{
+			level.m_Offset = outImage.m_Data.size();
+			level.m_Size = Ktx2::GetLevelSize(outImage.m_Format, levelWidth, levelHeight);
+			level.m_Width = levelWidth;
+			level.m_Height = levelHeight;
+		}
+
+		outImage.m_Data.resize(static_cast<size_t>(level.m_Offset + level.m_Size));
+		EncodeLevel(levelPixels, levelWidth, levelHeight, outImage.m_Format, outImage.m_Data.data() + level.m_Offset);
+		outImage.m_Levels.push_back(level);
+
+		if (levelIndex + 1 < levelsCount)
+		{
+			const uint32_t	nextWidth = std::max(levelWidth / 2, 1u);
+			const uint32_t	nextHeight = std::max(levelHeight / 2, 1u);
+
+			levelPixels = Downsample(levelPixels, levelWidth, levelHeight, nextWidth, nextHeight);
+			levelWidth = nextWidth;
+			levelHeight = nextHeight;
+		}
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	ConvertFile(const std::string &sourcePath, const std::string &destinationPath, TEXTURE_COMPRESSION compression)
+{
+	PROFILE_ZONE("Convert texture");
+
+	uint32_t				width = 0;
+	uint32_t				height = 0;
+	uint32_t				channel = 0;
+
+	std::vector<uint8_t>	pixels = LoadImageTextureWithSTB(sourcePath, &width, &height, &channel, 4);
+	if (pixels.empty())
+		return false;
+
+	Ktx2::Image				image;
+	if (!Encode(pixels, width, height, ChooseFormat(sourcePath, pixels, compression), image))
+		return false;
+
+	return Ktx2::Write(destinationPath, image);
+}
+
+//----------------------------------------------------------------
+
+uint32_t	ConvertFolder(const std::string &folderPath, TEXTURE_COMPRESSION compression)
+{
+	std::error_code		error;
+	uint32_t			convertedCount = 0;
+
+	std::filesystem::recursive_directory_iterator	fileIterator(folderPath, error);
+	if (error)
+	{
+		std::cout << "Can't open texture folder " << folderPath << std::endl; // TODO: change this for real logger
+		return 0;
+	}
+
+	for (const std::filesystem::directory_entry &entry : fileIterator)
+	{
+		if (!entry.is_regular_file(error) || !IsSourceImage(entry.path()))
+			continue;
+
+		std::filesystem::path	destinationPath = entry.path();
+		destinationPath.replace_extension(KTX2_EXTENSION);
+
+		// same rule as the loader, a conversion at least as recent as its source is kept
+		if (std::filesystem::exists(destinationPath, error) &&
+			std::filesystem::last_write_time(destinationPath, error) >= std::filesystem::last_write_time(entry.path(), error) && !error)
+			continue;
+
+		if (ConvertFile(entry.path().string(), destinationPath.string(), compression))
+			++convertedCount;
+		else
+			std::cout << "Can't convert texture " << entry.path().string() << std::endl; // TODO: change this for real logger
+	}
+
+	return convertedCount;
+}
+
+//----------------------------------------------------------------
+
+} // namespace TextureConverter
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
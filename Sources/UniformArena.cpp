@@ -0,0 +1,105 @@
+#include "UniformArena.h"
+
+#include <algorithm>
+
+#include "Device.h"
+#include "Buffer.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+UniformArena::UniformArena()
+:	m_Buffer(nullptr),
+	m_Size(0),
+	m_Alignment(1),
+	m_Head(0)
+{
+
+}
+
+//----------------------------------------------------------------
+
+UniformArena::~UniformArena()
+{
+
+}
+
+//----------------------------------------------------------------
+
+bool	UniformArena::Prepare(const VkDevice logicalDevice, VkDeviceSize size, VkDeviceSize alignment)
+{
+	m_Alignment = std::max(alignment, static_cast<VkDeviceSize>(1));
+	m_Size = GetAlignedSize(size);
+	m_Head = 0;
+
+	VkBufferCreateInfo		bufferCreateInfo = Initializers::Buffer::CreateInfo(BUFFER_TYPE::Uniform, m_Size);
+
+	CHECK_API_SUCCESS(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &m_Buffer)); // TODO: add error management
+
+	VkMemoryRequirements	memRequirements;
+	vkGetBufferMemoryRequirements(logicalDevice, m_Buffer, &memRequirements);
+
+	if (!Device::m_Device->GetMemoryAllocator()->Allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true, false, m_Allocation))
+	{
+		std::cout << "Can't allocate memory for uniform arena" << std::endl; // TODO: change this for real logger
+		return false;
+	}
+
+	CHECK_API_SUCCESS(vkBindBufferMemory(logicalDevice, m_Buffer, m_Allocation.m_Memory, m_Allocation.m_Offset));
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	UniformArena::Shutdown(const VkDevice logicalDevice)
+{
+	if (m_Buffer != nullptr)
+		vkDestroyBuffer(logicalDevice, m_Buffer, nullptr);
+
+	Device::m_Device->GetMemoryAllocator()->Free(m_Allocation);
+
+	m_Buffer = nullptr;
+	m_Size = 0;
+	m_Head = 0;
+}
+
+//----------------------------------------------------------------
+
+bool	UniformArena::Reserve(const VkDevice logicalDevice, VkDeviceSize size)
+{
+	if (size <= m_Size)
+		return true;
+
+	const VkDeviceSize	newSize = std::max(size, m_Size * 2);
+	const VkDeviceSize	alignment = m_Alignment;
+
+	Shutdown(logicalDevice);
+
+	return Prepare(logicalDevice, newSize, alignment);
+}
+
+//----------------------------------------------------------------
+
+void*	UniformArena::Allocate(VkDeviceSize size, uint32_t &outOffset)
+{
+	const VkDeviceSize	alignedSize = GetAlignedSize(size);
+
+	if (m_Head + alignedSize > m_Size)
+	{
+		std::cout << "Uniform arena full, " << alignedSize << " bytes requested" << std::endl; // TODO: change this for real logger
+		return nullptr;
+	}
+
+	outOffset = static_cast<uint32_t>(m_Head);
+	m_Head += alignedSize;
+
+	return static_cast<char*>(m_Allocation.m_MappedData) + outOffset;
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -0,0 +1,669 @@
+#include "UploadManager.h"
+
+#include "Device.h"
+#include "Buffer.h"
+#include "Texture.h"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+UploadBatch::UploadBatch()
+:	m_Id(0),
+	m_TransferBuffer(nullptr),
+	m_GraphicsBuffer(nullptr),
+	m_TransferSemaphore(nullptr),
+	m_Fence(nullptr),
+	m_StagingBuffers(std::vector<StagingBuffer>())
+{
+
+}
+
+//----------------------------------------------------------------
+
+UploadManager::UploadManager()
+:	m_LogicalDevice(nullptr),
+	m_GraphicsCommand(nullptr),
+	m_TransferCommand(nullptr),
+	m_PendingBatch(nullptr),
+	m_InFlightBatches(std::vector<UploadBatch*>()),
+	m_FreeBatches(std::vector<UploadBatch*>()),
+	m_NextBatchId(1),
+	m_CompletedBatchId(0)
+{
+
+}
+
+//----------------------------------------------------------------
+
+UploadManager::~UploadManager()
+{
+
+}
+
+//----------------------------------------------------------------
+
+bool	UploadManager::Setup(const std::vector<VkQueueFamilyProperties> &queuesFamilyProperties)
+{
+	m_GraphicsCommand = new RenderCommand(COMMAND_TYPE::GraphicsOp);
+	if (!m_GraphicsCommand->Setup(queuesFamilyProperties))
+		return false;
+
+	// fallback on the graphics queue when there is no dedicated transfer family
+	m_TransferCommand = new RenderCommand(COMMAND_TYPE::TransferOp);
+	if (!m_TransferCommand->Setup(queuesFamilyProperties) ||
+		m_TransferCommand->GetQueue().m_FamilyIndex == m_GraphicsCommand->GetQueue().m_FamilyIndex)
+	{
+		delete m_TransferCommand;
+		m_TransferCommand = m_GraphicsCommand;
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	UploadManager::Prepare(const VkDevice logicalDevice)
+{
+	m_LogicalDevice = logicalDevice;
+
+	if (!m_GraphicsCommand->Prepare(logicalDevice))
+		return false;
+
+	if (HasDedicatedTransfer() && !m_TransferCommand->Prepare(logicalDevice))
+		return false;
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	UploadManager::Shutdown()
+{
+	if (m_GraphicsCommand == nullptr)
+		return;
+
+	// nothing can be destroyed while uploads are still running
+	Wait(Flush());
+
+	const uint32_t	batchesCount = static_cast<uint32_t>(m_FreeBatches.size());
+	for (uint32_t batchIndex = 0; batchIndex < batchesCount; ++batchIndex)
+	{
+		UploadBatch	*batch = m_FreeBatches[batchIndex];
+
+		vkFreeCommandBuffers(m_LogicalDevice, m_TransferCommand->GetPool(), 1, &batch->m_TransferBuffer);
+
+		if (batch->m_GraphicsBuffer != nullptr)
+			vkFreeCommandBuffers(m_LogicalDevice, m_GraphicsCommand->GetPool(), 1, &batch->m_GraphicsBuffer);
+
+		if (batch->m_TransferSemaphore != nullptr)
+			vkDestroySemaphore(m_LogicalDevice, batch->m_TransferSemaphore, nullptr);
+
+		vkDestroyFence(m_LogicalDevice, batch->m_Fence, nullptr);
+
+		delete batch;
+	}
+
+	m_FreeBatches.clear();
+
+	if (HasDedicatedTransfer())
+	{
+		m_TransferCommand->Shutdown(m_LogicalDevice);
+		delete m_TransferCommand;
+	}
+
+	m_GraphicsCommand->Shutdown(m_LogicalDevice);
+	delete m_GraphicsCommand;
+
+	m_GraphicsCommand = nullptr;
+	m_TransferCommand = nullptr;
+}
+
+//----------------------------------------------------------------
+
+bool	UploadManager::UploadTexture(	const Texture &texture,
+										const std::vector<const void*> &layers,
+										VkDeviceSize layerSize,
+										VkImageSubresourceRange subRange,
+										bool generateMipmaps,
+										uint64_t &outBatchId)
+{
+	// before the pending batch is picked, making room may flush it
+	StagingBuffer				stagingBuffer;
+	if (!CreateStagingBuffer(layers, layerSize, stagingBuffer))
+		return false;
+
+	UploadBatch					*batch = GetPendingBatch();
+	batch->m_StagingBuffers.push_back(stagingBuffer);
+
+	const VkCommandBuffer		transferBuffer = batch->m_TransferBuffer;
+
+	VkImageMemoryBarrier		copyBarrier = { };
+	{
+		copyBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		copyBarrier.image = texture.m_Image;
+		copyBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		copyBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		copyBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		copyBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		copyBarrier.srcAccessMask = 0;
+		copyBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		copyBarrier.subresourceRange = subRange;
+	}
+
+	vkCmdPipelineBarrier(	transferBuffer,
+							VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+							VK_PIPELINE_STAGE_TRANSFER_BIT,
+							0,
+							0, nullptr,
+							0, nullptr,
+							1, &copyBarrier);
+
+	// one region per level stored in the pixels, layers are only ever uploaded with a single level,
+	// the layers data starts at the resident level which is the first mip of the image
+	const std::vector<Ktx2::Level>	&levels = texture.GetLevels();
+	const uint32_t					firstLevel = texture.m_ResidentLevel;
+	const uint32_t					levelsCount = static_cast<uint32_t>(levels.size()) - firstLevel;
+
+	std::vector<VkBufferImageCopy>	bufferImageCopies(levelsCount);
+	for (uint32_t levelIndex = 0; levelIndex < levelsCount; ++levelIndex)
+	{
+		const Ktx2::Level	&level = levels[firstLevel + levelIndex];
+
+		VkBufferImageCopy	&bufferImageCopy = bufferImageCopies[levelIndex];
+		{
+			bufferImageCopy.bufferOffset = level.m_Offset - levels[firstLevel].m_Offset;
+			bufferImageCopy.bufferRowLength = 0;
+			bufferImageCopy.bufferImageHeight = 0;
+			bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferImageCopy.imageSubresource.mipLevel = levelIndex;
+			bufferImageCopy.imageSubresource.baseArrayLayer = 0;
+			bufferImageCopy.imageSubresource.layerCount = subRange.layerCount;
+			bufferImageCopy.imageOffset = { 0, 0, 0 };
+			bufferImageCopy.imageExtent = { level.m_Width, level.m_Height, 1 };
+		}
+	}
+
+	vkCmdCopyBufferToImage(	transferBuffer,
+							stagingBuffer.m_Buffer,
+							texture.m_Image,
+							VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+							levelsCount,
+							bufferImageCopies.data());
+
+	if (HasDedicatedTransfer())
+	{
+		// release on the transfer queue then acquire on the graphics queue with the same barrier,
+		// the layout transition happens once between both
+		VkImageMemoryBarrier	ownershipBarrier = { };
+		{
+			ownershipBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			ownershipBarrier.image = texture.m_Image;
+			ownershipBarrier.srcQueueFamilyIndex = GetTransferFamilyIndex();
+			ownershipBarrier.dstQueueFamilyIndex = GetGraphicsFamilyIndex();
+			ownershipBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			ownershipBarrier.newLayout = (generateMipmaps) ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			ownershipBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			ownershipBarrier.dstAccessMask = 0;
+			ownershipBarrier.subresourceRange = subRange;
+		}
+
+		vkCmdPipelineBarrier(	transferBuffer,
+								VK_PIPELINE_STAGE_TRANSFER_BIT,
+								VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+								0,
+								0, nullptr,
+								0, nullptr,
+								1, &ownershipBarrier);
+
+		{
+			ownershipBarrier.srcAccessMask = 0;
+			ownershipBarrier.dstAccessMask = (generateMipmaps) ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+		}
+
+		vkCmdPipelineBarrier(	batch->m_GraphicsBuffer,
+								VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+								(generateMipmaps) ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+								0,
+								0, nullptr,
+								0, nullptr,
+								1, &ownershipBarrier);
+
+		// blits need a graphics queue
+		if (generateMipmaps)
+			RecordMipmaps(batch->m_GraphicsBuffer, texture, subRange);
+	}
+	else if (generateMipmaps)
+	{
+		RecordMipmaps(transferBuffer, texture, subRange);
+	}
+	else
+	{
+		{
+			copyBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			copyBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			copyBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			copyBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		}
+
+		vkCmdPipelineBarrier(	transferBuffer,
+								VK_PIPELINE_STAGE_TRANSFER_BIT,
+								VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+								0,
+								0, nullptr,
+								0, nullptr,
+								1, &copyBarrier);
+	}
+
+	outBatchId = batch->m_Id;
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+bool	UploadManager::UploadBuffer(const VkBuffer buffer,
+									const void *data,
+									VkDeviceSize size,
+									VkAccessFlags dstAccess,
+									VkPipelineStageFlags dstStage,
+									VkDeviceSize dstOffset)
+{
+	// before the pending batch is picked, making room may flush it
+	StagingBuffer				stagingBuffer;
+	if (!CreateStagingBuffer({ data }, size, stagingBuffer))
+		return false;
+
+	UploadBatch					*batch = GetPendingBatch();
+	batch->m_StagingBuffers.push_back(stagingBuffer);
+
+	VkBufferCopy				bufferCopy = { };
+	{
+		bufferCopy.srcOffset = 0;
+		bufferCopy.dstOffset = dstOffset;
+		bufferCopy.size = size;
+	}
+
+	vkCmdCopyBuffer(batch->m_TransferBuffer, stagingBuffer.m_Buffer, buffer, 1, &bufferCopy);
+
+	VkBufferMemoryBarrier		bufferBarrier = { };
+	{
+		bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		bufferBarrier.buffer = buffer;
+		bufferBarrier.offset = dstOffset;
+		bufferBarrier.size = size;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = dstAccess;
+	}
+
+	if (HasDedicatedTransfer())
+	{
+		// release then acquire, same as textures
+		{
+			bufferBarrier.srcQueueFamilyIndex = GetTransferFamilyIndex();
+			bufferBarrier.dstQueueFamilyIndex = GetGraphicsFamilyIndex();
+			bufferBarrier.dstAccessMask = 0;
+		}
+
+		vkCmdPipelineBarrier(	batch->m_TransferBuffer,
+								VK_PIPELINE_STAGE_TRANSFER_BIT,
+								VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+								0,
+								0, nullptr,
+								1, &bufferBarrier,
+								0, nullptr);
+
+		{
+			bufferBarrier.srcAccessMask = 0;
+			bufferBarrier.dstAccessMask = dstAccess;
+		}
+
+		vkCmdPipelineBarrier(	batch->m_GraphicsBuffer,
+								VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+								dstStage,
+								0,
+								0, nullptr,
+								1, &bufferBarrier,
+								0, nullptr);
+	}
+	else
+	{
+		vkCmdPipelineBarrier(	batch->m_TransferBuffer,
+								VK_PIPELINE_STAGE_TRANSFER_BIT,
+								dstStage,
+								0,
+								0, nullptr,
+								1, &bufferBarrier,
+								0, nullptr);
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+uint64_t	UploadManager::Flush()
+{
+	if (m_PendingBatch == nullptr)
+		return m_NextBatchId - 1;
+
+	UploadBatch			*batch = m_PendingBatch;
+	m_PendingBatch = nullptr;
+
+	CHECK_API_SUCCESS(vkEndCommandBuffer(batch->m_TransferBuffer));
+	CHECK_API_SUCCESS(vkResetFences(m_LogicalDevice, 1, &batch->m_Fence));
+
+	VkSubmitInfo		transferSubmitInfo = { };
+	{
+		transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		transferSubmitInfo.commandBufferCount = 1;
+		transferSubmitInfo.pCommandBuffers = &batch->m_TransferBuffer;
+	}
+
+	if (HasDedicatedTransfer())
+	{
+		CHECK_API_SUCCESS(vkEndCommandBuffer(batch->m_GraphicsBuffer));
+
+		{
+			transferSubmitInfo.signalSemaphoreCount = 1;
+			transferSubmitInfo.pSignalSemaphores = &batch->m_TransferSemaphore;
+		}
+
+		CHECK_API_SUCCESS(vkQueueSubmit(m_TransferCommand->GetQueue().m_ApiQueue, 1, &transferSubmitInfo, VK_NULL_HANDLE));
+
+		// acquire barriers wait for the copies through the semaphore
+		const VkPipelineStageFlags	waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkSubmitInfo				graphicsSubmitInfo = { };
+		{
+			graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			graphicsSubmitInfo.waitSemaphoreCount = 1;
+			graphicsSubmitInfo.pWaitSemaphores = &batch->m_TransferSemaphore;
+			graphicsSubmitInfo.pWaitDstStageMask = &waitStage;
+			graphicsSubmitInfo.commandBufferCount = 1;
+			graphicsSubmitInfo.pCommandBuffers = &batch->m_GraphicsBuffer;
+		}
+
+		CHECK_API_SUCCESS(vkQueueSubmit(m_GraphicsCommand->GetQueue().m_ApiQueue, 1, &graphicsSubmitInfo, batch->m_Fence));
+	}
+	else
+	{
+		CHECK_API_SUCCESS(vkQueueSubmit(m_GraphicsCommand->GetQueue().m_ApiQueue, 1, &transferSubmitInfo, batch->m_Fence));
+	}
+
+	m_InFlightBatches.push_back(batch);
+
+	return batch->m_Id;
+}
+
+//----------------------------------------------------------------
+
+void	UploadManager::Update()
+{
+	// batches are completed in submission order, stop at the first one still running
+	while (!m_InFlightBatches.empty())
+	{
+		UploadBatch	*batch = m_InFlightBatches.front();
+
+		if (vkGetFenceStatus(m_LogicalDevice, batch->m_Fence) != VK_SUCCESS)
+			break;
+
+		m_CompletedBatchId = batch->m_Id;
+
+		ReleaseBatch(batch);
+
+		m_InFlightBatches.erase(m_InFlightBatches.begin());
+	}
+}
+
+//----------------------------------------------------------------
+
+void	UploadManager::Wait(uint64_t batchId)
+{
+	if (IsComplete(batchId))
+		return;
+
+	if (m_PendingBatch != nullptr && m_PendingBatch->m_Id <= batchId)
+		Flush();
+
+	const uint32_t	batchesCount = static_cast<uint32_t>(m_InFlightBatches.size());
+	for (uint32_t batchIndex = 0; batchIndex < batchesCount; ++batchIndex)
+	{
+		const UploadBatch	*batch = m_InFlightBatches[batchIndex];
+
+		if (batch->m_Id > batchId)
+			break;
+
+		CHECK_API_SUCCESS(vkWaitForFences(m_LogicalDevice, 1, &batch->m_Fence, VK_TRUE, UINT64_MAX));
+	}
+
+	Update();
+}
+
+//----------------------------------------------------------------
+
+UploadBatch*	UploadManager::GetPendingBatch()
+{
+	if (m_PendingBatch != nullptr)
+		return m_PendingBatch;
+
+	UploadBatch		*batch = nullptr;
+
+	if (!m_FreeBatches.empty())
+	{
+		batch = m_FreeBatches.back();
+		m_FreeBatches.pop_back();
+	}
+	else
+	{
+		batch = new UploadBatch();
+
+		VkCommandBufferAllocateInfo	commandBufferAllocateInfo = Initializers::Command::BufferAllocateInfo(m_TransferCommand->GetPool(), 0, 1);
+		CHECK_API_SUCCESS(vkAllocateCommandBuffers(m_LogicalDevice, &commandBufferAllocateInfo, &batch->m_TransferBuffer)); // TODO: add error management
+
+		if (HasDedicatedTransfer())
+		{
+			commandBufferAllocateInfo = Initializers::Command::BufferAllocateInfo(m_GraphicsCommand->GetPool(), 0, 1);
+			CHECK_API_SUCCESS(vkAllocateCommandBuffers(m_LogicalDevice, &commandBufferAllocateInfo, &batch->m_GraphicsBuffer)); // TODO: add error management
+
+			VkSemaphoreCreateInfo	semaphoreCreateInfo = Initializers::Semaphore::CreateInfo();
+			CHECK_API_SUCCESS(vkCreateSemaphore(m_LogicalDevice, &semaphoreCreateInfo, nullptr, &batch->m_TransferSemaphore));
+		}
+
+		VkFenceCreateInfo			fenceCreateInfo = Initializers::Fence::CreateInfo();
+		CHECK_API_SUCCESS(vkCreateFence(m_LogicalDevice, &fenceCreateInfo, nullptr, &batch->m_Fence));
+	}
+
+	batch->m_Id = m_NextBatchId++;
+
+	VkCommandBufferBeginInfo	beginInfo = { };
+	{
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	}
+
+	CHECK_API_SUCCESS(vkBeginCommandBuffer(batch->m_TransferBuffer, &beginInfo));
+
+	if (batch->m_GraphicsBuffer != nullptr)
+		CHECK_API_SUCCESS(vkBeginCommandBuffer(batch->m_GraphicsBuffer, &beginInfo));
+
+	m_PendingBatch = batch;
+
+	return batch;
+}
+
+//----------------------------------------------------------------
+
+bool	UploadManager::CreateStagingBuffer(const std::vector<const void*> &data, VkDeviceSize dataSize, StagingBuffer &outStagingBuffer)
+{
+	const uint32_t			dataCount = static_cast<uint32_t>(data.size());
+
+	VkBufferCreateInfo		bufferCreateInfo = Initializers::Buffer::CreateInfo(BUFFER_TYPE::TransferSource, dataSize * dataCount);
+
+	if (vkCreateBuffer(m_LogicalDevice, &bufferCreateInfo, nullptr, &outStagingBuffer.m_Buffer) != VK_SUCCESS)
+	{
+		std::cout << "Can't create staging buffer" << std::endl; // TODO: change this for real logger
+		return false;
+	}
+
+	VkMemoryRequirements	memRequirements;
+	vkGetBufferMemoryRequirements(m_LogicalDevice, outStagingBuffer.m_Buffer, &memRequirements);
+
+	MemoryAllocator			*memoryAllocator = Device::m_Device->GetMemoryAllocator();
+	const VkMemoryPropertyFlags	memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	bool					isAllocated = memoryAllocator->Allocate(memRequirements, memoryProperties, true, false, outStagingBuffer.m_Allocation);
+
+	// staging memory only comes back once its batch completed, submit what is pending, wait for everything and retry once
+	if (!isAllocated && (m_PendingBatch != nullptr || !m_InFlightBatches.empty()))
+	{
+		Wait(Flush());
+
+		isAllocated = memoryAllocator->Allocate(memRequirements, memoryProperties, true, false, outStagingBuffer.m_Allocation);
+	}
+
+	if (!isAllocated)
+	{
+		std::cout << "Can't allocate memory for staging buffer of " << memRequirements.size << " bytes" << std::endl; // TODO: change this for real logger
+
+		vkDestroyBuffer(m_LogicalDevice, outStagingBuffer.m_Buffer, nullptr);
+		outStagingBuffer = StagingBuffer();
+
+		return false;
+	}
+
+	CHECK_API_SUCCESS(vkBindBufferMemory(m_LogicalDevice, outStagingBuffer.m_Buffer, outStagingBuffer.m_Allocation.m_Memory, outStagingBuffer.m_Allocation.m_Offset));
+
+	char					*mappedData = static_cast<char*>(outStagingBuffer.m_Allocation.m_MappedData);
+
+	for (uint32_t dataIndex = 0; dataIndex < dataCount; ++dataIndex)
+		memcpy(mappedData + dataSize * dataIndex, data[dataIndex], static_cast<size_t>(dataSize));
+
+	return true;
+}
+
+//----------------------------------------------------------------
+
+void	UploadManager::ReleaseBatch(UploadBatch *batch)
+{
+	const uint32_t	stagingBuffersCount = static_cast<uint32_t>(batch->m_StagingBuffers.size());
+	for (uint32_t stagingBufferIndex = 0; stagingBufferIndex < stagingBuffersCount; ++stagingBufferIndex)
+	{
+		vkDestroyBuffer(m_LogicalDevice, batch->m_StagingBuffers[stagingBufferIndex].m_Buffer, nullptr);
+		Device::m_Device->GetMemoryAllocator()->Free(batch->m_StagingBuffers[stagingBufferIndex].m_Allocation);
+	}
+
+	batch->m_StagingBuffers.clear();
+
+	m_FreeBatches.push_back(batch);
+}
+
+//----------------------------------------------------------------
+
+void	UploadManager::RecordMipmaps(const VkCommandBuffer commandBuffer, const Texture &texture, VkImageSubresourceRange subRange)
+{
+	const uint32_t	textureWidth = texture.GetWidth();
+	const uint32_t	textureHeight = texture.GetHeight();
+
+	for (uint32_t mipmapLevel = 1; mipmapLevel < texture.GetMipmapLevels(); ++mipmapLevel)
+	{
+		VkImageBlit				blitImage = { };
+
+		// source image
+		blitImage.srcOffsets[0] = { 0, 0, 0 };
+		blitImage.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blitImage.srcSubresource.baseArrayLayer = 0;
+		blitImage.srcSubresource.layerCount = 1;
+		// -1 to get previous image
+		blitImage.srcSubresource.mipLevel = mipmapLevel - 1;
+		blitImage.srcOffsets[1] = { static_cast<int32_t>(textureWidth >> (mipmapLevel - 1)), static_cast<int32_t>(textureHeight >> (mipmapLevel - 1)), 1 };
+
+		// destination image
+		blitImage.dstOffsets[0] = { 0, 0, 0 };
+		blitImage.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blitImage.dstSubresource.baseArrayLayer = 0;
+		blitImage.dstSubresource.layerCount = 1;
+		blitImage.dstSubresource.mipLevel = mipmapLevel;
+		blitImage.dstOffsets[1] = { static_cast<int32_t>(textureWidth >> (mipmapLevel)), static_cast<int32_t>(textureHeight >> (mipmapLevel)), 1 };
+
+		subRange.baseMipLevel = mipmapLevel - 1;
+		subRange.levelCount = 1;
+
+		VkImageMemoryBarrier	mipmapBarrier = { };
+		{
+			mipmapBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			mipmapBarrier.image = texture.m_Image;
+			mipmapBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			mipmapBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			mipmapBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			mipmapBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			mipmapBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			mipmapBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			mipmapBarrier.subresourceRange = subRange;
+		}
+
+		vkCmdPipelineBarrier(	commandBuffer,
+								VK_PIPELINE_STAGE_TRANSFER_BIT,
+								VK_PIPELINE_STAGE_TRANSFER_BIT,
+								0,
+								0, nullptr,
+								0, nullptr,
+								1, &mipmapBarrier);
+
+		vkCmdBlitImage(	commandBuffer,
+						texture.m_Image,
+						VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						texture.m_Image,
+						VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						1, &blitImage,
+						VK_FILTER_LINEAR);
+
+		{
+			mipmapBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			mipmapBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			mipmapBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			mipmapBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		}
+
+		vkCmdPipelineBarrier(	commandBuffer,
+								VK_PIPELINE_STAGE_TRANSFER_BIT,
+								VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+								0,
+								0, nullptr,
+								0, nullptr,
+								1, &mipmapBarrier);
+	}
+
+	// last level is never used as a blit source
+	subRange.baseMipLevel = texture.GetMipmapLevels() - 1;
+	subRange.levelCount = 1;
+
+	VkImageMemoryBarrier		lastLevelBarrier = { };
+	{
+		lastLevelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		lastLevelBarrier.image = texture.m_Image;
+		lastLevelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		lastLevelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		lastLevelBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		lastLevelBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		lastLevelBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		lastLevelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		lastLevelBarrier.subresourceRange = subRange;
+	}
+
+	vkCmdPipelineBarrier(	commandBuffer,
+							VK_PIPELINE_STAGE_TRANSFER_BIT,
+							VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+							0,
+							0, nullptr,
+							0, nullptr,
+							1, &lastLevelBarrier);
+}
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
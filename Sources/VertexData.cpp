@@ -0,0 +1,123 @@
+#include "VertexData.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "glm/gtc/packing.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+//----------------------------------------------------------------
+
+LIGHTLYY_BEGIN
+
+//----------------------------------------------------------------
+
+namespace VertexFormat
+{
+
+//----------------------------------------------------------------
+
+namespace
+{
+	// same scale on every axis, normals stay orthogonal to the surface under the dequantization
+	float	GetQuantizationScale(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+	{
+		const glm::vec3	extent = boundsMax - boundsMin;
+		const float		scale = std::max(std::max(extent.x, extent.y), extent.z);
+
+		return (scale > 0.f) ? scale : 1.f;
+	}
+
+	void	EncodeAttributes(const VertexData &vertex, CompactAttributeData &outAttributes)
+	{
+		const float		normalLength = glm::length(vertex.m_Normal);
+		const glm::vec3	normal = (normalLength > 0.f) ? vertex.m_Normal / normalLength : glm::vec3(0.f);
+
+		outAttributes.m_TexCoord.m_Packed = glm::packHalf2x16(vertex.m_TexCoord);
+		outAttributes.m_Normal.m_Packed = glm::packSnorm4x8(glm::vec4(normal, 0.f));
+		outAttributes.m_Color.m_Packed = glm::packUnorm4x8(vertex.m_Color);
+	}
+}
+
+//----------------------------------------------------------------
+
+uint32_t	GetPositionStride(VERTEX_LAYOUT layout)
+{
+	return (layout == VERTEX_LAYOUT::Quantized) ? sizeof(QuantizedShadowData) : sizeof(ShadowData);
+}
+
+//----------------------------------------------------------------
+
+uint32_t	GetAttributeStride(VERTEX_LAYOUT layout)
+{
+	return (layout == VERTEX_LAYOUT::Full) ? sizeof(AttributeData) : sizeof(CompactAttributeData);
+}
+
+//----------------------------------------------------------------
+
+glm::mat4	GetDequantization(VERTEX_LAYOUT layout, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	if (layout != VERTEX_LAYOUT::Quantized)
+		return glm::mat4(1.f);
+
+	const glm::mat4	translation = glm::translate(glm::mat4(1.f), boundsMin);
+
+	return glm::scale(translation, glm::vec3(GetQuantizationScale(boundsMin, boundsMax)));
+}
+
+//----------------------------------------------------------------
+
+void	Encode(	VERTEX_LAYOUT layout, const VertexData *vertices, uint32_t verticesCount, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+				std::vector<uint8_t> &outPositions, std::vector<uint8_t> &outAttributes)
+{
+	outPositions.resize(static_cast<size_t>(verticesCount) * GetPositionStride(layout));
+	outAttributes.resize(static_cast<size_t>(verticesCount) * GetAttributeStride(layout));
+
+	if (layout == VERTEX_LAYOUT::Quantized)
+	{
+		QuantizedShadowData	*positions = reinterpret_cast<QuantizedShadowData*>(outPositions.data());
+		const float			inverseScale = 1.f / GetQuantizationScale(boundsMin, boundsMax);
+
+		for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+		{
+			const glm::vec3	position = (vertices[vertexIndex].m_Pos - boundsMin) * inverseScale;
+			const uint64_t	packedPosition = glm::packUnorm4x16(glm::vec4(position, 1.f));
+
+			memcpy(positions[vertexIndex].m_Pos.m_Packed, &packedPosition, sizeof(UNorm16x4));
+		}
+	}
+	else
+	{
+		ShadowData	*positions = reinterpret_cast<ShadowData*>(outPositions.data());
+
+		for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+			positions[vertexIndex].m_Pos = vertices[vertexIndex].m_Pos;
+	}
+
+	if (layout == VERTEX_LAYOUT::Full)
+	{
+		AttributeData	*attributes = reinterpret_cast<AttributeData*>(outAttributes.data());
+
+		for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+		{
+			attributes[vertexIndex].m_TexCoord = vertices[vertexIndex].m_TexCoord;
+			attributes[vertexIndex].m_Normal = vertices[vertexIndex].m_Normal;
+			attributes[vertexIndex].m_Color = vertices[vertexIndex].m_Color;
+		}
+	}
+	else
+	{
+		CompactAttributeData	*attributes = reinterpret_cast<CompactAttributeData*>(outAttributes.data());
+
+		for (uint32_t vertexIndex = 0; vertexIndex < verticesCount; ++vertexIndex)
+			EncodeAttributes(vertices[vertexIndex], attributes[vertexIndex]);
+	}
+}
+
+//----------------------------------------------------------------
+
+} // namespace VertexFormat
+
+//----------------------------------------------------------------
+
+LIGHTLYY_END
@@ -1,6 +1,7 @@
 #include "Window.h"
 
 #include "Device.h"
+#include "CpuProfiler.h"
 
 //----------------------------------------------------------------
 
@@ -14,6 +15,8 @@ Window::Window()
 {
 	m_CameraX = 0.f;
 	m_CameraY = 0.f;
+
+	m_TraceKeyPressed = false;
 }
 
 //----------------------------------------------------------------
@@ -51,6 +54,8 @@ bool	Window::Setup(const char* applicationName)
 
 void	Window::RetrieveInputs()
 {
+	PROFILE_ZONE("Window::RetrieveInputs");
+
 	// TODO: make correct class Input
 	double		mouseX;
 	double		mouseY;
@@ -100,6 +105,13 @@ void	Window::RetrieveInputs()
 		m_Camera->SetRotation(glm::toQuat(glm::orientate3(eulerAngles)));
 	}
 
+	// dump the CPU zones of the last frames on release of F9
+	const bool	traceKeyPressed = glfwGetKey(m_ApiWindow, GLFW_KEY_F9) == GLFW_PRESS;
+	if (m_TraceKeyPressed && !traceKeyPressed)
+		CpuProfiler::m_Profiler.DumpChromeTrace(CPU_PROFILER_TRACE_PATH, CPU_PROFILER_DUMP_FRAMES);
+
+	m_TraceKeyPressed = traceKeyPressed;
+
 	m_PreviousMousePosition = { static_cast<float>(mouseX), static_cast<float>(mouseY) };
 
 	glfwPollEvents();
@@ -114,10 +126,12 @@ bool	Window::IsClosed() const
 
 //----------------------------------------------------------------
 
+#if defined(_WIN32)
 HWND	Window::GetWindowHandle() const
 {
 	return glfwGetWin32Window(m_ApiWindow);
 }
+#endif
 
 //----------------------------------------------------------------
 
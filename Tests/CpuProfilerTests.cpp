@@ -0,0 +1,148 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "CpuProfiler.h"
+
+#include "TestFramework.h"
+
+//----------------------------------------------------------------
+
+using namespace Lightlyy;
+
+//----------------------------------------------------------------
+
+#define CPU_PROFILER_TEST_TRACE_PATH "cpu_profiler_test.json"
+
+//----------------------------------------------------------------
+
+namespace
+{
+	// the profiler is a global, each test records in frames of its own and dumps only those
+	std::string		DumpTrace(uint32_t framesCount)
+	{
+		if (!TEST_CHECK(CpuProfiler::m_Profiler.DumpChromeTrace(CPU_PROFILER_TEST_TRACE_PATH, framesCount)))
+			return std::string();
+
+		std::ifstream		file(CPU_PROFILER_TEST_TRACE_PATH);
+		std::stringstream	content;
+		content << file.rdbuf();
+
+		return content.str();
+	}
+
+	//----------------------------------------------------------------
+
+	uint32_t		CountOccurrences(const std::string &text, const std::string &pattern)
+	{
+		uint32_t	occurrencesCount = 0;
+		for (size_t position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + pattern.size()))
+			++occurrencesCount;
+
+		return occurrencesCount;
+	}
+
+	//----------------------------------------------------------------
+
+	uint32_t		CountZones(const std::string &trace)
+	{
+		return CountOccurrences(trace, "\"ph\":\"X\"");
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestRingOverwritesOldest()
+	{
+		CpuProfiler::m_Profiler.SetFrame(1000);
+
+		for (uint32_t eventIndex = 0; eventIndex < 100; ++eventIndex)
+			CpuProfiler::m_Profiler.Record("Overwritten", eventIndex, eventIndex + 1);
+
+		for (uint32_t eventIndex = 0; eventIndex < CPU_PROFILER_EVENTS_PER_THREAD; ++eventIndex)
+			CpuProfiler::m_Profiler.Record("Kept", eventIndex, eventIndex + 1);
+
+		const std::string	trace = DumpTrace(0);
+
+		TEST_CHECK(CountZones(trace) == CPU_PROFILER_EVENTS_PER_THREAD);
+		TEST_CHECK(CountOccurrences(trace, "\"Kept\"") == CPU_PROFILER_EVENTS_PER_THREAD);
+		TEST_CHECK(CountOccurrences(trace, "\"Overwritten\"") == 0);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestLastFramesOnly()
+	{
+		for (uint64_t frame = 2000; frame < 2010; ++frame)
+		{
+			CpuProfiler::m_Profiler.SetFrame(frame);
+
+			for (uint32_t eventIndex = 0; eventIndex < 10; ++eventIndex)
+				CpuProfiler::m_Profiler.Record("Frame", eventIndex, eventIndex + 1);
+		}
+
+		// the current frame and the 3 before it
+		TEST_CHECK(CountZones(DumpTrace(3)) == 40);
+		TEST_CHECK(CountOccurrences(DumpTrace(3), "\"frame\":2005") == 0);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestDisabled()
+	{
+		CpuProfiler::m_Profiler.SetFrame(3000);
+		CpuProfiler::m_Profiler.SetEnabled(false);
+
+		for (uint32_t zoneIndex = 0; zoneIndex < 10; ++zoneIndex)
+		{
+			PROFILE_ZONE("Disabled");
+		}
+
+		CpuProfiler::m_Profiler.SetEnabled(true);
+
+		{
+			PROFILE_ZONE("Enabled");
+		}
+
+		const std::string	trace = DumpTrace(0);
+
+		TEST_CHECK(CountZones(trace) == 1);
+		TEST_CHECK(CountOccurrences(trace, "\"Enabled\"") == 1);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestThreads()
+	{
+		CpuProfiler::m_Profiler.SetFrame(4000);
+
+		std::thread	worker([]()
+		{
+			CpuProfiler::m_Profiler.SetThreadName("Worker");
+
+			for (uint32_t eventIndex = 0; eventIndex < 5; ++eventIndex)
+				CpuProfiler::m_Profiler.Record("Worker \"zone\"", eventIndex, eventIndex + 1);
+		});
+		worker.join();
+
+		CpuProfiler::m_Profiler.Record("Main", 0, 1);
+		CpuProfiler::m_Profiler.Record("Main", 1, 2);
+
+		const std::string	trace = DumpTrace(0);
+
+		// each thread writes its own buffer, names are escaped
+		TEST_CHECK(CountZones(trace) == 7);
+		TEST_CHECK(CountOccurrences(trace, "\"args\":{\"name\":\"Worker\"}") == 1);
+		TEST_CHECK(CountOccurrences(trace, "\"Worker \\\"zone\\\"\"") == 5);
+	}
+}
+
+//----------------------------------------------------------------
+
+int		main()
+{
+	return TestFramework::Run({	{ "CpuProfiler ring overwrites the oldest zones", TestRingOverwritesOldest },
+								{ "CpuProfiler last frames only", TestLastFramesOnly },
+								{ "CpuProfiler disabled", TestDisabled },
+								{ "CpuProfiler threads", TestThreads } });
+}
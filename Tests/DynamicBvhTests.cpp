@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "Tools/DynamicBvh.h"
+
+#include "TestFramework.h"
+
+//----------------------------------------------------------------
+
+using namespace Lightlyy;
+
+//----------------------------------------------------------------
+
+namespace
+{
+	// tight boxes of the proxies next to the tree, the queries must find every box the brute force finds
+	struct Scene
+	{
+		std::vector<uint32_t>	m_Proxies;
+		std::vector<glm::vec3>	m_Mins;
+		std::vector<glm::vec3>	m_Maxs;
+		std::vector<bool>		m_Alive;
+	}; // struct Scene
+
+	//----------------------------------------------------------------
+
+	void	Populate(DynamicBvh &bvh, Scene &scene, uint32_t operationsCount)
+	{
+		std::mt19937							random(1);
+		std::uniform_real_distribution<float>	position(0.f, 50.f);
+		std::uniform_real_distribution<float>	size(0.1f, 3.f);
+		std::uniform_real_distribution<float>	move(-2.5f, 2.5f);
+
+		for (uint32_t operationIndex = 0; operationIndex < operationsCount; ++operationIndex)
+		{
+			const uint32_t	operation = random() % 4;
+
+			if (operation < 2 || scene.m_Proxies.empty())
+			{
+				const glm::vec3	boundsMin(position(random), position(random), position(random));
+				const glm::vec3	boundsMax = boundsMin + glm::vec3(size(random), size(random), size(random));
+
+				// user data is the index in the scene plus one, so that it is never null
+				scene.m_Proxies.push_back(bvh.Insert(boundsMin, boundsMax, reinterpret_cast<void*>(static_cast<uintptr_t>(scene.m_Mins.size() + 1))));
+				scene.m_Mins.push_back(boundsMin);
+				scene.m_Maxs.push_back(boundsMax);
+				scene.m_Alive.push_back(true);
+				continue;
+			}
+
+			const uint32_t	objectIndex = random() % static_cast<uint32_t>(scene.m_Proxies.size());
+			if (!scene.m_Alive[objectIndex])
+				continue;
+
+			if (operation == 2)
+			{
+				bvh.Remove(scene.m_Proxies[objectIndex]);
+				scene.m_Alive[objectIndex] = false;
+			}
+			else
+			{
+				const glm::vec3	offset(move(random), move(random), move(random));
+
+				scene.m_Mins[objectIndex] += offset;
+				scene.m_Maxs[objectIndex] += offset;
+				bvh.Update(scene.m_Proxies[objectIndex], scene.m_Mins[objectIndex], scene.m_Maxs[objectIndex]);
+			}
+
+			if (operationIndex % 500 == 0)
+				bvh.RebuildIfDegraded();
+		}
+	}
+
+	//----------------------------------------------------------------
+
+	// scene index of each found proxy, every one of them must be alive and found once
+	std::vector<bool>	GetFound(const DynamicBvh &bvh, const Scene &scene, const std::vector<uint32_t> &proxies)
+	{
+		std::vector<bool>	found(scene.m_Mins.size(), false);
+
+		for (const uint32_t proxy : proxies)
+		{
+			const size_t	objectIndex = reinterpret_cast<uintptr_t>(bvh.GetUserData(proxy)) - 1;
+
+			if (!TEST_CHECK(objectIndex < scene.m_Mins.size()))
+				continue;
+
+			TEST_CHECK(scene.m_Alive[objectIndex]);
+			TEST_CHECK(!found[objectIndex]);
+			found[objectIndex] = true;
+		}
+
+		return found;
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestInsertRemoveUpdate()
+	{
+		DynamicBvh	bvh;
+		Scene		scene;
+
+		Populate(bvh, scene, 20000);
+
+		const uint32_t	aliveCount = static_cast<uint32_t>(std::count(scene.m_Alive.begin(), scene.m_Alive.end(), true));
+		TEST_CHECK(bvh.GetProxiesCount() == aliveCount);
+
+		// a query containing everything finds every alive proxy
+		std::vector<uint32_t>	proxies;
+		bvh.QueryAabb(glm::vec3(-1000.f), glm::vec3(1000.f), proxies);
+		TEST_CHECK(proxies.size() == aliveCount);
+
+		const std::vector<bool>	found = GetFound(bvh, scene, proxies);
+		TEST_CHECK(std::equal(found.begin(), found.end(), scene.m_Alive.begin()));
+
+		// the fat boxes hold the tight ones
+		for (size_t objectIndex = 0; objectIndex < scene.m_Mins.size(); ++objectIndex)
+		{
+			if (!scene.m_Alive[objectIndex])
+				continue;
+
+			const uint32_t	proxy = scene.m_Proxies[objectIndex];
+			TEST_CHECK(glm::all(glm::lessThanEqual(bvh.GetFatMin(proxy), scene.m_Mins[objectIndex])));
+			TEST_CHECK(glm::all(glm::greaterThanEqual(bvh.GetFatMax(proxy), scene.m_Maxs[objectIndex])));
+		}
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestQuerySphereAndAabb()
+	{
+		DynamicBvh	bvh;
+		Scene		scene;
+
+		Populate(bvh, scene, 5000);
+
+		std::mt19937							random(2);
+		std::uniform_real_distribution<float>	position(0.f, 50.f);
+
+		for (uint32_t queryIndex = 0; queryIndex < 200; ++queryIndex)
+		{
+			const glm::vec3			center(position(random), position(random), position(random));
+			const float				radius = 5.f;
+
+			std::vector<uint32_t>	proxies;
+			bvh.QuerySphere(center, radius, proxies);
+
+			const std::vector<bool>	foundInSphere = GetFound(bvh, scene, proxies);
+
+			const glm::vec3			boundsMin = center;
+			const glm::vec3			boundsMax = center + glm::vec3(6.f);
+
+			proxies.clear();
+			bvh.QueryAabb(boundsMin, boundsMax, proxies);
+
+			const std::vector<bool>	foundInAabb = GetFound(bvh, scene, proxies);
+
+			for (size_t objectIndex = 0; objectIndex < scene.m_Mins.size(); ++objectIndex)
+			{
+				if (!scene.m_Alive[objectIndex])
+					continue;
+
+				const glm::vec3	&objectMin = scene.m_Mins[objectIndex];
+				const glm::vec3	&objectMax = scene.m_Maxs[objectIndex];
+
+				const glm::vec3	closest = glm::max(objectMin, glm::min(center, objectMax)) - center;
+				if (glm::dot(closest, closest) <= radius * radius)
+					TEST_CHECK(foundInSphere[objectIndex]);
+
+				if (glm::all(glm::lessThanEqual(boundsMin, objectMax)) && glm::all(glm::lessThanEqual(objectMin, boundsMax)))
+					TEST_CHECK(foundInAabb[objectIndex]);
+			}
+		}
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestQueryFrustum()
+	{
+		DynamicBvh	bvh;
+		Scene		scene;
+
+		Populate(bvh, scene, 5000);
+
+		const glm::mat4	projection = glm::perspectiveRH_ZO(glm::radians(60.f), 16.f / 9.f, 0.1f, 40.f);
+		const glm::mat4	view = glm::lookAt(glm::vec3(-10.f, 25.f, -10.f), glm::vec3(25.f), glm::vec3(0.f, 1.f, 0.f));
+
+		const CullingView		cullingView = FrustumCulling::MakeView(projection * view, 720.f, 0.f);
+
+		std::vector<uint32_t>	proxies;
+		bvh.QueryFrustum(cullingView, proxies);
+
+		const std::vector<bool>	found = GetFound(bvh, scene, proxies);
+
+		uint32_t				insideCount = 0;
+		for (size_t objectIndex = 0; objectIndex < scene.m_Mins.size(); ++objectIndex)
+		{
+			if (!scene.m_Alive[objectIndex])
+				continue;
+
+			const glm::vec3	center = (scene.m_Mins[objectIndex] + scene.m_Maxs[objectIndex]) * 0.5f;
+			const glm::vec3	extent = (scene.m_Maxs[objectIndex] - scene.m_Mins[objectIndex]) * 0.5f;
+
+			bool			isOutside = false;
+			for (const glm::vec4 &plane : cullingView.m_Planes)
+				isOutside |= (glm::dot(glm::vec3(plane), center) + plane.w + glm::dot(glm::abs(glm::vec3(plane)), extent) < 0.f);
+
+			if (!isOutside)
+			{
+				TEST_CHECK(found[objectIndex]);
+				++insideCount;
+			}
+		}
+
+		// the view must see part of the scene for the test to mean anything
+		TEST_CHECK(insideCount > 0);
+		TEST_CHECK(proxies.size() < bvh.GetProxiesCount());
+	}
+
+	//----------------------------------------------------------------
+
+	// entry distance in a box, negative when missed
+	float	IntersectBox(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+	{
+		float	entry = 0.f;
+		float	exit = maxDistance;
+
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			float	near = (boundsMin[axis] - origin[axis]) / direction[axis];
+			float	far = (boundsMax[axis] - origin[axis]) / direction[axis];
+
+			if (near > far)
+				std::swap(near, far);
+
+			entry = std::max(entry, near);
+			exit = std::min(exit, far);
+
+			if (entry > exit)
+				return -1.f;
+		}
+
+		return entry;
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestRaycast()
+	{
+		DynamicBvh	bvh;
+		Scene		scene;
+
+		Populate(bvh, scene, 5000);
+
+		std::mt19937							random(3);
+		std::uniform_real_distribution<float>	position(0.f, 50.f);
+		std::uniform_real_distribution<float>	direction(-25.f, 25.f);
+
+		const float								maxDistance = 100.f;
+
+		uint32_t								hitsCount = 0;
+		for (uint32_t rayIndex = 0; rayIndex < 200; ++rayIndex)
+		{
+			const glm::vec3	rayOrigin(position(random), position(random), position(random));
+			const glm::vec3	rayDirection(direction(random), direction(random), direction(random));
+
+			// every fat box counts as a hit at its entry
+			BvhRayHit		hit;
+			const bool		isHit = bvh.Raycast(rayOrigin, rayDirection, maxDistance, [](uint32_t, float boxDistance) { return boxDistance; }, hit);
+
+			float			closestDistance = -1.f;
+			for (size_t objectIndex = 0; objectIndex < scene.m_Mins.size(); ++objectIndex)
+			{
+				if (!scene.m_Alive[objectIndex])
+					continue;
+
+				const uint32_t	proxy = scene.m_Proxies[objectIndex];
+				const float		distance = IntersectBox(rayOrigin, rayDirection, maxDistance, bvh.GetFatMin(proxy), bvh.GetFatMax(proxy));
+
+				if (distance >= 0.f && (closestDistance < 0.f || distance < closestDistance))
+					closestDistance = distance;
+			}
+
+			TEST_CHECK(isHit == (closestDistance >= 0.f));
+
+			if (isHit && closestDistance >= 0.f)
+			{
+				TEST_CHECK(std::fabs(hit.m_Distance - closestDistance) <= 1e-4f);
+				++hitsCount;
+			}
+		}
+
+		TEST_CHECK(hitsCount > 0);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestRebuild()
+	{
+		DynamicBvh	bvh;
+		Scene		scene;
+
+		Populate(bvh, scene, 5000);
+
+		std::vector<uint32_t>	proxiesBefore;
+		bvh.QueryAabb(glm::vec3(10.f), glm::vec3(30.f), proxiesBefore);
+
+		const uint32_t			rebuildsCount = bvh.GetRebuildsCount();
+		bvh.Rebuild();
+
+		TEST_CHECK(bvh.GetRebuildsCount() == rebuildsCount + 1);
+
+		// same proxies, the handles survive the rebuild
+		std::vector<uint32_t>	proxiesAfter;
+		bvh.QueryAabb(glm::vec3(10.f), glm::vec3(30.f), proxiesAfter);
+
+		std::sort(proxiesBefore.begin(), proxiesBefore.end());
+		std::sort(proxiesAfter.begin(), proxiesAfter.end());
+		TEST_CHECK(proxiesBefore == proxiesAfter);
+
+		// a fresh tree isn't degraded
+		TEST_CHECK(!bvh.RebuildIfDegraded());
+		TEST_CHECK(bvh.GetCost() > 0.f);
+	}
+}
+
+//----------------------------------------------------------------
+
+int		main()
+{
+	return TestFramework::Run({	{ "DynamicBvh insert remove update", TestInsertRemoveUpdate },
+								{ "DynamicBvh sphere and box queries", TestQuerySphereAndAabb },
+								{ "DynamicBvh frustum query", TestQueryFrustum },
+								{ "DynamicBvh raycast", TestRaycast },
+								{ "DynamicBvh rebuild", TestRebuild } });
+}
@@ -0,0 +1,252 @@
+#include <cmath>
+#include <random>
+
+#include "Tools/FrustumCulling.h"
+
+#include "TestFramework.h"
+
+//----------------------------------------------------------------
+
+using namespace Lightlyy;
+
+//----------------------------------------------------------------
+
+namespace
+{
+	// the kernel the build targets must give the scalar path's answer, object by object
+	bool	CullBoth(const CullingView &view, const CullingBounds &bounds, std::vector<uint32_t> &outVisible)
+	{
+		std::vector<uint32_t>	scalarVisible;
+
+		outVisible.clear();
+		FrustumCulling::Cull(view, bounds, outVisible);
+		FrustumCulling::CullScalar(view, bounds, scalarVisible);
+
+		return TEST_CHECK(outVisible == scalarVisible);
+	}
+
+	//----------------------------------------------------------------
+
+	// planes through random points with random unit normals, and a random divide row for the size test
+	CullingView		MakeRandomView(std::mt19937 &random, float minPixels)
+	{
+		std::uniform_real_distribution<float>	unit(-1.f, 1.f);
+		std::uniform_real_distribution<float>	position(-20.f, 20.f);
+
+		CullingView	view = { };
+
+		for (glm::vec4 &plane : view.m_Planes)
+		{
+			glm::vec3	normal(unit(random), unit(random), unit(random));
+			while (glm::length(normal) < 0.1f)
+				normal = glm::vec3(unit(random), unit(random), unit(random));
+
+			normal = normal / glm::length(normal);
+
+			const glm::vec3	point(position(random), position(random), position(random));
+			plane = glm::vec4(normal, -glm::dot(normal, point));
+		}
+
+		view.m_RowW = glm::vec4(unit(random), unit(random), unit(random), position(random));
+		view.m_RowWLength = glm::length(glm::vec3(view.m_RowW));
+		view.m_PixelsPerUnit = 500.f;
+		view.m_MinPixels = minPixels;
+
+		return view;
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestRandomBoxesAndPlanes()
+	{
+		std::mt19937							random(17);
+		std::uniform_real_distribution<float>	position(-30.f, 30.f);
+		std::uniform_real_distribution<float>	size(0.01f, 8.f);
+
+		// counts around the lanes of the kernels, the padding lanes must never show up
+		for (uint32_t objectsCount = 0; objectsCount < 4 * FRUSTUM_CULLING_LANES + 3; ++objectsCount)
+		{
+			for (uint32_t viewIndex = 0; viewIndex < 50; ++viewIndex)
+			{
+				CullingBounds	bounds;
+				bounds.Resize(objectsCount);
+
+				for (uint32_t objectIndex = 0; objectIndex < objectsCount; ++objectIndex)
+				{
+					const glm::vec3	extent(size(random), size(random), size(random));
+
+					// the radius is sometimes tighter than the box, sometimes not
+					bounds.Set(objectIndex, glm::vec3(position(random), position(random), position(random)), extent, glm::length(extent) * ((random() % 2 == 0) ? 1.f : 0.5f));
+				}
+
+				std::vector<uint32_t>	visible;
+				CullBoth(MakeRandomView(random, (viewIndex % 2 == 0) ? 0.f : 40.f), bounds, visible);
+
+				for (const uint32_t objectIndex : visible)
+					TEST_CHECK(objectIndex < objectsCount);
+			}
+		}
+	}
+
+	//----------------------------------------------------------------
+
+	// boxes placed so that their distance to one plane plus their radius is exactly zero, which counts as visible,
+	// the values are small dyadic fractions so that every sum is exact whatever the order
+	void	TestBoxesExactlyOnPlane()
+	{
+		CullingView	view = { };
+		{
+			view.m_Planes[0] = glm::vec4(1.f, 0.f, 0.f, 8.f); // x >= -8
+			view.m_Planes[1] = glm::vec4(-1.f, 0.f, 0.f, 8.f);
+			view.m_Planes[2] = glm::vec4(0.f, 1.f, 0.f, 8.f);
+			view.m_Planes[3] = glm::vec4(0.f, -1.f, 0.f, 8.f);
+			view.m_Planes[4] = glm::vec4(0.f, 0.f, 1.f, 8.f);
+			view.m_Planes[5] = glm::vec4(0.f, 0.f, -1.f, 8.f);
+
+			view.m_RowW = glm::vec4(0.f, 0.f, 0.f, 1.f);
+			view.m_RowWLength = 0.f;
+			view.m_PixelsPerUnit = 1.f;
+			view.m_MinPixels = 0.f;
+		}
+
+		const float		extents[4] = { 0.25f, 0.5f, 1.f, 2.5f };
+		const uint32_t	objectsCount = 6 * 4 * 3;
+
+		CullingBounds	bounds;
+		bounds.Resize(objectsCount);
+
+		uint32_t		objectIndex = 0;
+		for (uint32_t planeIndex = 0; planeIndex < 6; ++planeIndex)
+		{
+			const glm::vec3	normal = glm::vec3(view.m_Planes[planeIndex]);
+
+			for (const float extent : extents)
+			{
+				// touching, one step outside and one step inside, decided by the box then by the sphere
+				const float	offsets[3] = { 0.f, -0.125f, 0.125f };
+				for (const float offset : offsets)
+				{
+					const float		radius = (objectIndex % 2 == 0) ? extent * 2.f : extent * 0.5f;
+					const float		tightest = std::min(extent, radius);
+					const glm::vec3	center = normal * (-8.f - tightest + offset);
+
+					bounds.Set(objectIndex++, center, glm::vec3(extent), radius);
+				}
+			}
+		}
+
+		std::vector<uint32_t>	visible;
+		CullBoth(view, bounds, visible);
+
+		std::vector<bool>		isVisible(objectsCount, false);
+		for (const uint32_t visibleIndex : visible)
+			isVisible[visibleIndex] = true;
+
+		for (uint32_t testedIndex = 0; testedIndex < objectsCount; ++testedIndex)
+			TEST_CHECK(isVisible[testedIndex] == (testedIndex % 3 != 1));
+	}
+
+	//----------------------------------------------------------------
+
+	// boxes against random planes, as close to touching as the float math gets, both paths must round the same way
+	void	TestBoxesNearRandomPlanes()
+	{
+		std::mt19937							random(23);
+		std::uniform_real_distribution<float>	position(-10.f, 10.f);
+		std::uniform_real_distribution<float>	size(0.01f, 4.f);
+		std::uniform_real_distribution<float>	epsilon(-1e-5f, 1e-5f);
+
+		const uint32_t							objectsCount = 4099;
+
+		for (uint32_t viewIndex = 0; viewIndex < 20; ++viewIndex)
+		{
+			const CullingView	view = MakeRandomView(random, 0.f);
+
+			CullingBounds		bounds;
+			bounds.Resize(objectsCount);
+
+			for (uint32_t objectIndex = 0; objectIndex < objectsCount; ++objectIndex)
+			{
+				const glm::vec4	&plane = view.m_Planes[objectIndex % 6];
+				const glm::vec3	normal = glm::vec3(plane);
+				const glm::vec3	extent(size(random), size(random), size(random));
+				const float		radius = glm::length(extent);
+				const float		boxRadius = glm::dot(glm::abs(normal), extent);
+
+				// a point of the plane moved back by the box radius
+				glm::vec3		center(position(random), position(random), position(random));
+				center = center - normal * (glm::dot(normal, center) + plane.w) - normal * (std::min(boxRadius, radius) + epsilon(random));
+
+				bounds.Set(objectIndex, center, extent, radius);
+			}
+
+			std::vector<uint32_t>	visible;
+			CullBoth(view, bounds, visible);
+		}
+	}
+
+	//----------------------------------------------------------------
+
+	// a projection through MakeView, with the near plane dropped for the shadow views and the size test on
+	void	TestPerspectiveView()
+	{
+		const float		nearPlane = 0.1f;
+		const float		farPlane = 100.f;
+
+		glm::mat4		projection(0.f);
+		{
+			projection[0][0] = 1.f;
+			projection[1][1] = 1.f;
+			projection[2][2] = farPlane / (nearPlane - farPlane);
+			projection[2][3] = -1.f;
+			projection[3][2] = -(farPlane * nearPlane) / (farPlane - nearPlane);
+		}
+
+		CullingView		view = FrustumCulling::MakeView(projection, 720.f, 2.f);
+
+		CullingBounds	bounds;
+		bounds.Resize(3);
+		bounds.Set(0, glm::vec3(0.f, 0.f, -10.f), glm::vec3(1.f), 1.8f); // in front
+		bounds.Set(1, glm::vec3(0.f, 0.f, 10.f), glm::vec3(1.f), 1.8f); // behind the eye
+		bounds.Set(2, glm::vec3(0.f, 0.f, -90.f), glm::vec3(0.01f), 0.018f); // too small at that distance
+
+		std::vector<uint32_t>	visible;
+		CullBoth(view, bounds, visible);
+		TEST_CHECK(visible == std::vector<uint32_t>({ 0 }));
+
+		// between the eye and the near plane, kept once the near plane is dropped
+		bounds.Set(1, glm::vec3(0.f, 0.f, -0.05f), glm::vec3(0.01f), 0.018f);
+		CullBoth(view, bounds, visible);
+		TEST_CHECK(visible == std::vector<uint32_t>({ 0 }));
+
+		FrustumCulling::ExtendTowardEye(view);
+		CullBoth(view, bounds, visible);
+		TEST_CHECK(visible == std::vector<uint32_t>({ 0, 1 }));
+
+		std::mt19937							random(29);
+		std::uniform_real_distribution<float>	position(-100.f, 100.f);
+		std::uniform_real_distribution<float>	size(0.01f, 2.f);
+
+		bounds.Resize(10000);
+		for (uint32_t objectIndex = 0; objectIndex < bounds.GetCount(); ++objectIndex)
+		{
+			const glm::vec3	extent(size(random), size(random), size(random));
+			bounds.Set(objectIndex, glm::vec3(position(random), position(random), position(random)), extent, glm::length(extent));
+		}
+
+		CullBoth(FrustumCulling::MakeView(projection, 720.f, 2.f), bounds, visible);
+		TEST_CHECK(!visible.empty() && visible.size() < bounds.GetCount());
+	}
+}
+
+//----------------------------------------------------------------
+
+int		main()
+{
+	std::cout << "Frustum culling kernel: " << FrustumCulling::GetKernelName() << std::endl;
+
+	return TestFramework::Run({	{ "FrustumCulling random boxes and planes", TestRandomBoxesAndPlanes },
+								{ "FrustumCulling boxes exactly on a plane", TestBoxesExactlyOnPlane },
+								{ "FrustumCulling boxes near random planes", TestBoxesNearRandomPlanes },
+								{ "FrustumCulling perspective view", TestPerspectiveView } });
+}
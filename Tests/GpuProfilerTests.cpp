@@ -0,0 +1,291 @@
+#include <cmath>
+
+#include "GpuProfiler.h"
+
+#include "TestFramework.h"
+
+//----------------------------------------------------------------
+
+using namespace Lightlyy;
+
+//----------------------------------------------------------------
+
+namespace
+{
+	// the profiler only writes timestamps and reads them back, the query pools are fakes holding what was written
+	struct FakeQueryPool
+	{
+		uint64_t	m_Timestamps[GPU_PROFILER_MAX_SCOPES * 2];
+		bool		m_IsLive;
+	}; // struct FakeQueryPool
+
+	FakeQueryPool	s_QueryPools[4] = { };
+	uint32_t		s_QueryPoolsCount = 0;
+	uint64_t		s_Clock = 0; // ticks written by the next timestamp
+	VkResult		s_QueryResult = VK_SUCCESS;
+
+	//----------------------------------------------------------------
+
+	FakeQueryPool&	GetPool(VkQueryPool queryPool)
+	{
+		return *reinterpret_cast<FakeQueryPool*>(queryPool);
+	}
+
+	//----------------------------------------------------------------
+
+	VKAPI_ATTR VkResult VKAPI_CALL	FakeCreateQueryPool(VkDevice, const VkQueryPoolCreateInfo *createInfo, const VkAllocationCallbacks*, VkQueryPool *outQueryPool)
+	{
+		TEST_CHECK(createInfo->queryType == VK_QUERY_TYPE_TIMESTAMP);
+		TEST_CHECK(createInfo->queryCount == GPU_PROFILER_MAX_SCOPES * 2);
+
+		if (!TEST_CHECK(s_QueryPoolsCount < 4))
+			return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+		FakeQueryPool	&queryPool = s_QueryPools[s_QueryPoolsCount++];
+		queryPool = { };
+		queryPool.m_IsLive = true;
+
+		*outQueryPool = reinterpret_cast<VkQueryPool>(&queryPool);
+		return VK_SUCCESS;
+	}
+
+	//----------------------------------------------------------------
+
+	VKAPI_ATTR void VKAPI_CALL	FakeDestroyQueryPool(VkDevice, VkQueryPool queryPool, const VkAllocationCallbacks*)
+	{
+		TEST_CHECK(GetPool(queryPool).m_IsLive);
+		GetPool(queryPool).m_IsLive = false;
+	}
+
+	//----------------------------------------------------------------
+
+	VKAPI_ATTR void VKAPI_CALL	FakeCmdResetQueryPool(VkCommandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount)
+	{
+		TEST_CHECK(firstQuery + queryCount <= GPU_PROFILER_MAX_SCOPES * 2);
+
+		for (uint32_t queryIndex = firstQuery; queryIndex < firstQuery + queryCount; ++queryIndex)
+			GetPool(queryPool).m_Timestamps[queryIndex] = 0;
+	}
+
+	//----------------------------------------------------------------
+
+	VKAPI_ATTR void VKAPI_CALL	FakeCmdWriteTimestamp(VkCommandBuffer, VkPipelineStageFlagBits, VkQueryPool queryPool, uint32_t query)
+	{
+		TEST_CHECK(query < GPU_PROFILER_MAX_SCOPES * 2);
+		GetPool(queryPool).m_Timestamps[query] = s_Clock;
+	}
+
+	//----------------------------------------------------------------
+
+	VKAPI_ATTR VkResult VKAPI_CALL	FakeGetQueryPoolResults(VkDevice, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount, size_t dataSize, void *data,
+															VkDeviceSize stride, VkQueryResultFlags flags)
+	{
+		TEST_CHECK(stride == sizeof(uint64_t) && (flags & VK_QUERY_RESULT_64_BIT) != 0);
+		TEST_CHECK(dataSize >= queryCount * sizeof(uint64_t));
+
+		if (s_QueryResult != VK_SUCCESS)
+			return s_QueryResult;
+
+		uint64_t	*timestamps = static_cast<uint64_t*>(data);
+		for (uint32_t queryIndex = 0; queryIndex < queryCount; ++queryIndex)
+			timestamps[queryIndex] = GetPool(queryPool).m_Timestamps[firstQuery + queryIndex];
+
+		return VK_SUCCESS;
+	}
+
+	//----------------------------------------------------------------
+
+	void	PrepareProfiler(GpuProfiler &profiler, uint32_t pendingFrames, float timestampPeriod, uint32_t timestampValidBits)
+	{
+		vkCreateQueryPool = FakeCreateQueryPool;
+		vkDestroyQueryPool = FakeDestroyQueryPool;
+		vkCmdResetQueryPool = FakeCmdResetQueryPool;
+		vkCmdWriteTimestamp = FakeCmdWriteTimestamp;
+		vkGetQueryPoolResults = FakeGetQueryPoolResults;
+
+		s_QueryPoolsCount = 0;
+		s_Clock = 0;
+		s_QueryResult = VK_SUCCESS;
+
+		TEST_CHECK(profiler.Prepare(nullptr, pendingFrames, timestampPeriod, timestampValidBits));
+	}
+
+	//----------------------------------------------------------------
+
+	// the scope spans the ticks from begin to end
+	void	RecordScope(GpuProfiler &profiler, const char *name, uint64_t beginTicks, uint64_t endTicks)
+	{
+		s_Clock = beginTicks;
+		const uint32_t	scopeId = profiler.BeginScope(nullptr, name);
+
+		s_Clock = endTicks;
+		profiler.EndScope(nullptr, scopeId);
+	}
+
+	//----------------------------------------------------------------
+
+	bool	IsNear(float value, float expected)
+	{
+		return std::fabs(value - expected) <= 1e-5f * std::fmax(1.f, std::fabs(expected));
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestDisabled()
+	{
+		GpuProfiler	profiler;
+		PrepareProfiler(profiler, 2, 1.f, 0);
+
+		// no timestamp support, nothing is created nor recorded
+		TEST_CHECK(!profiler.IsEnabled());
+		TEST_CHECK(s_QueryPoolsCount == 0);
+
+		profiler.BeginFrame(nullptr, 0);
+		TEST_CHECK(profiler.BeginScope(nullptr, "Pass") == UINT32_MAX);
+		profiler.EndScope(nullptr, UINT32_MAX);
+
+		TEST_CHECK(profiler.GetScopes().empty());
+
+		profiler.Shutdown();
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestResolveScopes()
+	{
+		GpuProfiler	profiler;
+		PrepareProfiler(profiler, 2, 2.f, 64); // 2 nanoseconds per tick
+
+		TEST_CHECK(profiler.IsEnabled());
+		TEST_CHECK(s_QueryPoolsCount == 2);
+
+		profiler.BeginFrame(nullptr, 0);
+		RecordScope(profiler, "Shadows", 1000, 501000); // 1 ms
+		RecordScope(profiler, "Objects", 600000, 1600000); // 2 ms
+		RecordScope(profiler, "Shadows", 2000000, 2250000); // 0.5 ms more
+
+		// first frame in flight, the other slot has nothing to resolve
+		profiler.BeginFrame(nullptr, 1);
+		TEST_CHECK(profiler.FindScope("Shadows")->m_SamplesCount == 0);
+
+		// a scope recorded twice in a frame is their sum, in first recorded order
+		profiler.BeginFrame(nullptr, 0);
+
+		const std::vector<GpuScope>	&scopes = profiler.GetScopes();
+		TEST_CHECK(scopes.size() == 2);
+		TEST_CHECK(scopes[0].m_Name == "Shadows" && scopes[1].m_Name == "Objects");
+
+		TEST_CHECK(IsNear(scopes[0].m_Time, 1.5f));
+		TEST_CHECK(IsNear(scopes[1].m_Time, 2.f));
+
+		// the first sample sets the average
+		TEST_CHECK(scopes[0].m_SamplesCount == 1);
+		TEST_CHECK(IsNear(scopes[0].m_AverageTime, 1.5f));
+		TEST_CHECK(IsNear(profiler.GetFrameTime(), 3.5f));
+
+		TEST_CHECK(profiler.FindScope("Objects") == &scopes[1]);
+		TEST_CHECK(profiler.FindScope("Skybox") == nullptr);
+
+		profiler.Shutdown();
+		TEST_CHECK(!s_QueryPools[0].m_IsLive && !s_QueryPools[1].m_IsLive);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestSmoothing()
+	{
+		GpuProfiler	profiler;
+		PrepareProfiler(profiler, 1, 1.f, 64);
+
+		profiler.BeginFrame(nullptr, 0);
+		RecordScope(profiler, "Pass", 0, 1000000); // 1 ms
+
+		profiler.BeginFrame(nullptr, 0);
+		RecordScope(profiler, "Pass", 0, 3000000); // 3 ms
+
+		profiler.BeginFrame(nullptr, 0);
+
+		const GpuScope	*scope = profiler.FindScope("Pass");
+		TEST_CHECK(scope->m_SamplesCount == 2);
+		TEST_CHECK(IsNear(scope->m_Time, 3.f));
+		TEST_CHECK(IsNear(scope->m_AverageTime, 1.f + 2.f * GPU_PROFILER_SMOOTHING));
+
+		// a scope missing from a frame counts as 0
+		RecordScope(profiler, "Other", 0, 0);
+
+		profiler.BeginFrame(nullptr, 0);
+		TEST_CHECK(IsNear(profiler.FindScope("Pass")->m_Time, 0.f));
+		TEST_CHECK(profiler.FindScope("Pass")->m_SamplesCount == 3);
+
+		profiler.Shutdown();
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestTimestampWrap()
+	{
+		GpuProfiler	profiler;
+		PrepareProfiler(profiler, 1, 1.f, 32);
+
+		// the counter wraps between begin and end, only the valid bits are kept
+		profiler.BeginFrame(nullptr, 0);
+		RecordScope(profiler, "Pass", 0xffffffffull - 499999, 500000);
+
+		profiler.BeginFrame(nullptr, 0);
+		TEST_CHECK(IsNear(profiler.FindScope("Pass")->m_Time, 1.f));
+
+		profiler.Shutdown();
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestNotReady()
+	{
+		GpuProfiler	profiler;
+		PrepareProfiler(profiler, 1, 1.f, 64);
+
+		profiler.BeginFrame(nullptr, 0);
+		RecordScope(profiler, "Pass", 0, 1000000);
+
+		// results that aren't available keep the last timings, the queries are reset anyway
+		s_QueryResult = VK_NOT_READY;
+		profiler.BeginFrame(nullptr, 0);
+
+		TEST_CHECK(profiler.FindScope("Pass")->m_SamplesCount == 0);
+		TEST_CHECK(s_QueryPools[0].m_Timestamps[1] == 0);
+
+		profiler.Shutdown();
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestScopesLimit()
+	{
+		GpuProfiler	profiler;
+		PrepareProfiler(profiler, 1, 1.f, 64);
+
+		profiler.BeginFrame(nullptr, 0);
+
+		for (uint32_t scopeIndex = 0; scopeIndex < GPU_PROFILER_MAX_SCOPES; ++scopeIndex)
+			TEST_CHECK(profiler.BeginScope(nullptr, "Pass") == scopeIndex);
+
+		// no query left, the scope is dropped and its end ignored
+		const uint32_t	scopeId = profiler.BeginScope(nullptr, "Pass");
+		TEST_CHECK(scopeId == UINT32_MAX);
+		profiler.EndScope(nullptr, scopeId);
+
+		profiler.Shutdown();
+	}
+}
+
+//----------------------------------------------------------------
+
+int		main()
+{
+	return TestFramework::Run({	{ "GpuProfiler disabled", TestDisabled },
+								{ "GpuProfiler resolve scopes", TestResolveScopes },
+								{ "GpuProfiler smoothing", TestSmoothing },
+								{ "GpuProfiler timestamp wrap", TestTimestampWrap },
+								{ "GpuProfiler results not ready", TestNotReady },
+								{ "GpuProfiler scopes limit", TestScopesLimit } });
+}
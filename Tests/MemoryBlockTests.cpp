@@ -0,0 +1,271 @@
+#include <map>
+#include <random>
+
+#include "MemoryAllocator.h"
+
+#include "TestFramework.h"
+
+//----------------------------------------------------------------
+
+using namespace Lightlyy;
+
+//----------------------------------------------------------------
+
+namespace
+{
+	// the buddy bookkeeping never reads the memory, the block gets a fake handle instead of a device allocation
+	uint64_t	s_FakeMemory = 0;
+	uint32_t	s_LiveMemoriesCount = 0;
+
+	//----------------------------------------------------------------
+
+	VKAPI_ATTR VkResult VKAPI_CALL	FakeAllocateMemory(VkDevice, const VkMemoryAllocateInfo *allocateInfo, const VkAllocationCallbacks*, VkDeviceMemory *outMemory)
+	{
+		TEST_CHECK(allocateInfo->allocationSize == MEMORY_BLOCK_SIZE);
+
+		*outMemory = reinterpret_cast<VkDeviceMemory>(&s_FakeMemory);
+		++s_LiveMemoriesCount;
+
+		return VK_SUCCESS;
+	}
+
+	//----------------------------------------------------------------
+
+	VKAPI_ATTR void VKAPI_CALL	FakeFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*)
+	{
+		TEST_CHECK(memory == reinterpret_cast<VkDeviceMemory>(&s_FakeMemory));
+		--s_LiveMemoriesCount;
+	}
+
+	//----------------------------------------------------------------
+
+	void	CreateBlock(MemoryBlock &block)
+	{
+		vkAllocateMemory = FakeAllocateMemory;
+		vkFreeMemory = FakeFreeMemory;
+
+		TEST_CHECK(block.Create(nullptr, 0, false));
+		TEST_CHECK(block.GetLargestFreeSize() == MEMORY_BLOCK_SIZE);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestRoundedSizes()
+	{
+		MemoryBlock		block(0);
+		CreateBlock(block);
+
+		VkDeviceSize	offset = 0;
+		VkDeviceSize	size = 0;
+
+		// the smallest buddy for anything up to its size
+		TEST_CHECK(block.Allocate(1, offset, size));
+		TEST_CHECK(offset == 0 && size == MEMORY_MIN_ALLOCATION_SIZE);
+
+		TEST_CHECK(block.Allocate(MEMORY_MIN_ALLOCATION_SIZE + 1, offset, size));
+		TEST_CHECK(size == MEMORY_MIN_ALLOCATION_SIZE * 2);
+		TEST_CHECK(offset == MEMORY_MIN_ALLOCATION_SIZE * 2);
+
+		// the upper half of the first split is still free
+		TEST_CHECK(block.Allocate(MEMORY_MIN_ALLOCATION_SIZE, offset, size));
+		TEST_CHECK(offset == MEMORY_MIN_ALLOCATION_SIZE);
+
+		TEST_CHECK(block.GetAllocatedSize() == MEMORY_MIN_ALLOCATION_SIZE * 4);
+		TEST_CHECK(block.GetLargestFreeSize() == MEMORY_BLOCK_SIZE / 2);
+
+		block.Destroy(nullptr);
+		TEST_CHECK(s_LiveMemoriesCount == 0);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestExhaustAndMerge()
+	{
+		MemoryBlock		block(0);
+		CreateBlock(block);
+
+		const VkDeviceSize	quarterSize = MEMORY_BLOCK_SIZE / 4;
+
+		VkDeviceSize	offsets[4] = { };
+		VkDeviceSize	size = 0;
+
+		for (uint32_t quarterIndex = 0; quarterIndex < 4; ++quarterIndex)
+		{
+			TEST_CHECK(block.Allocate(quarterSize, offsets[quarterIndex], size));
+			TEST_CHECK(size == quarterSize);
+		}
+
+		VkDeviceSize	offset = 0;
+		TEST_CHECK(!block.Allocate(1, offset, size));
+		TEST_CHECK(block.GetLargestFreeSize() == 0);
+
+		// buddies merge back only once both halves are free
+		block.Free(offsets[0], quarterSize);
+		block.Free(offsets[3], quarterSize);
+		TEST_CHECK(block.GetLargestFreeSize() == quarterSize);
+
+		block.Free(offsets[1], quarterSize);
+		TEST_CHECK(block.GetLargestFreeSize() == quarterSize * 2);
+
+		block.Free(offsets[2], quarterSize);
+		TEST_CHECK(block.IsEmpty());
+		TEST_CHECK(block.GetLargestFreeSize() == MEMORY_BLOCK_SIZE);
+
+		block.Destroy(nullptr);
+	}
+
+	//----------------------------------------------------------------
+
+	// random allocations and frees, buddies must be aligned to their size and never overlap
+	void	TestRandomAgainstReference()
+	{
+		MemoryBlock		block(0);
+		CreateBlock(block);
+
+		std::map<VkDeviceSize, VkDeviceSize>	allocations; // size by offset
+		VkDeviceSize							allocatedSize = 0;
+
+		std::mt19937							random(11);
+
+		for (uint32_t iteration = 0; iteration < 20000; ++iteration)
+		{
+			if (allocations.empty() || random() % 3 != 0)
+			{
+				// mostly small sizes with a few large ones, like buffers and textures
+				const VkDeviceSize	requestedSize = (random() % 8 == 0) ? 1 + random() % (MEMORY_BLOCK_SIZE / 8) : 1 + random() % (64 << 10);
+
+				VkDeviceSize		offset = 0;
+				VkDeviceSize		size = 0;
+
+				if (!block.Allocate(requestedSize, offset, size))
+				{
+					TEST_CHECK(block.GetLargestFreeSize() < requestedSize);
+					continue;
+				}
+
+				TEST_CHECK(size >= requestedSize && size < requestedSize * 2 + MEMORY_MIN_ALLOCATION_SIZE);
+				TEST_CHECK(offset % size == 0);
+				TEST_CHECK(offset + size <= MEMORY_BLOCK_SIZE);
+
+				// neighbours in offset order must end before and start after
+				std::map<VkDeviceSize, VkDeviceSize>::iterator	next = allocations.lower_bound(offset);
+				if (next != allocations.end())
+					TEST_CHECK(offset + size <= next->first);
+				if (next != allocations.begin())
+				{
+					std::map<VkDeviceSize, VkDeviceSize>::iterator	previous = std::prev(next);
+					TEST_CHECK(previous->first + previous->second <= offset);
+				}
+
+				allocations[offset] = size;
+				allocatedSize += size;
+			}
+			else
+			{
+				std::map<VkDeviceSize, VkDeviceSize>::iterator	allocation = allocations.begin();
+				std::advance(allocation, random() % allocations.size());
+
+				block.Free(allocation->first, allocation->second);
+
+				allocatedSize -= allocation->second;
+				allocations.erase(allocation);
+			}
+
+			TEST_CHECK(block.GetAllocatedSize() == allocatedSize);
+		}
+
+		for (const std::pair<const VkDeviceSize, VkDeviceSize> &allocation : allocations)
+			block.Free(allocation.first, allocation.second);
+
+		// every buddy merged back
+		TEST_CHECK(block.IsEmpty());
+		TEST_CHECK(block.GetLargestFreeSize() == MEMORY_BLOCK_SIZE);
+
+		block.Destroy(nullptr);
+		TEST_CHECK(s_LiveMemoriesCount == 0);
+	}
+
+	//----------------------------------------------------------------
+
+	// memory types whose heap is full, and the largest allocation the fake device still accepts
+	uint32_t		s_FullTypes = 0;
+	VkDeviceSize	s_MaxAllocationSize = 0;
+	uint32_t		s_LastTypeIndex = UINT32_MAX;
+
+	VKAPI_ATTR VkResult VKAPI_CALL	FakeAllocateLimitedMemory(VkDevice, const VkMemoryAllocateInfo *allocateInfo, const VkAllocationCallbacks*, VkDeviceMemory *outMemory)
+	{
+		if ((s_FullTypes & (1u << allocateInfo->memoryTypeIndex)) != 0 || allocateInfo->allocationSize > s_MaxAllocationSize)
+			return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+		*outMemory = reinterpret_cast<VkDeviceMemory>(&s_FakeMemory);
+		++s_LiveMemoriesCount;
+		s_LastTypeIndex = allocateInfo->memoryTypeIndex;
+
+		return VK_SUCCESS;
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestMemoryTypeFallback()
+	{
+		vkAllocateMemory = FakeAllocateLimitedMemory;
+		vkFreeMemory = FakeFreeMemory;
+
+		// two device local types on different heaps around a host visible one
+		VkPhysicalDeviceMemoryProperties	memoryProperties = { };
+		memoryProperties.memoryTypeCount = 3;
+		memoryProperties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		memoryProperties.memoryTypes[1].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		memoryProperties.memoryTypes[2].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+		MemoryAllocator			allocator;
+		TEST_CHECK(allocator.Setup(nullptr, memoryProperties));
+
+		VkMemoryRequirements	requirements = { };
+		requirements.size = 4096;
+		requirements.alignment = 256;
+		requirements.memoryTypeBits = 0x7;
+
+		// the preferred type is full, the block comes from the next device local type
+		s_FullTypes = 1u << 0;
+		s_MaxAllocationSize = MEMORY_BLOCK_SIZE;
+
+		MemoryAllocation		pooled;
+		TEST_CHECK(allocator.Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, false, pooled));
+		TEST_CHECK(pooled.m_Block != nullptr);
+		TEST_CHECK(s_LastTypeIndex == 2);
+
+		// no room for a block in the linear pool, the request alone gets its own memory
+		requirements.size = MEMORY_BLOCK_SIZE / 8;
+		s_MaxAllocationSize = requirements.size;
+
+		MemoryAllocation		dedicated;
+		TEST_CHECK(allocator.Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, false, dedicated));
+		TEST_CHECK(dedicated.m_Block == nullptr);
+		TEST_CHECK(dedicated.m_Size == requirements.size);
+		TEST_CHECK(s_LastTypeIndex == 2);
+
+		// every matching type is full
+		s_FullTypes = (1u << 0) | (1u << 2);
+
+		MemoryAllocation		failed;
+		TEST_CHECK(!allocator.Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, false, failed));
+		TEST_CHECK(failed.m_Memory == nullptr);
+
+		allocator.Free(dedicated);
+		allocator.Free(pooled);
+		allocator.Shutdown();
+
+		TEST_CHECK(s_LiveMemoriesCount == 0);
+	}
+}
+
+//----------------------------------------------------------------
+
+int		main()
+{
+	return TestFramework::Run({	{ "MemoryBlock rounded sizes", TestRoundedSizes },
+								{ "MemoryBlock exhaust and merge", TestExhaustAndMerge },
+								{ "MemoryBlock random against reference", TestRandomAgainstReference },
+								{ "MemoryAllocator memory type fallback", TestMemoryTypeFallback } });
+}
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <tuple>
+
+#include "Tools/MeshOptimizer.h"
+
+#include "TestFramework.h"
+
+//----------------------------------------------------------------
+
+using namespace Lightlyy;
+
+//----------------------------------------------------------------
+
+namespace
+{
+	using TrianglePositions = std::array<std::tuple<float, float, float>, 3>;
+
+	//----------------------------------------------------------------
+
+	// triangles as positions, rotated so that the smallest corner comes first to keep the winding, then sorted,
+	// two index buffers draw the same surface when they give the same list
+	std::vector<TrianglePositions>	GetTriangles(const std::vector<VertexData> &vertices, const std::vector<uint32_t> &indices)
+	{
+		std::vector<TrianglePositions>	triangles;
+		triangles.reserve(indices.size() / 3);
+
+		for (size_t indexIndex = 0; indexIndex + 2 < indices.size(); indexIndex += 3)
+		{
+			TrianglePositions	triangle;
+			for (uint32_t cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+			{
+				const glm::vec3	&position = vertices[indices[indexIndex + cornerIndex]].m_Pos;
+				triangle[cornerIndex] = std::make_tuple(position.x, position.y, position.z);
+			}
+
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.push_back(triangle);
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+
+		return triangles;
+	}
+
+	//----------------------------------------------------------------
+
+	// counter clockwise seen from +z, one vertex per grid point
+	void	MakeGrid(uint32_t cellsCount, std::vector<VertexData> &outVertices, std::vector<uint32_t> &outIndices)
+	{
+		const uint32_t	rowCount = cellsCount + 1;
+
+		outVertices.clear();
+		outIndices.clear();
+
+		for (uint32_t y = 0; y < rowCount; ++y)
+		{
+			for (uint32_t x = 0; x < rowCount; ++x)
+			{
+				VertexData	vertex = { };
+				vertex.m_Pos = glm::vec3(static_cast<float>(x), static_cast<float>(y), 0.f);
+				vertex.m_Normal = glm::vec3(0.f, 0.f, 1.f);
+
+				outVertices.push_back(vertex);
+			}
+		}
+
+		for (uint32_t y = 0; y < cellsCount; ++y)
+		{
+			for (uint32_t x = 0; x < cellsCount; ++x)
+			{
+				const uint32_t	corner = y * rowCount + x;
+				outIndices.insert(outIndices.end(), { corner, corner + 1, corner + rowCount, corner + 1, corner + rowCount + 1, corner + rowCount });
+			}
+		}
+	}
+
+	//----------------------------------------------------------------
+
+	// triangles in random order, each one with vertices of its own like an unwelded import
+	void	Scramble(std::vector<VertexData> &vertices, std::vector<uint32_t> &indices)
+	{
+		std::vector<uint32_t>	triangleOrder(indices.size() / 3);
+		for (uint32_t triangleIndex = 0; triangleIndex < triangleOrder.size(); ++triangleIndex)
+			triangleOrder[triangleIndex] = triangleIndex;
+
+		std::mt19937	random(5);
+		std::shuffle(triangleOrder.begin(), triangleOrder.end(), random);
+
+		std::vector<VertexData>	scrambledVertices;
+		std::vector<uint32_t>	scrambledIndices;
+
+		for (const uint32_t triangleIndex : triangleOrder)
+		{
+			for (uint32_t cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+			{
+				scrambledIndices.push_back(static_cast<uint32_t>(scrambledVertices.size()));
+				scrambledVertices.push_back(vertices[indices[triangleIndex * 3 + cornerIndex]]);
+			}
+		}
+
+		vertices.swap(scrambledVertices);
+		indices.swap(scrambledIndices);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestAnalyzeVertexCache()
+	{
+		// a lone triangle transforms its 3 vertices, drawing it again hits the cache
+		const VertexCacheStatistics	single = MeshOptimizer::AnalyzeVertexCache({ 0, 1, 2 }, 3);
+		TEST_CHECK(single.GetAcmr() == 3.f);
+		TEST_CHECK(single.GetAtvr() == 1.f);
+
+		const VertexCacheStatistics	repeated = MeshOptimizer::AnalyzeVertexCache({ 0, 1, 2, 2, 1, 0 }, 3);
+		TEST_CHECK(repeated.m_TransformedCount == 3);
+		TEST_CHECK(repeated.GetAcmr() == 1.5f);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestWeldVertices()
+	{
+		std::vector<VertexData>	vertices;
+		std::vector<uint32_t>	indices;
+		MakeGrid(16, vertices, indices);
+
+		const std::vector<TrianglePositions>	sourceTriangles = GetTriangles(vertices, indices);
+		const size_t							gridVerticesCount = vertices.size();
+
+		Scramble(vertices, indices);
+		TEST_CHECK(vertices.size() == indices.size());
+
+		MeshOptimizer::WeldVertices(vertices, indices);
+		MeshOptimizer::OptimizeVertexFetch(vertices, indices);
+
+		TEST_CHECK(vertices.size() == gridVerticesCount);
+		TEST_CHECK(GetTriangles(vertices, indices) == sourceTriangles);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestOptimizeVertexCache()
+	{
+		std::vector<VertexData>	vertices;
+		std::vector<uint32_t>	indices;
+		MakeGrid(64, vertices, indices);
+
+		Scramble(vertices, indices);
+		MeshOptimizer::WeldVertices(vertices, indices);
+
+		const uint32_t							verticesCount = static_cast<uint32_t>(vertices.size());
+		const std::vector<TrianglePositions>	sourceTriangles = GetTriangles(vertices, indices);
+		const float								sourceAcmr = MeshOptimizer::AnalyzeVertexCache(indices, verticesCount).GetAcmr();
+
+		MeshOptimizer::OptimizeVertexCache(indices, verticesCount);
+
+		const float								optimizedAcmr = MeshOptimizer::AnalyzeVertexCache(indices, verticesCount).GetAcmr();
+
+		// same triangles with their winding, a regular grid gets well under one miss per triangle
+		TEST_CHECK(GetTriangles(vertices, indices) == sourceTriangles);
+		TEST_CHECK(optimizedAcmr < sourceAcmr);
+		TEST_CHECK(optimizedAcmr < 0.9f);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestOptimizeVertexFetch()
+	{
+		std::vector<VertexData>	vertices;
+		std::vector<uint32_t>	indices;
+		MakeGrid(16, vertices, indices);
+
+		// an unreferenced vertex is dropped
+		VertexData	unusedVertex = { };
+		unusedVertex.m_Pos = glm::vec3(100.f);
+		vertices.insert(vertices.begin() + 10, unusedVertex);
+
+		for (uint32_t &index : indices)
+			index += (index >= 10) ? 1 : 0;
+
+		std::reverse(indices.begin(), indices.end());
+
+		const std::vector<TrianglePositions>	sourceTriangles = GetTriangles(vertices, indices);
+
+		MeshOptimizer::OptimizeVertexFetch(vertices, indices);
+
+		TEST_CHECK(vertices.size() == 17 * 17);
+		TEST_CHECK(GetTriangles(vertices, indices) == sourceTriangles);
+
+		// each index is at most one past the largest one before it
+		uint32_t	nextVertex = 0;
+		for (const uint32_t index : indices)
+		{
+			TEST_CHECK(index <= nextVertex);
+			nextVertex = std::max(nextVertex, index + 1);
+		}
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestSimplifyPlane()
+	{
+		const uint32_t			cellsCount = 19;
+
+		std::vector<VertexData>	vertices;
+		std::vector<uint32_t>	indices;
+		MakeGrid(cellsCount, vertices, indices);
+
+		std::vector<uint32_t>	simplifiedIndices;
+		const float				error = MeshOptimizer::Simplify(vertices, indices, 0, 0.01f, simplifiedIndices);
+
+		// every inner vertex of a plane collapses for free
+		TEST_CHECK(error <= 0.01f);
+		TEST_CHECK(simplifiedIndices.size() % 3 == 0);
+		TEST_CHECK(simplifiedIndices.size() < indices.size() / 4);
+
+		// the border never moves so the surface keeps its area, no triangle flips
+		float	area = 0.f;
+		for (size_t indexIndex = 0; indexIndex < simplifiedIndices.size(); indexIndex += 3)
+		{
+			const glm::vec3	&first = vertices[simplifiedIndices[indexIndex + 0]].m_Pos;
+			const glm::vec3	normal = glm::cross(vertices[simplifiedIndices[indexIndex + 1]].m_Pos - first, vertices[simplifiedIndices[indexIndex + 2]].m_Pos - first);
+
+			TEST_CHECK(normal.z >= 0.f);
+			area += normal.z * 0.5f;
+		}
+
+		TEST_CHECK(std::fabs(area - static_cast<float>(cellsCount * cellsCount)) < 1e-3f);
+
+		std::vector<bool>	isUsed(vertices.size(), false);
+		for (const uint32_t index : simplifiedIndices)
+			isUsed[index] = true;
+
+		for (uint32_t vertexIndex = 0; vertexIndex < vertices.size(); ++vertexIndex)
+		{
+			const glm::vec3	&position = vertices[vertexIndex].m_Pos;
+			if (position.x == 0.f || position.y == 0.f || position.x == cellsCount || position.y == cellsCount)
+				TEST_CHECK(isUsed[vertexIndex]);
+		}
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestSimplifySphere()
+	{
+		// closed uv sphere, the poles and the seam are welded so that only the seam vertices are locked
+		const uint32_t			ringsCount = 24;
+		const uint32_t			segmentsCount = 48;
+		const float				pi = 3.14159265f;
+
+		std::vector<VertexData>	vertices;
+		std::vector<uint32_t>	indices;
+
+		for (uint32_t ring = 0; ring <= ringsCount; ++ring)
+		{
+			for (uint32_t segment = 0; segment <= segmentsCount; ++segment)
+			{
+				const float	theta = pi * ring / ringsCount;
+				const float	phi = 2.f * pi * (segment % segmentsCount) / segmentsCount;
+
+				VertexData	vertex = { };
+				vertex.m_Pos = (ring == 0 || ring == ringsCount) ? glm::vec3(0.f, std::cos(theta), 0.f) : glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+				vertex.m_TexCoord = glm::vec2(static_cast<float>(segment) / segmentsCount, static_cast<float>(ring) / ringsCount);
+
+				vertices.push_back(vertex);
+			}
+		}
+
+		for (uint32_t ring = 0; ring < ringsCount; ++ring)
+		{
+			for (uint32_t segment = 0; segment < segmentsCount; ++segment)
+			{
+				const uint32_t	corner = ring * (segmentsCount + 1) + segment;
+				const uint32_t	below = corner + segmentsCount + 1;
+
+				if (ring > 0)
+					indices.insert(indices.end(), { corner, corner + 1, below });
+				if (ring < ringsCount - 1)
+					indices.insert(indices.end(), { corner + 1, below + 1, below });
+			}
+		}
+
+		// each level of detail stops at its indices count or at its error, whichever comes first
+		const float				targetError = 0.05f;
+		uint32_t				previousCount = static_cast<uint32_t>(indices.size());
+
+		for (uint32_t lodIndex = 1; lodIndex < MESH_LOD_MAX_COUNT; ++lodIndex)
+		{
+			const uint32_t			targetCount = static_cast<uint32_t>(indices.size() >> lodIndex) / 3 * 3;
+
+			std::vector<uint32_t>	simplifiedIndices;
+			const float				error = MeshOptimizer::Simplify(vertices, indices, targetCount, targetError, simplifiedIndices);
+
+			TEST_CHECK(error <= targetError);
+			TEST_CHECK(simplifiedIndices.size() % 3 == 0);
+			TEST_CHECK(simplifiedIndices.size() <= previousCount);
+			TEST_CHECK(simplifiedIndices.size() < indices.size());
+
+			// collapses land on existing vertices of the sphere, the triangles stay close to it and face out
+			for (size_t indexIndex = 0; indexIndex < simplifiedIndices.size(); indexIndex += 3)
+			{
+				const glm::vec3	&first = vertices[simplifiedIndices[indexIndex + 0]].m_Pos;
+				const glm::vec3	&second = vertices[simplifiedIndices[indexIndex + 1]].m_Pos;
+				const glm::vec3	&third = vertices[simplifiedIndices[indexIndex + 2]].m_Pos;
+
+				const glm::vec3	center = (first + second + third) / 3.f;
+
+				TEST_CHECK(1.f - glm::length(center) < 0.25f);
+				TEST_CHECK(glm::dot(glm::cross(second - first, third - first), center) >= 0.f);
+			}
+
+			previousCount = static_cast<uint32_t>(simplifiedIndices.size());
+		}
+	}
+}
+
+//----------------------------------------------------------------
+
+int		main()
+{
+	return TestFramework::Run({	{ "MeshOptimizer vertex cache statistics", TestAnalyzeVertexCache },
+								{ "MeshOptimizer weld vertices", TestWeldVertices },
+								{ "MeshOptimizer Forsyth vertex cache order", TestOptimizeVertexCache },
+								{ "MeshOptimizer vertex fetch order", TestOptimizeVertexFetch },
+								{ "MeshOptimizer quadric simplification of a plane", TestSimplifyPlane },
+								{ "MeshOptimizer quadric simplification of a sphere", TestSimplifySphere } });
+}
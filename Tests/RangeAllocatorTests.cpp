@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <random>
+
+#include "RangeAllocator.h"
+
+#include "TestFramework.h"
+
+//----------------------------------------------------------------
+
+using namespace Lightlyy;
+
+//----------------------------------------------------------------
+
+namespace
+{
+	void	TestFirstFit()
+	{
+		RangeAllocator	allocator;
+		allocator.Reset(100);
+
+		TEST_CHECK(allocator.Allocate(10) == 0);
+		TEST_CHECK(allocator.Allocate(20) == 10);
+		TEST_CHECK(allocator.Allocate(30) == 30);
+		TEST_CHECK(allocator.GetUsedCount() == 60);
+
+		// the hole left by the first range is reused before the end of the capacity
+		allocator.Free(0, 10);
+		TEST_CHECK(allocator.Allocate(5) == 0);
+		TEST_CHECK(allocator.Allocate(10) == 60);
+		TEST_CHECK(allocator.Allocate(5) == 5);
+
+		TEST_CHECK(allocator.Allocate(31) == UINT32_MAX);
+		TEST_CHECK(allocator.Allocate(30) == 70);
+		TEST_CHECK(allocator.Allocate(1) == UINT32_MAX);
+		TEST_CHECK(allocator.GetUsedCount() == allocator.GetCapacity());
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestMerges()
+	{
+		RangeAllocator	allocator;
+		allocator.Reset(40);
+
+		for (uint32_t rangeIndex = 0; rangeIndex < 4; ++rangeIndex)
+			TEST_CHECK(allocator.Allocate(10) == rangeIndex * 10);
+
+		// with the next free range, then the previous one, then both
+		allocator.Free(20, 10);
+		allocator.Free(30, 10);
+		TEST_CHECK(allocator.Allocate(20) == 20);
+		allocator.Free(20, 20);
+
+		allocator.Free(0, 10);
+		allocator.Free(10, 10);
+		TEST_CHECK(allocator.GetUsedCount() == 0);
+
+		// a single range is left when every neighbour merged
+		TEST_CHECK(allocator.Allocate(40) == 0);
+	}
+
+	//----------------------------------------------------------------
+
+	void	TestEmptyRanges()
+	{
+		RangeAllocator	allocator;
+
+		TEST_CHECK(allocator.Allocate(1) == UINT32_MAX);
+
+		allocator.Reset(8);
+		TEST_CHECK(allocator.Allocate(0) == 0);
+		allocator.Free(0, 0);
+		TEST_CHECK(allocator.GetUsedCount() == 0);
+		TEST_CHECK(allocator.Allocate(8) == 0);
+	}
+
+	//----------------------------------------------------------------
+
+	// random allocations and frees against an array of owners, no element may be given twice
+	void	TestRandomAgainstReference()
+	{
+		const uint32_t			capacity = 4096;
+
+		RangeAllocator			allocator;
+		allocator.Reset(capacity);
+
+		struct Allocation
+		{
+			uint32_t	m_First;
+			uint32_t	m_Count;
+		};
+
+		std::vector<Allocation>	allocations;
+		std::vector<bool>		usedElements(capacity, false);
+		uint32_t				usedCount = 0;
+
+		std::mt19937			random(7);
+
+		for (uint32_t iteration = 0; iteration < 20000; ++iteration)
+		{
+			if (allocations.empty() || random() % 3 != 0)
+			{
+				const uint32_t	count = 1 + random() % 64;
+				const uint32_t	first = allocator.Allocate(count);
+
+				if (first == UINT32_MAX)
+				{
+					// only fails when no hole of the requested size is left
+					uint32_t	longestFreeCount = 0;
+					uint32_t	freeCount = 0;
+					for (uint32_t element = 0; element < capacity; ++element)
+					{
+						freeCount = usedElements[element] ? 0 : freeCount + 1;
+						longestFreeCount = std::max(longestFreeCount, freeCount);
+					}
+
+					TEST_CHECK(longestFreeCount < count);
+					continue;
+				}
+
+				if (!TEST_CHECK(first + count <= capacity))
+					return;
+
+				for (uint32_t element = first; element < first + count; ++element)
+				{
+					TEST_CHECK(!usedElements[element]);
+					usedElements[element] = true;
+				}
+
+				allocations.push_back({ first, count });
+				usedCount += count;
+			}
+			else
+			{
+				const uint32_t		allocationIndex = random() % static_cast<uint32_t>(allocations.size());
+				const Allocation	allocation = allocations[allocationIndex];
+
+				allocator.Free(allocation.m_First, allocation.m_Count);
+
+				for (uint32_t element = allocation.m_First; element < allocation.m_First + allocation.m_Count; ++element)
+					usedElements[element] = false;
+
+				allocations[allocationIndex] = allocations.back();
+				allocations.pop_back();
+				usedCount -= allocation.m_Count;
+			}
+
+			TEST_CHECK(allocator.GetUsedCount() == usedCount);
+		}
+
+		for (const Allocation &allocation : allocations)
+			allocator.Free(allocation.m_First, allocation.m_Count);
+
+		// every range merged back
+		TEST_CHECK(allocator.GetUsedCount() == 0);
+		TEST_CHECK(allocator.Allocate(capacity) == 0);
+	}
+}
+
+//----------------------------------------------------------------
+
+int		main()
+{
+	return TestFramework::Run({	{ "RangeAllocator first fit", TestFirstFit },
+								{ "RangeAllocator merges", TestMerges },
+								{ "RangeAllocator empty ranges", TestEmptyRanges },
+								{ "RangeAllocator random against reference", TestRandomAgainstReference } });
+}
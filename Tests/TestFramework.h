@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+//----------------------------------------------------------------
+
+// each test executable lists its cases and returns the failed checks count, ctest runs them one by one
+#define TEST_CHECK(condition) TestFramework::Check((condition), #condition, __FILE__, __LINE__)
+
+//----------------------------------------------------------------
+
+namespace TestFramework
+{
+
+//----------------------------------------------------------------
+
+struct TestCase
+{
+	const char	*m_Name;
+	void		(*m_Function)();
+}; // struct TestCase
+
+//----------------------------------------------------------------
+
+inline uint32_t&	GetFailuresCount()
+{
+	static uint32_t	failuresCount = 0;
+	return failuresCount;
+}
+
+//----------------------------------------------------------------
+
+inline bool		Check(bool condition, const char *text, const char *file, uint32_t line)
+{
+	if (!condition)
+	{
+		std::cout << file << "(" << line << "): check failed: " << text << std::endl;
+		++GetFailuresCount();
+	}
+
+	return condition;
+}
+
+//----------------------------------------------------------------
+
+inline int		Run(const std::vector<TestCase> &testCases)
+{
+	const uint32_t	testCasesCount = static_cast<uint32_t>(testCases.size());
+	for (uint32_t testCaseIndex = 0; testCaseIndex < testCasesCount; ++testCaseIndex)
+	{
+		const uint32_t	previousFailuresCount = GetFailuresCount();
+
+		testCases[testCaseIndex].m_Function();
+
+		std::cout << ((GetFailuresCount() == previousFailuresCount) ? "[ passed ] " : "[ failed ] ") << testCases[testCaseIndex].m_Name << std::endl;
+	}
+
+	return (GetFailuresCount() == 0) ? 0 : 1;
+}
+
+//----------------------------------------------------------------
+
+} // namespace TestFramework